@@ -0,0 +1,653 @@
+// Load / benchmark client for fsx_core
+// Usage:
+//   connect: ./bench_load connect <total_connections> <concurrency> [host] [port]
+//   upload:  ./bench_load upload <sender> <sender_pass> <receiver> <receiver_pass> <streams> <mb_per_stream> [host] [port]
+//   striped: ./bench_load striped <sender> <sender_pass> <receiver> <receiver_pass> <stripes> <mb> [host] [port]
+//   relay:   ./bench_load relay <sender> <sender_pass> <receiver> <receiver_pass> <streams> <mb_per_stream> [host] [port]
+//   login:   ./bench_load login <username> <password> <concurrent_logins> [host] [port]
+//   fetch:   ./bench_load fetch <receiver> <receiver_pass> <transfer_id> <concurrency> <repeat> [host] [port]
+//
+// connect: every connection does TCP connect -> PING -> PONG -> close, reports connections/sec.
+// login:   opens <concurrent_logins> connections, fires LOGIN_REQ on all of them at once and
+//          reports LOGIN_RESP latency p50/p99 (login storm against the auth worker pool).
+// upload:  <streams> parallel transfers from sender to receiver, reports aggregate chunk MB/s.
+//          Senders offer FILE_FEATURE_ACK and keep at most the server's window in flight
+//          and the last transfer_id (feed it to fetch).
+// relay:   like upload, but each stream's receiver accepts with FILE_ACCEPT_RELAY on its own
+//          connection and reads the chunks as they are forwarded; reports MB/s as seen by
+//          the receivers (sender -> core -> receiver at wire speed).
+// striped: one transfer whose chunks are dealt round-robin over <stripes> sender connections
+//          (chunk i on connection i % stripes); reports MB/s for the whole file.
+// fetch:   <concurrency> receiver connections each download a completed transfer <repeat>
+//          times with FILE_FETCH_REQ, reports aggregate GB/s.
+// Run scripts/bench_io_threads.sh to sweep FSX_IO_THREADS on the server side.
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+
+static constexpr uint32_t MAGIC = 0x46535831; // FSX1
+static constexpr uint8_t VERSION = 1;
+static constexpr uint32_t CHUNK_SIZE = 256 * 1024; // 256KB (server max)
+static constexpr uint32_t FILE_FEATURE_ACK = 0x00000001; // FILE_CHUNK_ACK + window
+
+#pragma pack(push, 1)
+struct Header {
+  uint32_t magic_be;
+  uint8_t  version;
+  uint8_t  type;
+  uint32_t len_be;
+  uint16_t reserved_be;
+};
+#pragma pack(pop)
+
+using boost::asio::ip::tcp;
+
+static uint64_t be64(uint64_t x) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap64(x);
+#else
+  return x;
+#endif
+}
+
+static void put_u16(std::vector<uint8_t>& out, uint16_t v) {
+  uint16_t be = htons(v);
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(&be), reinterpret_cast<const uint8_t*>(&be) + 2);
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+  uint32_t be = htonl(v);
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(&be), reinterpret_cast<const uint8_t*>(&be) + 4);
+}
+
+static void put_u64(std::vector<uint8_t>& out, uint64_t v) {
+  uint64_t be = be64(v);
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(&be), reinterpret_cast<const uint8_t*>(&be) + 8);
+}
+
+static void put_str(std::vector<uint8_t>& out, const std::string& s) {
+  put_u16(out, static_cast<uint16_t>(s.size()));
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+static void write_frame(tcp::socket& sock, uint8_t type, const std::vector<uint8_t>& payload) {
+  Header h{};
+  h.magic_be = htonl(MAGIC);
+  h.version = VERSION;
+  h.type = type;
+  h.len_be = htonl(static_cast<uint32_t>(payload.size()));
+  h.reserved_be = htons(0);
+  std::vector<boost::asio::const_buffer> bufs{boost::asio::buffer(&h, sizeof(h)), boost::asio::buffer(payload)};
+  boost::asio::write(sock, bufs);
+}
+
+// Reads one frame, returns its type and fills payload
+static uint8_t read_frame(tcp::socket& sock, std::vector<uint8_t>& payload) {
+  Header h{};
+  boost::asio::read(sock, boost::asio::buffer(&h, sizeof(h)));
+  if (ntohl(h.magic_be) != MAGIC || h.version != VERSION) throw std::runtime_error("bad header");
+  payload.resize(ntohl(h.len_be));
+  if (!payload.empty()) boost::asio::read(sock, boost::asio::buffer(payload));
+  return h.type;
+}
+
+static uint8_t expect_frame(tcp::socket& sock, uint8_t type, std::vector<uint8_t>& payload) {
+  uint8_t t = read_frame(sock, payload);
+  if (t != type) {
+    throw std::runtime_error("expected type " + std::to_string(type) + ", got " + std::to_string(t));
+  }
+  return t;
+}
+
+static void login(tcp::socket& sock, const std::string& username, const std::string& password) {
+  std::vector<uint8_t> p;
+  put_str(p, username);
+  put_str(p, password);
+  write_frame(sock, 12, p); // LOGIN_REQ
+  expect_frame(sock, 13, p); // LOGIN_RESP
+  if (p.empty() || p[0] == 0) throw std::runtime_error("login failed for " + username);
+}
+
+// Sender-side FILE_CHUNK_ACK bookkeeping for one connection. Indexed by
+// chunk, since a striped connection only sends every Nth chunk; acks cover
+// the whole transfer, so chunks sent elsewhere (chunk_len 0) are skipped.
+struct SendWindow {
+  bool enabled = false;
+  uint32_t window_bytes = 0;
+  std::vector<uint32_t> chunk_len;
+  std::vector<bool> acked;
+  uint32_t cumulative = 0;
+  uint64_t outstanding = 0;
+
+  void on_sent(uint32_t index, uint32_t len) {
+    if (chunk_len.size() <= index) {
+      chunk_len.resize(index + 1, 0);
+      acked.resize(index + 1, false);
+    }
+    chunk_len[index] = len;
+    outstanding += len;
+  }
+
+  void ack(uint32_t index) {
+    if (index >= acked.size() || acked[index] || chunk_len[index] == 0) return;
+    acked[index] = true;
+    outstanding -= chunk_len[index];
+  }
+
+  void on_ack(const std::vector<uint8_t>& p) {
+    if (p.size() < 18) throw std::runtime_error("FILE_CHUNK_ACK too short");
+    uint32_t cum = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 8));
+    window_bytes = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 12));
+    uint16_t sack_len = ntohs(*reinterpret_cast<const uint16_t*>(p.data() + 16));
+    if (size_t{18} + sack_len > p.size()) throw std::runtime_error("FILE_CHUNK_ACK bad sack_len");
+    for (; cumulative < cum; cumulative++) ack(cumulative);
+    for (uint32_t bit = 0; bit < sack_len * 8u; bit++) {
+      if ((p[18 + bit / 8] >> (bit % 8)) & 1) ack(cum + 1 + bit);
+    }
+  }
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static int run_connect(int total, int concurrency, const std::string& host, uint16_t port) {
+  boost::asio::io_context io;
+  tcp::resolver resolver(io);
+  auto endpoints = resolver.resolve(host, std::to_string(port));
+
+  std::atomic<int> next{0};
+  std::atomic<int> ok{0};
+  std::atomic<int> failed{0};
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int w = 0; w < concurrency; w++) {
+    workers.emplace_back([&]() {
+      boost::asio::io_context wio;
+      std::vector<uint8_t> p;
+      while (next.fetch_add(1) < total) {
+        try {
+          tcp::socket sock(wio);
+          boost::asio::connect(sock, endpoints);
+          write_frame(sock, 2, {'p', 'i', 'n', 'g'}); // PING
+          expect_frame(sock, 3, p);                    // PONG
+          ok++;
+        } catch (const std::exception&) {
+          failed++;
+        }
+      }
+    });
+  }
+  for (auto& t : workers) t.join();
+  double secs = seconds_since(t0);
+
+  std::cout << "[connect] total=" << total << " concurrency=" << concurrency
+            << " ok=" << ok << " failed=" << failed
+            << " secs=" << secs << " conn_per_sec=" << (ok / secs) << "\n";
+  return failed == 0 ? 0 : 1;
+}
+
+// Receiver side of one relayed stream: reads FILE_CHUNKs until FILE_DONE
+static uint64_t drain_relay(tcp::socket& rsock, uint64_t transfer_id) {
+  std::vector<uint8_t> p;
+  uint64_t got = 0;
+  for (;;) {
+    uint8_t t = read_frame(rsock, p);
+    if (t == 35) break; // FILE_DONE
+    if (t != 34 || p.size() < 12) throw std::runtime_error("unexpected frame " + std::to_string(t));
+    if (be64(*reinterpret_cast<const uint64_t*>(p.data())) != transfer_id) {
+      throw std::runtime_error("chunk for another transfer");
+    }
+    got += p.size() - 12;
+  }
+  return got;
+}
+
+static int run_upload(const std::string& sender, const std::string& sender_pass,
+                      const std::string& receiver, const std::string& receiver_pass,
+                      int streams, int mb_per_stream, const std::string& host, uint16_t port,
+                      bool relay) {
+  boost::asio::io_context io;
+  tcp::resolver resolver(io);
+  auto endpoints = resolver.resolve(host, std::to_string(port));
+
+  // One receiver connection accepts every stream's transfer
+  tcp::socket rsock(io);
+  boost::asio::connect(rsock, endpoints);
+  login(rsock, receiver, receiver_pass);
+  std::mutex rmu;
+
+  const uint64_t file_size = static_cast<uint64_t>(mb_per_stream) * 1024 * 1024;
+  std::atomic<uint64_t> bytes_sent{0};
+  std::atomic<uint64_t> bytes_relayed{0};
+  std::atomic<uint64_t> last_transfer_id{0};
+  std::atomic<int> failed{0};
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int s = 0; s < streams; s++) {
+    workers.emplace_back([&, s]() {
+      try {
+        boost::asio::io_context wio;
+        tcp::socket sock(wio);
+        boost::asio::connect(sock, endpoints);
+        login(sock, sender, sender_pass);
+
+        std::vector<uint8_t> p;
+        put_u64(p, 0);
+        put_str(p, receiver);
+        put_str(p, "bench_" + std::to_string(s) + ".bin");
+        put_u64(p, file_size);
+        put_u32(p, CHUNK_SIZE);
+        put_u32(p, FILE_FEATURE_ACK);
+        write_frame(sock, 30, p); // FILE_OFFER_REQ
+        expect_frame(sock, 31, p); // FILE_OFFER_RESP
+        if (p.size() < 9 || p[0] != 0) throw std::runtime_error("offer rejected");
+        uint64_t transfer_id = be64(*reinterpret_cast<const uint64_t*>(p.data() + 1));
+        SendWindow win;
+        if (p.size() >= 17) {
+          win.enabled = (ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 9)) & FILE_FEATURE_ACK) != 0;
+          win.window_bytes = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 13));
+        }
+
+        // relay: a dedicated receiver connection, drained by its own thread
+        tcp::socket relay_sock(wio);
+        std::thread drainer;
+        std::string drain_error;
+        struct DrainGuard {
+          tcp::socket& sock;
+          std::thread& t;
+          ~DrainGuard() {  // error path: unblock the drainer before joining
+            if (!t.joinable()) return;
+            boost::system::error_code ec;
+            sock.shutdown(tcp::socket::shutdown_both, ec);
+            t.join();
+          }
+        } drain_guard{relay_sock, drainer};
+        if (relay) {
+          boost::asio::connect(relay_sock, endpoints);
+          login(relay_sock, receiver, receiver_pass);
+          std::vector<uint8_t> a;
+          put_u64(a, transfer_id);
+          a.push_back(1);
+          a.push_back(0x01); // FILE_ACCEPT_RELAY
+          write_frame(relay_sock, 32, a); // FILE_ACCEPT_REQ
+          expect_frame(relay_sock, 33, a); // FILE_ACCEPT_RESP
+          drainer = std::thread([&]() {
+            try {
+              bytes_relayed += drain_relay(relay_sock, transfer_id);
+            } catch (const std::exception& e) {
+              drain_error = e.what();
+            }
+          });
+        } else {
+          std::lock_guard<std::mutex> lock(rmu);
+          std::vector<uint8_t> a;
+          put_u64(a, transfer_id);
+          a.push_back(1);
+          write_frame(rsock, 32, a); // FILE_ACCEPT_REQ
+          expect_frame(rsock, 33, a); // FILE_ACCEPT_RESP
+        }
+        expect_frame(sock, 33, p); // FILE_ACCEPT_RESP (forwarded to sender)
+
+        std::vector<uint8_t> chunk;
+        uint32_t index = 0;
+        for (uint64_t off = 0; off < file_size; off += CHUNK_SIZE) {
+          uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(CHUNK_SIZE, file_size - off));
+          while (win.enabled && win.outstanding > 0 && win.outstanding + n > win.window_bytes) {
+            expect_frame(sock, 39, p); // FILE_CHUNK_ACK
+            win.on_ack(p);
+          }
+          chunk.clear();
+          put_u64(chunk, transfer_id);
+          put_u32(chunk, index++);
+          chunk.resize(12 + n, static_cast<uint8_t>(s));
+          write_frame(sock, 34, chunk); // FILE_CHUNK
+          if (win.enabled) win.on_sent(index - 1, n);
+          bytes_sent += n;
+        }
+
+        p.clear();
+        put_u64(p, transfer_id);
+        put_u32(p, index);
+        put_u64(p, file_size);
+        write_frame(sock, 35, p); // FILE_DONE
+        uint8_t t;
+        while ((t = read_frame(sock, p)) == 39) {} // acks still in front of the result
+        if (t != 36) throw std::runtime_error("expected FILE_RESULT, got " + std::to_string(t));
+        if (drainer.joinable()) drainer.join();
+        if (!drain_error.empty()) throw std::runtime_error("relay receiver: " + drain_error);
+        if (p.size() < 9 || p[8] != 0) throw std::runtime_error("transfer failed");
+        last_transfer_id = transfer_id;
+      } catch (const std::exception& e) {
+        std::cerr << "[upload] stream " << s << " error: " << e.what() << "\n";
+        failed++;
+      }
+    });
+  }
+  for (auto& t : workers) t.join();
+  double secs = seconds_since(t0);
+
+  double mb = (relay ? bytes_relayed : bytes_sent) / (1024.0 * 1024.0);
+  std::cout << (relay ? "[relay]" : "[upload]") << " streams=" << streams << " mb_per_stream=" << mb_per_stream
+            << " failed=" << failed << " secs=" << secs
+            << " aggregate_mb_per_sec=" << (mb / secs)
+            << " last_transfer_id=" << last_transfer_id << "\n";
+  return failed == 0 ? 0 : 1;
+}
+
+static int run_striped(const std::string& sender, const std::string& sender_pass,
+                       const std::string& receiver, const std::string& receiver_pass,
+                       int stripes, int mb, const std::string& host, uint16_t port) {
+  boost::asio::io_context io;
+  tcp::resolver resolver(io);
+  auto endpoints = resolver.resolve(host, std::to_string(port));
+
+  const uint64_t file_size = static_cast<uint64_t>(mb) * 1024 * 1024;
+  const uint32_t total_chunks = static_cast<uint32_t>((file_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+  // Connection 0 offers and finishes the transfer; all of them carry chunks
+  std::vector<std::unique_ptr<tcp::socket>> socks;
+  for (int s = 0; s < stripes; s++) {
+    socks.push_back(std::make_unique<tcp::socket>(io));
+    boost::asio::connect(*socks.back(), endpoints);
+    login(*socks.back(), sender, sender_pass);
+  }
+  tcp::socket rsock(io);
+  boost::asio::connect(rsock, endpoints);
+  login(rsock, receiver, receiver_pass);
+
+  std::vector<uint8_t> p;
+  put_u64(p, 0);
+  put_str(p, receiver);
+  put_str(p, "striped.bin");
+  put_u64(p, file_size);
+  put_u32(p, CHUNK_SIZE);
+  put_u32(p, FILE_FEATURE_ACK);
+  write_frame(*socks[0], 30, p); // FILE_OFFER_REQ
+  expect_frame(*socks[0], 31, p); // FILE_OFFER_RESP
+  if (p.size() < 9 || p[0] != 0) throw std::runtime_error("offer rejected");
+  uint64_t transfer_id = be64(*reinterpret_cast<const uint64_t*>(p.data() + 1));
+  bool acks = p.size() >= 17 && (ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 9)) & FILE_FEATURE_ACK);
+  uint32_t window = p.size() >= 17 ? ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 13)) : 0;
+
+  std::vector<uint8_t> a;
+  put_u64(a, transfer_id);
+  a.push_back(1);
+  write_frame(rsock, 32, a); // FILE_ACCEPT_REQ
+  expect_frame(rsock, 33, a); // FILE_ACCEPT_RESP
+  expect_frame(*socks[0], 33, p); // FILE_ACCEPT_RESP (forwarded to sender)
+
+  std::atomic<int> failed{0};
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int s = 0; s < stripes; s++) {
+    workers.emplace_back([&, s]() {
+      try {
+        tcp::socket& sock = *socks[s];
+        SendWindow win;
+        win.enabled = acks;
+        win.window_bytes = window;
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> ack;
+        for (uint32_t index = s; index < total_chunks; index += stripes) {
+          uint64_t off = static_cast<uint64_t>(index) * CHUNK_SIZE;
+          uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(CHUNK_SIZE, file_size - off));
+          // The transfer's window is shared between the stripes
+          while (win.enabled && win.outstanding > 0 &&
+                 win.outstanding + n > std::max<uint64_t>(win.window_bytes / stripes, CHUNK_SIZE)) {
+            expect_frame(sock, 39, ack); // FILE_CHUNK_ACK
+            win.on_ack(ack);
+          }
+          chunk.clear();
+          put_u64(chunk, transfer_id);
+          put_u32(chunk, index);
+          chunk.resize(12 + n, static_cast<uint8_t>(index));
+          write_frame(sock, 34, chunk); // FILE_CHUNK
+          if (win.enabled) win.on_sent(index, n);
+        }
+        // Don't leave unread acks behind (closing would reset the connection),
+        // except on connection 0, which still reads up to FILE_RESULT
+        while (s != 0 && win.enabled && win.outstanding > 0) {
+          expect_frame(sock, 39, ack);
+          win.on_ack(ack);
+        }
+      } catch (const std::exception& e) {
+        std::cerr << "[striped] stripe " << s << " error: " << e.what() << "\n";
+        failed++;
+      }
+    });
+  }
+  for (auto& t : workers) t.join();
+
+  // The server holds FILE_DONE until every stripe's chunks are stored
+  p.clear();
+  put_u64(p, transfer_id);
+  put_u32(p, total_chunks);
+  put_u64(p, file_size);
+  write_frame(*socks[0], 35, p); // FILE_DONE
+  uint8_t t;
+  while ((t = read_frame(*socks[0], p)) == 39) {} // acks still in front of the result
+  if (t != 36 || p.size() < 9 || p[8] != 0) failed++;
+  double secs = seconds_since(t0);
+
+  double mbytes = file_size / (1024.0 * 1024.0);
+  std::cout << "[striped] stripes=" << stripes << " mb=" << mb << " failed=" << failed
+            << " secs=" << secs << " mb_per_sec=" << (mbytes / secs)
+            << " transfer_id=" << transfer_id << "\n";
+  return failed == 0 ? 0 : 1;
+}
+
+static int run_fetch(const std::string& receiver, const std::string& receiver_pass,
+                     uint64_t transfer_id, int concurrency, int repeat,
+                     const std::string& host, uint16_t port) {
+  boost::asio::io_context io;
+  tcp::resolver resolver(io);
+  auto endpoints = resolver.resolve(host, std::to_string(port));
+
+  std::atomic<uint64_t> bytes_recv{0};
+  std::atomic<int> failed{0};
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int c = 0; c < concurrency; c++) {
+    workers.emplace_back([&, c]() {
+      try {
+        boost::asio::io_context wio;
+        tcp::socket sock(wio);
+        boost::asio::connect(sock, endpoints);
+        login(sock, receiver, receiver_pass);
+
+        std::vector<uint8_t> p;
+        for (int r = 0; r < repeat; r++) {
+          p.clear();
+          put_u64(p, transfer_id);
+          write_frame(sock, 37, p); // FILE_FETCH_REQ
+          expect_frame(sock, 38, p); // FILE_FETCH_RESP
+          if (p.size() < 9 || p[0] != 0) throw std::runtime_error("fetch rejected");
+          uint64_t file_size = be64(*reinterpret_cast<const uint64_t*>(p.data() + 9));
+
+          uint64_t got = 0;
+          for (;;) {
+            uint8_t t = read_frame(sock, p);
+            if (t == 35) break; // FILE_DONE
+            if (t != 34 || p.size() < 12) throw std::runtime_error("unexpected frame " + std::to_string(t));
+            got += p.size() - 12;
+          }
+          if (got != file_size) throw std::runtime_error("short fetch");
+          bytes_recv += got;
+        }
+      } catch (const std::exception& e) {
+        std::cerr << "[fetch] conn " << c << " error: " << e.what() << "\n";
+        failed++;
+      }
+    });
+  }
+  for (auto& t : workers) t.join();
+  double secs = seconds_since(t0);
+
+  double gb = bytes_recv / (1024.0 * 1024.0 * 1024.0);
+  std::cout << "[fetch] concurrency=" << concurrency << " repeat=" << repeat
+            << " failed=" << failed << " secs=" << secs << " gb=" << gb
+            << " aggregate_gb_per_sec=" << (gb / secs) << "\n";
+  return failed == 0 ? 0 : 1;
+}
+
+struct LoginProbe {
+  tcp::socket sock;
+  Header h{};
+  std::vector<uint8_t> payload;
+  std::chrono::steady_clock::time_point sent;
+  explicit LoginProbe(boost::asio::io_context& io) : sock(io) {}
+};
+
+static int run_login(const std::string& username, const std::string& password,
+                     int concurrency, const std::string& host, uint16_t port) {
+  boost::asio::io_context io;
+  tcp::resolver resolver(io);
+  auto endpoints = resolver.resolve(host, std::to_string(port));
+
+  // Connect everything up front so only LOGIN handling is measured
+  std::vector<std::unique_ptr<LoginProbe>> probes;
+  probes.reserve(concurrency);
+  for (int i = 0; i < concurrency; i++) {
+    auto p = std::make_unique<LoginProbe>(io);
+    boost::asio::connect(p->sock, endpoints);
+    probes.push_back(std::move(p));
+  }
+
+  std::vector<uint8_t> req_payload;
+  put_str(req_payload, username);
+  put_str(req_payload, password);
+  Header req_h{};
+  req_h.magic_be = htonl(MAGIC);
+  req_h.version = VERSION;
+  req_h.type = 12; // LOGIN_REQ
+  req_h.len_be = htonl(static_cast<uint32_t>(req_payload.size()));
+  std::vector<uint8_t> frame(sizeof(req_h));
+  std::memcpy(frame.data(), &req_h, sizeof(req_h));
+  frame.insert(frame.end(), req_payload.begin(), req_payload.end());
+
+  std::vector<double> latencies_ms;
+  latencies_ms.reserve(concurrency);
+  int ok = 0;
+  int failed = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (auto& up : probes) {
+    LoginProbe* p = up.get();
+    p->sent = std::chrono::steady_clock::now();
+    boost::asio::async_write(p->sock, boost::asio::buffer(frame),
+      [&, p](boost::system::error_code ec, std::size_t) {
+        if (ec) { failed++; return; }
+        boost::asio::async_read(p->sock, boost::asio::buffer(&p->h, sizeof(p->h)),
+          [&, p](boost::system::error_code ec, std::size_t) {
+            if (ec || p->h.type != 13) { failed++; return; } // LOGIN_RESP
+            p->payload.resize(ntohl(p->h.len_be));
+            boost::asio::async_read(p->sock, boost::asio::buffer(p->payload),
+              [&, p](boost::system::error_code ec, std::size_t) {
+                if (ec || p->payload.empty() || p->payload[0] == 0) { failed++; return; }
+                latencies_ms.push_back(seconds_since(p->sent) * 1000.0);
+                ok++;
+              });
+          });
+      });
+  }
+  io.run();
+  double secs = seconds_since(t0);
+
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  auto pct = [&](double q) {
+    if (latencies_ms.empty()) return 0.0;
+    size_t i = static_cast<size_t>(q * (latencies_ms.size() - 1));
+    return latencies_ms[i];
+  };
+  std::cout << "[login] concurrency=" << concurrency << " ok=" << ok << " failed=" << failed
+            << " secs=" << secs << " logins_per_sec=" << (ok / secs)
+            << " p50_ms=" << pct(0.50) << " p99_ms=" << pct(0.99)
+            << " max_ms=" << (latencies_ms.empty() ? 0.0 : latencies_ms.back()) << "\n";
+  return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage:\n";
+    std::cerr << "  " << argv[0] << " connect <total_connections> <concurrency> [host] [port]\n";
+    std::cerr << "  " << argv[0] << " upload <sender> <sender_pass> <receiver> <receiver_pass> <streams> <mb_per_stream> [host] [port]\n";
+    std::cerr << "  " << argv[0] << " striped <sender> <sender_pass> <receiver> <receiver_pass> <stripes> <mb> [host] [port]\n";
+    std::cerr << "  " << argv[0] << " relay <sender> <sender_pass> <receiver> <receiver_pass> <streams> <mb_per_stream> [host] [port]\n";
+    std::cerr << "  " << argv[0] << " login <username> <password> <concurrent_logins> [host] [port]\n";
+    std::cerr << "  " << argv[0] << " fetch <receiver> <receiver_pass> <transfer_id> <concurrency> <repeat> [host] [port]\n";
+    return 1;
+  }
+
+  std::string cmd = argv[1];
+  std::string host = "127.0.0.1";
+  uint16_t port = 9000;
+
+  try {
+    if (cmd == "connect") {
+      if (argc < 4) {
+        std::cerr << "Error: connect requires total_connections and concurrency\n";
+        return 1;
+      }
+      if (argc >= 5) host = argv[4];
+      if (argc >= 6) port = static_cast<uint16_t>(std::stoi(argv[5]));
+      return run_connect(std::stoi(argv[2]), std::stoi(argv[3]), host, port);
+    }
+    if (cmd == "upload" || cmd == "relay") {
+      if (argc < 8) {
+        std::cerr << "Error: " << cmd << " requires sender, sender_pass, receiver, receiver_pass, streams and mb_per_stream\n";
+        return 1;
+      }
+      if (argc >= 9) host = argv[8];
+      if (argc >= 10) port = static_cast<uint16_t>(std::stoi(argv[9]));
+      return run_upload(argv[2], argv[3], argv[4], argv[5],
+                        std::stoi(argv[6]), std::stoi(argv[7]), host, port, cmd == "relay");
+    }
+    if (cmd == "striped") {
+      if (argc < 8) {
+        std::cerr << "Error: striped requires sender, sender_pass, receiver, receiver_pass, stripes and mb\n";
+        return 1;
+      }
+      if (argc >= 9) host = argv[8];
+      if (argc >= 10) port = static_cast<uint16_t>(std::stoi(argv[9]));
+      return run_striped(argv[2], argv[3], argv[4], argv[5],
+                         std::stoi(argv[6]), std::stoi(argv[7]), host, port);
+    }
+    if (cmd == "login") {
+      if (argc < 5) {
+        std::cerr << "Error: login requires username, password and concurrent_logins\n";
+        return 1;
+      }
+      if (argc >= 6) host = argv[5];
+      if (argc >= 7) port = static_cast<uint16_t>(std::stoi(argv[6]));
+      return run_login(argv[2], argv[3], std::stoi(argv[4]), host, port);
+    }
+    if (cmd == "fetch") {
+      if (argc < 7) {
+        std::cerr << "Error: fetch requires receiver, receiver_pass, transfer_id, concurrency and repeat\n";
+        return 1;
+      }
+      if (argc >= 8) host = argv[7];
+      if (argc >= 9) port = static_cast<uint16_t>(std::stoi(argv[8]));
+      return run_fetch(argv[2], argv[3], std::stoull(argv[4]),
+                       std::stoi(argv[5]), std::stoi(argv[6]), host, port);
+    }
+    std::cerr << "Error: Unknown command '" << cmd << "'\n";
+    return 1;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+}
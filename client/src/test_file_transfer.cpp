@@ -2,8 +2,20 @@
 // Usage:
 //   send: ./test_file_transfer send <username> <password> <receiver_username> <filepath> [host] [port]
 //   recv: ./test_file_transfer recv <username> <password> <transfer_id> <output_path> [host] [port]
+//   resume: ./test_file_transfer resume <username> <password> <transfer_id> <filepath> [host] [port]
+//     (sender reconnecting to an unfinished upload: sends only the chunks the
+//     server doesn't have yet)
+//   send-dedup: same arguments as send; offers SHA-256 hashes of the chunks
+//     first (FILE_FEATURE_DEDUP) and sends only those the server lacks
+// Uploads compress chunks with zlib when the server agrees
+// (FILE_FEATURE_COMPRESS) and a sample of the chunk compresses well.
 
 #include <boost/asio.hpp>
+#include <openssl/evp.h>
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include <cstring>
@@ -14,6 +26,17 @@
 static constexpr uint32_t MAGIC = 0x46535831; // FSX1
 static constexpr uint8_t VERSION = 1;
 static constexpr uint32_t DEFAULT_CHUNK_SIZE = 256 * 1024; // 256KB
+static constexpr uint32_t FILE_FEATURE_ACK = 0x00000001;   // FILE_CHUNK_ACK + window
+static constexpr uint32_t FILE_FEATURE_DEDUP = 0x00000002; // content-addressed blocks
+static constexpr uint32_t FILE_FEATURE_INTEGRITY = 0x00000004; // chunk CRC-32C + file SHA-256
+static constexpr uint32_t FILE_FEATURE_NACK = 0x00000008;  // FILE_NACK resend requests
+static constexpr uint32_t FILE_FEATURE_COMPRESS = 0x00000010; // per-chunk codec header
+static constexpr uint8_t CODEC_ZLIB = 1;
+
+struct OfferedBlock {
+  std::array<uint8_t, 32> sha256;
+  uint32_t length;
+};
 
 #pragma pack(push, 1)
 struct Header {
@@ -83,7 +106,8 @@ static std::vector<uint8_t> make_login_req(const std::string& username, const st
 static std::vector<uint8_t> make_file_offer_req(const std::string& receiver_username,
                                                  const std::string& filename,
                                                  uint64_t file_size,
-                                                 uint32_t chunk_size) {
+                                                 uint32_t chunk_size,
+                                                 const std::vector<OfferedBlock>* blocks = nullptr) {
   std::vector<uint8_t> payload;
   
   // Client transfer ID (0 = server assigns)
@@ -113,6 +137,28 @@ static std::vector<uint8_t> make_file_offer_req(const std::string& receiver_user
   payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&chunk_size_be),
                  reinterpret_cast<const uint8_t*>(&chunk_size_be) + 4);
   
+  // Features: we pipeline against FILE_CHUNK_ACKs
+  uint32_t features_be = htonl(FILE_FEATURE_ACK | FILE_FEATURE_INTEGRITY | FILE_FEATURE_NACK |
+                                FILE_FEATURE_COMPRESS | (blocks ? FILE_FEATURE_DEDUP : 0));
+  payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&features_be),
+                 reinterpret_cast<const uint8_t*>(&features_be) + 4);
+  
+  // Dedup: u32 block_count, then {sha256, u32 length} per chunk
+  if (blocks) {
+    uint32_t count_be = htonl(static_cast<uint32_t>(blocks->size()));
+    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&count_be),
+                   reinterpret_cast<const uint8_t*>(&count_be) + 4);
+    for (const auto& b : *blocks) {
+      payload.insert(payload.end(), b.sha256.begin(), b.sha256.end());
+      uint32_t length_be = htonl(b.length);
+      payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&length_be),
+                     reinterpret_cast<const uint8_t*>(&length_be) + 4);
+    }
+  }
+  
+  // Compression: codecs we can produce, as bits (1 << codec)
+  payload.push_back(1u << CODEC_ZLIB);
+  
   return make_frame(30, payload); // FILE_OFFER_REQ = 30
 }
 
@@ -128,8 +174,56 @@ static std::vector<uint8_t> make_file_accept_req(uint64_t transfer_id, bool acce
   return make_frame(32, payload); // FILE_ACCEPT_REQ = 32
 }
 
+// CRC-32C (Castagnoli), bitwise table; only used for FILE_FEATURE_INTEGRITY
+static uint32_t crc32c(const uint8_t* p, size_t len) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82f63b78 & (0u - (c & 1)));
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t c = 0xffffffff;
+  for (size_t i = 0; i < len; i++) c = (c >> 8) ^ table[(c ^ p[i]) & 0xff];
+  return ~c;
+}
+
+// FILE_FEATURE_COMPRESS chunk body: u8 codec, u32 raw_len, then the data,
+// zlib-compressed if a 16 KiB sample shrinks to 90% or less and the whole
+// chunk does shrink, as it is otherwise (codec 0)
+static std::vector<uint8_t> encode_chunk(const std::vector<uint8_t>& data) {
+  auto deflate_into = [](const uint8_t* p, size_t len, std::vector<uint8_t>& out) {
+    uLongf n = compressBound(static_cast<uLong>(len));
+    out.resize(n);
+    if (compress2(out.data(), &n, p, static_cast<uLong>(len), 1) != Z_OK || n >= len) return false;
+    out.resize(n);
+    return true;
+  };
+  std::vector<uint8_t> packed;
+  size_t sample = std::min<size_t>(data.size(), 16 * 1024);
+  bool zlib = deflate_into(data.data(), sample, packed) && packed.size() * 10 <= sample * 9 &&
+              deflate_into(data.data(), data.size(), packed);
+  
+  std::vector<uint8_t> body(5);
+  body[0] = zlib ? CODEC_ZLIB : 0;
+  uint32_t raw_len_be = htonl(static_cast<uint32_t>(data.size()));
+  std::memcpy(body.data() + 1, &raw_len_be, 4);
+  if (zlib) {
+    body.insert(body.end(), packed.begin(), packed.end());
+  } else {
+    body.insert(body.end(), data.begin(), data.end());
+  }
+  return body;
+}
+
 static std::vector<uint8_t> make_file_chunk(uint64_t transfer_id, uint32_t chunk_index,
-                                             const std::vector<uint8_t>& data) {
+                                             const std::vector<uint8_t>& raw, bool with_crc = false,
+                                             bool compress = false) {
+  std::vector<uint8_t> encoded;
+  if (compress) encoded = encode_chunk(raw);
+  const std::vector<uint8_t>& data = compress ? encoded : raw;
   std::vector<uint8_t> payload;
   
   uint64_t transfer_id_be = htobe64_portable(transfer_id);
@@ -142,6 +236,13 @@ static std::vector<uint8_t> make_file_chunk(uint64_t transfer_id, uint32_t chunk
   
   payload.insert(payload.end(), data.begin(), data.end());
   
+  // FILE_FEATURE_INTEGRITY: u32 crc32c of the data (as sent) as the last 4 bytes
+  if (with_crc) {
+    uint32_t crc_be = htonl(crc32c(data.data(), data.size()));
+    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&crc_be),
+                   reinterpret_cast<const uint8_t*>(&crc_be) + 4);
+  }
+  
   return make_frame(34, payload); // FILE_CHUNK = 34
 }
 
@@ -185,6 +286,96 @@ static std::vector<uint8_t> read_payload(boost::asio::ip::tcp::socket& sock, uin
   return payload;
 }
 
+// Sender-side view of FILE_CHUNK_ACKs: which chunks the server has stored and
+// how many unacknowledged bytes we may have outstanding
+struct SendWindow {
+  bool enabled = false;
+  uint32_t window_bytes = 0;
+  std::vector<uint32_t> chunk_len;  // bytes of each chunk sent so far (0: not sent)
+  std::vector<bool> acked;
+  uint32_t cumulative = 0;          // chunks below this are acked
+  uint64_t outstanding = 0;         // sent but not acked
+
+  void on_sent(uint32_t index, uint32_t len) {
+    if (index >= chunk_len.size()) {
+      chunk_len.resize(index + 1, 0);
+      acked.resize(index + 1, false);
+    }
+    if (acked[index]) return;
+    outstanding -= chunk_len[index];  // a resend replaces the lost copy
+    chunk_len[index] = len;
+    outstanding += len;
+  }
+
+  void ack(uint32_t index) {
+    if (index >= acked.size() || acked[index] || chunk_len[index] == 0) return;
+    acked[index] = true;
+    outstanding -= chunk_len[index];
+  }
+
+  // payload: u64 transfer_id, u32 cumulative_ack, u32 window_bytes, u16 sack_len, sack
+  void on_ack(const std::vector<uint8_t>& p) {
+    if (p.size() < 18) throw std::runtime_error("FILE_CHUNK_ACK too short");
+    uint32_t cum = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 8));
+    window_bytes = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 12));
+    uint16_t sack_len = ntohs(*reinterpret_cast<const uint16_t*>(p.data() + 16));
+    if (size_t{18} + sack_len > p.size()) throw std::runtime_error("FILE_CHUNK_ACK bad sack_len");
+    for (; cumulative < cum; cumulative++) ack(cumulative);
+    for (uint32_t bit = 0; bit < sack_len * 8u; bit++) {
+      if ((p[18 + bit / 8] >> (bit % 8)) & 1) ack(cum + 1 + bit);
+    }
+  }
+};
+
+// Answers FILE_NACK: reads the chunks the server asks for again from the file
+// and resends them
+struct Resender {
+  std::ifstream file;
+  uint64_t transfer_id = 0;
+  uint64_t file_size = 0;
+  uint32_t chunk_size = DEFAULT_CHUNK_SIZE;
+  bool with_crc = false;
+  bool compress = false;
+
+  Resender(const std::string& filepath, uint64_t transfer_id, uint64_t file_size,
+           uint32_t chunk_size, bool with_crc, bool compress)
+    : file(filepath, std::ios::binary), transfer_id(transfer_id), file_size(file_size),
+      chunk_size(chunk_size), with_crc(with_crc), compress(compress) {}
+
+  // payload: u64 transfer_id, u8 reason, u16 range_count, range_count x {u32 first, u32 count}
+  void on_nack(boost::asio::ip::tcp::socket& sock, const std::vector<uint8_t>& p, SendWindow& win) {
+    if (p.size() < 11) throw std::runtime_error("FILE_NACK too short");
+    uint16_t range_count = ntohs(*reinterpret_cast<const uint16_t*>(p.data() + 9));
+    if (11 + static_cast<size_t>(range_count) * 8 > p.size()) {
+      throw std::runtime_error("FILE_NACK bad range_count");
+    }
+    uint32_t total_chunks = static_cast<uint32_t>((file_size + chunk_size - 1) / chunk_size);
+    std::vector<uint8_t> chunk_data;
+    uint32_t resent = 0;
+    for (uint16_t r = 0; r < range_count; r++) {
+      uint32_t first = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 11 + r * 8));
+      uint32_t count = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 15 + r * 8));
+      for (uint32_t i = first; i < total_chunks && i - first < count; i++) {
+        uint64_t offset = static_cast<uint64_t>(i) * chunk_size;
+        size_t len = static_cast<size_t>(std::min<uint64_t>(chunk_size, file_size - offset));
+        chunk_data.resize(len);
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char*>(chunk_data.data()), static_cast<std::streamsize>(len));
+        if (static_cast<size_t>(file.gcount()) != len) {
+          throw std::runtime_error("Short read at chunk " + std::to_string(i));
+        }
+        auto chunk_frame = make_file_chunk(transfer_id, i, chunk_data, with_crc, compress);
+        boost::asio::write(sock, boost::asio::buffer(chunk_frame));
+        if (win.enabled) win.on_sent(i, static_cast<uint32_t>(len));
+        resent++;
+      }
+    }
+    std::cout << "[SEND] FILE_NACK (reason " << (int)p[8] << "): resent " << resent << " chunk(s)\n";
+    std::cout.flush();
+  }
+};
+
 static bool do_login(boost::asio::ip::tcp::socket& sock, const std::string& username, const std::string& password) {
   std::cout << "[LOGIN] Sending LOGIN_REQ for " << username << "\n";
   auto frame = make_login_req(username, password);
@@ -211,9 +402,112 @@ static bool do_login(boost::asio::ip::tcp::socket& sock, const std::string& user
   return ok;
 }
 
+static std::array<uint8_t, 32> sha256_file(const std::string& filepath) {
+  std::ifstream file(filepath, std::ios::binary);
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+  std::vector<char> buf(1 << 20);
+  while (file.read(buf.data(), static_cast<std::streamsize>(buf.size())) || file.gcount() > 0) {
+    EVP_DigestUpdate(ctx, buf.data(), static_cast<size_t>(file.gcount()));
+  }
+  std::array<uint8_t, 32> out{};
+  EVP_DigestFinal_ex(ctx, out.data(), nullptr);
+  EVP_MD_CTX_free(ctx);
+  return out;
+}
+
+// Sends FILE_DONE and waits for FILE_RESULT; throws if the upload failed or
+// the server's SHA-256 of the file doesn't match filepath
+static void finish_upload(boost::asio::ip::tcp::socket& sock, SendWindow& win, Resender& resender,
+                          uint64_t transfer_id, uint32_t total_chunks, uint64_t file_size,
+                          const std::string& filepath) {
+  std::cout << "[SEND] Sending FILE_DONE (total_chunks=" << total_chunks << ")\n";
+  auto done_frame = make_file_done(transfer_id, total_chunks, file_size);
+  boost::asio::write(sock, boost::asio::buffer(done_frame));
+  
+  // Wait for FILE_RESULT (acks for the last window may still be in front of it)
+  std::vector<uint8_t> result_payload;
+  for (;;) {
+    auto h = read_header(sock);
+    result_payload = read_payload(sock, ntohl(h.len_be));
+    if (h.type == 39 && win.enabled) { // FILE_CHUNK_ACK
+      win.on_ack(result_payload);
+      continue;
+    }
+    if (h.type == 42) { // FILE_NACK
+      resender.on_nack(sock, result_payload, win);
+      continue;
+    }
+    if (h.type != 36) { // FILE_RESULT
+      throw std::runtime_error("Expected FILE_RESULT, got type " + std::to_string(h.type));
+    }
+    break;
+  }
+
+  if (result_payload.size() < 9) {
+    throw std::runtime_error("FILE_RESULT too short");
+  }
+  
+  uint64_t result_transfer_id = be64toh_portable(*reinterpret_cast<const uint64_t*>(result_payload.data()));
+  bool result_ok = result_payload[8] == 0;
+  
+  if (result_ok) {
+    std::string path;
+    if (result_payload.size() >= 11) {
+      uint16_t path_len = ntohs(*reinterpret_cast<const uint16_t*>(result_payload.data() + 9));
+      if (11 + path_len <= result_payload.size()) {
+        path = std::string(reinterpret_cast<const char*>(result_payload.data() + 11), path_len);
+      }
+      // u8[32] sha256 follows the path on FILE_FEATURE_INTEGRITY transfers
+      if (11 + path_len + 32 <= result_payload.size()) {
+        auto local = sha256_file(filepath);
+        if (std::memcmp(local.data(), result_payload.data() + 11 + path_len, 32) != 0) {
+          throw std::runtime_error("SHA-256 mismatch: the server stored a different file");
+        }
+        std::cout << "[SEND] SHA-256 verified\n";
+      }
+    }
+    std::cout << "[SEND] SUCCESS! File saved at: " << path << "\n";
+  } else {
+    std::string reason;
+    if (result_payload.size() >= 11) {
+      uint16_t reason_len = ntohs(*reinterpret_cast<const uint16_t*>(result_payload.data() + 9));
+      if (11 + reason_len <= result_payload.size()) {
+        reason = std::string(reinterpret_cast<const char*>(result_payload.data() + 11), reason_len);
+      }
+    }
+    throw std::runtime_error("FILE_RESULT failed: " + reason);
+  }
+}
+
+// One block per DEFAULT_CHUNK_SIZE chunk, the same cut do_send uses
+static std::vector<OfferedBlock> hash_chunks(const std::string& filepath, uint64_t file_size) {
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open file: " + filepath);
+  }
+  std::vector<OfferedBlock> blocks;
+  std::vector<uint8_t> buf(DEFAULT_CHUNK_SIZE);
+  for (uint64_t off = 0; off < file_size; off += DEFAULT_CHUNK_SIZE) {
+    size_t len = static_cast<size_t>(std::min<uint64_t>(DEFAULT_CHUNK_SIZE, file_size - off));
+    file.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(len));
+    if (static_cast<size_t>(file.gcount()) != len) {
+      throw std::runtime_error("Short read while hashing at offset " + std::to_string(off));
+    }
+    OfferedBlock b;
+    b.length = static_cast<uint32_t>(len);
+    if (EVP_Digest(buf.data(), len, b.sha256.data(), nullptr, EVP_sha256(), nullptr) != 1) {
+      throw std::runtime_error("SHA-256 failed");
+    }
+    blocks.push_back(b);
+  }
+  return blocks;
+}
+
 static void do_send(boost::asio::ip::tcp::socket& sock,
                     const std::string& receiver_username,
-                    const std::string& filepath) {
+                    const std::string& filepath,
+                    bool dedup = false) {
   // Check file exists
   if (!std::filesystem::exists(filepath)) {
     throw std::runtime_error("File not found: " + filepath);
@@ -231,9 +525,18 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
     throw std::runtime_error("Failed to open file: " + filepath);
   }
   
+  std::vector<OfferedBlock> blocks;
+  if (dedup) {
+    auto t0 = std::chrono::steady_clock::now();
+    blocks = hash_chunks(filepath, file_size);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[SEND] Hashed " << blocks.size() << " chunks in " << secs << " s\n";
+  }
+  
   // Send FILE_OFFER_REQ
   std::cout << "[SEND] Sending FILE_OFFER_REQ...\n";
-  auto offer_frame = make_file_offer_req(receiver_username, filename, file_size, DEFAULT_CHUNK_SIZE);
+  auto offer_frame = make_file_offer_req(receiver_username, filename, file_size, DEFAULT_CHUNK_SIZE,
+                                         dedup ? &blocks : nullptr);
   boost::asio::write(sock, boost::asio::buffer(offer_frame));
   
   // Read FILE_OFFER_RESP
@@ -250,6 +553,38 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
   bool ok = resp_payload[0] == 0;
   uint64_t transfer_id = be64toh_portable(*reinterpret_cast<const uint64_t*>(resp_payload.data() + 1));
   
+  // u32 features + u32 window_bytes follow when the server speaks FILE_CHUNK_ACK
+  // then, for FILE_FEATURE_DEDUP, u32 block_count + a bitmap of blocks the server has
+  SendWindow win;
+  std::vector<bool> present;
+  bool with_crc = false;
+  bool compress = false;
+  if (ok && resp_payload.size() >= 17) {
+    uint32_t features = ntohl(*reinterpret_cast<const uint32_t*>(resp_payload.data() + 9));
+    win.enabled = (features & FILE_FEATURE_ACK) != 0;
+    with_crc = (features & FILE_FEATURE_INTEGRITY) != 0;
+    win.window_bytes = ntohl(*reinterpret_cast<const uint32_t*>(resp_payload.data() + 13));
+    size_t pos = 17;
+    if ((features & FILE_FEATURE_DEDUP) && resp_payload.size() >= 21) {
+      uint32_t block_count = ntohl(*reinterpret_cast<const uint32_t*>(resp_payload.data() + 17));
+      if (block_count != blocks.size() || 21 + (block_count + 7) / 8 > resp_payload.size()) {
+        throw std::runtime_error("FILE_OFFER_RESP bad block bitmap");
+      }
+      present.resize(block_count);
+      for (uint32_t i = 0; i < block_count; i++) present[i] = (resp_payload[21 + i / 8] >> (i % 8)) & 1;
+      pos = 21 + (block_count + 7) / 8;
+    } else if (dedup) {
+      std::cout << "[SEND] Server doesn't deduplicate; sending the whole file\n";
+    }
+    // then, for FILE_FEATURE_COMPRESS, the u8 codec granted
+    if (features & FILE_FEATURE_COMPRESS) {
+      if (pos >= resp_payload.size() || resp_payload[pos] != CODEC_ZLIB) {
+        throw std::runtime_error("FILE_OFFER_RESP bad codec");
+      }
+      compress = true;
+    }
+  }
+  
   if (!ok) {
     std::string reason;
     if (resp_payload.size() >= 11) {
@@ -262,6 +597,12 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
   }
   
   std::cout << "[SEND] Transfer ID: " << transfer_id << "\n";
+  if (win.enabled) {
+    std::cout << "[SEND] Flow control: FILE_CHUNK_ACK, window=" << win.window_bytes << " bytes\n";
+  }
+  if (compress) {
+    std::cout << "[SEND] Compression: zlib, adaptive per chunk\n";
+  }
   std::cout.flush();
   std::cout << "[SEND] >>> Receiver should run: recv <receiver_username> <receiver_password> " << transfer_id << " <output_path>\n";
   std::cout.flush();
@@ -293,11 +634,13 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
   
   std::cout << "[SEND] Accepted! Sending chunks...\n";
   std::cout.flush();
+  Resender resender(filepath, transfer_id, file_size, DEFAULT_CHUNK_SIZE, with_crc, compress);
   
   // Send chunks
   std::vector<uint8_t> chunk_data(DEFAULT_CHUNK_SIZE);
   uint32_t chunk_index = 0;
   uint64_t total_sent = 0;
+  uint64_t skipped_bytes = 0;
   
   // Reset file to beginning (in case it was read before)
   file.clear();
@@ -327,13 +670,36 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
       chunk_data.resize(bytes_read);
     }
     
+    // Already stored on the server: nothing to send
+    if (chunk_index < present.size() && present[chunk_index]) {
+      total_sent += bytes_read;
+      skipped_bytes += bytes_read;
+      chunk_index++;
+      continue;
+    }
+    
+    // Pipeline up to the window; with nothing outstanding one chunk may always go
+    while (win.enabled && win.outstanding > 0 && win.outstanding + bytes_read > win.window_bytes) {
+      h = read_header(sock);
+      auto ack_payload = read_payload(sock, ntohl(h.len_be));
+      if (h.type == 42) { // FILE_NACK
+        resender.on_nack(sock, ack_payload, win);
+        continue;
+      }
+      if (h.type != 39) { // FILE_CHUNK_ACK
+        throw std::runtime_error("Expected FILE_CHUNK_ACK, got type " + std::to_string(h.type));
+      }
+      win.on_ack(ack_payload);
+    }
+    
     std::cout << "[SEND] Sending chunk " << chunk_index << " (" << bytes_read << " bytes)...\n";
     std::cout.flush();
     
-    auto chunk_frame = make_file_chunk(transfer_id, chunk_index, chunk_data);
+    auto chunk_frame = make_file_chunk(transfer_id, chunk_index, chunk_data, with_crc, compress);
     boost::asio::write(sock, boost::asio::buffer(chunk_frame));
     
     total_sent += bytes_read;
+    if (win.enabled) win.on_sent(chunk_index, static_cast<uint32_t>(bytes_read));
     std::cout << "[SEND] Chunk " << chunk_index << " sent: " << bytes_read << " bytes (total: " << total_sent << "/" << file_size << ")\n";
     std::cout.flush();
     
@@ -352,6 +718,9 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
   }
   
   std::cout << "[SEND] Chunk loop finished. Total chunks sent: " << chunk_index << ", total bytes: " << total_sent << "/" << file_size << "\n";
+  if (!present.empty()) {
+    std::cout << "[SEND] Dedup: skipped " << skipped_bytes << " bytes the server already had\n";
+  }
   std::cout.flush();
   
   // Calculate total_chunks correctly: ceil(file_size / chunk_size)
@@ -369,43 +738,123 @@ static void do_send(boost::asio::ip::tcp::socket& sock,
       total_chunks = chunk_index;
     }
   }
-  std::cout << "[SEND] Sending FILE_DONE (total_chunks=" << total_chunks << ")\n";
-  auto done_frame = make_file_done(transfer_id, total_chunks, file_size);
-  boost::asio::write(sock, boost::asio::buffer(done_frame));
+  finish_upload(sock, win, resender, transfer_id, total_chunks, file_size, filepath);
+}
+
+static std::vector<uint8_t> make_file_resume_req(uint64_t transfer_id) {
+  std::vector<uint8_t> payload(8);
+  uint64_t transfer_id_be = htobe64_portable(transfer_id);
+  std::memcpy(payload.data(), &transfer_id_be, 8);
+  return make_frame(40, payload); // FILE_RESUME_REQ
+}
+
+static void do_resume(boost::asio::ip::tcp::socket& sock, uint64_t transfer_id, const std::string& filepath) {
+  std::cout << "[RESUME] Sending FILE_RESUME_REQ transfer_id=" << transfer_id << "\n";
+  auto req_frame = make_file_resume_req(transfer_id);
+  boost::asio::write(sock, boost::asio::buffer(req_frame));
   
-  // Wait for FILE_RESULT
-  h = read_header(sock);
-  if (h.type != 36) { // FILE_RESULT
-    throw std::runtime_error("Expected FILE_RESULT, got type " + std::to_string(h.type));
+  auto h = read_header(sock);
+  if (h.type != 41) { // FILE_RESUME_RESP
+    throw std::runtime_error("Expected FILE_RESUME_RESP, got type " + std::to_string(h.type));
+  }
+  auto p = read_payload(sock, ntohl(h.len_be));
+  if (p.size() < 9) {
+    throw std::runtime_error("FILE_RESUME_RESP too short");
+  }
+  if (p[0] != 0) {
+    std::string reason;
+    if (p.size() >= 11) {
+      uint16_t reason_len = ntohs(*reinterpret_cast<const uint16_t*>(p.data() + 9));
+      if (11 + reason_len <= p.size()) {
+        reason = std::string(reinterpret_cast<const char*>(p.data() + 11), reason_len);
+      }
+    }
+    throw std::runtime_error("FILE_RESUME failed: " + reason);
   }
   
-  auto result_payload = read_payload(sock, ntohl(h.len_be));
-  if (result_payload.size() < 9) {
-    throw std::runtime_error("FILE_RESULT too short");
+  // u64 file_size, u32 chunk_size, u32 total_chunks, u32 features, u32 window_bytes,
+  // u32 range_count, range_count x {u32 first, u32 count}, u8 codec (FILE_FEATURE_COMPRESS)
+  if (p.size() < 37) {
+    throw std::runtime_error("FILE_RESUME_RESP missing file info");
+  }
+  uint64_t file_size = be64toh_portable(*reinterpret_cast<const uint64_t*>(p.data() + 9));
+  uint32_t chunk_size = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 17));
+  uint32_t total_chunks = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 21));
+  uint32_t features = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 25));
+  SendWindow win;
+  win.enabled = (features & FILE_FEATURE_ACK) != 0;
+  bool with_crc = (features & FILE_FEATURE_INTEGRITY) != 0;
+  win.window_bytes = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 29));
+  uint32_t range_count = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 33));
+  if (37 + static_cast<size_t>(range_count) * 8 > p.size()) {
+    throw std::runtime_error("FILE_RESUME_RESP bad range_count");
+  }
+  std::vector<bool> have(total_chunks, false);
+  for (uint32_t r = 0; r < range_count; r++) {
+    uint32_t first = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 37 + r * 8));
+    uint32_t count = ntohl(*reinterpret_cast<const uint32_t*>(p.data() + 41 + r * 8));
+    for (uint32_t i = first; i < total_chunks && i - first < count; i++) have[i] = true;
+  }
+  size_t codec_pos = 37 + static_cast<size_t>(range_count) * 8;
+  bool compress = (features & FILE_FEATURE_COMPRESS) != 0;
+  if (compress && (codec_pos >= p.size() || p[codec_pos] != CODEC_ZLIB)) {
+    throw std::runtime_error("FILE_RESUME_RESP bad codec");
   }
   
-  uint64_t result_transfer_id = be64toh_portable(*reinterpret_cast<const uint64_t*>(result_payload.data()));
-  bool result_ok = result_payload[8] == 0;
+  if (!std::filesystem::exists(filepath) || std::filesystem::file_size(filepath) != file_size) {
+    throw std::runtime_error("Local file doesn't match the transfer (" + std::to_string(file_size) + " bytes): " + filepath);
+  }
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open file: " + filepath);
+  }
   
-  if (result_ok) {
-    std::string path;
-    if (result_payload.size() >= 11) {
-      uint16_t path_len = ntohs(*reinterpret_cast<const uint16_t*>(result_payload.data() + 9));
-      if (11 + path_len <= result_payload.size()) {
-        path = std::string(reinterpret_cast<const char*>(result_payload.data() + 11), path_len);
-      }
+  std::cout << "[RESUME] Server has " << range_count << " range(s); sending the rest of "
+            << total_chunks << " chunks\n";
+  std::cout.flush();
+  
+  Resender resender(filepath, transfer_id, file_size, chunk_size, with_crc, compress);
+  std::vector<uint8_t> chunk_data(chunk_size);
+  uint64_t sent_bytes = 0;
+  uint64_t skipped_bytes = 0;
+  for (uint32_t i = 0; i < total_chunks; i++) {
+    uint64_t offset = static_cast<uint64_t>(i) * chunk_size;
+    size_t len = static_cast<size_t>(std::min<uint64_t>(chunk_size, file_size - offset));
+    if (have[i]) {
+      skipped_bytes += len;
+      continue;
     }
-    std::cout << "[SEND] SUCCESS! File saved at: " << path << "\n";
-  } else {
-    std::string reason;
-    if (result_payload.size() >= 11) {
-      uint16_t reason_len = ntohs(*reinterpret_cast<const uint16_t*>(result_payload.data() + 9));
-      if (11 + reason_len <= result_payload.size()) {
-        reason = std::string(reinterpret_cast<const char*>(result_payload.data() + 11), reason_len);
+    
+    chunk_data.resize(len);
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char*>(chunk_data.data()), static_cast<std::streamsize>(len));
+    if (static_cast<size_t>(file.gcount()) != len) {
+      throw std::runtime_error("Short read at chunk " + std::to_string(i));
+    }
+    
+    while (win.enabled && win.outstanding > 0 && win.outstanding + len > win.window_bytes) {
+      h = read_header(sock);
+      auto ack_payload = read_payload(sock, ntohl(h.len_be));
+      if (h.type == 42) { // FILE_NACK
+        resender.on_nack(sock, ack_payload, win);
+        continue;
+      }
+      if (h.type != 39) { // FILE_CHUNK_ACK
+        throw std::runtime_error("Expected FILE_CHUNK_ACK, got type " + std::to_string(h.type));
       }
+      win.on_ack(ack_payload);
     }
-    throw std::runtime_error("FILE_RESULT failed: " + reason);
+    
+    auto chunk_frame = make_file_chunk(transfer_id, i, chunk_data, with_crc, compress);
+    boost::asio::write(sock, boost::asio::buffer(chunk_frame));
+    if (win.enabled) win.on_sent(i, static_cast<uint32_t>(len));
+    sent_bytes += len;
   }
+  
+  std::cout << "[RESUME] Sent " << sent_bytes << " bytes, skipped " << skipped_bytes
+            << " bytes already on the server\n";
+  std::cout.flush();
+  finish_upload(sock, win, resender, transfer_id, total_chunks, file_size, filepath);
 }
 
 static void do_recv(boost::asio::ip::tcp::socket& sock, uint64_t transfer_id, const std::string& output_path) {
@@ -451,6 +900,8 @@ int main(int argc, char** argv) {
     std::cerr << "Usage:\n";
     std::cerr << "  send: " << argv[0] << " send <username> <password> <receiver_username> <filepath> [host] [port]\n";
     std::cerr << "  recv: " << argv[0] << " recv <username> <password> [host] [port]\n";
+    std::cerr << "  resume: " << argv[0] << " resume <username> <password> <transfer_id> <filepath> [host] [port]\n";
+    std::cerr << "  send-dedup: " << argv[0] << " send-dedup <username> <password> <receiver_username> <filepath> [host] [port]\n";
     return 1;
   }
   
@@ -465,7 +916,7 @@ int main(int argc, char** argv) {
   uint64_t transfer_id = 0;
   std::string output_path;
   
-  if (cmd == "send") {
+  if (cmd == "send" || cmd == "send-dedup") {
     if (argc < 6) {
       std::cerr << "Error: send requires receiver_username and filepath\n";
       return 1;
@@ -483,8 +934,17 @@ int main(int argc, char** argv) {
     output_path = argv[5];
     if (argc >= 7) host = argv[6];
     if (argc >= 8) port = static_cast<uint16_t>(std::stoi(argv[7]));
+  } else if (cmd == "resume") {
+    if (argc < 6) {
+      std::cerr << "Error: resume requires transfer_id and filepath\n";
+      return 1;
+    }
+    transfer_id = std::stoull(argv[4]);
+    filepath = argv[5];
+    if (argc >= 7) host = argv[6];
+    if (argc >= 8) port = static_cast<uint16_t>(std::stoi(argv[7]));
   } else {
-    std::cerr << "Error: Unknown command '" << cmd << "' (use 'send' or 'recv')\n";
+    std::cerr << "Error: Unknown command '" << cmd << "' (use 'send', 'send-dedup', 'recv' or 'resume')\n";
     return 1;
   }
   
@@ -503,10 +963,12 @@ int main(int argc, char** argv) {
       return 1;
     }
     
-    if (cmd == "send") {
-      do_send(sock, receiver_username, filepath);
+    if (cmd == "send" || cmd == "send-dedup") {
+      do_send(sock, receiver_username, filepath, cmd == "send-dedup");
     } else if (cmd == "recv") {
       do_recv(sock, transfer_id, output_path);
+    } else if (cmd == "resume") {
+      do_resume(sock, transfer_id, filepath);
     }
     
     return 0;
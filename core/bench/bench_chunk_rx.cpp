@@ -0,0 +1,129 @@
+// FILE_CHUNK receive path: old (body_ vector per frame + FileChunk::deserialize
+// copy) versus the fast path in TcpSession::do_read_file_chunk (sub-header and
+// data read straight into a reused buffer). Both write through FileStore, so
+// the difference is the receive side only.
+// A writer thread streams framed chunks over a local socketpair; global
+// operator new is counted to report allocations per chunk.
+//
+// Usage: bench_chunk_rx [total_mb] [chunk_kb]
+//   defaults: 512 MB, 64 KiB chunks
+
+#include "fsx/protocol/message.h"
+#include "fsx/protocol/file_messages.h"
+#include "fsx/storage/file_store.h"
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(std::size_t n) {
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using boost::asio::local::stream_protocol;
+namespace proto = fsx::protocol;
+
+static void writer(stream_protocol::socket& sock, size_t chunks, size_t chunk_size) {
+  std::vector<uint8_t> frame(sizeof(proto::MessageHeaderWire) + 12 + chunk_size, 0xab);
+  auto h = proto::make_header(proto::MsgType::FILE_CHUNK, static_cast<uint32_t>(12 + chunk_size));
+  std::memcpy(frame.data(), &h, sizeof(h));
+  uint64_t tid = htobe64(1);
+  std::memcpy(frame.data() + sizeof(h), &tid, 8);
+  for (size_t i = 0; i < chunks; i++) {
+    uint32_t idx = htonl(static_cast<uint32_t>(i));
+    std::memcpy(frame.data() + sizeof(h) + 8, &idx, 4);
+    boost::asio::write(sock, boost::asio::buffer(frame));
+  }
+}
+
+struct Result {
+  double mb_per_sec;
+  double allocs_per_chunk;
+};
+
+template <typename Receive>
+static Result run(size_t chunks, size_t chunk_size, Receive receive) {
+  boost::asio::io_context io;
+  stream_protocol::socket rx(io), tx(io);
+  boost::asio::local::connect_pair(rx, tx);
+
+  fsx::storage::FileStore store("./bench_chunk_rx_tmp");
+  store.initialize();
+  auto fh = store.open_for_write(1, "sink.bin", chunks * chunk_size, static_cast<uint32_t>(chunk_size));
+  if (!fh) throw std::runtime_error("open_for_write failed");
+
+  std::thread w([&]() { writer(tx, chunks, chunk_size); });
+
+  uint64_t allocs_before = g_allocs.load();
+  auto t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < chunks; i++) receive(rx, store, *fh);
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  uint64_t allocs = g_allocs.load() - allocs_before;
+
+  w.join();
+  store.finalize_file(1, "sink.bin", *fh);
+  store.cleanup_transfer(1);
+
+  return Result{(chunks * chunk_size) / secs / (1024.0 * 1024.0),
+                static_cast<double>(allocs) / chunks};
+}
+
+int main(int argc, char** argv) {
+  size_t total_mb = argc >= 2 ? std::stoul(argv[1]) : 512;
+  size_t chunk_size = (argc >= 3 ? std::stoul(argv[2]) : 64) * 1024;
+  size_t chunks = total_mb * 1024 * 1024 / chunk_size;
+  if (chunks == 0) chunks = 1;
+
+  proto::MessageHeaderWire header{};
+  std::vector<uint8_t> body;
+
+  // Old path: fresh zeroed body per frame, then deserialize copies the data
+  auto legacy = [&](stream_protocol::socket& s, fsx::storage::FileStore& store, fsx::storage::WriteHandle& fh) {
+    boost::asio::read(s, boost::asio::buffer(&header, sizeof(header)));
+    body.assign(proto::payload_len(header), 0);
+    boost::asio::read(s, boost::asio::buffer(body));
+    proto::FileChunk chunk = proto::FileChunk::deserialize(body);
+    store.write_chunk(fh, chunk.chunk_index, chunk.data.data(), chunk.data.size());
+  };
+
+  // Fast path: one scatter read into the sub-header and a reused buffer
+  uint8_t chunk_hdr[12];
+  std::vector<uint8_t> chunk_buf;
+  auto fast = [&](stream_protocol::socket& s, fsx::storage::FileStore& store, fsx::storage::WriteHandle& fh) {
+    boost::asio::read(s, boost::asio::buffer(&header, sizeof(header)));
+    size_t data_len = proto::payload_len(header) - sizeof(chunk_hdr);
+    if (chunk_buf.size() < data_len) chunk_buf.resize(data_len);
+    std::array<boost::asio::mutable_buffer, 2> bufs = {
+      boost::asio::buffer(chunk_hdr, sizeof(chunk_hdr)),
+      boost::asio::buffer(chunk_buf.data(), data_len),
+    };
+    boost::asio::read(s, bufs);
+    uint32_t chunk_index_be;
+    std::memcpy(&chunk_index_be, chunk_hdr + 8, 4);
+    store.write_chunk(fh, ntohl(chunk_index_be), chunk_buf.data(), data_len);
+  };
+
+  try {
+    std::cout << "path,chunk_bytes,chunks,mb_per_sec,allocs_per_chunk\n";
+    Result a = run(chunks, chunk_size, legacy);
+    std::cout << "legacy," << chunk_size << "," << chunks << "," << a.mb_per_sec << "," << a.allocs_per_chunk << "\n";
+    Result b = run(chunks, chunk_size, fast);
+    std::cout << "fast," << chunk_size << "," << chunks << "," << b.mb_per_sec << "," << b.allocs_per_chunk << "\n";
+  } catch (const std::exception& e) {
+    std::cerr << "fatal: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+// Protocol codec cost per message, in ns: encode (serialize()) and decode
+// (deserialize(), and the View decoders that don't copy the payload) for the
+// messages on the hot and the chatty paths.
+//
+// Usage: bench_codec [iterations]
+//   default: 2,000,000 per case
+
+#include "fsx/protocol/auth_messages.h"
+#include "fsx/protocol/file_messages.h"
+#include "fsx/protocol/online_messages.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+namespace proto = fsx::protocol;
+
+// Keeps results observable so the loops aren't optimized away
+static volatile uint64_t g_sink;
+
+template <typename T>
+static uint64_t keep(const T& v) {
+  asm volatile("" : : "g"(&v) : "memory");
+  return 1;
+}
+
+template <typename Fn>
+static double ns_per_op(size_t iters, Fn&& fn) {
+  uint64_t sink = 0;
+  auto t0 = Clock::now();
+  for (size_t i = 0; i < iters; i++) sink += fn();
+  double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+  g_sink = sink;
+  return secs * 1e9 / double(iters);
+}
+
+template <typename Msg>
+static void run(const char* name, const Msg& msg, size_t iters) {
+  std::vector<uint8_t> wire = msg.serialize();
+  double enc = ns_per_op(iters, [&] { return msg.serialize().size(); });
+  if constexpr (requires { Msg::deserialize(wire); }) {
+    double dec = ns_per_op(iters, [&] { return keep(Msg::deserialize(wire)); });
+    std::printf("%-28s %7zu B   encode %8.1f ns   decode %8.1f ns\n", name, wire.size(), enc, dec);
+  } else {
+    // Server-to-client only: the server never decodes it
+    std::printf("%-28s %7zu B   encode %8.1f ns\n", name, wire.size(), enc);
+  }
+}
+
+template <typename View>
+static void run_view(const char* name, const std::vector<uint8_t>& wire, size_t iters) {
+  double dec = ns_per_op(iters, [&] { return keep(View::decode(wire)); });
+  std::printf("%-28s %7zu B                        view   %8.1f ns\n", name, wire.size(), dec);
+}
+
+int main(int argc, char** argv) {
+  size_t iters = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+  std::mt19937_64 rng(42);
+
+  proto::FileChunkAck ack;
+  ack.transfer_id = 7;
+  ack.cumulative_ack = 1000;
+  ack.window_bytes = 8 << 20;
+  ack.sack.resize(64);
+  for (auto& b : ack.sack) b = static_cast<uint8_t>(rng());
+
+  proto::FileOfferReq offer;
+  offer.receiver_username = "bob";
+  offer.filename = "dataset-2024-archive.tar";
+  offer.file_size = 1ull << 30;
+  offer.chunk_size = 1 << 20;
+  offer.features = proto::FILE_FEATURE_DEDUP | proto::FILE_FEATURE_COMPRESS;
+  offer.codecs = 0x02;
+  offer.blocks.resize(1024);
+  for (auto& b : offer.blocks) {
+    for (auto& x : b.sha256) x = static_cast<uint8_t>(rng());
+    b.length = 1 << 20;
+  }
+
+  proto::LoginResp login;
+  login.ok = true;
+  login.token = std::string(64, 'a');
+  login.user_id = 12345;
+  login.username = "alice";
+  login.msg = "login ok";
+
+  proto::FileChunk chunk;
+  chunk.transfer_id = 7;
+  chunk.chunk_index = 3;
+  chunk.data.resize(256 * 1024);
+
+  proto::OnlineListResp online;
+  for (int i = 0; i < 100; i++) online.usernames.push_back("user" + std::to_string(i));
+
+  std::printf("%zu iterations per case\n", iters);
+  run("FILE_CHUNK_ACK (64B sack)", ack, iters);
+  run_view<proto::FileChunkAck::View>("FILE_CHUNK_ACK", ack.serialize(), iters);
+  run("FILE_OFFER_REQ (1024 blocks)", offer, iters / 100);
+  run("LOGIN_RESP", login, iters);
+  run("FILE_CHUNK (256K)", chunk, iters / 100);
+  run_view<proto::FileChunk::View>("FILE_CHUNK (256K)", chunk.serialize(), iters);
+  run("ONLINE_LIST_RESP (100)", online, iters / 10);
+  return 0;
+}
@@ -0,0 +1,123 @@
+// Per-chunk compression as FILE_FEATURE_COMPRESS does it: every chunk is
+// sampled (worth_compressing), compressed if the sample shrank, and
+// decompressed on the server. For each codec built in and each input:
+// ratio, compress / decompress speed, and the effective upload rate over a
+// link of the given speed, i.e. raw bytes per second when the slowest of
+// compress, wire and decompress sets the pace (they run pipelined).
+//
+// Usage: bench_compress [link_mbit] [chunk_kb] [file]
+//   defaults: 1000 Mbit/s, 256 KiB chunks; inputs are 64 MiB of generated
+//   CSV log lines ("text") and of random bytes ("compressed"), plus file if
+//   given
+
+#include "fsx/compress/chunk_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using fsx::compress::Codec;
+
+static std::vector<uint8_t> make_text(size_t size) {
+  static const char* levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+  static const char* paths[] = {"/api/v1/files", "/api/v1/login", "/api/v1/online", "/healthz"};
+  std::mt19937_64 rng(7);
+  std::string out;
+  out.reserve(size + 256);
+  uint64_t ts = 1700000000000;
+  while (out.size() < size) {
+    ts += rng() % 50;
+    out += std::to_string(ts) + "," + levels[rng() % 6] + ",core," + paths[rng() % 4] +
+           ",user" + std::to_string(rng() % 500) + "," + std::to_string(rng() % 100000) +
+           ",latency_ms=" + std::to_string(rng() % 900) + "\n";
+  }
+  out.resize(size);
+  return std::vector<uint8_t>(out.begin(), out.end());
+}
+
+static std::vector<uint8_t> make_random(size_t size) {
+  std::vector<uint8_t> buf(size);
+  std::mt19937_64 rng(42);
+  for (size_t i = 0; i + 8 <= buf.size(); i += 8) {
+    uint64_t v = rng();
+    std::memcpy(buf.data() + i, &v, 8);
+  }
+  return buf;
+}
+
+static void run(const char* input, const std::vector<uint8_t>& data, Codec codec, size_t chunk,
+                double link_bytes_per_sec) {
+  std::vector<std::vector<uint8_t>> packed;
+  std::vector<bool> compressed;
+  uint64_t wire = 0;
+
+  auto t0 = Clock::now();
+  for (size_t off = 0; off < data.size(); off += chunk) {
+    size_t len = std::min(chunk, data.size() - off);
+    std::vector<uint8_t> out;
+    bool ok = fsx::compress::worth_compressing(codec, data.data() + off, len) &&
+              fsx::compress::compress(codec, data.data() + off, len, &out);
+    if (!ok) out.assign(data.begin() + off, data.begin() + off + len);
+    wire += out.size() + 5;  // codec header
+    packed.push_back(std::move(out));
+    compressed.push_back(ok);
+  }
+  double compress_secs = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  std::vector<uint8_t> raw(chunk);
+  t0 = Clock::now();
+  size_t i = 0;
+  for (size_t off = 0; off < data.size(); off += chunk, i++) {
+    size_t len = std::min(chunk, data.size() - off);
+    Codec c = compressed[i] ? codec : Codec::NONE;
+    if (!fsx::compress::decompress(c, packed[i].data(), packed[i].size(), raw.data(), len) ||
+        std::memcmp(raw.data(), data.data() + off, len) != 0) {
+      std::cerr << "round trip FAILED at chunk " << i << "\n";
+      return;
+    }
+  }
+  double decompress_secs = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  size_t chunks_compressed = 0;
+  for (bool b : compressed) chunks_compressed += b;
+  double total = static_cast<double>(data.size());
+  double wire_secs = static_cast<double>(wire) / link_bytes_per_sec;
+  double slowest = std::max({compress_secs, wire_secs, decompress_secs});
+  std::cout << input << "," << fsx::compress::codec_name(codec) << ","
+            << total / static_cast<double>(wire) << ","
+            << chunks_compressed << "/" << compressed.size() << ","
+            << total / compress_secs / 1e6 << ","
+            << total / decompress_secs / 1e6 << ","
+            << total / slowest / 1e6 << "\n";
+}
+
+int main(int argc, char** argv) {
+  double link_mbit = argc >= 2 ? std::stod(argv[1]) : 1000.0;
+  size_t chunk = (argc >= 3 ? std::stoul(argv[2]) : 256) * 1024;
+  double link = link_mbit * 1e6 / 8;
+
+  std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs;
+  inputs.emplace_back("text", make_text(64u << 20));
+  inputs.emplace_back("compressed", make_random(64u << 20));
+  if (argc >= 4) {
+    std::ifstream in(argv[3], std::ios::binary);
+    inputs.emplace_back(argv[3], std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {}));
+  }
+
+  std::cout << "link " << link / 1e6 << " MB/s\n";
+  std::cout << "input,codec,ratio,chunks_compressed,compress_mb_s,decompress_mb_s,effective_mb_s\n";
+  for (const auto& [name, data] : inputs) {
+    if (data.empty()) continue;
+    for (Codec c : {Codec::NONE, Codec::ZLIB, Codec::LZ4, Codec::ZSTD}) {
+      if (!(fsx::compress::supported_codecs() & fsx::compress::codec_bit(c))) continue;
+      run(name.c_str(), data, c, chunk, link);
+    }
+  }
+  return 0;
+}
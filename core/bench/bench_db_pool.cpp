@@ -0,0 +1,88 @@
+// DbPool throughput benchmark: queries/sec versus pool size.
+// Needs a reachable postgres with the fsx schema (docker compose up -d db),
+// configured through the same FSX_DB_* variables as fsx_core.
+//
+// Usage: bench_db_pool [total_queries] [outstanding] [pool sizes...]
+//   defaults: 20000 queries, 256 outstanding, pool sizes 1 2 4 8 16
+
+#include "fsx/db/db_pool.h"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static std::string env_or(const char* k, const char* defv) {
+  const char* v = std::getenv(k);
+  return v ? std::string(v) : std::string(defv);
+}
+
+static double run(const fsx::db::DbConfig& cfg, size_t pool_size, int total, int outstanding) {
+  boost::asio::io_context io;
+  auto guard = boost::asio::make_work_guard(io);
+  fsx::db::DbPool pool(io, cfg, pool_size);
+  pool.connect();
+
+  std::vector<std::thread> threads;
+  unsigned n_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < n_threads; i++) threads.emplace_back([&io]() { io.run(); });
+
+  std::atomic<int> issued{0};
+  std::atomic<int> done{0};
+  std::atomic<int> errors{0};
+
+  // Same shape as the FILE_OFFER receiver lookup
+  const std::string sql = "SELECT id, username, email, pass_hash FROM users WHERE username = $1 LIMIT 1;";
+
+  std::function<void()> issue = [&]() {
+    if (issued.fetch_add(1) >= total) return;
+    pool.async_exec_params(sql, {"bench_user"}, [&](PGresult* r) {
+      if (!r || PQresultStatus(r) != PGRES_TUPLES_OK) errors++;
+      if (r) PQclear(r);
+      if (done.fetch_add(1) + 1 == total) {
+        guard.reset();
+        io.stop();
+        return;
+      }
+      issue();
+    });
+  };
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < outstanding; i++) issue();
+  for (auto& t : threads) t.join();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  if (errors) std::cerr << "  errors=" << errors << "\n";
+  return done / secs;
+}
+
+int main(int argc, char** argv) {
+  fsx::db::DbConfig cfg;
+  cfg.host = env_or("FSX_DB_HOST", "localhost");
+  cfg.port = std::stoi(env_or("FSX_DB_PORT", "5432"));
+  cfg.user = env_or("FSX_DB_USER", "fsx");
+  cfg.password = env_or("FSX_DB_PASSWORD", "fsxpass");
+  cfg.name = env_or("FSX_DB_NAME", "fsx");
+
+  int total = argc >= 2 ? std::stoi(argv[1]) : 20000;
+  int outstanding = argc >= 3 ? std::stoi(argv[2]) : 256;
+  std::vector<size_t> sizes;
+  for (int i = 3; i < argc; i++) sizes.push_back(std::stoul(argv[i]));
+  if (sizes.empty()) sizes = {1, 2, 4, 8, 16};
+
+  try {
+    std::cout << "pool_size,queries_per_sec\n";
+    for (size_t n : sizes) {
+      std::cout << n << "," << run(cfg, n, total, outstanding) << "\n";
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "fatal: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Per-call latency of the user lookup: text exec_params versus the named
+// prepared statement with binary parameters/results (what UserRepository uses).
+// Calls are sequential so the numbers are round trip + parse/plan + decode,
+// not pool throughput (see bench_db_pool for that).
+// Needs a reachable postgres with the fsx schema, configured through the same
+// FSX_DB_* variables as fsx_core.
+//
+// Usage: bench_db_prepared [calls] [username]
+//   defaults: 20000 calls, user "bench_user"
+
+#include "fsx/db/db_pool.h"
+#include "fsx/db/user_repository.h"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static std::string env_or(const char* k, const char* defv) {
+  const char* v = std::getenv(k);
+  return v ? std::string(v) : std::string(defv);
+}
+
+static const char* kSelectUserByUsername =
+    "SELECT id, username, email, pass_hash FROM users WHERE username = $1 LIMIT 1;";
+
+// Decodes like the pre-prepared repository did (text format, stoll)
+static long long decode_text(PGresult* r) {
+  if (PQntuples(r) == 0) return -1;
+  long long id = std::stoll(PQgetvalue(r, 0, 0));
+  std::string username = PQgetvalue(r, 0, 1);
+  std::string email = PQgetvalue(r, 0, 2);
+  std::string pass_hash = PQgetvalue(r, 0, 3);
+  return id + static_cast<long long>(username.size() + email.size() + pass_hash.size());
+}
+
+static long long decode_binary(PGresult* r) {
+  if (PQntuples(r) == 0) return -1;
+  long long id = fsx::db::pg_get_int8(r, 0, 0);
+  std::string username = fsx::db::pg_get_text(r, 0, 1);
+  std::string email = fsx::db::pg_get_text(r, 0, 2);
+  std::string pass_hash = fsx::db::pg_get_text(r, 0, 3);
+  return id + static_cast<long long>(username.size() + email.size() + pass_hash.size());
+}
+
+static void report(const char* mode, std::vector<double>& us) {
+  std::sort(us.begin(), us.end());
+  double sum = 0;
+  for (double v : us) sum += v;
+  auto pct = [&](double p) { return us[static_cast<size_t>(p * (us.size() - 1))]; };
+  std::cout << mode << "," << us.size() << "," << sum / us.size() << ","
+            << pct(0.50) << "," << pct(0.99) << "\n";
+}
+
+int main(int argc, char** argv) {
+  fsx::db::DbConfig cfg;
+  cfg.host = env_or("FSX_DB_HOST", "localhost");
+  cfg.port = std::stoi(env_or("FSX_DB_PORT", "5432"));
+  cfg.user = env_or("FSX_DB_USER", "fsx");
+  cfg.password = env_or("FSX_DB_PASSWORD", "fsxpass");
+  cfg.name = env_or("FSX_DB_NAME", "fsx");
+
+  int calls = argc >= 2 ? std::stoi(argv[1]) : 20000;
+  std::string username = argc >= 3 ? argv[2] : "bench_user";
+  if (calls <= 0) calls = 1;
+
+  boost::asio::io_context io;
+  auto guard = boost::asio::make_work_guard(io);
+  fsx::db::DbPool pool(io, cfg, 1);
+  fsx::db::UserRepository::prepare_statements(pool);
+
+  std::thread io_thread([&io]() { io.run(); });
+  int rc = 0;
+  try {
+    pool.connect();
+
+    std::vector<double> text_us, prep_us;
+    text_us.reserve(calls);
+    prep_us.reserve(calls);
+    long long sink = 0;
+
+    // Alternate the two paths so drift (cache warmup, autovacuum) hits both
+    for (int i = 0; i < calls; i++) {
+      auto t0 = Clock::now();
+      PGresult* r = pool.exec_params(kSelectUserByUsername, {username}).get();
+      fsx::db::must_ok(r, "text");
+      sink += decode_text(r);
+      PQclear(r);
+      auto t1 = Clock::now();
+
+      fsx::db::PgParams p;
+      p.text(username);
+      r = pool.exec_prepared("user_by_username", std::move(p)).get();
+      fsx::db::must_ok(r, "prepared");
+      sink += decode_binary(r);
+      PQclear(r);
+      auto t2 = Clock::now();
+
+      text_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+      prep_us.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+    }
+
+    std::cout << "mode,calls,avg_us,p50_us,p99_us\n";
+    report("text", text_us);
+    report("prepared_binary", prep_us);
+    if (sink < 0) std::cerr << "note: user " << username << " not found, rows were empty\n";
+  } catch (const std::exception& e) {
+    std::cerr << "fatal: " << e.what() << "\n";
+    rc = 1;
+  }
+
+  guard.reset();
+  io.stop();
+  io_thread.join();
+  return rc;
+}
@@ -0,0 +1,110 @@
+// Cost of end-to-end integrity on the receive path, in cycles/byte and GB/s:
+// CRC-32C per chunk (hardware and table), the whole-file SHA-256, and both
+// together the way TcpSession runs them (crc32c + FileDigest::add per chunk,
+// in order). memcpy is there for scale.
+//
+// Usage: bench_integrity [chunk_kb] [total_mb]
+//   defaults: 256 KiB chunks, 1024 MiB per measurement (over a 64 MiB buffer)
+// Cycles are TSC ticks on x86-64 (nominal clock), estimated from wall time
+// and /proc/cpuinfo MHz elsewhere.
+
+#include "fsx/transfer/integrity.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+#if !defined(__x86_64__)
+static double cpu_mhz() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("cpu MHz", 0) == 0) return std::stod(line.substr(line.find(':') + 1));
+  }
+  return 0.0;
+}
+#endif
+
+// fn processes [p, p + len); returns {cycles/byte, GB/s} over `total` bytes
+static std::pair<double, double> measure(const std::vector<uint8_t>& buf, size_t chunk, size_t total,
+                                         const std::function<void(const uint8_t*, size_t)>& fn) {
+  size_t done = 0;
+  auto t0 = Clock::now();
+#if defined(__x86_64__)
+  uint64_t c0 = __rdtsc();
+#endif
+  while (done < total) {
+    for (size_t off = 0; off + chunk <= buf.size() && done < total; off += chunk) {
+      fn(buf.data() + off, chunk);
+      done += chunk;
+    }
+  }
+  double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+#if defined(__x86_64__)
+  double cycles = double(__rdtsc() - c0);
+#else
+  double cycles = secs * cpu_mhz() * 1e6;
+#endif
+  return {cycles / double(done), double(done) / secs / 1e9};
+}
+
+int main(int argc, char** argv) {
+  size_t chunk = (argc >= 2 ? std::stoul(argv[1]) : 256) * 1024;
+  size_t total = (argc >= 3 ? std::stoul(argv[2]) : 1024) << 20;
+
+  std::vector<uint8_t> buf(64u << 20);
+  std::mt19937_64 rng(42);
+  for (size_t i = 0; i + 8 <= buf.size(); i += 8) {
+    uint64_t v = rng();
+    std::memcpy(buf.data() + i, &v, 8);
+  }
+  chunk = std::min(chunk, buf.size());
+
+  // Keep results live so nothing is optimized away
+  volatile uint32_t sink = 0;
+  std::vector<uint8_t> dst(chunk);
+
+  std::cout << "crc32c implementation: " << fsx::transfer::crc32c_impl() << "\n";
+  std::cout << "op,chunk_kb,cycles_per_byte,gb_per_sec\n";
+  auto report = [&](const char* op, std::pair<double, double> r) {
+    std::cout << op << "," << chunk / 1024 << "," << r.first << "," << r.second << "\n";
+  };
+
+  report("memcpy", measure(buf, chunk, total, [&](const uint8_t* p, size_t n) {
+    std::memcpy(dst.data(), p, n);
+    sink = sink + dst[n / 2];
+  }));
+  report("crc32c", measure(buf, chunk, total, [&](const uint8_t* p, size_t n) {
+    sink = sink + fsx::transfer::crc32c(p, n);
+  }));
+  report("crc32c_table", measure(buf, chunk, total, [&](const uint8_t* p, size_t n) {
+    sink = sink + fsx::transfer::crc32c_sw(p, n);
+  }));
+
+  fsx::crypto::Sha256 sha;
+  report("sha256", measure(buf, chunk, total, [&](const uint8_t* p, size_t n) { sha.update(p, n); }));
+  sink = sink + sha.final()[0];
+
+  // Receive path: verify the chunk's CRC, then feed the file digest in order
+  fsx::transfer::FileDigest digest;
+  uint64_t offset = 0;
+  report("crc32c+digest", measure(buf, chunk, total, [&](const uint8_t* p, size_t n) {
+    sink = sink + fsx::transfer::crc32c(p, n);
+    digest.add(offset, p, n);
+    offset += n;
+  }));
+  fsx::crypto::Sha256Digest d;
+  digest.finish(-1, offset, &d);
+  sink = sink + d[0];
+  return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace fsx::admin {
+
+// Lock-free latency histogram with power-of-two microsecond buckets.
+// Bucket i holds samples in [2^(i-1), 2^i) us; percentiles report the bucket
+// upper bound, which is plenty for p50/p99 tracking.
+class LatencyHistogram {
+ public:
+  void record_us(uint64_t us);
+
+  template <typename Duration>
+  void record(Duration d) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    record_us(us < 0 ? 0 : static_cast<uint64_t>(us));
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max_us() const { return max_.load(std::memory_order_relaxed); }
+  uint64_t percentile_us(double p) const;
+
+  // "n=<count> p50=<us>us p99=<us>us max=<us>us"
+  std::string summary() const;
+
+ private:
+  static constexpr size_t kBuckets = 40;
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+// Process-wide registry of named counters and histograms.
+// Lookups take a mutex, so hot paths should look a metric up once and keep
+// the reference (entries are never removed).
+class Metrics {
+ public:
+  static Metrics& instance();
+
+  std::atomic<uint64_t>& counter(const std::string& name);
+  LatencyHistogram& histogram(const std::string& name);
+
+  // One line, "name=value" for counters and "name{...}" for histograms
+  std::string dump() const;
+
+ private:
+  Metrics() = default;
+
+  mutable std::mutex mu_;
+  std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters_;
+  std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+};
+
+} // namespace fsx::admin
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "fsx/net/auth_handler.h"
+#include "fsx/protocol/auth_messages.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fsx::auth {
+
+// Bounded CPU worker pool for REGISTER/LOGIN.
+// PBKDF2 (120k iterations) plus the DB round-trips would otherwise run inline
+// on an io thread and stall every session sharing it. Sessions submit jobs
+// here and get the response through a callback, invoked on a worker thread
+// (callers hop back onto their own strand).
+//
+// Backpressure: at most max_queue jobs wait; submit_* returns false when the
+// queue is full and the caller should answer "server busy" right away.
+//
+// Per-stage latency histograms (see fsx/admin/metrics.h):
+//   auth.queue_wait  submit -> worker picks the job up
+//   auth.kdf         PBKDF2 hash/verify (recorded by AuthHandler)
+//   auth.exec        whole AuthHandler call (validation + DB + KDF)
+//   auth.total       submit -> callback
+class AuthService {
+ public:
+  using RegisterCallback = std::function<void(fsx::protocol::RegisterResp)>;
+  using LoginCallback = std::function<void(fsx::protocol::LoginResp)>;
+
+  AuthService(fsx::net::AuthHandler& handler, size_t threads, size_t max_queue);
+  ~AuthService();
+
+  AuthService(const AuthService&) = delete;
+  AuthService& operator=(const AuthService&) = delete;
+
+  bool submit_register(fsx::protocol::RegisterReq req, RegisterCallback cb);
+  bool submit_login(fsx::protocol::LoginReq req, LoginCallback cb);
+
+  size_t queue_depth() const;
+  fsx::net::AuthHandler& handler() { return handler_; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Job {
+    Clock::time_point submitted;
+    std::function<void()> run;
+  };
+
+  bool enqueue(std::function<void()> run);
+  void worker_loop();
+
+  fsx::net::AuthHandler& handler_;
+  size_t max_queue_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace fsx::auth
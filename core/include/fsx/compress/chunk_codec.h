@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fsx::compress {
+
+// Per-chunk compression for FILE_FEATURE_COMPRESS transfers. Every chunk is
+// compressed on its own, so chunks can still be stored at chunk_index *
+// chunk_size, resent and resumed one by one. The ids go on the wire: never
+// renumber.
+enum class Codec : uint8_t {
+  NONE = 0,
+  ZLIB = 1,  // always built
+  LZ4 = 2,   // -DFSX_WITH_LZ4=ON
+  ZSTD = 3,  // -DFSX_WITH_ZSTD=ON
+};
+
+constexpr uint8_t codec_bit(Codec c) { return static_cast<uint8_t>(1u << static_cast<uint8_t>(c)); }
+
+// codec_bit()s of the codecs this build has (NONE included)
+uint8_t supported_codecs();
+// Best codec in offered that this build has: zstd, then lz4, then zlib.
+// NONE if there is none.
+Codec pick_codec(uint8_t offered);
+const char* codec_name(Codec c);
+
+// Compresses src into *dst (resized to the output). false if the codec isn't
+// built or the output isn't smaller than the input: send the chunk as it is.
+bool compress(Codec c, const void* src, size_t len, std::vector<uint8_t>* dst, int level = 1);
+// Decompresses src into dst, which must come out exactly raw_len bytes;
+// false on corrupt input, a size mismatch or a codec that isn't built
+bool decompress(Codec c, const void* src, size_t len, void* dst, size_t raw_len);
+
+// Adaptive part: compresses a sample (the first sample_bytes) of the chunk
+// and says whether the whole is worth compressing, i.e. the sample shrank to
+// at most max_ratio. Already-compressed data (archives, media) fails after
+// one cheap sample instead of a full-chunk attempt.
+bool worth_compressing(Codec c, const void* data, size_t len,
+                       size_t sample_bytes = 16 * 1024, double max_ratio = 0.9);
+
+} // namespace fsx::compress
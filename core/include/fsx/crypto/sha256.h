@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+namespace fsx::crypto {
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+// Incremental SHA-256 (OpenSSL EVP, so SHA-NI/AVX2 code paths when the CPU
+// has them). Not copyable; reset() starts over after final().
+class Sha256 {
+ public:
+  Sha256();
+  ~Sha256();
+
+  Sha256(const Sha256&) = delete;
+  Sha256& operator=(const Sha256&) = delete;
+
+  void update(const void* data, size_t len);
+  Sha256Digest final();
+  void reset();
+
+ private:
+  EVP_MD_CTX* ctx_;
+};
+
+// One-shot digest of data[0, len)
+Sha256Digest sha256(const void* data, size_t len);
+
+// Lowercase hex, 64 characters
+std::string to_hex(const Sha256Digest& digest);
+// false unless hex is exactly 64 hex characters
+bool from_hex(const std::string& hex, Sha256Digest* digest);
+
+} // namespace fsx::crypto
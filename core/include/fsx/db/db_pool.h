@@ -0,0 +1,112 @@
+#pragma once
+
+#include "fsx/db/pg_params.h"
+#include <boost/asio.hpp>
+#include <libpq-fe.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fsx::db {
+
+struct DbConfig {
+  std::string host;
+  int port = 5432;
+  std::string user;
+  std::string password;
+  std::string name;
+};
+
+// libpq connection string for cfg
+std::string make_conninfo(const DbConfig& cfg);
+
+// Throws std::runtime_error (ctx + the server's message) unless r is a
+// successful command or query result; r is PQclear'd before throwing
+void must_ok(PGresult* r, const std::string& ctx);
+
+// Pool of non-blocking libpq connections driven by the asio reactor.
+//
+// Each connection lives on its own strand and waits on PQsocket() with
+// async_wait, so no io thread ever blocks on postgres. Queries go to the
+// least-loaded connection that is up; with libpq >= 14 a connection keeps up to
+// pipeline_depth queries in flight (pipeline mode, one sync per query so a
+// failing query doesn't abort its neighbours).
+//
+// Broken connections are re-established in the background with exponential
+// backoff; queries that were already sent get a null result, queries still
+// queued are sent after the reconnect.
+//
+// Hot queries are named prepared statements: register them with prepare()
+// before connect(); every connection prepares them on (re)connect and
+// exec_prepared sends only the statement name plus binary-bound parameters
+// (results come back in binary format, see pg_params.h).
+//
+// The callback owns the PGresult* and must PQclear it (must_ok does so on
+// error). A null result means the
+// connection was lost before the query completed.
+class DbPool {
+ public:
+  using Callback = std::function<void(PGresult*)>;
+
+  DbPool(boost::asio::io_context& io, DbConfig cfg, size_t size, size_t pipeline_depth = 16);
+  ~DbPool();
+
+  DbPool(const DbPool&) = delete;
+  DbPool& operator=(const DbPool&) = delete;
+
+  // Registers a statement prepared on every connection. Call before connect().
+  void prepare(std::string name, std::string sql, std::vector<Oid> param_types);
+
+  // Connects and prepares every connection (blocking, throws on failure so
+  // startup fails fast)
+  void connect();
+
+  // Callback runs on the connection's strand; post back to your own executor.
+  void async_exec_params(std::string sql, std::vector<std::string> params, Callback cb);
+
+  // Future flavour for worker threads (AuthService). Never wait on this from an
+  // io thread: the pool needs those threads to make progress.
+  std::future<PGresult*> exec_params(std::string sql, std::vector<std::string> params);
+
+  // stmt must be a name registered with prepare() and outlive the call
+  // (string literals); results are in binary format.
+  void async_exec_prepared(const char* stmt, PgParams params, Callback cb);
+  std::future<PGresult*> exec_prepared(const char* stmt, PgParams params);
+
+  size_t size() const { return conns_.size(); }
+
+ private:
+  class Connection;
+  friend class Connection;
+
+  struct Statement {
+    std::string name;
+    std::string sql;
+    std::vector<Oid> param_types;
+  };
+
+  struct Query {
+    enum class Kind { Params, Prepared, Prepare };
+    Kind kind = Kind::Params;
+    std::string sql;                  // Params
+    std::vector<std::string> params;  // Params
+    const char* stmt = nullptr;       // Prepared / Prepare
+    PgParams bound;                   // Prepared
+    const Statement* def = nullptr;   // Prepare
+    Callback cb;
+  };
+
+  Connection& pick_connection();
+  void submit(Query q);
+
+  boost::asio::io_context& io_;
+  DbConfig cfg_;
+  size_t pipeline_depth_;
+  std::vector<Statement> statements_;
+  std::vector<std::shared_ptr<Connection>> conns_;
+};
+
+} // namespace fsx::db
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <libpq-fe.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <arpa/inet.h>
+#include <endian.h>
+
+namespace fsx::db {
+
+// Parameter type OIDs used by our prepared statements (pg_type.h)
+static constexpr Oid kOidInt8 = 20;
+static constexpr Oid kOidInt4 = 23;
+static constexpr Oid kOidText = 25;
+
+// Bound parameters for one prepared-statement call.
+// Integers are stored inline in binary (network order) form, so binding a
+// user_id or TTL costs no std::to_string; text is moved in. The pointer
+// arrays libpq wants are rebuilt by bind() right before sending, because the
+// object (and any SSO string buffers) may have moved since it was filled.
+class PgParams {
+ public:
+  static constexpr int kMaxParams = 8;
+
+  PgParams& text(std::string s) {
+    Slot& slot = next();
+    slot.kind = Kind::Text;
+    slot.text = std::move(s);
+    return *this;
+  }
+
+  PgParams& int8(int64_t v) {
+    Slot& slot = next();
+    slot.kind = Kind::Int8;
+    uint64_t be = htobe64(static_cast<uint64_t>(v));
+    std::memcpy(slot.raw, &be, 8);
+    return *this;
+  }
+
+  PgParams& int4(int32_t v) {
+    Slot& slot = next();
+    slot.kind = Kind::Int4;
+    uint32_t be = htonl(static_cast<uint32_t>(v));
+    std::memcpy(slot.raw, &be, 4);
+    return *this;
+  }
+
+  int count() const { return n_; }
+
+  // Fills values/lengths/formats for PQsendQueryPrepared; valid until this
+  // object is modified or moved.
+  void bind() {
+    for (int i = 0; i < n_; i++) {
+      Slot& slot = slots_[i];
+      switch (slot.kind) {
+        case Kind::Text:
+          values_[i] = slot.text.c_str();
+          lengths_[i] = static_cast<int>(slot.text.size());
+          formats_[i] = 0;
+          break;
+        case Kind::Int8:
+          values_[i] = slot.raw;
+          lengths_[i] = 8;
+          formats_[i] = 1;
+          break;
+        case Kind::Int4:
+          values_[i] = slot.raw;
+          lengths_[i] = 4;
+          formats_[i] = 1;
+          break;
+      }
+    }
+  }
+
+  const char* const* values() const { return values_.data(); }
+  const int* lengths() const { return lengths_.data(); }
+  const int* formats() const { return formats_.data(); }
+
+ private:
+  enum class Kind : uint8_t { Text, Int8, Int4 };
+
+  struct Slot {
+    Kind kind = Kind::Text;
+    char raw[8] = {};
+    std::string text;
+  };
+
+  Slot& next() {
+    if (n_ >= kMaxParams) throw std::runtime_error("PgParams: too many parameters");
+    return slots_[n_++];
+  }
+
+  std::array<Slot, kMaxParams> slots_;
+  std::array<const char*, kMaxParams> values_{};
+  std::array<int, kMaxParams> lengths_{};
+  std::array<int, kMaxParams> formats_{};
+  int n_ = 0;
+};
+
+// Readers for binary-format results (resultFormat = 1)
+
+inline int64_t pg_get_int8(const PGresult* r, int row, int col) {
+  if (PQgetlength(r, row, col) != 8) throw std::runtime_error("pg_get_int8: unexpected length");
+  uint64_t be;
+  std::memcpy(&be, PQgetvalue(r, row, col), 8);
+  return static_cast<int64_t>(be64toh(be));
+}
+
+inline std::string pg_get_text(const PGresult* r, int row, int col) {
+  if (PQgetisnull(r, row, col)) return std::string();
+  return std::string(PQgetvalue(r, row, col), static_cast<size_t>(PQgetlength(r, row, col)));
+}
+
+} // namespace fsx::db
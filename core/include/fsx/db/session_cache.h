@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fsx::db {
+
+struct SessionRow {
+  long long id;
+  long long user_id;
+  std::string token;
+  std::string expires_at;   // keep as text for now (TIMESTAMPTZ)
+  std::string last_seen_at;
+};
+
+// In-process view of live session tokens plus the pending last_seen_at
+// updates for them. validate answers from memory; touches only record the
+// time and are drained in batches by SessionRepository's flush timer.
+// Thread-safe.
+class SessionCache {
+ public:
+  using SysClock = std::chrono::system_clock;
+
+  // expires is the row's expires_at as a wall-clock time
+  void put(const SessionRow& row, SysClock::time_point expires);
+
+  // nullopt if unknown or expired (expired entries are dropped)
+  std::optional<SessionRow> get(const std::string& token);
+
+  // Records a keep-alive; coalesces with earlier touches of the same token
+  void mark_seen(const std::string& token, SysClock::time_point when);
+
+  // Hands over the pending (token, seen) pairs and clears them
+  std::vector<std::pair<std::string, SysClock::time_point>> take_seen();
+
+  // Puts pairs back after a failed flush (newer touches win)
+  void restore_seen(std::vector<std::pair<std::string, SysClock::time_point>> seen);
+
+  // Drops expired tokens; returns how many were removed
+  size_t sweep_expired();
+
+  size_t size() const;
+
+ private:
+  struct Entry {
+    SessionRow row;
+    SysClock::time_point expires;
+  };
+
+  mutable std::mutex mu_;
+  std::unordered_map<std::string, Entry> tokens_;
+  std::unordered_map<std::string, SysClock::time_point> seen_;
+};
+
+} // namespace fsx::db
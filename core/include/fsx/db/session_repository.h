@@ -1,23 +1,30 @@
 #pragma once
 
-#include "fsx/db/db.h"
+#include "fsx/db/db_pool.h"
+#include "fsx/db/session_cache.h"
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 #include <optional>
 
 namespace fsx::db {
 
-struct SessionRow {
-  long long id;
-  long long user_id;
-  std::string token;
-  std::string expires_at;   // keep as text for now (TIMESTAMPTZ)
-  std::string last_seen_at;
-};
-
+// Blocking calls (wait on the DbPool future): worker threads only.
+//
+// Tokens created or validated here are kept in a SessionCache, so repeated
+// validate_token calls are answered without I/O. Once start_write_behind()
+// runs, touch_session only records the time and never blocks (safe on an io
+// thread); pending last_seen_at values go out as one multi-row UPDATE per
+// interval. last_seen_at is advisory, so touches not yet flushed when the
+// process dies are simply lost.
 class SessionRepository {
  public:
-  explicit SessionRepository(Db& db) : db_(db) {}
+  explicit SessionRepository(DbPool& db) : db_(db) {}
+
+  // Registers this repository's prepared statements; call before db.connect()
+  static void prepare_statements(DbPool& db);
 
   // creates session and returns token
   std::string create_session(long long user_id, int ttl_seconds);
@@ -28,8 +35,19 @@ class SessionRepository {
 
   std::vector<SessionRow> list_valid_sessions();
 
+  // Starts the periodic last_seen_at flush on io
+  void start_write_behind(boost::asio::io_context& io, std::chrono::milliseconds interval);
+
+  // Sends the pending touches now (async; failures are retried next round)
+  void flush_touches();
+
  private:
-  Db& db_;
+  void arm_flush();
+
+  DbPool& db_;
+  SessionCache cache_;
+  std::unique_ptr<boost::asio::steady_timer> flush_timer_;
+  std::chrono::milliseconds flush_interval_{1000};
 };
 
 } // namespace fsx::db
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace fsx::db {
+
+struct UserRow {
+  long long id;
+  std::string username;
+  std::string email;
+  std::string pass_hash;
+};
+
+// Bounded LRU of UserRow with a per-entry TTL, indexed by username and by id.
+// Only positive lookups are cached (a miss must still reach postgres, so a
+// user registered a moment ago is found). Thread-safe: auth workers and
+// the DbPool strands hit it concurrently.
+class UserCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // capacity 0 disables the cache (every lookup is a miss, put is a no-op)
+  UserCache(size_t capacity, std::chrono::seconds ttl);
+
+  std::optional<UserRow> get_by_username(const std::string& username);
+  std::optional<UserRow> get_by_id(long long id);
+
+  // Inserts or refreshes; replaces any entry sharing the username or the id
+  void put(const UserRow& row);
+
+  void invalidate_username(const std::string& username);
+  void invalidate_id(long long id);
+
+  size_t size() const;
+
+ private:
+  struct Entry {
+    UserRow row;
+    Clock::time_point expires;
+  };
+  using List = std::list<Entry>;
+
+  // Callers hold mu_
+  std::optional<UserRow> hit(List::iterator it);
+  void erase(List::iterator it);
+
+  size_t capacity_;
+  std::chrono::seconds ttl_;
+
+  mutable std::mutex mu_;
+  List lru_;  // front = most recently used
+  std::unordered_map<std::string, List::iterator> by_username_;
+  std::unordered_map<long long, List::iterator> by_id_;
+
+  std::atomic<uint64_t>& hits_;
+  std::atomic<uint64_t>& misses_;
+  std::atomic<uint64_t>& evictions_;
+};
+
+} // namespace fsx::db
@@ -1,30 +1,46 @@
 #pragma once
 
-#include "fsx/db/db.h"
+#include "fsx/db/db_pool.h"
+#include "fsx/db/user_cache.h"
+#include <chrono>
+#include <functional>
 #include <optional>
 #include <string>
 
 namespace fsx::db {
 
-struct UserRow {
-  long long id;
-  std::string username;
-  std::string email;
-  std::string pass_hash;
-};
-
+// Blocking methods wait on the DbPool future: call them from worker threads
+// (AuthService), never from an io thread. Sessions use the async_* variants.
+//
+// Lookups are read-through a UserCache: hits return without a DB round trip,
+// rows fetched or created here are cached, and writes replace stale entries.
 class UserRepository {
  public:
-  explicit UserRepository(Db& db) : db_(db) {}
+  // error is empty on success; user is nullopt if not found (or on error)
+  using UserCallback = std::function<void(std::optional<UserRow> user, std::string error)>;
+
+  explicit UserRepository(DbPool& db,
+                          size_t cache_capacity = 10000,
+                          std::chrono::seconds cache_ttl = std::chrono::seconds(300))
+    : db_(db), cache_(cache_capacity, cache_ttl) {}
+
+  // Registers this repository's prepared statements; call before db.connect()
+  static void prepare_statements(DbPool& db);
 
   // returns created user_id
   long long create_user(const std::string& username, const std::string& email, const std::string& pass_hash);
 
   std::optional<UserRow> get_user_by_username(const std::string& username);
+  std::optional<UserRow> get_user_by_id(long long id);
+
+  // Callback runs on a DbPool strand, or inline on a cache hit
+  void async_get_user_by_username(const std::string& username, UserCallback cb);
+
+  UserCache& cache() { return cache_; }
 
  private:
-  Db& db_;
+  DbPool& db_;
+  UserCache cache_;
 };
 
 } // namespace fsx::db
-
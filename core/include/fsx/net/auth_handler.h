@@ -16,6 +16,10 @@ class AuthHandler {
   fsx::protocol::RegisterResp handle_register(const fsx::protocol::RegisterReq& req);
   fsx::protocol::LoginResp handle_login(const fsx::protocol::LoginReq& req);
 
+  // Keep-alive for an authenticated connection; non-blocking once the
+  // session write-behind is running (see SessionRepository)
+  void touch_session(const std::string& token) { sessions_.touch_session(token); }
+
  private:
   fsx::db::UserRepository& users_;
   fsx::db::SessionRepository& sessions_;
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+namespace fsx::net {
+
+namespace detail {
+// Header of a pooled buffer; the bytes follow it in the same allocation
+struct BufferSlab {
+  std::atomic<uint32_t> refs{1};
+  uint8_t size_class = 0;
+  size_t capacity = 0;
+  size_t size = 0;
+  uint8_t* bytes() { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+} // namespace detail
+
+// Ref-counted handle to a pooled byte buffer. Copies share the buffer (one
+// atomic increment, no allocation); when the last handle goes the buffer
+// returns to the pool of the thread it goes on. The bytes start out
+// uninitialized.
+class PooledBuffer {
+ public:
+  PooledBuffer() = default;
+  PooledBuffer(const PooledBuffer& o) noexcept : slab_(o.slab_) {
+    if (slab_) slab_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  PooledBuffer(PooledBuffer&& o) noexcept : slab_(std::exchange(o.slab_, nullptr)) {}
+  PooledBuffer& operator=(PooledBuffer o) noexcept {
+    std::swap(slab_, o.slab_);
+    return *this;
+  }
+  ~PooledBuffer() { reset(); }
+
+  void reset() noexcept;
+  explicit operator bool() const { return slab_ != nullptr; }
+  // No other handle: the bytes may be written
+  bool unique() const { return slab_->refs.load(std::memory_order_acquire) == 1; }
+
+  uint8_t* data() { return slab_->bytes(); }
+  const uint8_t* data() const { return slab_->bytes(); }
+  // What acquire() was asked for; capacity() is the slab's size class
+  size_t size() const { return slab_->size; }
+  size_t capacity() const { return slab_->capacity; }
+  std::span<const uint8_t> span() const { return {data(), size()}; }
+
+ private:
+  friend class BufferPool;
+  using Slab = detail::BufferSlab;
+  explicit PooledBuffer(Slab* slab) : slab_(slab) {}
+
+  Slab* slab_ = nullptr;
+};
+
+// Size-class pool of receive buffers (frame bodies, chunk data), so a
+// steady stream of frames reuses a few slabs instead of allocating and
+// zero-filling a vector per frame. Each thread keeps freelists of its own:
+// acquire and release take no lock. A buffer released on another thread
+// (a relayed chunk written by the receiver's strand) joins that thread's
+// freelist.
+//
+// Counters: pool.hits, pool.misses (served from / not from a freelist),
+// pool.bytes (slab bytes held, in use or free) and pool.peak_bytes.
+class BufferPool {
+ public:
+  static constexpr size_t kClasses = 5;
+  static constexpr std::array<size_t, kClasses> kClassBytes = {
+    4 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024,
+  };
+  // Slabs are this much over their class, so a chunk_size chunk plus its
+  // codec header and CRC trailer still fits the chunk_size class
+  static constexpr size_t kSlack = 64;
+  // Free slabs a thread keeps per class; the rest go back to the heap
+  static constexpr std::array<size_t, kClasses> kMaxFree = {64, 16, 8, 4, 1};
+
+  // A buffer of len bytes from the smallest class that fits. Past the
+  // largest class it is a one-off heap allocation, freed when released.
+  static PooledBuffer acquire(size_t len);
+  // Frees the calling thread's free slabs
+  static void trim();
+
+ private:
+  friend class PooledBuffer;
+  static void release(detail::BufferSlab* slab);
+};
+
+inline void PooledBuffer::reset() noexcept {
+  Slab* slab = std::exchange(slab_, nullptr);
+  if (slab && slab->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) BufferPool::release(slab);
+}
+
+} // namespace fsx::net
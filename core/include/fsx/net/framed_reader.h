@@ -0,0 +1,56 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace fsx::net {
+
+// Read-ahead buffer for the frame parser: the socket is read with large
+// read_some()s and every complete frame that arrived is parsed out of the
+// buffer before the next read. Bytes stay contiguous (what's left unparsed,
+// at most one partial frame, moves to the front before a read) so a frame
+// body can be handed to its handler in place.
+class FramedReader {
+ public:
+  explicit FramedReader(size_t capacity) : capacity_(capacity) {}
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return end_ - begin_; }
+  const uint8_t* data() const { return buf_.data() + begin_; }
+
+  void consume(size_t n) {
+    begin_ += n;
+    if (begin_ == end_) begin_ = end_ = 0;
+  }
+  // Moves up to n buffered bytes to dst; returns how many
+  size_t take(void* dst, size_t n) {
+    n = std::min(n, size());
+    if (n > 0) std::memcpy(dst, data(), n);
+    consume(n);
+    return n;
+  }
+
+  // Free space for the next read (allocated on the first one)
+  boost::asio::mutable_buffer prepare() {
+    if (buf_.empty()) buf_.resize(capacity_);
+    if (begin_ > 0) {
+      std::memmove(buf_.data(), data(), size());
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    return boost::asio::buffer(buf_.data() + end_, buf_.size() - end_);
+  }
+  void commit(size_t n) { end_ += n; }
+
+ private:
+  size_t capacity_;
+  std::vector<uint8_t> buf_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+};
+
+} // namespace fsx::net
@@ -9,8 +9,14 @@
 
 namespace fsx::net {
 
+// Thread-safe registry of authenticated sessions. Sessions live on different
+// io threads, so everything read here from another session (e.g. the username
+// for the online list) is captured at add time instead of read off the
+// TcpSession; sending to a session found here goes through TcpSession::send,
+// which hops onto that session's strand.
 class SessionManager {
  public:
+  // Must be called from the session's own strand (username is read from it)
   void add_session(const std::string& token, std::shared_ptr<TcpSession> session);
   void remove_session(const std::string& token);
   void remove_session(std::shared_ptr<TcpSession> session);
@@ -22,8 +28,13 @@ class SessionManager {
   std::shared_ptr<TcpSession> get_session(const std::string& token) const;
 
  private:
+  struct Entry {
+    std::weak_ptr<TcpSession> session;
+    std::string username;
+  };
+
   mutable std::mutex mutex_;
-  mutable std::unordered_map<std::string, std::weak_ptr<TcpSession>> sessions_; // token -> session
+  mutable std::unordered_map<std::string, Entry> sessions_; // token -> session
 };
 
 } // namespace fsx::net
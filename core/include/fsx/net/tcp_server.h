@@ -1,6 +1,6 @@
 #pragma once
 #include <boost/asio.hpp>
-#include "fsx/net/auth_handler.h"
+#include "fsx/auth/auth_service.h"
 
 namespace fsx::net {
 class SessionManager;
@@ -24,7 +24,7 @@ class TcpServer {
 public:
   TcpServer(boost::asio::io_context& io, 
             uint16_t port, 
-            AuthHandler& auth_handler, 
+            fsx::auth::AuthService& auth_service, 
             SessionManager& session_manager,
             fsx::transfer::TransferManager& transfer_manager,
             fsx::storage::FileStore& file_store,
@@ -38,7 +38,7 @@ private:
 
   boost::asio::io_context& io_;
   boost::asio::ip::tcp::acceptor acceptor_;
-  AuthHandler& auth_handler_;
+  fsx::auth::AuthService& auth_service_;
   SessionManager& session_manager_;
   fsx::transfer::TransferManager& transfer_manager_;
   fsx::storage::FileStore& file_store_;
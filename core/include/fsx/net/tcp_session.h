@@ -1,11 +1,19 @@
 #pragma once
 #include <boost/asio.hpp>
+#include <array>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 #include <iostream>
+#include "fsx/net/buffer_pool.h"
+#include "fsx/net/framed_reader.h"
 #include "fsx/protocol/message.h"
-#include "fsx/net/auth_handler.h"
+#include "fsx/protocol/file_messages.h"
+#include "fsx/db/user_repository.h"
+#include "fsx/auth/auth_service.h"
+#include "fsx/storage/block_store.h"
 
 namespace fsx::net {
 class SessionManager;
@@ -13,14 +21,13 @@ class SessionManager;
 
 namespace fsx::transfer {
 class TransferManager;
+struct TransferSession;
+class TokenBucket;
 }
 
 namespace fsx::storage {
 class FileStore;
-}
-
-namespace fsx::db {
-class UserRepository;
+class WriteHandle;
 }
 
 namespace fsx::net {
@@ -28,7 +35,7 @@ namespace fsx::net {
 class TcpSession : public std::enable_shared_from_this<TcpSession> {
 public:
   TcpSession(boost::asio::ip::tcp::socket socket, 
-             AuthHandler& auth_handler, 
+             fsx::auth::AuthService& auth_service, 
              SessionManager& session_manager,
              fsx::transfer::TransferManager& transfer_manager,
              fsx::storage::FileStore& file_store,
@@ -54,26 +61,131 @@ public:
   }
 
 private:
-  void log(const std::string& s);
+  // Static so the transfer-wide timers (on_hole_timer) log the same way
+  static void log(const std::string& s);
   std::string get_remote_endpoint() const;
   std::string get_token_short() const;
 
+  // Handles the frames buffered in rx_, then reads more. Small frames are
+  // handled straight from rx_, so one read serves every frame it brought.
   void do_read_header();
-  void do_read_body();
+  // One frame out of rx_; true if it was handled and the next may follow
+  bool next_frame();
+  void read_more();
+  // Body too big for rx_: have bytes of it are in body_ already
+  void do_read_body(size_t have);
+  // FILE_CHUNK fast path: sub-header + data land in chunk_hdr_ and a pooled
+  // buffer (what rx_ read ahead is moved over, the rest read directly)
+  void do_read_file_chunk(size_t len);
+  void on_file_chunk(PooledBuffer buf, size_t data_len);
+  void on_read_error(const std::string& what);
+  // Charges a stored chunk to the global, user and transfer rate limits
+  // (TransferManager::throttler); the wait lands in read_pause_
+  void pace_chunk(fsx::transfer::TransferSession& session, size_t len);
+  // Reads the next frame, after read_pause_ if the limits asked for one
+  void resume_reads();
 
-  void send(fsx::protocol::MsgType type, const std::vector<uint8_t>& payload);
+  // Safe to call from any thread: the frame is queued on this session's strand
+  void send(fsx::protocol::MsgType type, std::vector<uint8_t> payload);
+  // Writes the front of outq_ as one gathered write (see kWriteBatchBytes)
   void do_write();
+  void do_send_file();
+  // Retires the frames do_write sent and starts the next write
+  void finish_write();
+  void on_write_error(const std::string& what);
 
-  void handle_message(fsx::protocol::MsgType type, const std::vector<uint8_t>& payload);
+  // Looks the type up in kRoutes: unknown types are logged and dropped,
+  // auth is checked before the handler runs
+  void handle_message(fsx::protocol::MsgType type, std::span<const uint8_t> payload);
+
+  // Message dispatch. Every message the server accepts has a Handler<T>
+  // traits specialization in tcp_session.cpp (name, auth requirement, max
+  // payload, handler, reply to an unauthenticated caller); make_routes
+  // compiles them into kRoutes, indexed by the header's type byte.
+  // next_frame drops the connection for a payload over the type's cap
+  // before any of it is read.
+  using MessageFn = void (TcpSession::*)(std::span<const uint8_t>);
+  using RejectFn = void (TcpSession::*)();
+  struct Route {
+    const char* name = nullptr;
+    MessageFn handle = nullptr;      // nullptr: not a client-to-server message
+    RejectFn reject = nullptr;       // nullptr: unauthenticated callers get no reply
+    uint32_t max_payload = 0;
+    bool needs_auth = false;
+  };
+  template <fsx::protocol::MsgType T> struct Handler;
+  template <fsx::protocol::MsgType T> static constexpr Route route();
+  template <fsx::protocol::MsgType... Ts> static constexpr std::array<Route, 256> make_routes();
+  static const std::array<Route, 256> kRoutes;
+  template <typename Resp, fsx::protocol::MsgType kRespType> void reject_unauthenticated();
+
+  void handle_hello(std::span<const uint8_t> payload);
+  void handle_ping(std::span<const uint8_t> payload);
+  void handle_pong(std::span<const uint8_t> payload);
+  void handle_register_req(std::span<const uint8_t> payload);
+  void handle_login_req(std::span<const uint8_t> payload);
+  void handle_online_list_req(std::span<const uint8_t> payload);
+
+  // AuthService completions (run on this session's strand)
+  void on_register_done(const std::string& username, const fsx::protocol::RegisterResp& resp);
+  void on_login_done(const std::string& username, const fsx::protocol::LoginResp& resp);
   
   // File transfer handlers (Phase 3)
-  void handle_file_offer_req(const std::vector<uint8_t>& payload);
-  void handle_file_accept_req(const std::vector<uint8_t>& payload);
-  void handle_file_chunk(const std::vector<uint8_t>& payload);
-  void handle_file_done(const std::vector<uint8_t>& payload);
+  void handle_file_offer_req(std::span<const uint8_t> payload);
+  void on_file_offer_receiver(const fsx::protocol::FileOfferReq& req,
+                              const std::optional<fsx::db::UserRow>& receiver_user,
+                              const std::string& error);
+  void handle_file_accept_req(std::span<const uint8_t> payload);
+  void handle_file_chunk(std::span<const uint8_t> payload);
+  // The first len bytes of buf are the chunk data. buf is shared with the
+  // receiver's outq_ when the chunk is relayed, so it must not be modified
+  // while anyone else holds it. done runs on this strand once the next frame
+  // may be read (chunk on disk / relay window open, or chunk rejected).
+  void handle_file_chunk_data(uint64_t transfer_id, uint32_t chunk_index,
+                              PooledBuffer buf, size_t len, std::function<void()> done);
+  // Sender side of cut-through relay: holds done while too many relayed bytes
+  // are still queued at the receiver
+  void relay_continue(std::function<void()> done);
+  // FILE_FEATURE_DEDUP chunk: verified against the offered block, then put
+  // in the BlockStore. packed: the chunk as it came off the wire when it was
+  // compressed (FILE_FEATURE_COMPRESS), null otherwise; stored as is.
+  void store_block(const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                   uint32_t chunk_index, const uint8_t* data, size_t len,
+                   const uint8_t* packed = nullptr, size_t packed_len = 0);
+  // FILE_FEATURE_COMPRESS chunk (codec header + data) -> raw bytes in a
+  // pooled *raw. false if the header or data is bad.
+  bool inflate_chunk(const fsx::transfer::TransferSession& session, const uint8_t* data, size_t len,
+                     PooledBuffer* raw);
+  // FILE_FEATURE_NACK: asks this connection to resend one chunk, failing the
+  // transfer once that chunk was asked for too often. false if the sender
+  // doesn't do NACKs.
+  bool nack_chunk(const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                  uint32_t chunk_index, fsx::protocol::NackReason reason);
+  // Starts the hole timer on the timing wheel if chunks are missing and none
+  // is running. When it fires, the holes still open are NACKed to whichever
+  // connection last sent a chunk. Static: it outlives this connection.
+  static void watch_holes(transfer::TransferManager& transfers, SessionManager& sessions,
+                          const std::shared_ptr<fsx::transfer::TransferSession>& session);
+  static void on_hole_timer(transfer::TransferManager& transfers, SessionManager& sessions,
+                            const std::weak_ptr<fsx::transfer::TransferSession>& weak);
+  // FILE_CHUNK_ACK for FILE_FEATURE_ACK transfers (no-op otherwise)
+  void send_chunk_ack(const fsx::transfer::TransferSession& session);
+  void on_relay_sent(uint64_t transfer_id, size_t len, bool delivered);
+  // Receiver side: queues a FILE_CHUNK whose data is buf[0, len). on_sent
+  // runs on this strand once it's written (true) or the socket failed (false).
+  void relay_chunk(uint64_t transfer_id, uint32_t chunk_index, PooledBuffer buf, size_t len,
+                   std::function<void(bool)> on_sent);
+  void handle_file_done(std::span<const uint8_t> payload);
+  void handle_file_fetch_req(std::span<const uint8_t> payload);
+  void handle_file_resume_req(std::span<const uint8_t> payload);
+  // Queues FILE_CHUNK frames of active fetches while the window allows
+  void pump_fetches();
+  void on_file_finalized(const fsx::protocol::FileDone& done,
+                         const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                         bool success);
 
   boost::asio::ip::tcp::socket socket_;
-  AuthHandler& auth_handler_;
+  fsx::auth::AuthService& auth_service_;
   SessionManager& session_manager_;
   fsx::transfer::TransferManager& transfer_manager_;
   fsx::storage::FileStore& file_store_;
@@ -84,13 +196,91 @@ private:
   long long user_id_ = 0;
   std::string username_;
 
+  // Last upload written with coalescing; its run is flushed once the socket
+  // has nothing more buffered (read_more), or when a chunk of another upload
+  // comes in, so at most one handle holds staged chunks
+  std::shared_ptr<fsx::storage::WriteHandle> staged_write_;
+  // Read-ahead: frames up to kReadAhead are parsed out of rx_ in place
+  static constexpr size_t kReadAhead = 16 * 1024;
+  FramedReader rx_{kReadAhead};
+  bool in_frame_loop_ = false;
+  bool frame_loop_again_ = false;
+
+  // Larger frame bodies and chunk data come from the BufferPool and go back
+  // to it once handled (a relayed chunk once the receiver has written it)
   fsx::protocol::MessageHeaderWire header_{};
-  std::vector<uint8_t> body_;
+  PooledBuffer body_;
+  // FILE_CHUNK sub-header (u64 transfer_id, u32 chunk_index)
+  uint8_t chunk_hdr_[12];
 
+  // Upload shaping: reading stops (TCP pushes back on the sender) instead of
+  // buffering. rate_user_ is this user's bucket, looked up on the first chunk.
+  boost::asio::steady_timer read_pause_timer_;
+  std::chrono::nanoseconds read_pause_{0};
+  std::shared_ptr<fsx::transfer::TokenBucket> rate_user_;
+  long long rate_user_id_ = 0;
+
+  // Relayed bytes not yet written to receivers; reading stops at kRelayWindow
+  static constexpr size_t kRelayWindow = 4 * 1024 * 1024;
+  size_t relay_inflight_ = 0;
+  std::function<void()> relay_resume_;
+
+  // Download of a completed file (FILE_FETCH_REQ), served with sendfile
+  struct FetchStream {
+    int fd = -1;
+    uint64_t transfer_id = 0;
+    uint64_t file_size = 0;
+    uint32_t chunk_size = 0;
+    uint32_t total_chunks = 0;
+    uint32_t next_index = 0;
+    // Deduplicated file: chunk i is blocks[i], each sent from its own block
+    // file (fd stays -1)
+    std::vector<fsx::storage::BlockRef> blocks;
+    ~FetchStream();
+  };
+
+  // A queued frame goes out as up to three buffers, head, payload and
+  // shared, in place: nothing is copied into a contiguous frame
   struct OutFrame {
-    std::vector<uint8_t> bytes;
+    // Frame header, plus the u64 transfer_id + u32 chunk_index sub-header
+    // of a FILE_CHUNK
+    uint8_t head[fsx::protocol::HEADER_SIZE + 12];
+    uint8_t head_len = 0;
+    std::vector<uint8_t> payload;
+    // FILE_CHUNK from disk: after head, file_len bytes at file_off of
+    // source->fd go out with sendfile
+    std::shared_ptr<FetchStream> source;
+    uint64_t file_off = 0;
+    size_t file_len = 0;
+    size_t window_bytes = 0;  // file bytes charged to fetch_window_used_
+    // Relayed FILE_CHUNK: shared_len bytes of shared follow head
+    PooledBuffer shared;
+    size_t shared_len = 0;
+    std::function<void(bool)> on_sent;
+
+    void set_header(fsx::protocol::MsgType type, uint32_t len);
+    // FILE_CHUNK header + sub-header for len bytes of chunk data
+    void set_chunk_header(uint64_t transfer_id, uint32_t chunk_index, size_t len);
   };
   std::deque<OutFrame> outq_;
+
+  // do_write gathers queued frames into one writev until kWriteBatchBytes
+  // or kWriteBatchBuffers (what asio passes to one writev) is reached, so a
+  // burst of small frames (ACKs, online-list pushes) costs one syscall. A
+  // frame with a sendfile part ends the batch. write_batch_ frames at the
+  // front of outq_ are in flight; write_bufs_ only grows.
+  static constexpr size_t kWriteBatchBytes = 256 * 1024;
+  static constexpr size_t kWriteBatchBuffers = 64;
+  std::vector<boost::asio::const_buffer> write_bufs_;
+  size_t write_batch_ = 0;
+  std::vector<std::function<void(bool)>> sent_callbacks_;
+
+  // Fetches take turns one chunk at a time; at most kFetchWindow file bytes
+  // sit in outq_, so a slow receiver stalls its fetch instead of growing outq_
+  static constexpr size_t kFetchWindow = 1024 * 1024;
+  std::deque<std::shared_ptr<FetchStream>> fetches_;
+  size_t fetch_window_used_ = 0;
+  bool write_failed_ = false;
 };
 
 } // namespace fsx::net
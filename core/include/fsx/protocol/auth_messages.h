@@ -1,10 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
-#include <arpa/inet.h>
+#include "fsx/protocol/codec.h"
 
 namespace fsx::protocol {
 
@@ -21,39 +23,41 @@ struct RegisterReq {
   std::string email;
   std::string password;
 
-  static RegisterReq deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 6) throw std::runtime_error("REGISTER_REQ: payload too short");
-    
-    size_t pos = 0;
-    
-    // Username
-    uint16_t username_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    if (pos + username_len > payload.size()) throw std::runtime_error("REGISTER_REQ: invalid username_len");
-    std::string username(reinterpret_cast<const char*>(payload.data() + pos), username_len);
-    pos += username_len;
-    
-    // Email
-    if (pos + 2 > payload.size()) throw std::runtime_error("REGISTER_REQ: missing email_len");
-    uint16_t email_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    if (pos + email_len > payload.size()) throw std::runtime_error("REGISTER_REQ: invalid email_len");
-    std::string email(reinterpret_cast<const char*>(payload.data() + pos), email_len);
-    pos += email_len;
-    
-    // Password
-    if (pos + 2 > payload.size()) throw std::runtime_error("REGISTER_REQ: missing password_len");
-    uint16_t password_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    if (pos + password_len > payload.size()) throw std::runtime_error("REGISTER_REQ: invalid password_len");
-    std::string password(reinterpret_cast<const char*>(payload.data() + pos), password_len);
-    
+  using Wire = wire::Layout<wire::Str16, wire::Str16, wire::Str16>;
+
+  // Fields point into the payload
+  struct View {
+    std::string_view username;
+    std::string_view email;
+    std::string_view password;
+
+    static View decode(std::span<const uint8_t> payload) {
+      if (payload.size() < Wire::kSize) throw std::runtime_error("REGISTER_REQ: payload too short");
+      Reader r(payload, "REGISTER_REQ");
+      View v;
+      v.username = r.str16("username");
+      v.email = r.str16("email");
+      v.password = r.str16("password");
+      return v;
+    }
+  };
+
+  static RegisterReq deserialize(std::span<const uint8_t> payload) {
+    View v = View::decode(payload);
     RegisterReq req;
-    req.username = std::move(username);
-    req.email = std::move(email);
-    req.password = std::move(password);
+    req.username = v.username;
+    req.email = v.email;
+    req.password = v.password;
     return req;
   }
+
+  size_t encoded_size() const { return Wire::kSize + username.size() + email.size() + password.size(); }
+  void encode(Writer& w) const {
+    w.str16(username);
+    w.str16(email);
+    w.str16(password);
+  }
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
 };
 
 // REGISTER_RESP payload format:
@@ -65,19 +69,14 @@ struct RegisterResp {
   bool ok;
   std::string msg;
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> out;
-    out.reserve(3 + msg.size());
-    
-    out.push_back(ok ? 1 : 0);
-    
-    uint16_t msg_len_be = htons(static_cast<uint16_t>(msg.size()));
-    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&msg_len_be), 
-               reinterpret_cast<const uint8_t*>(&msg_len_be) + 2);
-    
-    out.insert(out.end(), msg.begin(), msg.end());
-    return out;
+  using Wire = wire::Layout<wire::U8, wire::Str16>;
+
+  size_t encoded_size() const { return Wire::kSize + msg.size(); }
+  void encode(Writer& w) const {
+    w.u8(ok ? 1 : 0);
+    w.str16(msg);
   }
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
 };
 
 // LOGIN_REQ payload format: same as REGISTER_REQ
@@ -90,30 +89,37 @@ struct LoginReq {
   std::string username;
   std::string password;
 
-  static LoginReq deserialize(const std::vector<uint8_t>& payload) {
-    // Same format as RegisterReq, but return LoginReq
-    if (payload.size() < 4) throw std::runtime_error("LOGIN_REQ: payload too short");
-    
-    size_t pos = 0;
-    uint16_t username_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    
-    if (pos + username_len > payload.size()) throw std::runtime_error("LOGIN_REQ: invalid username_len");
-    std::string username(reinterpret_cast<const char*>(payload.data() + pos), username_len);
-    pos += username_len;
-    
-    if (pos + 2 > payload.size()) throw std::runtime_error("LOGIN_REQ: missing password_len");
-    uint16_t password_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    
-    if (pos + password_len > payload.size()) throw std::runtime_error("LOGIN_REQ: invalid password_len");
-    std::string password(reinterpret_cast<const char*>(payload.data() + pos), password_len);
-    
+  using Wire = wire::Layout<wire::Str16, wire::Str16>;
+
+  // Fields point into the payload
+  struct View {
+    std::string_view username;
+    std::string_view password;
+
+    static View decode(std::span<const uint8_t> payload) {
+      if (payload.size() < Wire::kSize) throw std::runtime_error("LOGIN_REQ: payload too short");
+      Reader r(payload, "LOGIN_REQ");
+      View v;
+      v.username = r.str16("username");
+      v.password = r.str16("password");
+      return v;
+    }
+  };
+
+  static LoginReq deserialize(std::span<const uint8_t> payload) {
+    View v = View::decode(payload);
     LoginReq req;
-    req.username = std::move(username);
-    req.password = std::move(password);
+    req.username = v.username;
+    req.password = v.password;
     return req;
   }
+
+  size_t encoded_size() const { return Wire::kSize + username.size() + password.size(); }
+  void encode(Writer& w) const {
+    w.str16(username);
+    w.str16(password);
+  }
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
 };
 
 // LOGIN_RESP payload format:
@@ -121,6 +127,9 @@ struct LoginReq {
 // if ok=1:
 //   u16 token_len (network order)
 //   bytes token
+//   u64 user_id (network order)
+//   u16 username_len (network order)
+//   bytes username
 // u16 msg_len (network order)
 // bytes msg
 
@@ -131,39 +140,22 @@ struct LoginResp {
   std::string username;  // only if ok=true
   std::string msg;
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> out;
-    size_t est_size = 1 + 2 + (ok ? (2 + token.size()) : 0) + 2 + msg.size();
-    out.reserve(est_size);
-    
-    out.push_back(ok ? 1 : 0);
-    
+  using Wire = wire::Layout<wire::U8, wire::Str16>;
+  using OkWire = wire::Layout<wire::Str16, wire::U64, wire::Str16>;
+
+  size_t encoded_size() const {
+    return Wire::kSize + msg.size() + (ok ? OkWire::kSize + token.size() + username.size() : 0);
+  }
+  void encode(Writer& w) const {
+    w.u8(ok ? 1 : 0);
     if (ok) {
-      uint16_t token_len_be = htons(static_cast<uint16_t>(token.size()));
-      out.insert(out.end(), reinterpret_cast<const uint8_t*>(&token_len_be), 
-                 reinterpret_cast<const uint8_t*>(&token_len_be) + 2);
-      out.insert(out.end(), token.begin(), token.end());
-      
-      // user_id (int64_t, network byte order)
-      uint64_t user_id_be = htobe64(static_cast<uint64_t>(user_id));
-      out.insert(out.end(), reinterpret_cast<const uint8_t*>(&user_id_be),
-                 reinterpret_cast<const uint8_t*>(&user_id_be) + 8);
-      
-      // username
-      uint16_t username_len_be = htons(static_cast<uint16_t>(username.size()));
-      out.insert(out.end(), reinterpret_cast<const uint8_t*>(&username_len_be),
-                 reinterpret_cast<const uint8_t*>(&username_len_be) + 2);
-      out.insert(out.end(), username.begin(), username.end());
+      w.str16(token);
+      w.u64(static_cast<uint64_t>(user_id));
+      w.str16(username);
     }
-    
-    uint16_t msg_len_be = htons(static_cast<uint16_t>(msg.size()));
-    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&msg_len_be), 
-               reinterpret_cast<const uint8_t*>(&msg_len_be) + 2);
-    out.insert(out.end(), msg.begin(), msg.end());
-    
-    return out;
+    w.str16(msg);
   }
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
 };
 
 } // namespace fsx::protocol
-
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fsx::protocol {
+
+// Payload codec shared by all messages. Integers are big-endian and
+// strings / byte runs carry a u16 length prefix. Reader decodes straight
+// from the received span: every access is bounds-checked, loads go through
+// memcpy (payloads sit at any alignment), and variable fields come back as
+// views into the payload. Writer encodes into a buffer that was sized
+// exactly once from the message's encoded_size().
+
+namespace wire {
+
+// Field-layout descriptors: a message spells out its fixed fields as a
+// Layout, and its wire size is known at compile time
+template <size_t N>
+struct Fixed {
+  static constexpr size_t kSize = N;
+};
+using U8 = Fixed<1>;
+using U16 = Fixed<2>;
+using U32 = Fixed<4>;
+using U64 = Fixed<8>;
+template <size_t N>
+using Bytes = Fixed<N>;
+// u16 length prefix; the bytes themselves are counted at run time
+struct Str16 {
+  static constexpr size_t kSize = 2;
+};
+
+template <typename... Fields>
+struct Layout {
+  static constexpr size_t kSize = (size_t{0} + ... + Fields::kSize);
+};
+
+template <typename T>
+inline T load_be(const uint8_t* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 2) v = __builtin_bswap16(v);
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 4) v = __builtin_bswap32(v);
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 8) v = __builtin_bswap64(v);
+  return v;
+}
+
+template <typename T>
+inline void store_be(uint8_t* p, T v) {
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 2) v = __builtin_bswap16(v);
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 4) v = __builtin_bswap32(v);
+  if constexpr (std::endian::native == std::endian::little && sizeof(T) == 8) v = __builtin_bswap64(v);
+  std::memcpy(p, &v, sizeof(T));
+}
+
+} // namespace wire
+
+class Reader {
+ public:
+  // msg names the message in errors: "<msg>: missing <field>"
+  Reader(std::span<const uint8_t> in, const char* msg) : in_(in), msg_(msg) {}
+
+  size_t pos() const { return pos_; }
+  size_t remaining() const { return in_.size() - pos_; }
+  bool has(size_t n) const { return remaining() >= n; }
+
+  uint8_t u8(const char* field) {
+    need(1, field);
+    return in_[pos_++];
+  }
+  uint16_t u16(const char* field) { return load<uint16_t>(field); }
+  uint32_t u32(const char* field) { return load<uint32_t>(field); }
+  uint64_t u64(const char* field) { return load<uint64_t>(field); }
+
+  std::span<const uint8_t> bytes(size_t n, const char* field) {
+    if (!has(n)) fail("invalid ", field);
+    auto out = in_.subspan(pos_, n);
+    pos_ += n;
+    return out;
+  }
+  void copy(void* dst, size_t n, const char* field) {
+    need(n, field);
+    std::memcpy(dst, in_.data() + pos_, n);
+    pos_ += n;
+  }
+  // u16 length + bytes
+  std::string_view str16(const char* field) {
+    if (!has(2)) fail("missing ", field, "_len");
+    size_t n = wire::load_be<uint16_t>(in_.data() + pos_);
+    if (!has(2 + n)) fail("invalid ", field, "_len");
+    std::string_view out(reinterpret_cast<const char*>(in_.data() + pos_ + 2), n);
+    pos_ += 2 + n;
+    return out;
+  }
+  // str16 for lenient, optional text: false, and nothing consumed, if the
+  // prefix or the text doesn't fit
+  bool try_str16(std::string_view* out) {
+    if (!has(2)) return false;
+    size_t n = wire::load_be<uint16_t>(in_.data() + pos_);
+    if (!has(2 + n)) return false;
+    *out = std::string_view(reinterpret_cast<const char*>(in_.data() + pos_ + 2), n);
+    pos_ += 2 + n;
+    return true;
+  }
+  std::span<const uint8_t> rest() {
+    auto out = in_.subspan(pos_);
+    pos_ = in_.size();
+    return out;
+  }
+
+  [[noreturn]] void fail(const char* what, const char* field = "", const char* suffix = "") const {
+    throw std::runtime_error(std::string(msg_) + ": " + what + field + suffix);
+  }
+
+ private:
+  void need(size_t n, const char* field) {
+    if (!has(n)) fail("missing ", field);
+  }
+  template <typename T>
+  T load(const char* field) {
+    need(sizeof(T), field);
+    T v = wire::load_be<T>(in_.data() + pos_);
+    pos_ += sizeof(T);
+    return v;
+  }
+
+  std::span<const uint8_t> in_;
+  size_t pos_ = 0;
+  const char* msg_;
+};
+
+// Writes into a buffer of exactly the encoded size; running past its end is
+// a bug in the message's encoded_size() and throws std::logic_error
+class Writer {
+ public:
+  explicit Writer(std::span<uint8_t> out) : out_(out) {}
+
+  size_t pos() const { return pos_; }
+  bool full() const { return pos_ == out_.size(); }
+
+  void u8(uint8_t v) { out_[reserve(1)] = v; }
+  void u16(uint16_t v) { wire::store_be(out_.data() + reserve(2), v); }
+  void u32(uint32_t v) { wire::store_be(out_.data() + reserve(4), v); }
+  void u64(uint64_t v) { wire::store_be(out_.data() + reserve(8), v); }
+  void bytes(const void* p, size_t n) {
+    size_t at = reserve(n);
+    if (n > 0) std::memcpy(out_.data() + at, p, n);
+  }
+  void bytes(std::span<const uint8_t> b) { bytes(b.data(), b.size()); }
+  // a string the u16 prefix cannot describe is refused, never truncated
+  void str16(std::string_view s) {
+    if (s.size() > UINT16_MAX) throw std::length_error("protocol::Writer: string longer than 65535 bytes");
+    u16(static_cast<uint16_t>(s.size()));
+    bytes(s.data(), s.size());
+  }
+
+ private:
+  size_t reserve(size_t n) {
+    if (out_.size() - pos_ < n) throw std::logic_error("protocol::Writer: encoded_size too small");
+    size_t at = pos_;
+    pos_ += n;
+    return at;
+  }
+
+  std::span<uint8_t> out_;
+  size_t pos_ = 0;
+};
+
+// One allocation of exactly msg.encoded_size() bytes
+template <typename Msg>
+std::vector<uint8_t> encode(const Msg& msg) {
+  std::vector<uint8_t> out(msg.encoded_size());
+  Writer w(out);
+  msg.encode(w);
+  if (!w.full()) throw std::logic_error("protocol::encode: encoded_size too large");
+  return out;
+}
+
+} // namespace fsx::protocol
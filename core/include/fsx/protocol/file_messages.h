@@ -1,35 +1,13 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <span>
 #include <vector>
 #include <string>
 #include <stdexcept>
-#include <arpa/inet.h>
-
-// Portable 64-bit endian conversion helpers
-namespace {
-  inline uint64_t be64toh_portable(uint64_t x) {
-    #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-      return __builtin_bswap64(x);
-    #elif defined(_WIN32) || defined(_WIN64)
-      return _byteswap_uint64(x);
-    #else
-      // Fallback: manual byte swap
-      return ((x & 0xFF00000000000000ULL) >> 56) |
-             ((x & 0x00FF000000000000ULL) >> 40) |
-             ((x & 0x0000FF0000000000ULL) >> 24) |
-             ((x & 0x000000FF00000000ULL) >> 8)  |
-             ((x & 0x00000000FF000000ULL) << 8)  |
-             ((x & 0x0000000000FF0000ULL) << 24) |
-             ((x & 0x000000000000FF00ULL) << 40) |
-             ((x & 0x00000000000000FFULL) << 56);
-    #endif
-  }
-  
-  inline uint64_t htobe64_portable(uint64_t x) {
-    return be64toh_portable(x);  // Same operation
-  }
-}
+#include "fsx/protocol/codec.h"
 
 namespace fsx::protocol {
 
@@ -41,6 +19,37 @@ namespace fsx::protocol {
 // bytes filename
 // u64 file_size (network order)
 // u32 chunk_size (network order)
+// [u32 features] optional (network order), FILE_FEATURE_* bits the sender
+//                supports; older senders omit it (= 0)
+// if features has FILE_FEATURE_DEDUP:
+//   u32 block_count (network order)
+//   block_count x { u8[32] sha256, u32 length (network order) }:
+//     the file's chunks in order. Lengths may vary (content-defined
+//     chunking) but must be 1..chunk_size and add up to file_size; chunk i
+//     of the transfer is block i.
+// if features has FILE_FEATURE_COMPRESS:
+//   u8 codecs: bit (1 << id) for each chunk codec the sender can produce
+//     (ids as fsx::compress::Codec: 1 = zlib, 2 = lz4, 3 = zstd)
+
+// Negotiated per transfer: the sender offers, FILE_OFFER_RESP echoes the subset
+// the server agreed to
+static constexpr uint32_t FILE_FEATURE_ACK = 0x00000001;    // FILE_CHUNK_ACK + window
+static constexpr uint32_t FILE_FEATURE_DEDUP = 0x00000002;  // content-addressed blocks
+// CRC-32C trailer on every FILE_CHUNK, SHA-256 of the file in FILE_RESULT
+static constexpr uint32_t FILE_FEATURE_INTEGRITY = 0x00000004;
+// Sender understands FILE_NACK and resends what it asks for
+static constexpr uint32_t FILE_FEATURE_NACK = 0x00000008;
+// FILE_CHUNK data starts with a codec header (kChunkCodecHeader bytes:
+// u8 codec, u32 raw_len) and is compressed with that codec, or stored as-is
+// with codec 0. Each chunk is compressed on its own; the CRC-32C trailer
+// covers the bytes on the wire.
+static constexpr uint32_t FILE_FEATURE_COMPRESS = 0x00000010;
+static constexpr size_t kChunkCodecHeader = 5;
+
+struct OfferedBlock {
+  std::array<uint8_t, 32> sha256{};
+  uint32_t length = 0;
+};
 
 struct FileOfferReq {
   uint64_t client_transfer_id = 0;  // Client can suggest, server will assign
@@ -48,165 +57,208 @@ struct FileOfferReq {
   std::string filename;
   uint64_t file_size = 0;
   uint32_t chunk_size = 0;  // Recommended chunk size (server may adjust)
+  uint32_t features = 0;
+  std::vector<OfferedBlock> blocks;  // FILE_FEATURE_DEDUP
+  uint8_t codecs = 0;                // FILE_FEATURE_COMPRESS
+
+  static constexpr uint32_t kMaxBlocks = 256 * 1024;  // keeps the frame under ~10 MB
 
-  static FileOfferReq deserialize(const std::vector<uint8_t>& payload) {
+  using Wire = wire::Layout<wire::U64, wire::Str16, wire::Str16, wire::U64, wire::U32>;
+  using BlockWire = wire::Layout<wire::Bytes<32>, wire::U32>;
+
+  static FileOfferReq deserialize(std::span<const uint8_t> payload) {
     if (payload.size() < 14) throw std::runtime_error("FILE_OFFER_REQ: payload too short");
     
-    size_t pos = 0;
+    Reader r(payload, "FILE_OFFER_REQ");
     FileOfferReq req;
-    
-    // Client transfer ID (optional, 0 if not provided)
-    if (pos + 8 <= payload.size()) {
-      req.client_transfer_id = be64toh_portable(*reinterpret_cast<const uint64_t*>(payload.data() + pos));
-      pos += 8;
+    req.client_transfer_id = r.u64("transfer_id");
+    req.receiver_username = r.str16("receiver_username");
+    req.filename = r.str16("filename");
+    req.file_size = r.u64("file_size");
+    req.chunk_size = r.u32("chunk_size");
+    
+    // Features (optional)
+    if (r.has(4)) req.features = r.u32("features");
+    
+    if (req.features & FILE_FEATURE_DEDUP) {
+      uint32_t block_count = r.u32("block_count");
+      if (block_count > kMaxBlocks || !r.has(static_cast<size_t>(block_count) * BlockWire::kSize)) {
+        r.fail("invalid block_count");
+      }
+      // Bounds were checked for the whole run above
+      const uint8_t* p = r.bytes(static_cast<size_t>(block_count) * BlockWire::kSize, "blocks").data();
+      req.blocks.resize(block_count);
+      for (auto& b : req.blocks) {
+        std::memcpy(b.sha256.data(), p, b.sha256.size());
+        b.length = wire::load_be<uint32_t>(p + b.sha256.size());
+        p += BlockWire::kSize;
+      }
     }
     
-    // Receiver username
-    if (pos + 2 > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: missing receiver_username_len");
-    uint16_t receiver_username_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    if (pos + receiver_username_len > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: invalid receiver_username_len");
-    req.receiver_username = std::string(reinterpret_cast<const char*>(payload.data() + pos), receiver_username_len);
-    pos += receiver_username_len;
-    
-    // Filename
-    if (pos + 2 > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: missing filename_len");
-    uint16_t filename_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
-    if (pos + filename_len > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: invalid filename_len");
-    req.filename = std::string(reinterpret_cast<const char*>(payload.data() + pos), filename_len);
-    pos += filename_len;
-    
-    // File size
-    if (pos + 8 > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: missing file_size");
-      req.file_size = be64toh_portable(*reinterpret_cast<const uint64_t*>(payload.data() + pos));
-    pos += 8;
-    
-    // Chunk size
-    if (pos + 4 > payload.size()) throw std::runtime_error("FILE_OFFER_REQ: missing chunk_size");
-    req.chunk_size = ntohl(*reinterpret_cast<const uint32_t*>(payload.data() + pos));
-    pos += 4;
+    if (req.features & FILE_FEATURE_COMPRESS) req.codecs = r.u8("codecs");
     
     return req;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
-    
-    // Client transfer ID
-      uint64_t client_id_be = htobe64_portable(client_transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&client_id_be), 
-                   reinterpret_cast<const uint8_t*>(&client_id_be) + 8);
-    
-    // Receiver username
-    uint16_t receiver_username_len_be = htons((uint16_t)receiver_username.size());
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&receiver_username_len_be),
-                   reinterpret_cast<const uint8_t*>(&receiver_username_len_be) + 2);
-    payload.insert(payload.end(), receiver_username.begin(), receiver_username.end());
-    
-    // Filename
-    uint16_t filename_len_be = htons((uint16_t)filename.size());
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&filename_len_be),
-                   reinterpret_cast<const uint8_t*>(&filename_len_be) + 2);
-    payload.insert(payload.end(), filename.begin(), filename.end());
-    
-    // File size
-      uint64_t file_size_be = htobe64_portable(file_size);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&file_size_be),
-                   reinterpret_cast<const uint8_t*>(&file_size_be) + 8);
-    
-    // Chunk size
-    uint32_t chunk_size_be = htonl(chunk_size);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&chunk_size_be),
-                   reinterpret_cast<const uint8_t*>(&chunk_size_be) + 4);
-    
-    return payload;
+  size_t encoded_size() const {
+    size_t n = Wire::kSize + receiver_username.size() + filename.size();
+    if (features != 0) n += 4;
+    if (features & FILE_FEATURE_DEDUP) n += 4 + blocks.size() * BlockWire::kSize;
+    if (features & FILE_FEATURE_COMPRESS) n += 1;
+    return n;
   }
+
+  void encode(Writer& w) const {
+    w.u64(client_transfer_id);
+    w.str16(receiver_username);
+    w.str16(filename);
+    w.u64(file_size);
+    w.u32(chunk_size);
+    if (features != 0) w.u32(features);
+    if (features & FILE_FEATURE_DEDUP) {
+      w.u32(static_cast<uint32_t>(blocks.size()));
+      for (const auto& b : blocks) {
+        w.bytes(b.sha256.data(), b.sha256.size());
+        w.u32(b.length);
+      }
+    }
+    if (features & FILE_FEATURE_COMPRESS) w.u8(codecs);
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
 // FILE_OFFER_RESP payload format:
 // u8 status (0=OK, 1=FAIL)
 // u64 transfer_id (server-assigned, network order)
-// u16 reason_len (network order, 0 if OK)
-// bytes reason (if FAIL)
+// if OK and the offer carried features:
+//   u32 features (network order, agreed subset)
+//   u32 window_bytes (network order, initial send window for FILE_FEATURE_ACK)
+//   if features has FILE_FEATURE_DEDUP:
+//     u32 block_count (network order)
+//     bytes present[(block_count + 7) / 8]: bit i (LSB-first) set = block i
+//       is already stored; the sender must not send that chunk
+//   if features has FILE_FEATURE_COMPRESS:
+//     u8 codec: the one codec (from the offered set) chunks may use
+// if FAIL:
+//   u16 reason_len (network order)
+//   bytes reason
 
 struct FileOfferResp {
   bool ok = false;
   uint64_t transfer_id = 0;
+  uint32_t features = 0;
+  uint32_t window_bytes = 0;
+  uint32_t block_count = 0;      // FILE_FEATURE_DEDUP
+  std::vector<uint8_t> present;  // (block_count + 7) / 8 bytes
+  uint8_t codec = 0;             // FILE_FEATURE_COMPRESS
   std::string reason;
 
-  static FileOfferResp deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 9) throw std::runtime_error("FILE_OFFER_RESP: payload too short");
+  bool block_present(uint32_t i) const {
+    return i < block_count && (present[i / 8] >> (i % 8)) & 1;
+  }
+
+  using Wire = wire::Layout<wire::U8, wire::U64>;
+  using FeaturesWire = wire::Layout<wire::U32, wire::U32>;
+
+  static FileOfferResp deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_OFFER_RESP: payload too short");
     
-    size_t pos = 0;
+    Reader r(payload, "FILE_OFFER_RESP");
     FileOfferResp resp;
+    resp.ok = r.u8("status") == 0;
+    resp.transfer_id = r.u64("transfer_id");
     
-    resp.ok = (payload[pos] == 0);
-    pos += 1;
-    
-      resp.transfer_id = be64toh_portable(*reinterpret_cast<const uint64_t*>(payload.data() + pos));
-    pos += 8;
+    if (resp.ok && r.has(FeaturesWire::kSize)) {
+      resp.features = r.u32("features");
+      resp.window_bytes = r.u32("window_bytes");
+    }
     
-    if (!resp.ok && pos + 2 <= payload.size()) {
-      uint16_t reason_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-      pos += 2;
-      if (pos + reason_len <= payload.size()) {
-        resp.reason = std::string(reinterpret_cast<const char*>(payload.data() + pos), reason_len);
-      }
+    if (resp.ok && (resp.features & FILE_FEATURE_DEDUP)) {
+      resp.block_count = r.u32("block_count");
+      size_t bytes = (static_cast<size_t>(resp.block_count) + 7) / 8;
+      if (!r.has(bytes)) r.fail("truncated present bitmap");
+      auto present = r.bytes(bytes, "present");
+      resp.present.assign(present.begin(), present.end());
     }
     
+    if (resp.ok && (resp.features & FILE_FEATURE_COMPRESS)) resp.codec = r.u8("codec");
+    
+    std::string_view reason;
+    if (!resp.ok && r.try_str16(&reason)) resp.reason = reason;
+    
     return resp;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
-    
-    payload.push_back(ok ? 0 : 1);
-    
-      uint64_t transfer_id_be = htobe64_portable(transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&transfer_id_be),
-                   reinterpret_cast<const uint8_t*>(&transfer_id_be) + 8);
-    
-    if (!ok) {
-      uint16_t reason_len_be = htons((uint16_t)reason.size());
-      payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&reason_len_be),
-                     reinterpret_cast<const uint8_t*>(&reason_len_be) + 2);
-      payload.insert(payload.end(), reason.begin(), reason.end());
+  size_t encoded_size() const {
+    size_t n = Wire::kSize;
+    if (ok && features != 0) {
+      n += FeaturesWire::kSize;
+      if (features & FILE_FEATURE_DEDUP) n += 4 + present.size();
+      if (features & FILE_FEATURE_COMPRESS) n += 1;
     }
-    
-    return payload;
+    if (!ok) n += wire::Str16::kSize + reason.size();
+    return n;
   }
+
+  void encode(Writer& w) const {
+    w.u8(ok ? 0 : 1);
+    w.u64(transfer_id);
+    if (ok && features != 0) {
+      w.u32(features);
+      w.u32(window_bytes);
+      if (features & FILE_FEATURE_DEDUP) {
+        w.u32(block_count);
+        w.bytes(present);
+      }
+      if (features & FILE_FEATURE_COMPRESS) w.u8(codec);
+    }
+    if (!ok) w.str16(reason);
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
 // FILE_ACCEPT_REQ payload format:
 // u64 transfer_id (network order)
 // u8 accept (0=reject, 1=accept)
+// [u8 flags] optional, FILE_ACCEPT_RELAY: forward chunks to this session as
+//            they arrive (FILE_CHUNK frames, then FILE_DONE) instead of only
+//            storing them for FILE_FETCH
+
+static constexpr uint8_t FILE_ACCEPT_RELAY = 0x01;
 
 struct FileAcceptReq {
   uint64_t transfer_id = 0;
   bool accept = false;
+  uint8_t flags = 0;
+
+  using Wire = wire::Layout<wire::U64, wire::U8>;
 
-  static FileAcceptReq deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 9) throw std::runtime_error("FILE_ACCEPT_REQ: payload too short");
+  static FileAcceptReq deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_ACCEPT_REQ: payload too short");
     
+    Reader r(payload, "FILE_ACCEPT_REQ");
     FileAcceptReq req;
-    req.transfer_id = be64toh(*reinterpret_cast<const uint64_t*>(payload.data()));
-    req.accept = (payload[8] == 1);
+    req.transfer_id = r.u64("transfer_id");
+    req.accept = r.u8("accept") == 1;
+    if (r.has(1)) req.flags = r.u8("flags");
     
     return req;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
-    
-      uint64_t transfer_id_be = htobe64_portable(transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&transfer_id_be),
-                   reinterpret_cast<const uint8_t*>(&transfer_id_be) + 8);
-    
-    payload.push_back(accept ? 1 : 0);
-    
-    return payload;
+  size_t encoded_size() const { return Wire::kSize + (flags != 0 ? 1 : 0); }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u8(accept ? 1 : 0);
+    if (flags != 0) w.u8(flags);
   }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
 // FILE_ACCEPT_RESP payload format:
@@ -218,77 +270,100 @@ struct FileAcceptResp {
   bool ok = false;
   std::string reason;
 
-  static FileAcceptResp deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 1) throw std::runtime_error("FILE_ACCEPT_RESP: payload too short");
+  using Wire = wire::Layout<wire::U8>;
+
+  static FileAcceptResp deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_ACCEPT_RESP: payload too short");
     
+    Reader r(payload, "FILE_ACCEPT_RESP");
     FileAcceptResp resp;
-    resp.ok = (payload[0] == 0);
+    resp.ok = r.u8("status") == 0;
     
-    if (!resp.ok && payload.size() >= 3) {
-      uint16_t reason_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + 1));
-      if (3 + reason_len <= payload.size()) {
-        resp.reason = std::string(reinterpret_cast<const char*>(payload.data() + 3), reason_len);
-      }
-    }
+    std::string_view reason;
+    if (!resp.ok && r.try_str16(&reason)) resp.reason = reason;
     
     return resp;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
-    
-    payload.push_back(ok ? 0 : 1);
-    
-    if (!ok) {
-      uint16_t reason_len_be = htons((uint16_t)reason.size());
-      payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&reason_len_be),
-                     reinterpret_cast<const uint8_t*>(&reason_len_be) + 2);
-      payload.insert(payload.end(), reason.begin(), reason.end());
-    }
-    
-    return payload;
+  size_t encoded_size() const { return Wire::kSize + (ok ? 0 : wire::Str16::kSize + reason.size()); }
+
+  void encode(Writer& w) const {
+    w.u8(ok ? 0 : 1);
+    if (!ok) w.str16(reason);
   }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
 // FILE_CHUNK payload format:
 // u64 transfer_id (network order)
 // u32 chunk_index (network order)
 // bytes chunk_data (rest of payload)
+// Sender -> server on a FILE_FEATURE_INTEGRITY transfer: the last 4 bytes
+// are u32 crc32c (network order) of chunk_data instead. A chunk that doesn't
+// match is dropped (not stored, not acknowledged). Chunks the server sends
+// (fetch, relay) never carry it.
 
 struct FileChunk {
   uint64_t transfer_id = 0;
   uint32_t chunk_index = 0;
   std::vector<uint8_t> data;
 
-  static FileChunk deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 12) throw std::runtime_error("FILE_CHUNK: payload too short");
-    
-    FileChunk chunk;
-    chunk.transfer_id = be64toh(*reinterpret_cast<const uint64_t*>(payload.data()));
-    chunk.chunk_index = ntohl(*reinterpret_cast<const uint32_t*>(payload.data() + 8));
-    
-    if (payload.size() > 12) {
-      chunk.data.assign(payload.begin() + 12, payload.end());
+  using Wire = wire::Layout<wire::U64, wire::U32>;
+
+  static constexpr uint32_t kMaxChunkSize = 1024 * 1024;  // FILE_OFFER_REQ chunk_size cap
+  // Largest chunk plus its codec header and CRC-32C trailer
+  static constexpr uint32_t kMaxPayload = Wire::kSize + kChunkCodecHeader + kMaxChunkSize + 4;
+
+  // data points into the payload
+  struct View {
+    uint64_t transfer_id = 0;
+    uint32_t chunk_index = 0;
+    std::span<const uint8_t> data;
+
+    static View decode(std::span<const uint8_t> payload) {
+      if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_CHUNK: payload too short");
+      Reader r(payload, "FILE_CHUNK");
+      View v;
+      v.transfer_id = r.u64("transfer_id");
+      v.chunk_index = r.u32("chunk_index");
+      v.data = r.rest();
+      return v;
     }
-    
+  };
+
+  static FileChunk deserialize(std::span<const uint8_t> payload) {
+    View v = View::decode(payload);
+    FileChunk chunk;
+    chunk.transfer_id = v.transfer_id;
+    chunk.chunk_index = v.chunk_index;
+    chunk.data.assign(v.data.begin(), v.data.end());
     return chunk;
   }
 
+  size_t encoded_size() const { return Wire::kSize + data.size(); }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u32(chunk_index);
+    w.bytes(data);
+  }
+
+  // Appends data to the encoded header rather than copying it over a
+  // zero-filled buffer: the copy is the whole cost for a large chunk
   std::vector<uint8_t> serialize() const {
+    uint8_t head[Wire::kSize];
+    Writer w(head);
+    w.u64(transfer_id);
+    w.u32(chunk_index);
     std::vector<uint8_t> payload;
-    
-      uint64_t transfer_id_be = htobe64_portable(transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&transfer_id_be),
-                   reinterpret_cast<const uint8_t*>(&transfer_id_be) + 8);
-    
-    uint32_t chunk_index_be = htonl(chunk_index);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&chunk_index_be),
-                   reinterpret_cast<const uint8_t*>(&chunk_index_be) + 4);
-    
+    payload.reserve(encoded_size());
+    payload.assign(head, head + Wire::kSize);
     payload.insert(payload.end(), data.begin(), data.end());
-    
     return payload;
   }
+
 };
 
 // FILE_DONE payload format:
@@ -301,34 +376,30 @@ struct FileDone {
   uint32_t total_chunks = 0;
   uint64_t file_size = 0;
 
-  static FileDone deserialize(const std::vector<uint8_t>& payload) {
-    if (payload.size() < 16) throw std::runtime_error("FILE_DONE: payload too short");
+  using Wire = wire::Layout<wire::U64, wire::U32, wire::U64>;
+
+  static FileDone deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_DONE: payload too short");
     
+    Reader r(payload, "FILE_DONE");
     FileDone done;
-    done.transfer_id = be64toh(*reinterpret_cast<const uint64_t*>(payload.data()));
-    done.total_chunks = ntohl(*reinterpret_cast<const uint32_t*>(payload.data() + 8));
-    done.file_size = be64toh(*reinterpret_cast<const uint64_t*>(payload.data() + 12));
+    done.transfer_id = r.u64("transfer_id");
+    done.total_chunks = r.u32("total_chunks");
+    done.file_size = r.u64("file_size");
     
     return done;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
-    
-      uint64_t transfer_id_be = htobe64_portable(transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&transfer_id_be),
-                   reinterpret_cast<const uint8_t*>(&transfer_id_be) + 8);
-    
-    uint32_t total_chunks_be = htonl(total_chunks);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&total_chunks_be),
-                   reinterpret_cast<const uint8_t*>(&total_chunks_be) + 4);
-    
-      uint64_t file_size_be = htobe64_portable(file_size);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&file_size_be),
-                   reinterpret_cast<const uint8_t*>(&file_size_be) + 8);
-    
-    return payload;
+  size_t encoded_size() const { return Wire::kSize; }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u32(total_chunks);
+    w.u64(file_size);
   }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
 // FILE_RESULT payload format:
@@ -336,46 +407,433 @@ struct FileDone {
 // u8 status (0=OK, 1=FAIL)
 // u16 path_len (network order, 0 if FAIL)
 // bytes saved_path (if OK) or error_reason (if FAIL)
+// [u8[32] sha256] optional, OK on a FILE_FEATURE_INTEGRITY transfer: digest
+//                 of the file as the server stored it
 
 struct FileResult {
   uint64_t transfer_id = 0;
   bool ok = false;
   std::string path_or_reason;  // saved path if OK, error reason if FAIL
+  bool has_sha256 = false;
+  std::array<uint8_t, 32> sha256{};
+
+  using Wire = wire::Layout<wire::U64, wire::U8, wire::Str16>;
 
-  static FileResult deserialize(const std::vector<uint8_t>& payload) {
+  static FileResult deserialize(std::span<const uint8_t> payload) {
     if (payload.size() < 9) throw std::runtime_error("FILE_RESULT: payload too short");
     
+    Reader r(payload, "FILE_RESULT");
     FileResult result;
-    result.transfer_id = be64toh(*reinterpret_cast<const uint64_t*>(payload.data()));
-    result.ok = (payload[8] == 0);
-    
-    if (payload.size() >= 11) {
-      uint16_t path_len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + 9));
-      if (11 + path_len <= payload.size()) {
-        result.path_or_reason = std::string(reinterpret_cast<const char*>(payload.data() + 11), path_len);
+    result.transfer_id = r.u64("transfer_id");
+    result.ok = r.u8("status") == 0;
+    
+    std::string_view text;
+    if (r.try_str16(&text)) {
+      result.path_or_reason = text;
+      if (result.ok && r.has(result.sha256.size())) {
+        r.copy(result.sha256.data(), result.sha256.size(), "sha256");
+        result.has_sha256 = true;
       }
     }
     
     return result;
   }
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> payload;
+  size_t encoded_size() const {
+    return Wire::kSize + path_or_reason.size() + (ok && has_sha256 ? sha256.size() : 0);
+  }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u8(ok ? 0 : 1);
+    w.str16(path_or_reason);
+    if (ok && has_sha256) w.bytes(sha256.data(), sha256.size());
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+// FILE_CHUNK_ACK payload format (server -> sender, FILE_FEATURE_ACK only):
+// u64 transfer_id (network order)
+// u32 cumulative_ack (network order): every chunk below this index is stored
+// u32 window_bytes (network order): how many unacknowledged bytes the sender
+//     may have outstanding from now on
+// u16 sack_len (network order)
+// bytes sack: bit i (LSB-first within each byte) set = chunk
+//     cumulative_ack + 1 + i is stored too
+
+struct FileChunkAck {
+  static constexpr size_t kMaxSackBytes = 256;
+
+  uint64_t transfer_id = 0;
+  uint32_t cumulative_ack = 0;
+  uint32_t window_bytes = 0;
+  std::vector<uint8_t> sack;
+
+  bool sacked(uint32_t chunk_index) const {
+    if (chunk_index <= cumulative_ack) return false;
+    uint32_t bit = chunk_index - cumulative_ack - 1;
+    if (bit / 8 >= sack.size()) return false;
+    return (sack[bit / 8] >> (bit % 8)) & 1;
+  }
+
+  using Wire = wire::Layout<wire::U64, wire::U32, wire::U32, wire::U16>;
+
+  // sack points into the payload
+  struct View {
+    uint64_t transfer_id = 0;
+    uint32_t cumulative_ack = 0;
+    uint32_t window_bytes = 0;
+    std::span<const uint8_t> sack;
+
+    static View decode(std::span<const uint8_t> payload) {
+      if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_CHUNK_ACK: payload too short");
+      Reader r(payload, "FILE_CHUNK_ACK");
+      View v;
+      v.transfer_id = r.u64("transfer_id");
+      v.cumulative_ack = r.u32("cumulative_ack");
+      v.window_bytes = r.u32("window_bytes");
+      uint16_t sack_len = r.u16("sack_len");
+      if (sack_len > kMaxSackBytes || !r.has(sack_len)) r.fail("invalid sack_len");
+      v.sack = r.bytes(sack_len, "sack");
+      return v;
+    }
+  };
+
+  static FileChunkAck deserialize(std::span<const uint8_t> payload) {
+    View v = View::decode(payload);
+    FileChunkAck ack;
+    ack.transfer_id = v.transfer_id;
+    ack.cumulative_ack = v.cumulative_ack;
+    ack.window_bytes = v.window_bytes;
+    ack.sack.assign(v.sack.begin(), v.sack.end());
+    return ack;
+  }
+
+  size_t encoded_size() const { return Wire::kSize + sack.size(); }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u32(cumulative_ack);
+    w.u32(window_bytes);
+    w.u16(static_cast<uint16_t>(sack.size()));
+    w.bytes(sack);
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+// FILE_FETCH_REQ payload format:
+// u64 transfer_id (network order)
+//
+// Sent by the receiver of a COMPLETED transfer. The server answers with
+// FILE_FETCH_RESP and, if OK, streams the file as FILE_CHUNK frames
+// (same layout as uploads, chunk_index 0..total_chunks-1 in order)
+// followed by FILE_DONE, or by FILE_RESULT with status FAIL if a stored
+// chunk turns out to be unreadable part way through.
+
+struct FileFetchReq {
+  uint64_t transfer_id = 0;
+
+  using Wire = wire::Layout<wire::U64>;
+
+  static FileFetchReq deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_FETCH_REQ: payload too short");
+    
+    Reader r(payload, "FILE_FETCH_REQ");
+    FileFetchReq req;
+    req.transfer_id = r.u64("transfer_id");
+    return req;
+  }
+
+  size_t encoded_size() const { return Wire::kSize; }
+
+  void encode(Writer& w) const { w.u64(transfer_id); }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+// FILE_FETCH_RESP payload format:
+// u8 status (0=OK, 1=FAIL)
+// u64 transfer_id (network order)
+// if OK:
+//   u64 file_size (network order)
+//   u32 chunk_size (network order)
+//   u32 total_chunks (network order)
+//   u16 filename_len (network order)
+//   bytes filename
+//   [u8[32] sha256] optional: digest of the file, if it was uploaded with
+//                   FILE_FEATURE_INTEGRITY
+// if FAIL:
+//   u16 reason_len (network order)
+//   bytes reason
+
+struct FileFetchResp {
+  bool ok = false;
+  uint64_t transfer_id = 0;
+  uint64_t file_size = 0;
+  uint32_t chunk_size = 0;
+  uint32_t total_chunks = 0;
+  std::string filename;
+  bool has_sha256 = false;
+  std::array<uint8_t, 32> sha256{};
+  std::string reason;
+
+  using Wire = wire::Layout<wire::U8, wire::U64, wire::Str16>;
+  using OkWire = wire::Layout<wire::U64, wire::U32, wire::U32>;
+
+  static FileFetchResp deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < 9) throw std::runtime_error("FILE_FETCH_RESP: payload too short");
+    
+    Reader r(payload, "FILE_FETCH_RESP");
+    FileFetchResp resp;
+    resp.ok = r.u8("status") == 0;
+    resp.transfer_id = r.u64("transfer_id");
     
-      uint64_t transfer_id_be = htobe64_portable(transfer_id);
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&transfer_id_be),
-                   reinterpret_cast<const uint8_t*>(&transfer_id_be) + 8);
+    if (resp.ok) {
+      if (!r.has(OkWire::kSize + wire::Str16::kSize)) r.fail("missing file info");
+      resp.file_size = r.u64("file_size");
+      resp.chunk_size = r.u32("chunk_size");
+      resp.total_chunks = r.u32("total_chunks");
+    }
     
-    payload.push_back(ok ? 0 : 1);
+    std::string_view text;
+    if (r.try_str16(&text)) {
+      if (resp.ok) resp.filename = text;
+      else resp.reason = text;
+    }
     
-    uint16_t path_len_be = htons((uint16_t)path_or_reason.size());
-    payload.insert(payload.end(), reinterpret_cast<const uint8_t*>(&path_len_be),
-                   reinterpret_cast<const uint8_t*>(&path_len_be) + 2);
-    payload.insert(payload.end(), path_or_reason.begin(), path_or_reason.end());
+    if (resp.ok && r.has(resp.sha256.size())) {
+      r.copy(resp.sha256.data(), resp.sha256.size(), "sha256");
+      resp.has_sha256 = true;
+    }
     
-    return payload;
+    return resp;
   }
+
+  size_t encoded_size() const {
+    if (!ok) return Wire::kSize + reason.size();
+    return Wire::kSize + OkWire::kSize + filename.size() + (has_sha256 ? sha256.size() : 0);
+  }
+
+  void encode(Writer& w) const {
+    w.u8(ok ? 0 : 1);
+    w.u64(transfer_id);
+    if (ok) {
+      w.u64(file_size);
+      w.u32(chunk_size);
+      w.u32(total_chunks);
+    }
+    w.str16(ok ? filename : reason);
+    if (ok && has_sha256) w.bytes(sha256.data(), sha256.size());
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
 };
 
-} // namespace fsx::protocol
+// FILE_RESUME_REQ payload format:
+// u64 transfer_id (network order)
+//
+// Sent by the sender of an ACCEPTED/RECEIVING transfer on a new connection
+// (the server may have restarted in between). The answer lists the chunks
+// already stored so only the rest has to be sent again, followed by FILE_DONE
+// as usual.
+
+struct FileResumeReq {
+  uint64_t transfer_id = 0;
+
+  using Wire = wire::Layout<wire::U64>;
+
+  static FileResumeReq deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_RESUME_REQ: payload too short");
+    
+    Reader r(payload, "FILE_RESUME_REQ");
+    FileResumeReq req;
+    req.transfer_id = r.u64("transfer_id");
+    return req;
+  }
 
+  size_t encoded_size() const { return Wire::kSize; }
+
+  void encode(Writer& w) const { w.u64(transfer_id); }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+// FILE_RESUME_RESP payload format:
+// u8 status (0=OK, 1=FAIL)
+// u64 transfer_id (network order)
+// if OK:
+//   u64 file_size (network order)
+//   u32 chunk_size (network order)
+//   u32 total_chunks (network order)
+//   u32 features (network order, as granted in FILE_OFFER_RESP)
+//   u32 window_bytes (network order, FILE_FEATURE_ACK only)
+//   u32 range_count (network order)
+//   range_count x { u32 first_chunk, u32 chunk_count } (network order):
+//     chunks already stored, ascending. At most kMaxRanges; a heavily
+//     fragmented transfer reports only the first ones and the sender just
+//     resends the rest (duplicates are harmless).
+//   if features has FILE_FEATURE_COMPRESS:
+//     u8 codec (as granted in FILE_OFFER_RESP)
+// if FAIL:
+//   u16 reason_len (network order)
+//   bytes reason
+
+struct FileResumeResp {
+  static constexpr uint32_t kMaxRanges = 65536;
+
+  struct Range {
+    uint32_t first = 0;
+    uint32_t count = 0;
+  };
+
+  bool ok = false;
+  uint64_t transfer_id = 0;
+  uint64_t file_size = 0;
+  uint32_t chunk_size = 0;
+  uint32_t total_chunks = 0;
+  uint32_t features = 0;
+  uint32_t window_bytes = 0;
+  std::vector<Range> ranges;
+  uint8_t codec = 0;  // FILE_FEATURE_COMPRESS
+  std::string reason;
+
+  using Wire = wire::Layout<wire::U8, wire::U64>;
+  using OkWire = wire::Layout<wire::U64, wire::U32, wire::U32, wire::U32, wire::U32, wire::U32>;
+  using RangeWire = wire::Layout<wire::U32, wire::U32>;
+
+  static FileResumeResp deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_RESUME_RESP: payload too short");
+    
+    Reader r(payload, "FILE_RESUME_RESP");
+    FileResumeResp resp;
+    resp.ok = r.u8("status") == 0;
+    resp.transfer_id = r.u64("transfer_id");
+    
+    if (!resp.ok) {
+      std::string_view reason;
+      if (r.try_str16(&reason)) resp.reason = reason;
+      return resp;
+    }
+    
+    if (!r.has(OkWire::kSize)) r.fail("missing file info");
+    resp.file_size = r.u64("file_size");
+    resp.chunk_size = r.u32("chunk_size");
+    resp.total_chunks = r.u32("total_chunks");
+    resp.features = r.u32("features");
+    resp.window_bytes = r.u32("window_bytes");
+    uint32_t range_count = r.u32("range_count");
+    if (range_count > kMaxRanges || !r.has(static_cast<size_t>(range_count) * RangeWire::kSize)) {
+      r.fail("invalid range_count");
+    }
+    resp.ranges.resize(range_count);
+    for (auto& range : resp.ranges) {
+      range.first = r.u32("first_chunk");
+      range.count = r.u32("chunk_count");
+    }
+    
+    if (resp.features & FILE_FEATURE_COMPRESS) resp.codec = r.u8("codec");
+    
+    return resp;
+  }
+
+  size_t encoded_size() const {
+    if (!ok) return Wire::kSize + wire::Str16::kSize + reason.size();
+    return Wire::kSize + OkWire::kSize + ranges.size() * RangeWire::kSize +
+           ((features & FILE_FEATURE_COMPRESS) ? 1 : 0);
+  }
+
+  void encode(Writer& w) const {
+    w.u8(ok ? 0 : 1);
+    w.u64(transfer_id);
+    if (!ok) {
+      w.str16(reason);
+      return;
+    }
+    w.u64(file_size);
+    w.u32(chunk_size);
+    w.u32(total_chunks);
+    w.u32(features);
+    w.u32(window_bytes);
+    w.u32(static_cast<uint32_t>(ranges.size()));
+    for (const auto& range : ranges) {
+      w.u32(range.first);
+      w.u32(range.count);
+    }
+    if (features & FILE_FEATURE_COMPRESS) w.u8(codec);
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+// FILE_NACK payload format (server -> sender, FILE_FEATURE_NACK only):
+// u64 transfer_id (network order)
+// u8 reason (NackReason)
+// u16 range_count (network order, 1..kMaxRanges)
+// range_count x { u32 first_chunk, u32 chunk_count } (network order)
+//
+// The sender resends exactly these chunks, then carries on. For
+// FILE_FEATURE_ACK accounting they are no longer in flight. A chunk asked for
+// too many times fails the transfer instead.
+
+enum class NackReason : uint8_t {
+  CORRUPT = 1,    // failed its CRC-32C or block hash
+  MISSING = 2,    // not received within the retransmit timeout
+  NOT_STORED = 3  // arrived but couldn't be written
+};
+
+struct FileNack {
+  static constexpr size_t kMaxRanges = 1024;
+
+  uint64_t transfer_id = 0;
+  NackReason reason = NackReason::MISSING;
+  std::vector<FileResumeResp::Range> ranges;
+
+  using Wire = wire::Layout<wire::U64, wire::U8, wire::U16>;
+  using RangeWire = FileResumeResp::RangeWire;
+
+  static FileNack deserialize(std::span<const uint8_t> payload) {
+    if (payload.size() < Wire::kSize) throw std::runtime_error("FILE_NACK: payload too short");
+    
+    Reader r(payload, "FILE_NACK");
+    FileNack nack;
+    nack.transfer_id = r.u64("transfer_id");
+    nack.reason = static_cast<NackReason>(r.u8("reason"));
+    uint16_t range_count = r.u16("range_count");
+    if (range_count == 0 || range_count > kMaxRanges ||
+        !r.has(static_cast<size_t>(range_count) * RangeWire::kSize)) {
+      r.fail("invalid range_count");
+    }
+    nack.ranges.resize(range_count);
+    for (auto& range : nack.ranges) {
+      range.first = r.u32("first_chunk");
+      range.count = r.u32("chunk_count");
+    }
+    
+    return nack;
+  }
+
+  size_t encoded_size() const { return Wire::kSize + ranges.size() * RangeWire::kSize; }
+
+  void encode(Writer& w) const {
+    w.u64(transfer_id);
+    w.u8(static_cast<uint8_t>(reason));
+    w.u16(static_cast<uint16_t>(ranges.size()));
+    for (const auto& range : ranges) {
+      w.u32(range.first);
+      w.u32(range.count);
+    }
+  }
+
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
+
+};
+
+} // namespace fsx::protocol
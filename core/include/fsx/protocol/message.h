@@ -31,6 +31,16 @@ enum class MsgType : uint8_t {
   FILE_CHUNK       = 34,
   FILE_DONE        = 35,
   FILE_RESULT      = 36,
+  // Download of a completed transfer by its receiver
+  FILE_FETCH_REQ   = 37,
+  FILE_FETCH_RESP  = 38,
+  // Per-chunk acknowledgement + send window (FILE_FEATURE_ACK)
+  FILE_CHUNK_ACK   = 39,
+  // Sender picking an unfinished upload back up (after a reconnect or restart)
+  FILE_RESUME_REQ  = 40,
+  FILE_RESUME_RESP = 41,
+  // Server asking the sender to resend chunks (FILE_FEATURE_NACK)
+  FILE_NACK        = 42,
   // Admin messages (port 9100)
   ADMIN_ONLINE_LIST_REQ  = 100,
   ADMIN_ONLINE_LIST_RESP = 101
@@ -1,9 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
-#include <arpa/inet.h>
+#include "fsx/protocol/codec.h"
 
 namespace fsx::protocol {
 
@@ -18,47 +19,32 @@ namespace fsx::protocol {
 struct OnlineListResp {
   std::vector<std::string> usernames;
 
-  std::vector<uint8_t> serialize() const {
-    std::vector<uint8_t> out;
-    size_t est_size = 2 + usernames.size() * 64; // rough estimate
-    out.reserve(est_size);
+  using Wire = wire::Layout<wire::U16>;
 
-    uint16_t count_be = htons(static_cast<uint16_t>(usernames.size()));
-    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&count_be),
-               reinterpret_cast<const uint8_t*>(&count_be) + 2);
-
-    for (const auto& username : usernames) {
-      uint16_t len_be = htons(static_cast<uint16_t>(username.size()));
-      out.insert(out.end(), reinterpret_cast<const uint8_t*>(&len_be),
-                 reinterpret_cast<const uint8_t*>(&len_be) + 2);
-      out.insert(out.end(), username.begin(), username.end());
-    }
-
-    return out;
+  size_t encoded_size() const {
+    size_t n = Wire::kSize;
+    for (const auto& username : usernames) n += wire::Str16::kSize + username.size();
+    return n;
+  }
+  void encode(Writer& w) const {
+    w.u16(static_cast<uint16_t>(usernames.size()));
+    for (const auto& username : usernames) w.str16(username);
   }
+  std::vector<uint8_t> serialize() const { return protocol::encode(*this); }
 
-  static OnlineListResp deserialize(const std::vector<uint8_t>& payload) {
+  // Lenient: a truncated list yields the names that made it
+  static OnlineListResp deserialize(std::span<const uint8_t> payload) {
     OnlineListResp resp;
-    if (payload.size() < 2) return resp;
-
-    size_t pos = 0;
-    uint16_t count = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-    pos += 2;
+    Reader r(payload, "ONLINE_LIST_RESP");
+    if (!r.has(2)) return resp;
 
+    uint16_t count = r.u16("count");
     resp.usernames.reserve(count);
-    for (uint16_t i = 0; i < count && pos + 2 <= payload.size(); i++) {
-      uint16_t len = ntohs(*reinterpret_cast<const uint16_t*>(payload.data() + pos));
-      pos += 2;
-      if (pos + len <= payload.size()) {
-        std::string username(reinterpret_cast<const char*>(payload.data() + pos), len);
-        resp.usernames.push_back(std::move(username));
-        pos += len;
-      }
-    }
+    std::string_view username;
+    for (uint16_t i = 0; i < count && r.try_str16(&username); i++) resp.usernames.emplace_back(username);
 
     return resp;
   }
 };
 
 } // namespace fsx::protocol
-
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "fsx/crypto/sha256.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fsx::storage {
+
+// A block is keyed by the SHA-256 of its contents
+using BlockId = fsx::crypto::Sha256Digest;
+
+struct BlockRef {
+  BlockId id{};
+  uint32_t length = 0;
+};
+
+// Content-addressed chunk store shared by every FILE_FEATURE_DEDUP transfer.
+// Each distinct block is one file, <base>/<2 hex>/<64 hex>, written once and
+// reference counted; a deduplicated file is a manifest listing its blocks in
+// order (see write_manifest), so a second upload of the same installer costs
+// a manifest and no data.
+//
+// A block may be stored compressed: then its file is u8 codec
+// (fsx::compress::Codec) + the compressed bytes, always shorter than the
+// block, so a file whose size differs from the block length is a packed one.
+//
+// Reference counts live in memory. initialize() rebuilds them from the
+// manifests on disk, and then removes blocks that no manifest names (left
+// behind by transfers that never finished). Thread-safe.
+class BlockStore {
+ public:
+  explicit BlockStore(std::string base_path = "./storage/blocks");
+
+  // Creates the directory and loads the index; manifests_root is scanned
+  // for */*.manifest
+  bool initialize(const std::string& manifests_root);
+
+  // Takes a reference if the block is stored; false if it isn't
+  bool ref_if_present(const BlockId& id);
+
+  // Stores data as block id and takes a reference. The caller has checked
+  // that data hashes to id. The write goes to a temp file outside the lock;
+  // if another transfer stored the same block meanwhile it's discarded and
+  // *created is false. False on I/O error (logged, no reference taken).
+  // packed: the same block compressed with codec, as it came off the wire
+  // (FILE_FEATURE_COMPRESS); stored instead of data when given and, with
+  // its codec byte, shorter than len.
+  bool put(const BlockId& id, const void* data, size_t len, bool* created = nullptr,
+           uint8_t codec = 0, const void* packed = nullptr, size_t packed_len = 0);
+
+  // Drops a reference; the last one deletes the block file
+  void unref(const BlockId& id);
+
+  std::string block_path(const BlockId& id) const;
+  // O_RDONLY fd of a stored block, -1 on error. Its contents are the block
+  // itself only if the file is length bytes long (see is_packed).
+  int open_block(const BlockId& id) const;
+  static bool is_packed(int fd, uint32_t length);
+  // The block's contents, decompressed if it is stored packed
+  bool read_block(const BlockId& id, uint32_t length, std::vector<uint8_t>* out) const;
+
+  // Manifest: one "<64 hex> <length>" line per block, in file order, written
+  // via temp file + rename. sync: syncfs() first, so the blocks it names are
+  // on stable storage before the manifest that makes them reachable.
+  bool write_manifest(const std::string& path, const std::vector<BlockRef>& blocks, bool sync);
+  static bool read_manifest(const std::string& path, std::vector<BlockRef>* blocks);
+
+  size_t block_count() const;
+  uint64_t stored_bytes() const;
+
+ private:
+  struct Entry {
+    uint32_t refs = 0;
+    uint32_t length = 0;  // on disk
+  };
+  struct IdHash {
+    size_t operator()(const BlockId& id) const {
+      size_t h;
+      std::memcpy(&h, id.data(), sizeof(h));  // already uniformly distributed
+      return h;
+    }
+  };
+
+  std::string base_path_;
+  mutable std::mutex mu_;
+  std::unordered_map<BlockId, Entry, IdHash> blocks_;
+  uint64_t stored_bytes_ = 0;
+  uint64_t tmp_seq_ = 0;
+};
+
+} // namespace fsx::storage
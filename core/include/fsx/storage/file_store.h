@@ -1,30 +1,66 @@
 #pragma once
 
+#include "fsx/storage/write_handle.h"
+#include <boost/asio.hpp>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <memory>
 
 namespace fsx::storage {
 
+class IoUringEngine;
+
 class FileStore {
 public:
-  FileStore(const std::string& base_storage_path = "./storage/transfers");
+  FileStore(const std::string& base_storage_path = "./storage/transfers",
+            WritePolicy policy = WritePolicy{});
   ~FileStore();
 
   // Initialize storage directory structure
   bool initialize();
 
-  // Open a file for writing (creates .part file)
-  // Returns file handle (FILE*) or nullptr on error
-  void* open_for_write(uint64_t transfer_id, const std::string& filename);
+  // Switches chunk writes, fsync and rename to io_uring. Returns false (and
+  // keeps the blocking path) if fsx_core was built without FSX_WITH_IO_URING
+  // or the ring can't be created.
+  bool enable_io_uring(boost::asio::io_context& io, unsigned entries);
+  bool uses_io_uring() const { return uring_ != nullptr; }
+
+  // Open a file for writing (creates .part file, preallocated to file_size)
+  // Returns the write handle or nullptr on error. resume reopens the .part
+  // file of a transfer restored after a restart without truncating it.
+  std::shared_ptr<WriteHandle> open_for_write(uint64_t transfer_id, const std::string& filename,
+                                              uint64_t file_size, uint32_t chunk_size,
+                                              bool resume = false);
 
-  // Write chunk data to file
+  // Write chunk data at chunk_index * chunk_size
   // Returns bytes written, or -1 on error
-  int64_t write_chunk(void* file_handle, const void* data, size_t len);
+  int64_t write_chunk(WriteHandle& handle, uint32_t chunk_index, const void* data, size_t len);
 
-  // Finalize file: close, rename .part to final filename
+  // Finalize file: close (durability policy applies), rename .part to final filename
   // Returns true on success
-  bool finalize_file(uint64_t transfer_id, const std::string& filename, void* file_handle);
+  bool finalize_file(uint64_t transfer_id, const std::string& filename, WriteHandle& handle);
+
+  // Async flavours used by TcpSession. cb runs on ex once the chunk is in
+  // the file (or failed); data must stay valid until on_queued has run.
+  // With io_uring the work is submitted to the ring, otherwise it runs
+  // inline and cb is dispatched to ex. Coalescing only applies to the
+  // blocking path (the ring already batches submissions); there a staged
+  // chunk's cb waits for its run to be written, which takes later chunks or
+  // a WriteHandle::flush(). on_queued runs on ex, after cb unless the chunk
+  // was staged, once the store is ready for the next chunk: gate reading on
+  // it, not on cb.
+  using WriteCallback = std::function<void(int64_t written)>;
+  using FinalizeCallback = std::function<void(bool ok)>;
+  void async_write_chunk(std::shared_ptr<WriteHandle> handle, uint32_t chunk_index,
+                         const void* data, size_t len,
+                         boost::asio::any_io_executor ex, WriteCallback cb,
+                         std::function<void()> on_queued = nullptr);
+  void async_finalize_file(uint64_t transfer_id, const std::string& filename,
+                           std::shared_ptr<WriteHandle> handle,
+                           boost::asio::any_io_executor ex, FinalizeCallback cb);
+
+  const WritePolicy& write_policy() const { return policy_; }
 
   // Get full path for a transfer file
   std::string get_file_path(uint64_t transfer_id, const std::string& filename) const;
@@ -35,6 +71,8 @@ public:
 
 private:
   std::string base_path_;
+  WritePolicy policy_;
+  std::shared_ptr<IoUringEngine> uring_;  // null: blocking WriteHandle path
   
   // Ensure directory exists
   bool ensure_directory(const std::string& path);
@@ -0,0 +1,67 @@
+#pragma once
+
+// io_uring submission/completion for FileStore (build with -DFSX_WITH_IO_URING=ON).
+// Only compiled when liburing is available; FileStore falls back to the
+// blocking WriteHandle path otherwise.
+#ifdef FSX_HAVE_IO_URING
+
+#include <boost/asio.hpp>
+#include <liburing.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace fsx::storage {
+
+// One ring shared by all transfers. Any thread may submit; completions are
+// reaped on the io_context (the ring's eventfd is watched by asio) and each
+// callback is posted to the executor it was submitted with, typically the
+// owning TcpSession's strand.
+class IoUringEngine {
+ public:
+  // res is the CQE result: bytes written / 0 on success, -errno on failure
+  using Completion = std::function<void(int res)>;
+
+  // Throws std::runtime_error if the ring can't be set up (old kernel,
+  // seccomp, RLIMIT_MEMLOCK); callers treat that as "use the sync path"
+  IoUringEngine(boost::asio::io_context& io, unsigned entries);
+  ~IoUringEngine();
+
+  IoUringEngine(const IoUringEngine&) = delete;
+  IoUringEngine& operator=(const IoUringEngine&) = delete;
+
+  // Writes all of [data, data+len) at offset (short writes are resubmitted).
+  // data must stay valid until cb runs.
+  void write(int fd, const void* data, size_t len, uint64_t offset,
+             boost::asio::any_io_executor ex, Completion cb);
+  void fdatasync(int fd, boost::asio::any_io_executor ex, Completion cb);
+  void rename(std::string from, std::string to, boost::asio::any_io_executor ex, Completion cb);
+
+ private:
+  struct Op {
+    boost::asio::any_io_executor ex;
+    Completion cb;
+    std::string from, to;  // rename
+  };
+
+  // Gets an SQE (flushing the SQ if full), lets prep fill it, submits.
+  // Without a free SQE the op completes with -EBUSY. Once prepared the SQE
+  // belongs to the ring: if io_uring_submit fails it stays queued and goes
+  // out with the next submit (reap() retries), and the op completes from
+  // its CQE like any other.
+  void submit(std::unique_ptr<Op> op, const std::function<void(io_uring_sqe*)>& prep);
+  void wait_completions();
+  void reap();
+
+  io_uring ring_;
+  int event_fd_ = -1;
+  boost::asio::posix::stream_descriptor event_desc_;
+  std::mutex sq_mu_;
+  bool unsubmitted_ = false;  // SQEs left queued by a failed io_uring_submit (under sq_mu_)
+};
+
+} // namespace fsx::storage
+
+#endif // FSX_HAVE_IO_URING
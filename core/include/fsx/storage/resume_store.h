@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fsx::storage {
+
+// Persistent received-chunk bitmap for one transfer, mmap'd from
+// <base>/<transfer_id>/chunks.bitmap:
+//   [u32 magic "FSXB"][u32 version][u32 total_chunks][u32 reserved]
+//   [u64 words...]  bit i of the set = bit i % 64 of word i / 64
+// set() is a single atomic OR on an in-memory copy, so recording a stored
+// chunk costs no syscall. Bits reach the mapping only through publish(),
+// which the .part file's WriteHandle calls once an fdatasync covering those
+// chunks has returned: the page cache may write the bitmap back before the
+// data, so a bit published any earlier could outlive its chunk in a power
+// loss. After a crash the bitmap misses the chunks stored since the last
+// sync (they are simply sent again) but never claims one that isn't on disk.
+class ResumeBitmap {
+ public:
+  using Words = std::vector<uint64_t>;
+
+  // Maps the file, creating it (all clear) if it's missing or doesn't match
+  // total_chunks. nullptr on error (logged).
+  static std::shared_ptr<ResumeBitmap> open(const std::string& path, uint32_t total_chunks);
+  ~ResumeBitmap();
+
+  ResumeBitmap(const ResumeBitmap&) = delete;
+  ResumeBitmap& operator=(const ResumeBitmap&) = delete;
+
+  // Thread-safe. set/test/words see the in-memory copy, which starts out
+  // as what the file held.
+  void set(uint32_t i);
+  bool test(uint32_t i) const;
+
+  uint32_t size() const { return total_chunks_; }
+  const uint64_t* words() const { return live_.data(); }
+  size_t word_count() const { return live_.size(); }
+
+  // The bits set so far: take it before syncing the data, publish() it once
+  // the sync returned
+  Words snapshot() const;
+  // ORs words into the mapping and asks the kernel to start writing it back
+  // (MS_ASYNC)
+  void publish(const Words& words);
+
+  const std::string& path() const { return path_; }
+
+ private:
+  ResumeBitmap(std::string path, void* map, size_t map_len, uint32_t total_chunks);
+
+  std::string path_;
+  void* map_;
+  size_t map_len_;
+  uint32_t total_chunks_;
+  uint64_t* words_;  // the mapping's bits (published)
+  Words live_;       // bits set so far
+};
+
+// Hands out ResumeBitmaps living next to the .part files of FileStore
+class ResumeStore {
+ public:
+  explicit ResumeStore(std::string base_storage_path = "./storage/transfers");
+
+  std::shared_ptr<ResumeBitmap> open(uint64_t transfer_id, uint32_t total_chunks);
+  // Deletes the bitmap file (transfer completed or abandoned)
+  void remove(uint64_t transfer_id);
+
+  std::string bitmap_path(uint64_t transfer_id) const;
+
+ private:
+  std::string base_path_;
+};
+
+} // namespace fsx::storage
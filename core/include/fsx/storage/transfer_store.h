@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fsx::storage {
+
+// What survives a restart of one transfer (the received chunks are in the
+// ResumeBitmap next to it)
+struct TransferRecord {
+  uint64_t transfer_id = 0;
+  long long sender_user_id = 0;
+  std::string sender_username;
+  long long receiver_user_id = 0;
+  std::string receiver_username;
+  std::string filename;
+  uint64_t file_size = 0;
+  uint32_t chunk_size = 0;
+  uint32_t features = 0;
+  uint32_t window_bytes = 0;
+  int codec = 0;  // FILE_FEATURE_COMPRESS chunk codec
+  bool relay = false;
+  bool dedup = false;  // file is a block manifest
+  std::string sha256;  // hex digest of the completed file, empty if none
+  int state = 0;  // fsx::transfer::TransferState
+};
+
+// One small text file per transfer, <base>/<transfer_id>/transfer.meta, with
+// "key=value" lines (strings escaped). save() writes a temp file and renames
+// it over the old one, so a crash leaves either the old or the new record.
+// Records only change on offer, accept and completion, never per chunk.
+class TransferStore {
+ public:
+  explicit TransferStore(std::string base_storage_path = "./storage/transfers");
+
+  bool save(const TransferRecord& record);
+  void remove(uint64_t transfer_id);
+
+  // Every readable record under base (unreadable ones are logged and skipped)
+  std::vector<TransferRecord> load_all() const;
+
+ private:
+  std::string meta_path(uint64_t transfer_id) const;
+
+  std::string base_path_;
+};
+
+} // namespace fsx::storage
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "fsx/storage/resume_store.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+namespace fsx::storage {
+
+// When received data is forced to stable storage. A resumable upload
+// (set_resume) is also checkpointed every sync_interval under SyncOnDone:
+// its bitmap only ever records synced chunks.
+enum class Durability {
+  None,        // leave it to the page cache
+  SyncOnDone,  // fdatasync once, before the .part file is renamed
+  Periodic     // fdatasync every sync_interval while writing, and on done
+};
+
+struct WritePolicy {
+  Durability durability = Durability::SyncOnDone;
+  std::chrono::milliseconds sync_interval{1000};  // Periodic, resume checkpoints
+  size_t coalesce_bytes = 0;  // > 0: stage adjacent chunks, flush with one pwritev
+  bool preallocate = true;    // fallocate to file_size when the file is opened
+};
+
+// Parses "none" / "done" / "periodic"; anything else yields SyncOnDone
+Durability parse_durability(const std::string& s);
+
+// Positional writer for one transfer's .part file.
+// Chunk i lands at i * chunk_size, so chunks may arrive in any order. Without
+// coalescing every chunk is a single pwrite straight from the caller's buffer.
+// With coalescing, chunks that extend the current run are copied into reused
+// staging buffers and written together with pwritev once the run breaks,
+// reaches coalesce_bytes or ends the file, or on flush(). A staged chunk is
+// not stored yet: its on_stored callback runs only once the run is written
+// (or fails), so nothing acknowledges data that is still in memory.
+// Thread-safe: a striped transfer's chunks are written from several sender
+// strands. Uncoalesced pwrites run without the lock (chunks never overlap);
+// the staging run and the bookkeeping are under mu_.
+class WriteHandle {
+ public:
+  // nullptr on error (logged). resume keeps what an earlier run of the same
+  // transfer already wrote instead of truncating.
+  static std::shared_ptr<WriteHandle> open(const std::string& path, uint64_t file_size,
+                                           uint32_t chunk_size, const WritePolicy& policy,
+                                           bool resume = false);
+  ~WriteHandle();
+
+  WriteHandle(const WriteHandle&) = delete;
+  WriteHandle& operator=(const WriteHandle&) = delete;
+
+  // Runs exactly once per write_chunk call: true once the chunk's bytes are
+  // in the file, false if it was rejected or its write failed. Called
+  // without the lock held, possibly from a later write_chunk/flush/close on
+  // another thread (the one that wrote the run).
+  using StoredFn = std::function<void(bool stored)>;
+
+  // Returns bytes accepted, or -1 on error (bad index/length or I/O failure).
+  // With coalescing a staged chunk returns len before on_stored has run.
+  int64_t write_chunk(uint32_t chunk_index, const void* data, size_t len, StoredFn on_stored = nullptr);
+
+  // Writes staged chunks; false on I/O failure
+  bool flush();
+  bool has_staged() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return staged_count_ > 0;
+  }
+
+  // Flushes, trims preallocation past the highest byte written, applies the
+  // durability policy (unless sync is false: the caller already synced) and
+  // closes the fd. Idempotent; false on failure.
+  bool close(bool sync = true);
+
+  // For async backends that write the fd themselves (see IoUringEngine):
+  // validate a chunk and get its offset, then record it once written.
+  bool check_chunk(uint32_t chunk_index, size_t len, uint64_t* offset) const;
+  void note_written(uint64_t offset, size_t len);
+  // Cuts preallocation back to the highest byte written
+  bool trim();
+
+  // Publishes the resume bitmap's bits after each sync (the bits set before
+  // it started). Set once, before the first chunk is written.
+  void set_resume(std::shared_ptr<ResumeBitmap> resume) { resume_ = std::move(resume); }
+  // For async backends that sync the fd themselves: snapshot before the
+  // sync, publish once it returned
+  ResumeBitmap::Words resume_snapshot() const;
+  void publish_resume(const ResumeBitmap::Words& bits);
+
+  // Periodic policy or a resume checkpoint: true (and the interval restarts)
+  // once sync_interval has passed since the last sync
+  bool sync_due();
+
+  int fd() const { return fd_; }
+  const std::string& path() const { return path_; }
+  const WritePolicy& policy() const { return policy_; }
+  uint64_t bytes_written() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return bytes_written_;
+  }
+
+ private:
+  WriteHandle(int fd, std::string path, uint64_t file_size, uint32_t chunk_size, WritePolicy policy);
+
+  bool write_at(uint64_t offset, const void* data, size_t len);
+  bool maybe_periodic_sync();
+  bool datasync();
+  using Completions = std::vector<std::pair<StoredFn, bool>>;
+  static void run_completions(Completions& done);
+
+  // Callers hold mu_. flush_locked moves the run's callbacks to done along
+  // with the outcome.
+  bool flush_locked(Completions* done);
+  bool trim_locked();
+  bool sync_due_locked();
+  void note_written_locked(uint64_t offset, size_t len);
+
+  mutable std::mutex mu_;
+
+  int fd_;
+  std::string path_;
+  uint64_t file_size_;
+  uint32_t chunk_size_;
+  WritePolicy policy_;
+
+  uint64_t bytes_written_ = 0;
+  uint64_t high_water_ = 0;  // end offset of the furthest chunk written
+  std::chrono::steady_clock::time_point last_sync_;
+  std::shared_ptr<ResumeBitmap> resume_;
+
+  // Coalescing run: staged_[0..staged_count_) hold consecutive chunks
+  // starting at run_offset_, staged_done_ their on_stored callbacks.
+  // Buffers are kept between runs.
+  std::vector<std::vector<uint8_t>> staged_;
+  std::vector<StoredFn> staged_done_;
+  size_t staged_count_ = 0;
+  size_t staged_bytes_ = 0;
+  uint64_t run_offset_ = 0;
+  std::vector<iovec> iov_;
+};
+
+} // namespace fsx::storage
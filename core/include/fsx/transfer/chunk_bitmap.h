@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fsx::transfer {
+
+// Received-chunk set for one transfer: one bit per chunk plus a Fenwick tree
+// of per-block (512-bit) popcounts, so rank/select stay O(log n) while bits
+// are being set in any order. ~1 bit per chunk + 4 bytes per 512 chunks: a
+// 100 GiB file in 256 KiB chunks costs ~52 KiB.
+// Not thread-safe (TransferSession::mu guards it).
+class ChunkBitmap {
+ public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  explicit ChunkBitmap(uint32_t size = 0);
+
+  uint32_t size() const { return size_; }
+  uint32_t count() const { return count_; }
+  bool all() const { return count_ == size_; }
+
+  bool test(uint32_t i) const {
+    return i < size_ && ((words_[i / 64] >> (i % 64)) & 1);
+  }
+
+  // Returns false if i is out of range or already set
+  bool set(uint32_t i);
+
+  // Set bits in [0, i)
+  uint32_t rank(uint32_t i) const;
+  // Index of the k-th set bit (0-based), npos if k >= count()
+  uint32_t select(uint32_t k) const;
+  // First clear index >= from, size() if there is none
+  uint32_t next_unset(uint32_t from) const;
+  // First set index >= from, size() if there is none
+  uint32_t next_set(uint32_t from) const;
+
+  // Bits [from, from + max_bytes * 8) packed LSB-first, trailing zero bytes
+  // dropped (the SACK field of FILE_CHUNK_ACK)
+  std::vector<uint8_t> range_bytes(uint32_t from, size_t max_bytes) const;
+
+  // Raw words, bit i of the set = bit i % 64 of word i / 64
+  const std::vector<uint64_t>& words() const { return words_; }
+  // Replaces the contents (bits past size() are ignored)
+  void assign_words(const uint64_t* words, size_t n);
+
+ private:
+  static constexpr uint32_t kWordsPerBlock = 8;
+
+  void tree_add(size_t block, int32_t delta);
+  uint32_t tree_prefix(size_t blocks) const;  // set bits in blocks [0, blocks)
+  void rebuild_tree();
+
+  uint32_t size_ = 0;
+  uint32_t count_ = 0;
+  std::vector<uint64_t> words_;
+  std::vector<uint32_t> tree_;  // 1-based Fenwick tree over blocks
+};
+
+} // namespace fsx::transfer
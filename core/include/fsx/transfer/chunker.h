@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fsx::transfer {
+
+enum class ChunkingMode {
+  Fixed,          // every chunk is max_size (the last one may be short)
+  ContentDefined  // FastCDC-style cut points from a Gear rolling hash
+};
+
+struct ChunkerConfig {
+  ChunkingMode mode = ChunkingMode::ContentDefined;
+  uint32_t min_size = 16 * 1024;   // >= 32 (the hash window)
+  uint32_t avg_size = 64 * 1024;   // rounded down to a power of two
+  uint32_t max_size = 256 * 1024;  // also the chunk size in Fixed mode
+};
+
+// Splits a byte stream into chunks.
+//
+// ContentDefined follows FastCDC: a 32-bit Gear hash h = (h << 1) + gear[b]
+// (so h depends only on the last 32 bytes) is tested at every position
+// between min_size and max_size from the chunk start; before avg_size a
+// stricter mask (2 more bits) is used, after it a looser one (2 fewer), which
+// keeps chunk sizes close to avg_size. Because the hash only sees a fixed
+// window, an insertion or deletion shifts at most the chunks around it and
+// later cut points line up again: that's what makes dedup of near-identical
+// files work.
+//
+// Cut points are part of the on-disk/wire format once chunks are addressed by
+// hash: the gear table, masks and rules here must not change.
+//
+// The boundary scan has an AVX2 version (8 lanes, one slice of the search
+// range each, with vpgatherdd table lookups) picked at runtime, and a scalar
+// fallback; both return the same cut points.
+//
+// Not thread-safe (keeps scratch space); use one per stream.
+class Chunker {
+ public:
+  explicit Chunker(ChunkerConfig cfg = ChunkerConfig{});
+
+  const ChunkerConfig& config() const { return cfg_; }
+
+  // Length of the chunk starting at data[0], given n available bytes. last:
+  // nothing follows data[n). Returns 0 when more data is needed to decide
+  // (only if !last and n < max_size).
+  size_t next(const uint8_t* data, size_t n, bool last);
+
+  // Appends the lengths of every chunk in data[0, n) to lengths and returns
+  // the bytes they cover. Unless last, a trailing partial chunk is left for
+  // the next call (pass it again at the start of the next buffer).
+  size_t split(const uint8_t* data, size_t n, bool last, std::vector<uint32_t>* lengths);
+
+  // Whether the AVX2 scan is in use (built for x86-64 and the CPU has it);
+  // set_simd(false) forces the scalar path, e.g. to compare them
+  bool simd() const { return simd_; }
+  void set_simd(bool on);
+  static bool cpu_has_avx2();
+
+ private:
+  size_t next_cdc(const uint8_t* data, size_t n, bool last);
+
+  ChunkerConfig cfg_;
+  uint32_t mask_s_;  // before avg_size
+  uint32_t mask_l_;  // from avg_size on (a subset of mask_s_'s bits)
+  bool simd_;
+  std::vector<uint32_t> lane_hits_[8];
+};
+
+} // namespace fsx::transfer
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "fsx/crypto/sha256.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace fsx::transfer {
+
+// CRC-32C (Castagnoli, the iSCSI/ext4 polynomial) of data[0, len), continuing
+// from crc (0 for a fresh checksum). Uses the SSE4.2 crc32 instruction on
+// x86-64 and the ARMv8 CRC extension on aarch64 when the CPU has them,
+// slicing-by-8 tables otherwise; all give the same result.
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+// Table version, always available (benchmarks compare against it)
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t crc = 0);
+// "sse4.2", "armv8-crc" or "table"
+const char* crc32c_impl();
+
+// Whole-file SHA-256 computed while a transfer is received, so the result
+// needs no second pass over the file. Chunks may be stored in any order but
+// SHA-256 only takes bytes in order: a chunk that is next in file order is
+// hashed straight from the receive buffer, one that arrives early is copied
+// aside (up to max_pending_bytes) until the gap before it is filled. Whatever
+// couldn't be hashed that way is read back from the finished file by
+// finish(). Thread-safe: chunks of a striped transfer come from several
+// strands.
+class FileDigest {
+ public:
+  explicit FileDigest(size_t max_pending_bytes = 8 * 1024 * 1024);
+
+  // Bytes [offset, offset + len) of the file were stored. Duplicates are
+  // ignored.
+  void add(uint64_t offset, const void* data, size_t len);
+
+  // Length of the prefix hashed so far
+  uint64_t hashed() const;
+
+  // Hashes [hashed(), file_size) from fd (the complete file) and returns the
+  // digest. Pass fd = -1 when there is no file to read (a relay without tee):
+  // then it fails unless everything was hashed already. false on read error.
+  bool finish(int fd, uint64_t file_size, fsx::crypto::Sha256Digest* out,
+              uint64_t* reread_bytes = nullptr);
+
+ private:
+  void drain_locked();
+
+  mutable std::mutex mu_;
+  fsx::crypto::Sha256 sha_;
+  uint64_t next_ = 0;  // end of the hashed prefix
+  std::map<uint64_t, std::vector<uint8_t>> pending_;
+  size_t pending_bytes_ = 0;
+  size_t max_pending_;
+  bool overflowed_ = false;  // a chunk was not kept: stop buffering
+};
+
+} // namespace fsx::transfer
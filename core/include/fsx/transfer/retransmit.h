@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace fsx::transfer {
+
+// Hashed timing wheel (Varghese & Lauck): one process-wide set of timers
+// advanced by a single periodic tick, instead of an asio timer per transfer.
+// A timer due d ticks after the last processed tick goes into slot
+// (cursor + d) % slots with d / slots full turns still to wait, so schedule
+// and cancel are O(1) and a tick only looks at one slot. Resolution is one
+// tick; timers fire late by up to a tick, never early.
+//
+// Thread-safe. Callbacks run on the thread calling advance(), outside the
+// lock, so they may schedule or cancel timers.
+class TimingWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+  using TimerId = uint64_t;  // never 0
+
+  explicit TimingWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(50),
+                       size_t slots = 512);
+
+  TimerId schedule(std::chrono::milliseconds delay, Callback cb);
+  // false if the timer already fired or was cancelled
+  bool cancel(TimerId id);
+
+  // Runs every timer that became due up to now; returns how many fired
+  size_t advance(Clock::time_point now = Clock::now());
+
+  std::chrono::milliseconds tick() const { return tick_; }
+  size_t pending() const;
+
+ private:
+  struct Entry {
+    TimerId id;
+    uint64_t rounds;  // full turns of the wheel left
+    Callback cb;
+  };
+  struct Location {
+    size_t slot;
+    std::list<Entry>::iterator it;
+  };
+
+  std::chrono::milliseconds tick_;
+  mutable std::mutex mu_;
+  std::vector<std::list<Entry>> slots_;
+  std::unordered_map<TimerId, Location> index_;
+  size_t cursor_ = 0;            // slot of the last processed tick
+  Clock::time_point cursor_time_;
+  TimerId next_id_ = 1;
+};
+
+// Selective retransmission policy, shared by every transfer: how long a hole
+// in the received chunks may stay open before the sender is asked for it
+// again with FILE_NACK (doubling on each round that brings nothing), and how
+// often one chunk may be asked for before the transfer is given up.
+struct RetransmitPolicy {
+  std::chrono::milliseconds timeout{1000};
+  uint32_t max_backoff_shift = 4;  // timeout << 4 at most
+  uint32_t max_attempts = 8;       // NACKs per chunk
+};
+
+} // namespace fsx::transfer
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace fsx::transfer {
+
+// Byte-rate limiter in GCRA form (the "virtual scheduling" token bucket): the
+// whole state is one atomic theoretical arrival time, tat, advanced by
+// bytes / rate on every charge, so a charge is a single CAS loop with no
+// lock. Traffic conforms while tat stays within `burst` bytes' worth of time
+// ahead of now; past that consume() returns how long the caller should stop
+// reading. Bytes are charged even when they have to wait: the caller already
+// has them, and the debt delays whatever comes next.
+class TokenBucket {
+ public:
+  TokenBucket() = default;  // unlimited
+  TokenBucket(uint64_t rate_bytes_per_sec, uint64_t burst_bytes) { reset(rate_bytes_per_sec, burst_bytes); }
+
+  // Not safe against concurrent consume(): configure before sharing.
+  // rate 0 = unlimited
+  void reset(uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+  bool limited() const { return rate_ != 0; }
+  uint64_t rate() const { return rate_; }
+
+  // Charges bytes at now_ns (steady clock); returns the pause before more
+  // may be read, zero while within the burst
+  std::chrono::nanoseconds consume(uint64_t bytes, int64_t now_ns);
+
+ private:
+  uint64_t rate_ = 0;
+  int64_t tolerance_ns_ = 0;  // burst_bytes at rate_
+  std::atomic<int64_t> tat_{0};
+};
+
+// Configured limits in bytes/s; 0 = unlimited
+struct RateLimits {
+  uint64_t global_bps = 0;    // all uploads on this server
+  uint64_t user_bps = 0;      // one user, over all their connections
+  uint64_t transfer_bps = 0;  // one transfer, over all its stripes
+  uint64_t burst_bytes = 1024 * 1024;
+};
+
+// Hierarchical shaper for received file data: every chunk is charged to the
+// global bucket, its user's bucket and its transfer's bucket, and reading
+// pauses for the longest of the three waits. The buckets are found once
+// (user's at login, transfer's when it is created) and charged lock-free.
+class Throttler {
+ public:
+  explicit Throttler(const RateLimits& limits);
+
+  const RateLimits& limits() const { return limits_; }
+  bool enabled() const {
+    return limits_.global_bps != 0 || limits_.user_bps != 0 || limits_.transfer_bps != 0;
+  }
+
+  TokenBucket& global() { return global_; }
+  // Shared by all connections of the user; null when users are unlimited.
+  // Takes a lock: look it up once per connection, not per chunk
+  std::shared_ptr<TokenBucket> user_bucket(long long user_id);
+  // Configures a transfer's own bucket
+  void init_transfer_bucket(TokenBucket& bucket) const {
+    bucket.reset(limits_.transfer_bps, limits_.burst_bytes);
+  }
+
+  // Charges bytes to global and to user/transfer when given; the longest wait
+  std::chrono::nanoseconds consume(TokenBucket* user, TokenBucket* transfer, uint64_t bytes);
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+ private:
+  RateLimits limits_;
+  TokenBucket global_;
+  std::mutex users_mu_;
+  std::unordered_map<long long, std::weak_ptr<TokenBucket>> users_;
+};
+
+} // namespace fsx::transfer
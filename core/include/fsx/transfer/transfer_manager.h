@@ -1,6 +1,12 @@
 #pragma once
 
+#include "fsx/storage/block_store.h"
+#include "fsx/transfer/chunk_bitmap.h"
+#include "fsx/transfer/integrity.h"
+#include "fsx/transfer/retransmit.h"
+#include "fsx/transfer/throttler.h"
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <memory>
 #include <unordered_map>
@@ -8,6 +14,14 @@
 #include <atomic>
 #include <vector>
 
+namespace fsx::storage {
+class WriteHandle;
+class FileStore;
+class ResumeBitmap;
+class ResumeStore;
+class TransferStore;
+}
+
 namespace fsx::transfer {
 
 enum class TransferState {
@@ -25,17 +39,70 @@ struct TransferSession {
   std::string sender_token;  // Token to find sender session
   long long receiver_user_id = 0;
   std::string receiver_username;
+  std::string receiver_token;  // Token of the session that accepted
+  // Receiver asked for chunks to be forwarded live (FILE_ACCEPT_RELAY)
+  bool relay = false;
   std::string filename;
   uint64_t file_size = 0;
   uint32_t chunk_size = 0;
-  uint32_t expected_chunk_index = 0;  // Next expected chunk (0-based)
+  uint32_t total_chunks = 0;          // ceil(file_size / chunk_size)
+
+  // Reassembly state. Chunks may arrive in any order and over several of the
+  // sender's connections at once (striping), so it's guarded by mu.
+  mutable std::mutex mu;
+  ChunkBitmap received;
+  uint32_t expected_chunk_index = 0;  // Lowest chunk not yet stored
+  uint32_t received_end = 0;          // One past the highest chunk stored
   uint64_t bytes_received = 0;
-  TransferState state = TransferState::OFFERED;
+  // FILE_DONE that arrived while stripes still had chunks in flight; runs
+  // once the last chunk is stored
+  std::function<void()> on_complete;
+
+  // Flow control (FILE_FEATURE_ACK), fixed at offer time.
+  // bytes_pending: chunk bytes read off the socket but not yet stored; the
+  // window advertised in each FILE_CHUNK_ACK shrinks by that much
+  uint32_t features = 0;
+  uint32_t window_bytes = 0;
+  uint8_t codec = 0;  // FILE_FEATURE_COMPRESS: fsx::compress::Codec granted
+  std::atomic<uint64_t> bytes_pending{0};
+  // Written by the receiver's session (accept) and read by the sender's
+  // session (chunks), which may run on different io threads. file_handle is
+  // published before state moves to ACCEPTED, so reading state first is enough
+  // (same for receiver_token and relay).
+  std::atomic<TransferState> state{TransferState::OFFERED};
   std::string temp_file_path;  // .part file path
   std::string final_file_path; // Final file path after completion
   
-  // File handle (will be managed by FileStore)
-  void* file_handle = nullptr;  // FILE* cast to void* for portability
+  // Positional writer for the .part file (opened by FileStore on accept)
+  std::shared_ptr<fsx::storage::WriteHandle> file_handle;
+  // On-disk copy of `received` (set_stores), as of the last sync of the
+  // .part file; kept until the transfer ends
+  std::shared_ptr<fsx::storage::ResumeBitmap> resume;
+
+  // FILE_FEATURE_DEDUP: chunk i is blocks[i] in the BlockStore instead of a
+  // range of a .part file (file_handle stays null). Every chunk marked in
+  // `received` holds one reference; FILE_DONE writes the manifest
+  // (final_file_path) that keeps them.
+  bool dedup = false;
+  std::vector<fsx::storage::BlockRef> blocks;
+
+  // FILE_FEATURE_INTEGRITY: the file's SHA-256, fed as chunks are stored and
+  // finished on FILE_DONE (digest is dropped then, sha256 kept)
+  std::shared_ptr<FileDigest> digest;
+  bool has_sha256 = false;
+  fsx::crypto::Sha256Digest sha256{};
+
+  // Selective retransmission (FILE_FEATURE_NACK), under mu: the wheel timer
+  // watching for holes and its backoff round, NACKs sent per chunk, and the
+  // connection that last delivered a chunk (NACKs go there: with striping
+  // the offering connection may be gone)
+  TimingWheel::TimerId nack_timer = 0;
+  uint32_t nack_round = 0;
+  std::unordered_map<uint32_t, uint32_t> nack_attempts;
+  std::string chunk_token;
+
+  // This transfer's rate limit (FSX_RATE_TRANSFER_KBPS), shared by its stripes
+  TokenBucket throttle;
 };
 
 class TransferManager {
@@ -62,11 +129,48 @@ public:
   // Get transfer session (returns nullptr if not found)
   std::shared_ptr<TransferSession> get_transfer(uint64_t transfer_id);
 
-  // Update transfer state
+  // Update transfer state (persisted when stores are set)
   bool update_state(uint64_t transfer_id, TransferState new_state);
 
-  // Mark chunk as received (increment expected_chunk_index)
-  bool mark_chunk_received(uint64_t transfer_id, uint32_t chunk_index, size_t chunk_bytes);
+  // Persistence, off unless set. Transfers are recorded in TransferStore on
+  // offer and on every update_state; stored chunks go to a ResumeBitmap from
+  // accept until the transfer ends. Both must outlive the manager.
+  void set_stores(fsx::storage::TransferStore* transfers, fsx::storage::ResumeStore* resume) {
+    transfer_store_ = transfers;
+    resume_store_ = resume;
+  }
+  // Opens the session's ResumeBitmap and hands it to file_handle, which
+  // publishes it after each sync; call on accept, once file_handle is set
+  // and before update_state moves it to ACCEPTED. False if persistence is off or the open failed
+  // (the transfer works, it just can't be resumed after a restart).
+  bool attach_resume(TransferSession& session);
+  // Startup: reloads ACCEPTED/RECEIVING transfers with their received chunks
+  // and reopened .part files (senders pick them up with FILE_RESUME_REQ), and
+  // COMPLETED ones so they can still be fetched. New transfer ids continue
+  // after the highest recorded one. Returns the number of transfers restored.
+  size_t restore(fsx::storage::FileStore& files);
+
+  // Content-addressed storage for FILE_FEATURE_DEDUP offers; null: feature off
+  void set_block_store(fsx::storage::BlockStore* blocks) { block_store_ = blocks; }
+  fsx::storage::BlockStore* block_store() const { return block_store_; }
+  // Turns a just-created transfer into a dedup one made of blocks. Blocks
+  // already stored are referenced and marked received at once; the result
+  // has bit i (LSB-first) set for each of them, for FILE_OFFER_RESP.
+  std::vector<uint8_t> setup_dedup(TransferSession& session, std::vector<fsx::storage::BlockRef> blocks);
+
+  // Records a stored chunk; false if it's out of range or a duplicate. When
+  // this was the last missing chunk and FILE_DONE is already waiting, its
+  // callback is handed back through on_complete (run it outside any lock).
+  bool mark_chunk_received(uint64_t transfer_id, uint32_t chunk_index, size_t chunk_bytes,
+                           std::function<void()>* on_complete = nullptr);
+
+  // FILE_DONE: true if every chunk is stored (finalize now); otherwise keeps
+  // on_complete to be returned by the mark_chunk_received that completes it
+  bool complete_or_defer(TransferSession& session, std::function<void()> on_complete);
+
+  // cumulative ack + SACK bits after it, for FILE_CHUNK_ACK
+  void ack_state(const TransferSession& session, uint32_t* cumulative,
+                 std::vector<uint8_t>* sack, size_t max_sack_bytes) const;
 
   // Remove transfer (cleanup)
   bool remove_transfer(uint64_t transfer_id);
@@ -74,7 +178,57 @@ public:
   // Get all active transfers (for monitoring)
   std::vector<std::shared_ptr<TransferSession>> get_all_transfers();
 
+  // Relayed transfers are also written to disk (FSX_RELAY_TEE); when off,
+  // a relayed transfer exists only on the receiver and fails if it drops
+  void set_relay_tee(bool tee) { relay_tee_ = tee; }
+  bool relay_tee() const { return relay_tee_; }
+
+  // Chunk codecs FILE_FEATURE_COMPRESS may grant (fsx::compress::codec_bit
+  // mask, FSX_COMPRESS); 0 turns compression off
+  void set_codecs(uint8_t codecs) { codecs_ = codecs; }
+  uint8_t codecs() const { return codecs_; }
+
+  // Selective retransmission for FILE_FEATURE_NACK senders; off (null
+  // wheel) unless set. The wheel must outlive the manager.
+  void set_retransmit(TimingWheel* wheel, RetransmitPolicy policy) {
+    wheel_ = wheel;
+    retransmit_policy_ = policy;
+  }
+  TimingWheel* timing_wheel() const { return wheel_; }
+  // Upload rate limits; off unless set. Must outlive the manager.
+  void set_throttler(Throttler* throttler) { throttler_ = throttler; }
+  Throttler* throttler() const { return throttler_; }
+  const RetransmitPolicy& retransmit_policy() const { return retransmit_policy_; }
+  // Chunks the sender should have delivered by now: the holes below the
+  // highest stored chunk, and everything still missing once FILE_DONE is
+  // waiting. Ascending, at most max_ranges.
+  std::vector<std::pair<uint32_t, uint32_t>> missing_ranges(const TransferSession& session,
+                                                            size_t max_ranges) const;
+  // Counts one more NACK for chunks [first, first + count); false once any of
+  // them has been asked for more than max_attempts times (give up)
+  bool count_nack(TransferSession& session, uint32_t first, uint32_t count);
+
+  // Send window granted to FILE_FEATURE_ACK senders (FSX_TRANSFER_WINDOW_KB)
+  void set_window_bytes(uint32_t bytes) { window_bytes_ = bytes; }
+  uint32_t window_bytes() const { return window_bytes_; }
+  // Out-of-order bytes a transfer's FileDigest may hold back before it leaves
+  // the rest to finish() (FSX_DIGEST_BUFFER_KB)
+  void set_digest_buffer_bytes(size_t bytes) { digest_buffer_bytes_ = bytes; }
+  size_t digest_buffer_bytes() const { return digest_buffer_bytes_; }
+
 private:
+  void persist(const TransferSession& session);
+
+  fsx::storage::TransferStore* transfer_store_ = nullptr;
+  fsx::storage::ResumeStore* resume_store_ = nullptr;
+  fsx::storage::BlockStore* block_store_ = nullptr;
+  TimingWheel* wheel_ = nullptr;
+  Throttler* throttler_ = nullptr;
+  RetransmitPolicy retransmit_policy_;
+  bool relay_tee_ = true;
+  uint8_t codecs_ = 0;
+  uint32_t window_bytes_ = 8 * 1024 * 1024;
+  size_t digest_buffer_bytes_ = 8 * 1024 * 1024;
   std::atomic<uint64_t> next_transfer_id_{1};
   std::unordered_map<uint64_t, std::shared_ptr<TransferSession>> transfers_;
   std::mutex mutex_;
@@ -0,0 +1,75 @@
+#include "fsx/admin/metrics.h"
+#include <sstream>
+
+namespace fsx::admin {
+
+void LatencyHistogram::record_us(uint64_t us) {
+  size_t bucket = us == 0 ? 0 : static_cast<size_t>(64 - __builtin_clzll(us));
+  if (bucket >= kBuckets) bucket = kBuckets - 1;
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t prev = max_.load(std::memory_order_relaxed);
+  while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::percentile_us(double p) const {
+  uint64_t total = count();
+  if (total == 0) return 0;
+  uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+  if (rank >= total) rank = total - 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen > rank) return i == 0 ? 0 : (1ULL << i);
+  }
+  return max_us();
+}
+
+std::string LatencyHistogram::summary() const {
+  std::ostringstream ss;
+  ss << "n=" << count()
+     << " p50=" << percentile_us(0.50) << "us"
+     << " p99=" << percentile_us(0.99) << "us"
+     << " max=" << max_us() << "us";
+  return ss.str();
+}
+
+Metrics& Metrics::instance() {
+  static Metrics inst;
+  return inst;
+}
+
+std::atomic<uint64_t>& Metrics::counter(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto& slot = counters_[name];
+  if (!slot) slot = std::make_unique<std::atomic<uint64_t>>(0);
+  return *slot;
+}
+
+LatencyHistogram& Metrics::histogram(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto& slot = histograms_[name];
+  if (!slot) slot = std::make_unique<LatencyHistogram>();
+  return *slot;
+}
+
+std::string Metrics::dump() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  std::ostringstream ss;
+  bool first = true;
+  for (const auto& [name, value] : counters_) {
+    ss << (first ? "" : " ") << name << "=" << value->load(std::memory_order_relaxed);
+    first = false;
+  }
+  for (const auto& [name, hist] : histograms_) {
+    if (hist->count() == 0) continue;
+    ss << (first ? "" : " ") << name << "{" << hist->summary() << "}";
+    first = false;
+  }
+  return ss.str();
+}
+
+} // namespace fsx::admin
@@ -0,0 +1,110 @@
+#include "fsx/auth/auth_service.h"
+#include "fsx/admin/metrics.h"
+
+namespace fsx::auth {
+
+namespace {
+
+struct AuthMetrics {
+  fsx::admin::LatencyHistogram& queue_wait;
+  fsx::admin::LatencyHistogram& exec;
+  fsx::admin::LatencyHistogram& total;
+  std::atomic<uint64_t>& rejected_busy;
+};
+
+AuthMetrics& metrics() {
+  auto& m = fsx::admin::Metrics::instance();
+  static AuthMetrics am{
+    m.histogram("auth.queue_wait"),
+    m.histogram("auth.exec"),
+    m.histogram("auth.total"),
+    m.counter("auth.rejected_busy"),
+  };
+  return am;
+}
+
+} // namespace
+
+AuthService::AuthService(fsx::net::AuthHandler& handler, size_t threads, size_t max_queue)
+  : handler_(handler), max_queue_(max_queue) {
+  if (threads == 0) threads = 1;
+  workers_.reserve(threads);
+  for (size_t i = 0; i < threads; i++) {
+    workers_.emplace_back([this]() { worker_loop(); });
+  }
+}
+
+AuthService::~AuthService() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : workers_) t.join();
+}
+
+size_t AuthService::queue_depth() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return queue_.size();
+}
+
+bool AuthService::enqueue(std::function<void()> run) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (stopping_ || queue_.size() >= max_queue_) {
+      metrics().rejected_busy.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    queue_.push_back(Job{Clock::now(), std::move(run)});
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void AuthService::worker_loop() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (stopping_ && queue_.empty()) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    auto started = Clock::now();
+    metrics().queue_wait.record(started - job.submitted);
+    job.run();
+    auto finished = Clock::now();
+    metrics().exec.record(finished - started);
+    metrics().total.record(finished - job.submitted);
+  }
+}
+
+bool AuthService::submit_register(fsx::protocol::RegisterReq req, RegisterCallback cb) {
+  return enqueue([this, req = std::move(req), cb = std::move(cb)]() {
+    fsx::protocol::RegisterResp resp;
+    try {
+      resp = handler_.handle_register(req);
+    } catch (const std::exception& e) {
+      resp.ok = false;
+      resp.msg = std::string("error: ") + e.what();
+    }
+    cb(std::move(resp));
+  });
+}
+
+bool AuthService::submit_login(fsx::protocol::LoginReq req, LoginCallback cb) {
+  return enqueue([this, req = std::move(req), cb = std::move(cb)]() {
+    fsx::protocol::LoginResp resp;
+    try {
+      resp = handler_.handle_login(req);
+    } catch (const std::exception& e) {
+      resp.ok = false;
+      resp.msg = std::string("error: ") + e.what();
+    }
+    cb(std::move(resp));
+  });
+}
+
+} // namespace fsx::auth
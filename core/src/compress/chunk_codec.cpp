@@ -0,0 +1,122 @@
+#include "fsx/compress/chunk_codec.h"
+#include <algorithm>
+#include <zlib.h>
+
+#ifdef FSX_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef FSX_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace fsx::compress {
+
+uint8_t supported_codecs() {
+  uint8_t mask = codec_bit(Codec::NONE) | codec_bit(Codec::ZLIB);
+#ifdef FSX_HAVE_LZ4
+  mask |= codec_bit(Codec::LZ4);
+#endif
+#ifdef FSX_HAVE_ZSTD
+  mask |= codec_bit(Codec::ZSTD);
+#endif
+  return mask;
+}
+
+Codec pick_codec(uint8_t offered) {
+  uint8_t both = offered & supported_codecs();
+  for (Codec c : {Codec::ZSTD, Codec::LZ4, Codec::ZLIB}) {
+    if (both & codec_bit(c)) return c;
+  }
+  return Codec::NONE;
+}
+
+const char* codec_name(Codec c) {
+  switch (c) {
+    case Codec::NONE: return "none";
+    case Codec::ZLIB: return "zlib";
+    case Codec::LZ4: return "lz4";
+    case Codec::ZSTD: return "zstd";
+  }
+  return "unknown";
+}
+
+bool compress(Codec c, const void* src, size_t len, std::vector<uint8_t>* dst, int level) {
+  size_t out = 0;
+  switch (c) {
+    case Codec::ZLIB: {
+      uLongf n = compressBound(static_cast<uLong>(len));
+      dst->resize(n);
+      if (compress2(dst->data(), &n, static_cast<const Bytef*>(src), static_cast<uLong>(len),
+                    std::clamp(level, 1, 9)) != Z_OK) {
+        return false;
+      }
+      out = n;
+      break;
+    }
+#ifdef FSX_HAVE_LZ4
+    case Codec::LZ4: {
+      dst->resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(len))));
+      int n = LZ4_compress_fast(static_cast<const char*>(src), reinterpret_cast<char*>(dst->data()),
+                                static_cast<int>(len), static_cast<int>(dst->size()), 1);
+      if (n <= 0) return false;
+      out = static_cast<size_t>(n);
+      break;
+    }
+#endif
+#ifdef FSX_HAVE_ZSTD
+    case Codec::ZSTD: {
+      thread_local ZSTD_CCtx* cctx = ZSTD_createCCtx();
+      dst->resize(ZSTD_compressBound(len));
+      size_t n = ZSTD_compressCCtx(cctx, dst->data(), dst->size(), src, len, level);
+      if (ZSTD_isError(n)) return false;
+      out = n;
+      break;
+    }
+#endif
+    default:
+      return false;
+  }
+  if (out >= len) return false;
+  dst->resize(out);
+  return true;
+}
+
+bool decompress(Codec c, const void* src, size_t len, void* dst, size_t raw_len) {
+  switch (c) {
+    case Codec::NONE:
+      if (len != raw_len) return false;
+      std::copy_n(static_cast<const uint8_t*>(src), len, static_cast<uint8_t*>(dst));
+      return true;
+    case Codec::ZLIB: {
+      uLongf n = static_cast<uLongf>(raw_len);
+      return uncompress(static_cast<Bytef*>(dst), &n, static_cast<const Bytef*>(src),
+                        static_cast<uLong>(len)) == Z_OK && n == raw_len;
+    }
+#ifdef FSX_HAVE_LZ4
+    case Codec::LZ4: {
+      int n = LZ4_decompress_safe(static_cast<const char*>(src), static_cast<char*>(dst),
+                                  static_cast<int>(len), static_cast<int>(raw_len));
+      return n >= 0 && static_cast<size_t>(n) == raw_len;
+    }
+#endif
+#ifdef FSX_HAVE_ZSTD
+    case Codec::ZSTD: {
+      thread_local ZSTD_DCtx* dctx = ZSTD_createDCtx();
+      size_t n = ZSTD_decompressDCtx(dctx, dst, raw_len, src, len);
+      return !ZSTD_isError(n) && n == raw_len;
+    }
+#endif
+    default:
+      return false;
+  }
+}
+
+bool worth_compressing(Codec c, const void* data, size_t len, size_t sample_bytes, double max_ratio) {
+  if (c == Codec::NONE || len == 0) return false;
+  size_t n = std::min(len, sample_bytes);
+  thread_local std::vector<uint8_t> scratch;
+  if (!compress(c, data, n, &scratch)) return false;
+  return static_cast<double>(scratch.size()) <= max_ratio * static_cast<double>(n);
+}
+
+} // namespace fsx::compress
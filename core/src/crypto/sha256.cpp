@@ -0,0 +1,69 @@
+#include "fsx/crypto/sha256.h"
+#include <openssl/evp.h>
+#include <stdexcept>
+
+namespace fsx::crypto {
+
+Sha256::Sha256() : ctx_(EVP_MD_CTX_new()) {
+  if (!ctx_) throw std::runtime_error("Sha256: EVP_MD_CTX_new failed");
+  reset();
+}
+
+Sha256::~Sha256() {
+  EVP_MD_CTX_free(ctx_);
+}
+
+void Sha256::reset() {
+  if (EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr) != 1) {
+    throw std::runtime_error("Sha256: EVP_DigestInit_ex failed");
+  }
+}
+
+void Sha256::update(const void* data, size_t len) {
+  if (len > 0) EVP_DigestUpdate(ctx_, data, len);
+}
+
+Sha256Digest Sha256::final() {
+  Sha256Digest out{};
+  unsigned int n = 0;
+  EVP_DigestFinal_ex(ctx_, out.data(), &n);
+  return out;
+}
+
+Sha256Digest sha256(const void* data, size_t len) {
+  Sha256Digest out{};
+  unsigned int n = 0;
+  if (EVP_Digest(data, len, out.data(), &n, EVP_sha256(), nullptr) != 1) {
+    throw std::runtime_error("sha256: EVP_Digest failed");
+  }
+  return out;
+}
+
+std::string to_hex(const Sha256Digest& digest) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string out(64, '0');
+  for (size_t i = 0; i < digest.size(); i++) {
+    out[2 * i] = kHex[digest[i] >> 4];
+    out[2 * i + 1] = kHex[digest[i] & 0xf];
+  }
+  return out;
+}
+
+bool from_hex(const std::string& hex, Sha256Digest* digest) {
+  if (hex.size() != 64) return false;
+  auto nibble = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  for (size_t i = 0; i < 32; i++) {
+    int hi = nibble(hex[2 * i]);
+    int lo = nibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    (*digest)[i] = static_cast<uint8_t>(hi << 4 | lo);
+  }
+  return true;
+}
+
+} // namespace fsx::crypto
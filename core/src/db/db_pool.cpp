@@ -0,0 +1,433 @@
+#include "fsx/db/db_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace fsx::db {
+
+std::string make_conninfo(const DbConfig& cfg) {
+  std::ostringstream ss;
+  ss << "host=" << cfg.host
+     << " port=" << cfg.port
+     << " dbname=" << cfg.name
+     << " user=" << cfg.user
+     << " password=" << cfg.password
+     << " connect_timeout=10";
+  return ss.str();
+}
+
+void must_ok(PGresult* r, const std::string& ctx) {
+  if (!r) throw std::runtime_error(ctx + ": PGresult is null");
+  auto st = PQresultStatus(r);
+  if (st != PGRES_COMMAND_OK && st != PGRES_TUPLES_OK) {
+    std::string err = PQresultErrorMessage(r);
+    PQclear(r);
+    throw std::runtime_error(ctx + ": " + err);
+  }
+}
+
+class DbPool::Connection : public std::enable_shared_from_this<DbPool::Connection> {
+ public:
+  Connection(DbPool& pool, size_t index)
+    : pool_(pool),
+      index_(index),
+      strand_(boost::asio::make_strand(pool.io_)),
+      sock_(strand_),
+      retry_timer_(strand_) {}
+
+  ~Connection() { close(); }
+
+  size_t load() const { return load_.load(std::memory_order_relaxed); }
+  // Connected and not waiting out a reconnect backoff (read off-strand)
+  bool up() const { return ready_.load(std::memory_order_relaxed); }
+
+  void connect_blocking() {
+    pg_ = PQconnectdb(make_conninfo(pool_.cfg_).c_str());
+    if (!pg_ || PQstatus(pg_) != CONNECTION_OK) {
+      std::string err = pg_ ? PQerrorMessage(pg_) : "PQconnectdb failed";
+      close();
+      throw std::runtime_error("DB connect failed: " + err);
+    }
+    for (const auto& st : pool_.statements_) {
+      PGresult* r = PQprepare(pg_, st.name.c_str(), st.sql.c_str(),
+                              static_cast<int>(st.param_types.size()), st.param_types.data());
+      must_ok(r, "prepare " + st.name);
+      PQclear(r);
+    }
+    auto self = shared_from_this();
+    boost::asio::post(strand_, [this, self]() { on_connected(false); });
+  }
+
+  void submit(Query q) {
+    load_.fetch_add(1, std::memory_order_relaxed);
+    auto self = shared_from_this();
+    boost::asio::post(strand_, [this, self, q = std::move(q)]() mutable {
+      pending_.push_back(std::move(q));
+      pump();
+    });
+  }
+
+  void close() {
+    boost::system::error_code ignored;
+    retry_timer_.cancel();
+    if (sock_.is_open()) sock_.close(ignored);
+    if (pg_) {
+      PQfinish(pg_);
+      pg_ = nullptr;
+    }
+    ready_ = false;
+    reading_ = false;
+    writing_ = false;
+    generation_++;
+  }
+
+ private:
+  struct InFlight {
+    Query query;
+    PGresult* result = nullptr;
+    bool awaiting_sync = false;
+  };
+
+  void log(const std::string& s) {
+    std::string line = "[DB] pool conn " + std::to_string(index_) + ": " + s + "\n";
+    std::cout << line;
+    std::cout.flush();
+  }
+
+  size_t max_inflight() const { return pipeline_ ? pool_.pipeline_depth_ : 1; }
+
+  // Socket handling: we wait on a dup() of PQsocket so closing our descriptor
+  // never closes libpq's.
+  bool attach_socket() {
+    boost::system::error_code ignored;
+    if (sock_.is_open()) sock_.close(ignored);
+    int fd = PQsocket(pg_);
+    if (fd < 0) return false;
+    int dup_fd = ::dup(fd);
+    if (dup_fd < 0) return false;
+    sock_.assign(dup_fd);
+    return true;
+  }
+
+  // --- connect / reconnect ---
+
+  void on_connected(bool prepare) {
+    if (PQsetnonblocking(pg_, 1) != 0) {
+      handle_broken("PQsetnonblocking failed");
+      return;
+    }
+#ifdef LIBPQ_HAS_PIPELINING
+    pipeline_ = PQenterPipelineMode(pg_) == 1;
+#endif
+    if (!attach_socket()) {
+      handle_broken("no socket");
+      return;
+    }
+    if (prepare) {
+      // Fresh session after a reconnect: statements go ahead of queued
+      // queries. Prepares queued by an earlier attempt that never got sent
+      // would run a second time and fail as duplicates, so they go first.
+      size_t stale = std::erase_if(pending_, [](const Query& q) { return q.kind == Query::Kind::Prepare; });
+      load_.fetch_sub(stale, std::memory_order_relaxed);
+      for (auto it = pool_.statements_.rbegin(); it != pool_.statements_.rend(); ++it) {
+        Query q;
+        q.kind = Query::Kind::Prepare;
+        q.def = &*it;
+        load_.fetch_add(1, std::memory_order_relaxed);
+        pending_.push_front(std::move(q));
+      }
+    }
+    ready_ = true;
+    backoff_ = kInitialBackoff;
+    wait_readable();
+    pump();
+  }
+
+  void schedule_reconnect() {
+    auto self = shared_from_this();
+    retry_timer_.expires_after(backoff_);
+    backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+    retry_timer_.async_wait([this, self](boost::system::error_code ec) {
+      if (ec) return;
+      start_connect();
+    });
+  }
+
+  void start_connect() {
+    pg_ = PQconnectStart(make_conninfo(pool_.cfg_).c_str());
+    if (!pg_ || PQstatus(pg_) == CONNECTION_BAD || !attach_socket()) {
+      log("reconnect failed: " + std::string(pg_ ? PQerrorMessage(pg_) : "PQconnectStart failed"));
+      close();
+      schedule_reconnect();
+      return;
+    }
+    poll_connect(PGRES_POLLING_WRITING);
+  }
+
+  void poll_connect(PostgresPollingStatusType st) {
+    if (st == PGRES_POLLING_OK) {
+      log("reconnected");
+      on_connected(true);
+      return;
+    }
+    if (st == PGRES_POLLING_FAILED) {
+      log("reconnect failed: " + std::string(PQerrorMessage(pg_)));
+      close();
+      schedule_reconnect();
+      return;
+    }
+    auto self = shared_from_this();
+    auto gen = generation_;
+    auto wait = st == PGRES_POLLING_READING ? boost::asio::posix::stream_descriptor::wait_read
+                                            : boost::asio::posix::stream_descriptor::wait_write;
+    sock_.async_wait(wait, [this, self, gen](boost::system::error_code ec) {
+      if (ec || gen != generation_) return;
+      PostgresPollingStatusType next = PQconnectPoll(pg_);
+      // libpq may switch sockets while connecting (e.g. after a failed address)
+      if (next != PGRES_POLLING_FAILED && !attach_socket()) next = PGRES_POLLING_FAILED;
+      poll_connect(next);
+    });
+  }
+
+  void handle_broken(const std::string& why) {
+    log("connection lost: " + why);
+    std::deque<InFlight> failed;
+    failed.swap(inflight_);
+    close();
+    for (auto& f : failed) {
+      if (f.result) PQclear(f.result);
+      complete(f.query, nullptr);
+    }
+    schedule_reconnect();
+  }
+
+  // --- query path ---
+
+  void pump() {
+    if (!ready_) return;
+    bool sent = false;
+    while (!pending_.empty() && inflight_.size() < max_inflight()) {
+      Query& q = pending_.front();
+      int rc = send_query(q);
+#ifdef LIBPQ_HAS_PIPELINING
+      if (rc == 1 && pipeline_) rc = PQpipelineSync(pg_);
+#endif
+      if (rc != 1) {
+        handle_broken(PQerrorMessage(pg_));
+        return;
+      }
+      inflight_.push_back(InFlight{std::move(q)});
+      pending_.pop_front();
+      sent = true;
+    }
+    if (sent) flush();
+  }
+
+  int send_query(Query& q) {
+    switch (q.kind) {
+      case Query::Kind::Prepared:
+        q.bound.bind();
+        return PQsendQueryPrepared(pg_, q.stmt, q.bound.count(), q.bound.values(),
+                                   q.bound.lengths(), q.bound.formats(), 1);
+      case Query::Kind::Prepare:
+        return PQsendPrepare(pg_, q.def->name.c_str(), q.def->sql.c_str(),
+                             static_cast<int>(q.def->param_types.size()), q.def->param_types.data());
+      case Query::Kind::Params:
+        break;
+    }
+    std::vector<const char*> values;
+    values.reserve(q.params.size());
+    for (auto& p : q.params) values.push_back(p.c_str());
+    return PQsendQueryParams(pg_, q.sql.c_str(), static_cast<int>(values.size()),
+                             nullptr, values.data(), nullptr, nullptr, 0);
+  }
+
+  void flush() {
+    if (writing_) return;
+    int rc = PQflush(pg_);
+    if (rc == 0) return;
+    if (rc < 0) {
+      handle_broken(PQerrorMessage(pg_));
+      return;
+    }
+    // Output buffer full: wait until the socket drains
+    writing_ = true;
+    auto self = shared_from_this();
+    auto gen = generation_;
+    sock_.async_wait(boost::asio::posix::stream_descriptor::wait_write,
+      [this, self, gen](boost::system::error_code ec) {
+        if (ec || gen != generation_) return;
+        writing_ = false;
+        flush();
+      });
+  }
+
+  void wait_readable() {
+    if (reading_) return;
+    reading_ = true;
+    auto self = shared_from_this();
+    auto gen = generation_;
+    sock_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+      [this, self, gen](boost::system::error_code ec) {
+        if (ec || gen != generation_) return;
+        reading_ = false;
+        if (PQconsumeInput(pg_) != 1) {
+          handle_broken(PQerrorMessage(pg_));
+          return;
+        }
+        drain_results();
+        if (!ready_) return;
+        wait_readable();
+        pump();
+      });
+  }
+
+  void drain_results() {
+    while (!inflight_.empty() && !PQisBusy(pg_)) {
+      PGresult* r = PQgetResult(pg_);
+      InFlight& f = inflight_.front();
+
+#ifdef LIBPQ_HAS_PIPELINING
+      if (pipeline_ && f.awaiting_sync) {
+        if (!r) break;
+        bool is_sync = PQresultStatus(r) == PGRES_PIPELINE_SYNC;
+        PQclear(r);
+        if (is_sync) finish_front();
+        continue;
+      }
+#endif
+      if (r) {
+        // Single-statement queries produce one result; keep the first
+        if (!f.result) f.result = r;
+        else PQclear(r);
+        continue;
+      }
+
+      // NULL: this query's results are complete
+      if (pipeline_) {
+        f.awaiting_sync = true;
+      } else {
+        finish_front();
+      }
+    }
+  }
+
+  void finish_front() {
+    InFlight f = std::move(inflight_.front());
+    inflight_.pop_front();
+    complete(f.query, f.result);
+  }
+
+  void complete(Query& q, PGresult* r) {
+    load_.fetch_sub(1, std::memory_order_relaxed);
+    if (q.kind == Query::Kind::Prepare && r && PQresultStatus(r) != PGRES_COMMAND_OK) {
+      log("prepare " + q.def->name + " failed: " + PQresultErrorMessage(r));
+    }
+    if (q.cb) {
+      q.cb(r);
+    } else if (r) {
+      PQclear(r);
+    }
+  }
+
+  static constexpr std::chrono::milliseconds kInitialBackoff{250};
+  static constexpr std::chrono::milliseconds kMaxBackoff{10000};
+
+  DbPool& pool_;
+  size_t index_;
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::posix::stream_descriptor sock_;
+  boost::asio::steady_timer retry_timer_;
+
+  PGconn* pg_ = nullptr;
+  std::atomic<bool> ready_{false};
+  bool reading_ = false;
+  bool writing_ = false;
+  bool pipeline_ = false;
+  uint64_t generation_ = 0;  // bumped on close; stale socket waits are ignored
+  std::chrono::milliseconds backoff_{kInitialBackoff};
+
+  std::deque<Query> pending_;
+  std::deque<InFlight> inflight_;
+  std::atomic<size_t> load_{0};
+};
+
+DbPool::DbPool(boost::asio::io_context& io, DbConfig cfg, size_t size, size_t pipeline_depth)
+  : io_(io), cfg_(std::move(cfg)), pipeline_depth_(pipeline_depth ? pipeline_depth : 1) {
+  if (size == 0) size = 1;
+  conns_.reserve(size);
+  for (size_t i = 0; i < size; i++) {
+    conns_.push_back(std::make_shared<Connection>(*this, i));
+  }
+}
+
+DbPool::~DbPool() {
+  for (auto& c : conns_) c->close();
+}
+
+void DbPool::prepare(std::string name, std::string sql, std::vector<Oid> param_types) {
+  statements_.push_back(Statement{std::move(name), std::move(sql), std::move(param_types)});
+}
+
+void DbPool::connect() {
+  for (auto& c : conns_) c->connect_blocking();
+}
+
+DbPool::Connection& DbPool::pick_connection() {
+  // Least-loaded connection that is up; a query queued on one that is
+  // reconnecting would wait out its backoff. Only with every connection
+  // down does it queue on the least-loaded one anyway.
+  Connection* best = nullptr;
+  Connection* fallback = conns_.front().get();
+  for (auto& c : conns_) {
+    if (c->load() < fallback->load()) fallback = c.get();
+    if (c->up() && (!best || c->load() < best->load())) best = c.get();
+  }
+  return best ? *best : *fallback;
+}
+
+void DbPool::submit(Query q) {
+  pick_connection().submit(std::move(q));
+}
+
+void DbPool::async_exec_params(std::string sql, std::vector<std::string> params, Callback cb) {
+  Query q;
+  q.kind = Query::Kind::Params;
+  q.sql = std::move(sql);
+  q.params = std::move(params);
+  q.cb = std::move(cb);
+  submit(std::move(q));
+}
+
+void DbPool::async_exec_prepared(const char* stmt, PgParams params, Callback cb) {
+  Query q;
+  q.kind = Query::Kind::Prepared;
+  q.stmt = stmt;
+  q.bound = std::move(params);
+  q.cb = std::move(cb);
+  submit(std::move(q));
+}
+
+std::future<PGresult*> DbPool::exec_prepared(const char* stmt, PgParams params) {
+  auto promise = std::make_shared<std::promise<PGresult*>>();
+  auto fut = promise->get_future();
+  async_exec_prepared(stmt, std::move(params), [promise](PGresult* r) {
+    promise->set_value(r);
+  });
+  return fut;
+}
+
+std::future<PGresult*> DbPool::exec_params(std::string sql, std::vector<std::string> params) {
+  auto promise = std::make_shared<std::promise<PGresult*>>();
+  auto fut = promise->get_future();
+  async_exec_params(std::move(sql), std::move(params), [promise](PGresult* r) {
+    promise->set_value(r);
+  });
+  return fut;
+}
+
+} // namespace fsx::db
@@ -0,0 +1,80 @@
+#include "fsx/db/session_cache.h"
+#include "fsx/admin/metrics.h"
+
+namespace fsx::db {
+
+static std::atomic<uint64_t>& hit_counter() {
+  static auto& c = fsx::admin::Metrics::instance().counter("session_cache.hit");
+  return c;
+}
+
+static std::atomic<uint64_t>& miss_counter() {
+  static auto& c = fsx::admin::Metrics::instance().counter("session_cache.miss");
+  return c;
+}
+
+void SessionCache::put(const SessionRow& row, SysClock::time_point expires) {
+  std::lock_guard<std::mutex> lock(mu_);
+  tokens_[row.token] = Entry{row, expires};
+}
+
+std::optional<SessionRow> SessionCache::get(const std::string& token) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = tokens_.find(token);
+  if (it == tokens_.end()) {
+    miss_counter().fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  if (SysClock::now() >= it->second.expires) {
+    tokens_.erase(it);
+    miss_counter().fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  hit_counter().fetch_add(1, std::memory_order_relaxed);
+  return it->second.row;
+}
+
+void SessionCache::mark_seen(const std::string& token, SysClock::time_point when) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto& t = seen_[token];
+  if (when > t) t = when;
+}
+
+std::vector<std::pair<std::string, SessionCache::SysClock::time_point>> SessionCache::take_seen() {
+  std::unordered_map<std::string, SysClock::time_point> taken;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    taken.swap(seen_);
+  }
+  return {std::make_move_iterator(taken.begin()), std::make_move_iterator(taken.end())};
+}
+
+void SessionCache::restore_seen(std::vector<std::pair<std::string, SysClock::time_point>> seen) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (auto& [token, when] : seen) {
+    auto& t = seen_[token];
+    if (when > t) t = when;
+  }
+}
+
+size_t SessionCache::sweep_expired() {
+  auto now = SysClock::now();
+  std::lock_guard<std::mutex> lock(mu_);
+  size_t removed = 0;
+  for (auto it = tokens_.begin(); it != tokens_.end();) {
+    if (now >= it->second.expires) {
+      it = tokens_.erase(it);
+      removed++;
+    } else {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+size_t SessionCache::size() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return tokens_.size();
+}
+
+} // namespace fsx::db
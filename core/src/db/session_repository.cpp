@@ -1,5 +1,8 @@
 #include "fsx/db/session_repository.h"
+#include "fsx/admin/metrics.h"
 #include <openssl/rand.h>
+#include <algorithm>
+#include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -7,6 +10,32 @@
 
 namespace fsx::db {
 
+static const char* kSessionCreate = "session_create";
+static const char* kSessionValidate = "session_validate";
+static const char* kSessionTouch = "session_touch";
+
+// Rows per write-behind UPDATE (2 params each, far below libpq's 65535 limit)
+static constexpr size_t kTouchBatchRows = 500;
+
+void SessionRepository::prepare_statements(DbPool& db) {
+  db.prepare(kSessionCreate,
+             "INSERT INTO sessions(user_id, token, expires_at) "
+             "VALUES ($1, $2, now() + $3 * interval '1 second') "
+             "RETURNING id, token, expires_at::text, last_seen_at::text, "
+             "extract(epoch from expires_at)::int8;",
+             {kOidInt8, kOidText, kOidInt4});
+  db.prepare(kSessionValidate,
+             "SELECT id, user_id, token, expires_at::text, last_seen_at::text, "
+             "extract(epoch from expires_at)::int8 "
+             "FROM sessions "
+             "WHERE token = $1 AND expires_at > now() "
+             "LIMIT 1;",
+             {kOidText});
+  db.prepare(kSessionTouch,
+             "UPDATE sessions SET last_seen_at = now() WHERE token = $1;",
+             {kOidText});
+}
+
 static std::string random_hex_token(size_t nbytes) {
   std::vector<unsigned char> buf(nbytes);
   if (RAND_bytes(buf.data(), (int)buf.size()) != 1) {
@@ -22,31 +51,42 @@ std::string SessionRepository::create_session(long long user_id, int ttl_seconds
   std::string token = random_hex_token(32);
 
   // expires_at = now() + interval
-  const std::string sql =
-      "INSERT INTO sessions(user_id, token, expires_at) "
-      "VALUES ($1, $2, now() + ($3 || ' seconds')::interval) "
-      "RETURNING token;";
-  PGresult* r = db_.exec_params(sql, {std::to_string(user_id), token, std::to_string(ttl_seconds)});
-  Db::must_ok(r, "create_session");
+  PgParams p;
+  p.int8(user_id).text(std::move(token)).int4(ttl_seconds);
+  PGresult* r = db_.exec_prepared(kSessionCreate, std::move(p)).get();
+  must_ok(r, "create_session");
 
   if (PQntuples(r) != 1) {
     PQclear(r);
     throw std::runtime_error("create_session: unexpected row count");
   }
 
-  std::string out = PQgetvalue(r, 0, 0);
+  SessionRow s;
+  int64_t expires_epoch;
+  try {
+    s.id = pg_get_int8(r, 0, 0);
+    expires_epoch = pg_get_int8(r, 0, 4);
+  } catch (...) {
+    PQclear(r);
+    throw;
+  }
+  s.user_id = user_id;
+  s.token = pg_get_text(r, 0, 1);
+  s.expires_at = pg_get_text(r, 0, 2);
+  s.last_seen_at = pg_get_text(r, 0, 3);
   PQclear(r);
-  return out;
+
+  cache_.put(s, SessionCache::SysClock::time_point(std::chrono::seconds(expires_epoch)));
+  return s.token;
 }
 
 std::optional<SessionRow> SessionRepository::validate_token(const std::string& token) {
-  const std::string sql =
-      "SELECT id, user_id, token, expires_at::text, last_seen_at::text "
-      "FROM sessions "
-      "WHERE token = $1 AND expires_at > now() "
-      "LIMIT 1;";
-  PGresult* r = db_.exec_params(sql, {token});
-  Db::must_ok(r, "validate_token");
+  if (auto cached = cache_.get(token)) return cached;
+
+  PgParams p;
+  p.text(token);
+  PGresult* r = db_.exec_prepared(kSessionValidate, std::move(p)).get();
+  must_ok(r, "validate_token");
 
   if (PQntuples(r) == 0) {
     PQclear(r);
@@ -54,20 +94,35 @@ std::optional<SessionRow> SessionRepository::validate_token(const std::string& t
   }
 
   SessionRow s;
-  s.id = std::stoll(PQgetvalue(r, 0, 0));
-  s.user_id = std::stoll(PQgetvalue(r, 0, 1));
-  s.token = PQgetvalue(r, 0, 2);
-  s.expires_at = PQgetvalue(r, 0, 3);
-  s.last_seen_at = PQgetvalue(r, 0, 4);
+  int64_t expires_epoch;
+  try {
+    s.id = pg_get_int8(r, 0, 0);
+    s.user_id = pg_get_int8(r, 0, 1);
+    expires_epoch = pg_get_int8(r, 0, 5);
+  } catch (...) {
+    PQclear(r);
+    throw;
+  }
+  s.token = pg_get_text(r, 0, 2);
+  s.expires_at = pg_get_text(r, 0, 3);
+  s.last_seen_at = pg_get_text(r, 0, 4);
   PQclear(r);
+
+  cache_.put(s, SessionCache::SysClock::time_point(std::chrono::seconds(expires_epoch)));
   return s;
 }
 
 void SessionRepository::touch_session(const std::string& token) {
-  const std::string sql =
-      "UPDATE sessions SET last_seen_at = now() WHERE token = $1;";
-  PGresult* r = db_.exec_params(sql, {token});
-  Db::must_ok(r, "touch_session");
+  if (flush_timer_) {
+    cache_.mark_seen(token, SessionCache::SysClock::now());
+    return;
+  }
+
+  // No write-behind running (tools, tests): write through
+  PgParams p;
+  p.text(token);
+  PGresult* r = db_.exec_prepared(kSessionTouch, std::move(p)).get();
+  must_ok(r, "touch_session");
   PQclear(r);
 }
 
@@ -76,8 +131,8 @@ std::vector<SessionRow> SessionRepository::list_valid_sessions() {
       "SELECT id, user_id, token, expires_at::text, last_seen_at::text "
       "FROM sessions WHERE expires_at > now() "
       "ORDER BY last_seen_at DESC;";
-  PGresult* r = db_.exec(sql);
-  Db::must_ok(r, "list_valid_sessions");
+  PGresult* r = db_.exec_params(sql, {}).get();
+  must_ok(r, "list_valid_sessions");
 
   std::vector<SessionRow> out;
   int n = PQntuples(r);
@@ -97,5 +152,66 @@ std::vector<SessionRow> SessionRepository::list_valid_sessions() {
   return out;
 }
 
-} // namespace fsx::db
+void SessionRepository::start_write_behind(boost::asio::io_context& io,
+                                           std::chrono::milliseconds interval) {
+  flush_interval_ = interval.count() > 0 ? interval : std::chrono::milliseconds(1000);
+  flush_timer_ = std::make_unique<boost::asio::steady_timer>(io);
+  arm_flush();
+}
 
+void SessionRepository::arm_flush() {
+  flush_timer_->expires_after(flush_interval_);
+  flush_timer_->async_wait([this](boost::system::error_code ec) {
+    if (ec) return;
+    flush_touches();
+    cache_.sweep_expired();
+    arm_flush();
+  });
+}
+
+void SessionRepository::flush_touches() {
+  auto seen = cache_.take_seen();
+  if (seen.empty()) return;
+
+  auto& flushed = fsx::admin::Metrics::instance().counter("session.touch_flushed");
+  auto& failed = fsx::admin::Metrics::instance().counter("session.touch_flush_failed");
+
+  for (size_t begin = 0; begin < seen.size(); begin += kTouchBatchRows) {
+    size_t end = std::min(seen.size(), begin + kTouchBatchRows);
+
+    // UPDATE ... FROM (VALUES ($1::text, to_timestamp($2::int8 / 1000.0)), ...)
+    std::string sql = "UPDATE sessions AS s SET last_seen_at = v.seen FROM (VALUES ";
+    std::vector<std::string> params;
+    params.reserve((end - begin) * 2);
+    for (size_t i = begin; i < end; i++) {
+      size_t n = params.size();
+      if (i != begin) sql += ", ";
+      sql += "($" + std::to_string(n + 1) + "::text, to_timestamp($" +
+             std::to_string(n + 2) + "::int8 / 1000.0))";
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+          seen[i].second.time_since_epoch()).count();
+      params.push_back(seen[i].first);
+      params.push_back(std::to_string(ms));
+    }
+    sql += ") AS v(token, seen) WHERE s.token = v.token AND s.last_seen_at < v.seen;";
+
+    auto batch = std::make_shared<std::vector<std::pair<std::string, SessionCache::SysClock::time_point>>>(
+        std::make_move_iterator(seen.begin() + begin), std::make_move_iterator(seen.begin() + end));
+    db_.async_exec_params(std::move(sql), std::move(params),
+      [this, batch, &flushed, &failed](PGresult* r) {
+        if (r && PQresultStatus(r) == PGRES_COMMAND_OK) {
+          flushed.fetch_add(batch->size(), std::memory_order_relaxed);
+          PQclear(r);
+          return;
+        }
+        std::string err = r ? PQresultErrorMessage(r) : "connection lost";
+        if (r) PQclear(r);
+        failed.fetch_add(1, std::memory_order_relaxed);
+        std::cout << "[DB] last_seen flush failed (" << batch->size() << " rows, will retry): " << err;
+        if (err.empty() || err.back() != '\n') std::cout << "\n";
+        cache_.restore_seen(std::move(*batch));
+      });
+  }
+}
+
+} // namespace fsx::db
@@ -0,0 +1,86 @@
+#include "fsx/db/user_cache.h"
+#include "fsx/admin/metrics.h"
+
+namespace fsx::db {
+
+UserCache::UserCache(size_t capacity, std::chrono::seconds ttl)
+  : capacity_(capacity),
+    ttl_(ttl),
+    hits_(fsx::admin::Metrics::instance().counter("user_cache.hit")),
+    misses_(fsx::admin::Metrics::instance().counter("user_cache.miss")),
+    evictions_(fsx::admin::Metrics::instance().counter("user_cache.evict")) {}
+
+std::optional<UserRow> UserCache::get_by_username(const std::string& username) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = by_username_.find(username);
+  if (it == by_username_.end()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  return hit(it->second);
+}
+
+std::optional<UserRow> UserCache::get_by_id(long long id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = by_id_.find(id);
+  if (it == by_id_.end()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  return hit(it->second);
+}
+
+std::optional<UserRow> UserCache::hit(List::iterator it) {
+  if (Clock::now() >= it->expires) {
+    erase(it);
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  lru_.splice(lru_.begin(), lru_, it);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return it->row;
+}
+
+void UserCache::put(const UserRow& row) {
+  if (capacity_ == 0) return;
+  std::lock_guard<std::mutex> lock(mu_);
+
+  auto by_name = by_username_.find(row.username);
+  if (by_name != by_username_.end()) erase(by_name->second);
+  auto by_id = by_id_.find(row.id);
+  if (by_id != by_id_.end()) erase(by_id->second);
+
+  lru_.push_front(Entry{row, Clock::now() + ttl_});
+  by_username_[row.username] = lru_.begin();
+  by_id_[row.id] = lru_.begin();
+
+  while (lru_.size() > capacity_) {
+    erase(std::prev(lru_.end()));
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void UserCache::invalidate_username(const std::string& username) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = by_username_.find(username);
+  if (it != by_username_.end()) erase(it->second);
+}
+
+void UserCache::invalidate_id(long long id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = by_id_.find(id);
+  if (it != by_id_.end()) erase(it->second);
+}
+
+size_t UserCache::size() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return lru_.size();
+}
+
+void UserCache::erase(List::iterator it) {
+  by_username_.erase(it->row.username);
+  by_id_.erase(it->row.id);
+  lru_.erase(it);
+}
+
+} // namespace fsx::db
@@ -4,45 +4,107 @@
 
 namespace fsx::db {
 
+static const char* kUserByUsername = "user_by_username";
+static const char* kUserById = "user_by_id";
+static const char* kUserCreate = "user_create";
+
+void UserRepository::prepare_statements(DbPool& db) {
+  db.prepare(kUserByUsername,
+             "SELECT id, username, email, pass_hash FROM users WHERE username = $1 LIMIT 1;",
+             {kOidText});
+  db.prepare(kUserById,
+             "SELECT id, username, email, pass_hash FROM users WHERE id = $1 LIMIT 1;",
+             {kOidInt8});
+  db.prepare(kUserCreate,
+             "INSERT INTO users(username, email, pass_hash) VALUES ($1, $2, $3) RETURNING id;",
+             {kOidText, kOidText, kOidText});
+}
+
+// Consumes r (PQclear) and returns the row, if any. r is in binary format.
+static std::optional<UserRow> take_user_row(PGresult* r) {
+  if (PQntuples(r) == 0) {
+    PQclear(r);
+    return std::nullopt;
+  }
+
+  UserRow u;
+  try {
+    u.id = pg_get_int8(r, 0, 0);
+  } catch (...) {
+    PQclear(r);
+    throw;
+  }
+  u.username = pg_get_text(r, 0, 1);
+  u.email = pg_get_text(r, 0, 2);
+  u.pass_hash = pg_get_text(r, 0, 3);
+  PQclear(r);
+  return u;
+}
+
 long long UserRepository::create_user(const std::string& username,
                                       const std::string& email,
                                       const std::string& pass_hash) {
   // INSERT ... RETURNING id
-  const std::string sql =
-      "INSERT INTO users(username, email, pass_hash) VALUES ($1, $2, $3) RETURNING id;";
-  PGresult* r = db_.exec_params(sql, {username, email, pass_hash});
-  Db::must_ok(r, "create_user");
+  PgParams p;
+  p.text(username).text(email).text(pass_hash);
+  PGresult* r = db_.exec_prepared(kUserCreate, std::move(p)).get();
+  must_ok(r, "create_user");
 
-  if (PQntuples(r) != 1) {
+  if (PQntuples(r) != 1 || PQgetlength(r, 0, 0) != 8) {
     PQclear(r);
-    throw std::runtime_error("create_user: unexpected row count");
+    throw std::runtime_error("create_user: unexpected result");
   }
 
-  char* id_str = PQgetvalue(r, 0, 0);
-  long long id = std::stoll(id_str);
+  long long id = pg_get_int8(r, 0, 0);
   PQclear(r);
+  cache_.put(UserRow{id, username, email, pass_hash});
   return id;
 }
 
 std::optional<UserRow> UserRepository::get_user_by_username(const std::string& username) {
-  const std::string sql =
-      "SELECT id, username, email, pass_hash FROM users WHERE username = $1 LIMIT 1;";
-  PGresult* r = db_.exec_params(sql, {username});
-  Db::must_ok(r, "get_user_by_username");
+  if (auto cached = cache_.get_by_username(username)) return cached;
 
-  if (PQntuples(r) == 0) {
-    PQclear(r);
-    return std::nullopt;
+  PgParams p;
+  p.text(username);
+  PGresult* r = db_.exec_prepared(kUserByUsername, std::move(p)).get();
+  must_ok(r, "get_user_by_username");
+  auto user = take_user_row(r);
+  if (user) cache_.put(*user);
+  return user;
+}
+
+std::optional<UserRow> UserRepository::get_user_by_id(long long id) {
+  if (auto cached = cache_.get_by_id(id)) return cached;
+
+  PgParams p;
+  p.int8(id);
+  PGresult* r = db_.exec_prepared(kUserById, std::move(p)).get();
+  must_ok(r, "get_user_by_id");
+  auto user = take_user_row(r);
+  if (user) cache_.put(*user);
+  return user;
+}
+
+void UserRepository::async_get_user_by_username(const std::string& username, UserCallback cb) {
+  if (auto cached = cache_.get_by_username(username)) {
+    cb(std::move(cached), "");
+    return;
   }
 
-  UserRow u;
-  u.id = std::stoll(PQgetvalue(r, 0, 0));
-  u.username = PQgetvalue(r, 0, 1);
-  u.email = PQgetvalue(r, 0, 2) ? PQgetvalue(r, 0, 2) : "";
-  u.pass_hash = PQgetvalue(r, 0, 3);
-  PQclear(r);
-  return u;
+  PgParams p;
+  p.text(username);
+  db_.async_exec_prepared(kUserByUsername, std::move(p), [this, cb = std::move(cb)](PGresult* r) {
+    std::optional<UserRow> user;
+    try {
+      must_ok(r, "get_user_by_username");
+      user = take_user_row(r);
+    } catch (const std::exception& e) {
+      cb(std::nullopt, e.what());
+      return;
+    }
+    if (user) cache_.put(*user);
+    cb(std::move(user), "");
+  });
 }
 
 } // namespace fsx::db
-
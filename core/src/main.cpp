@@ -1,14 +1,25 @@
-#include "fsx/db/db.h"
+#include "fsx/db/db_pool.h"
 #include "fsx/db/user_repository.h"
 #include "fsx/db/session_repository.h"
 #include "fsx/net/tcp_server.h"
 #include "fsx/net/auth_handler.h"
+#include "fsx/auth/auth_service.h"
+#include "fsx/admin/metrics.h"
+#include "fsx/compress/chunk_codec.h"
 #include "fsx/net/session_manager.h"
 #include "fsx/transfer/transfer_manager.h"
+#include "fsx/storage/block_store.h"
 #include "fsx/storage/file_store.h"
+#include "fsx/storage/resume_store.h"
+#include "fsx/storage/transfer_store.h"
 #include <boost/asio.hpp>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 // Make stdout unbuffered for Docker logs
 static struct UnbufferedStdout {
@@ -43,29 +54,126 @@ int main(int argc, char** argv) {
     cfg.password = env_or("FSX_DB_PASSWORD", "fsxpass");
     cfg.name = env_or("FSX_DB_NAME", "fsx");
 
-    fsx::db::Db db(cfg);
+    // Reactor threads: one shared io_context, each TcpSession runs on its own strand
+    int io_threads = env_int_or("FSX_IO_THREADS", static_cast<int>(std::thread::hardware_concurrency()));
+    if (io_threads < 1) io_threads = 1;
+    boost::asio::io_context io(io_threads);
+
+    // Non-blocking libpq connections driven by the same reactor
+    int db_pool_size = env_int_or("FSX_DB_POOL_SIZE", 4);
+    int db_pipeline_depth = env_int_or("FSX_DB_PIPELINE_DEPTH", 16);
+    fsx::db::DbPool db(io, cfg,
+                       static_cast<size_t>(db_pool_size > 0 ? db_pool_size : 1),
+                       static_cast<size_t>(db_pipeline_depth > 0 ? db_pipeline_depth : 1));
+    fsx::db::UserRepository::prepare_statements(db);
+    fsx::db::SessionRepository::prepare_statements(db);
     db.connect();
-    std::cout << "[DB] connected\n";
+    std::cout << "[DB] connected pool_size=" << db.size() << "\n";
     std::cout.flush();
 
     // Create repositories
-    fsx::db::UserRepository users(db);
+    // Read-through user directory cache (FSX_USER_CACHE_SIZE=0 disables)
+    int user_cache_size = env_int_or("FSX_USER_CACHE_SIZE", 10000);
+    int user_cache_ttl = env_int_or("FSX_USER_CACHE_TTL_SEC", 300);
+    fsx::db::UserRepository users(db,
+                                  static_cast<size_t>(user_cache_size > 0 ? user_cache_size : 0),
+                                  std::chrono::seconds(user_cache_ttl > 0 ? user_cache_ttl : 0));
     fsx::db::SessionRepository sessions(db);
 
+    // last_seen_at keep-alives are coalesced and written in batches
+    int touch_flush_ms = env_int_or("FSX_SESSION_FLUSH_MS", 1000);
+    sessions.start_write_behind(io, std::chrono::milliseconds(touch_flush_ms > 0 ? touch_flush_ms : 1000));
+
     // Create auth handler
     fsx::net::AuthHandler auth_handler(users, sessions);
 
+    // PBKDF2 + auth DB calls run on a dedicated CPU pool, off the io threads
+    int auth_threads = env_int_or("FSX_AUTH_THREADS", static_cast<int>(std::thread::hardware_concurrency()));
+    int auth_queue = env_int_or("FSX_AUTH_QUEUE", 1024);
+    fsx::auth::AuthService auth_service(auth_handler,
+                                        static_cast<size_t>(auth_threads > 0 ? auth_threads : 1),
+                                        static_cast<size_t>(auth_queue > 0 ? auth_queue : 1));
+    std::cout << "[auth] worker pool threads=" << auth_threads << " queue=" << auth_queue << "\n";
+
     // Create session manager
     fsx::net::SessionManager session_manager;
 
     // Create transfer manager and file store (Phase 3)
+    const std::string storage_path = "./storage/transfers";
+    fsx::storage::TransferStore transfer_store(storage_path);
+    fsx::storage::ResumeStore resume_store(storage_path);
+    fsx::storage::BlockStore block_store("./storage/blocks");
+    fsx::transfer::TimingWheel retransmit_wheel;
+    // Upload shaping in KB/s, 0 = unlimited: FSX_RATE_GLOBAL_KBPS (whole server),
+    // FSX_RATE_USER_KBPS (per user), FSX_RATE_TRANSFER_KBPS (per transfer);
+    // FSX_RATE_BURST_KB is what each may send at once after idling
+    fsx::transfer::RateLimits rate_limits;
+    rate_limits.global_bps = static_cast<uint64_t>(std::max(env_int_or("FSX_RATE_GLOBAL_KBPS", 0), 0)) * 1024;
+    rate_limits.user_bps = static_cast<uint64_t>(std::max(env_int_or("FSX_RATE_USER_KBPS", 0), 0)) * 1024;
+    rate_limits.transfer_bps = static_cast<uint64_t>(std::max(env_int_or("FSX_RATE_TRANSFER_KBPS", 0), 0)) * 1024;
+    rate_limits.burst_bytes = static_cast<uint64_t>(std::max(env_int_or("FSX_RATE_BURST_KB", 1024), 1)) * 1024;
+    fsx::transfer::Throttler throttler(rate_limits);
     fsx::transfer::TransferManager transfer_manager;
-    fsx::storage::FileStore file_store("./storage/transfers");
+    // Receivers that accept with FILE_ACCEPT_RELAY get chunks live; FSX_RELAY_TEE=0
+    // skips writing those transfers to disk
+    transfer_manager.set_relay_tee(env_int_or("FSX_RELAY_TEE", 1) != 0);
+    // FILE_FEATURE_COMPRESS senders may compress chunks with the best codec
+    // both sides have (zstd, lz4, zlib); FSX_COMPRESS=0 refuses
+    if (env_int_or("FSX_COMPRESS", 1) != 0) transfer_manager.set_codecs(fsx::compress::supported_codecs());
+    // Unacknowledged bytes a FILE_FEATURE_ACK sender may keep in flight
+    int window_kb = env_int_or("FSX_TRANSFER_WINDOW_KB", 8192);
+    if (window_kb > 0) transfer_manager.set_window_bytes(static_cast<uint32_t>(window_kb) * 1024);
+    // Out-of-order chunks held per transfer for the whole-file SHA-256; what
+    // doesn't fit is read back from disk on FILE_DONE
+    int digest_kb = env_int_or("FSX_DIGEST_BUFFER_KB", 8192);
+    if (digest_kb >= 0) transfer_manager.set_digest_buffer_bytes(static_cast<size_t>(digest_kb) * 1024);
+    // Receive-side write engine: FSX_DURABILITY=none|done|periodic,
+    // FSX_FSYNC_INTERVAL_MS (periodic), FSX_WRITE_COALESCE_KB (0 = pwrite per chunk)
+    fsx::storage::WritePolicy write_policy;
+    write_policy.durability = fsx::storage::parse_durability(env_or("FSX_DURABILITY", "done"));
+    write_policy.sync_interval = std::chrono::milliseconds(env_int_or("FSX_FSYNC_INTERVAL_MS", 1000));
+    int coalesce_kb = env_int_or("FSX_WRITE_COALESCE_KB", 0);
+    write_policy.coalesce_bytes = static_cast<size_t>(coalesce_kb > 0 ? coalesce_kb : 0) * 1024;
+    write_policy.preallocate = env_int_or("FSX_PREALLOCATE", 1) != 0;
+    fsx::storage::FileStore file_store(storage_path, write_policy);
     if (!file_store.initialize()) {
       std::cerr << "fatal: failed to initialize file store\n";
       return 1;
     }
-    std::cout << "[storage] initialized\n";
+    // FSX_STORAGE_BACKEND=uring needs a -DFSX_WITH_IO_URING=ON build; falls back to blocking
+    if (env_or("FSX_STORAGE_BACKEND", "blocking") == "uring") {
+      file_store.enable_io_uring(io, static_cast<unsigned>(env_int_or("FSX_URING_ENTRIES", 1024)));
+    }
+    std::cout << "[storage] initialized backend=" << (file_store.uses_io_uring() ? "io_uring" : "blocking") << "\n";
+    // FILE_FEATURE_DEDUP offers store each distinct block once; FSX_DEDUP=0
+    // stores every upload as a plain file
+    if (env_int_or("FSX_DEDUP", 1) != 0 && block_store.initialize(storage_path)) {
+      transfer_manager.set_block_store(&block_store);
+    }
+    if (throttler.enabled()) {
+      transfer_manager.set_throttler(&throttler);
+      std::cout << "[transfer] rate limits global=" << rate_limits.global_bps / 1024
+                << " user=" << rate_limits.user_bps / 1024
+                << " transfer=" << rate_limits.transfer_bps / 1024 << " KB/s\n";
+    }
+    // Transfers and their received chunks survive reconnects and restarts
+    // (FILE_RESUME_REQ); FSX_RESUME=0 keeps them in memory only
+    if (env_int_or("FSX_RESUME", 1) != 0) {
+      transfer_manager.set_stores(&transfer_store, &resume_store);
+      size_t restored = transfer_manager.restore(file_store);
+      std::cout << "[storage] resume enabled, restored " << restored << " transfer(s)\n";
+    }
+    // FILE_FEATURE_NACK senders are asked again for chunks still missing after
+    // FSX_NACK_TIMEOUT_MS (doubling per round, 0 disables), at most
+    // FSX_NACK_MAX_ATTEMPTS times per chunk
+    int nack_timeout_ms = env_int_or("FSX_NACK_TIMEOUT_MS", 1000);
+    if (nack_timeout_ms > 0) {
+      fsx::transfer::RetransmitPolicy retransmit;
+      retransmit.timeout = std::chrono::milliseconds(nack_timeout_ms);
+      int nack_attempts = env_int_or("FSX_NACK_MAX_ATTEMPTS", 8);
+      retransmit.max_attempts = static_cast<uint32_t>(nack_attempts > 0 ? nack_attempts : 1);
+      transfer_manager.set_retransmit(&retransmit_wheel, retransmit);
+    }
     std::cout.flush();
 
     // Start TCP server
@@ -83,13 +191,44 @@ int main(int argc, char** argv) {
       port = static_cast<uint16_t>(env_port);
     }
 
-    boost::asio::io_context io;
-    fsx::net::TcpServer server(io, port, auth_handler, session_manager, transfer_manager, file_store, users);
+    fsx::net::TcpServer server(io, port, auth_service, session_manager, transfer_manager, file_store, users);
     server.start();
 
-    std::cout << "[core] server started on port " << port << ", running...\n";
+    // Periodic metrics line in the core log (FSX_METRICS_INTERVAL_SEC=0 disables)
+    int metrics_interval = env_int_or("FSX_METRICS_INTERVAL_SEC", 30);
+    boost::asio::steady_timer metrics_timer(io);
+    std::function<void()> arm_metrics = [&]() {
+      metrics_timer.expires_after(std::chrono::seconds(metrics_interval));
+      metrics_timer.async_wait([&](boost::system::error_code ec) {
+        if (ec) return;
+        std::cout << "[metrics] " << fsx::admin::Metrics::instance().dump() << "\n";
+        arm_metrics();
+      });
+    };
+    if (metrics_interval > 0) arm_metrics();
+
+    // Drives every retransmission timer
+    boost::asio::steady_timer wheel_timer(io);
+    std::function<void()> arm_wheel = [&]() {
+      wheel_timer.expires_after(retransmit_wheel.tick());
+      wheel_timer.async_wait([&](boost::system::error_code ec) {
+        if (ec) return;
+        retransmit_wheel.advance();
+        arm_wheel();
+      });
+    };
+    if (transfer_manager.timing_wheel()) arm_wheel();
+
+    std::cout << "[core] server started on port " << port << " io_threads=" << io_threads << ", running...\n";
     std::cout.flush();
+
+    std::vector<std::thread> pool;
+    pool.reserve(io_threads - 1);
+    for (int i = 1; i < io_threads; i++) {
+      pool.emplace_back([&io]() { io.run(); });
+    }
     io.run();
+    for (auto& t : pool) t.join();
     return 0;
   } catch (const std::exception& e) {
     std::cerr << "fatal: " << e.what() << "\n";
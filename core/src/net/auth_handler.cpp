@@ -1,8 +1,15 @@
 #include "fsx/net/auth_handler.h"
+#include "fsx/admin/metrics.h"
+#include <chrono>
 #include <stdexcept>
 
 namespace fsx::net {
 
+static fsx::admin::LatencyHistogram& kdf_histogram() {
+  static auto& h = fsx::admin::Metrics::instance().histogram("auth.kdf");
+  return h;
+}
+
 fsx::protocol::RegisterResp AuthHandler::handle_register(const fsx::protocol::RegisterReq& req) {
   fsx::protocol::RegisterResp resp;
   
@@ -35,7 +42,9 @@ fsx::protocol::RegisterResp AuthHandler::handle_register(const fsx::protocol::Re
 
   // Hash password and create user
   try {
+    auto kdf_start = std::chrono::steady_clock::now();
     std::string pass_hash = fsx::auth::hash_password_pbkdf2(req.password);
+    kdf_histogram().record(std::chrono::steady_clock::now() - kdf_start);
     long long user_id = users_.create_user(req.username, req.email, pass_hash);
     
     resp.ok = true;
@@ -67,7 +76,10 @@ fsx::protocol::LoginResp AuthHandler::handle_login(const fsx::protocol::LoginReq
   }
 
   // Verify password
-  if (!fsx::auth::verify_password_pbkdf2(req.password, user->pass_hash)) {
+  auto kdf_start = std::chrono::steady_clock::now();
+  bool password_ok = fsx::auth::verify_password_pbkdf2(req.password, user->pass_hash);
+  kdf_histogram().record(std::chrono::steady_clock::now() - kdf_start);
+  if (!password_ok) {
     resp.ok = false;
     resp.msg = "invalid username or password";
     return resp;
@@ -0,0 +1,104 @@
+#include "fsx/net/buffer_pool.h"
+#include "fsx/admin/metrics.h"
+#include <new>
+#include <vector>
+
+namespace fsx::net {
+
+namespace {
+
+using Slab = detail::BufferSlab;
+
+constexpr uint8_t kUnpooled = BufferPool::kClasses;
+
+struct Counters {
+  std::atomic<uint64_t>& hits = fsx::admin::Metrics::instance().counter("pool.hits");
+  std::atomic<uint64_t>& misses = fsx::admin::Metrics::instance().counter("pool.misses");
+  std::atomic<uint64_t>& bytes = fsx::admin::Metrics::instance().counter("pool.bytes");
+  std::atomic<uint64_t>& peak = fsx::admin::Metrics::instance().counter("pool.peak_bytes");
+};
+
+Counters& counters() {
+  static Counters c;
+  return c;
+}
+
+void free_slab(Slab* slab) {
+  counters().bytes.fetch_sub(slab->capacity, std::memory_order_relaxed);
+  size_t capacity = slab->capacity;
+  slab->~Slab();
+  ::operator delete(slab, sizeof(Slab) + capacity);
+}
+
+// Set once this thread's freelists are destroyed: buffers released during
+// thread exit after that go straight back to the heap
+thread_local bool tl_gone = false;
+
+struct FreeLists {
+  std::array<std::vector<Slab*>, BufferPool::kClasses> lists;
+
+  void clear() {
+    for (auto& list : lists) {
+      for (Slab* slab : list) free_slab(slab);
+      list.clear();
+    }
+  }
+  ~FreeLists() {
+    clear();
+    tl_gone = true;
+  }
+};
+
+FreeLists& freelists() {
+  thread_local FreeLists f;
+  return f;
+}
+
+} // namespace
+
+PooledBuffer BufferPool::acquire(size_t len) {
+  auto& c = counters();
+  uint8_t cls = 0;
+  while (cls < kClasses && len > kClassBytes[cls] + kSlack) cls++;
+
+  if (cls < kClasses && !tl_gone) {
+    auto& list = freelists().lists[cls];
+    if (!list.empty()) {
+      Slab* slab = list.back();
+      list.pop_back();
+      slab->refs.store(1, std::memory_order_relaxed);
+      slab->size = len;
+      c.hits.fetch_add(1, std::memory_order_relaxed);
+      return PooledBuffer(slab);
+    }
+  }
+
+  size_t capacity = cls < kClasses ? kClassBytes[cls] + kSlack : len;
+  auto* slab = new (::operator new(sizeof(Slab) + capacity)) Slab;
+  slab->size_class = cls;
+  slab->capacity = capacity;
+  slab->size = len;
+  c.misses.fetch_add(1, std::memory_order_relaxed);
+  uint64_t held = c.bytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+  uint64_t peak = c.peak.load(std::memory_order_relaxed);
+  while (held > peak && !c.peak.compare_exchange_weak(peak, held, std::memory_order_relaxed)) {
+  }
+  return PooledBuffer(slab);
+}
+
+void BufferPool::release(Slab* slab) {
+  if (slab->size_class != kUnpooled && !tl_gone) {
+    auto& list = freelists().lists[slab->size_class];
+    if (list.size() < kMaxFree[slab->size_class]) {
+      list.push_back(slab);
+      return;
+    }
+  }
+  free_slab(slab);
+}
+
+void BufferPool::trim() {
+  if (!tl_gone) freelists().clear();
+}
+
+} // namespace fsx::net
@@ -5,7 +5,7 @@ namespace fsx::net {
 
 void SessionManager::add_session(const std::string& token, std::shared_ptr<TcpSession> session) {
   std::lock_guard<std::mutex> lock(mutex_);
-  sessions_[token] = session;
+  sessions_[token] = Entry{session, session->username()};
 }
 
 void SessionManager::remove_session(const std::string& token) {
@@ -16,7 +16,7 @@ void SessionManager::remove_session(const std::string& token) {
 void SessionManager::remove_session(std::shared_ptr<TcpSession> session) {
   std::lock_guard<std::mutex> lock(mutex_);
   for (auto it = sessions_.begin(); it != sessions_.end();) {
-    if (auto s = it->second.lock()) {
+    if (auto s = it->second.session.lock()) {
       if (s == session) {
         it = sessions_.erase(it);
         return;
@@ -34,10 +34,8 @@ std::vector<std::string> SessionManager::get_online_usernames() const {
   std::vector<std::string> usernames;
   
   for (auto it = sessions_.begin(); it != sessions_.end();) {
-    if (auto session = it->second.lock()) {
-      if (session->is_authenticated()) {
-        usernames.push_back(session->username());
-      }
+    if (!it->second.session.expired()) {
+      usernames.push_back(it->second.username);
       ++it;
     } else {
       // Clean up expired weak_ptr
@@ -52,8 +50,8 @@ size_t SessionManager::count() const {
   std::lock_guard<std::mutex> lock(mutex_);
   size_t cnt = 0;
   for (auto it = sessions_.begin(); it != sessions_.end();) {
-    if (auto s = it->second.lock()) {
-      if (s->is_authenticated()) cnt++;
+    if (!it->second.session.expired()) {
+      cnt++;
       ++it;
     } else {
       it = sessions_.erase(it);
@@ -66,7 +64,7 @@ std::shared_ptr<TcpSession> SessionManager::get_session(const std::string& token
   std::lock_guard<std::mutex> lock(mutex_);
   auto it = sessions_.find(token);
   if (it != sessions_.end()) {
-    return it->second.lock();  // Returns nullptr if expired
+    return it->second.session.lock();  // Returns nullptr if expired
   }
   return nullptr;
 }
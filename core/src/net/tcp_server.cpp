@@ -7,14 +7,14 @@ namespace fsx::net {
 
 TcpServer::TcpServer(boost::asio::io_context& io, 
                      uint16_t port, 
-                     AuthHandler& auth_handler, 
+                     fsx::auth::AuthService& auth_service, 
                      SessionManager& session_manager,
                      fsx::transfer::TransferManager& transfer_manager,
                      fsx::storage::FileStore& file_store,
                      fsx::db::UserRepository& user_repository)
   : io_(io),
     acceptor_(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
-    auth_handler_(auth_handler),
+    auth_service_(auth_service),
     session_manager_(session_manager),
     transfer_manager_(transfer_manager),
     file_store_(file_store),
@@ -27,10 +27,13 @@ void TcpServer::start() {
 }
 
 void TcpServer::do_accept() {
-  acceptor_.async_accept([this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+  // Each accepted socket gets its own strand so a session's handlers never run
+  // concurrently, while different sessions spread across all io threads.
+  acceptor_.async_accept(boost::asio::make_strand(io_),
+                         [this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
     if (!ec) {
       auto s = std::make_shared<TcpSession>(std::move(socket), 
-                                            auth_handler_, 
+                                            auth_service_, 
                                             session_manager_,
                                             transfer_manager_,
                                             file_store_,
@@ -6,9 +6,21 @@
 #include "fsx/transfer/transfer_manager.h"
 #include "fsx/storage/file_store.h"
 #include "fsx/db/user_repository.h"
+#include "fsx/admin/metrics.h"
+#include "fsx/compress/chunk_codec.h"
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstring>
+#include <span>
 #include <sstream>
 #include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
 
 namespace fsx::net {
 
@@ -19,20 +31,23 @@ static std::string now_ts() {
 }
 
 TcpSession::TcpSession(boost::asio::ip::tcp::socket socket, 
-                       AuthHandler& auth_handler, 
+                       fsx::auth::AuthService& auth_service, 
                        SessionManager& session_manager,
                        transfer::TransferManager& transfer_manager,
                        storage::FileStore& file_store,
                        db::UserRepository& user_repository)
   : socket_(std::move(socket)), 
-    auth_handler_(auth_handler), 
+    auth_service_(auth_service), 
     session_manager_(session_manager),
     transfer_manager_(transfer_manager),
     file_store_(file_store),
-    user_repository_(user_repository) {}
+    user_repository_(user_repository),
+    read_pause_timer_(socket_.get_executor()) {}
 
 void TcpSession::log(const std::string& s) {
-  std::cout << "[sess " << now_ts() << "] " << s << "\n";
+  // Build the line first so concurrent sessions don't interleave mid-line
+  std::string line = "[sess " + now_ts() + "] " + s + "\n";
+  std::cout << line;
   std::cout.flush();
 }
 
@@ -62,272 +77,767 @@ void TcpSession::start() {
   do_read_header();
 }
 
+void TcpSession::on_read_error(const std::string& what) {
+  log("DISCONNECTED (" + what + ")");
+  if (!token_.empty()) {
+  size_t count_before = session_manager_.count();
+  log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
+      " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
+      " count_before=" + std::to_string(count_before));
+  session_manager_.remove_session(token_);
+  clear_auth();
+  }
+}
+
 void TcpSession::do_read_header() {
+  // A chunk whose done() runs inline lands back here: let the loop below
+  // carry on instead of nesting one call per buffered frame
+  if (in_frame_loop_) {
+    frame_loop_again_ = true;
+    return;
+  }
+  in_frame_loop_ = true;
+  for (;;) {
+    frame_loop_again_ = false;
+    if (next_frame()) continue;
+    if (!frame_loop_again_) break;
+  }
+  in_frame_loop_ = false;
+}
+
+bool TcpSession::next_frame() {
+  static auto& frames_read = fsx::admin::Metrics::instance().counter("net.frames_read");
+
+  if (rx_.size() < sizeof(header_)) {
+    read_more();
+    return false;
+  }
+  std::memcpy(&header_, rx_.data(), sizeof(header_));
+  try {
+    fsx::protocol::validate_header(header_);
+  } catch (const std::exception& e) {
+    on_read_error(std::string("bad header: ") + e.what());
+    return false;
+  }
+
+  auto len = fsx::protocol::payload_len(header_);
+  if (len > kRoutes[header_.type].max_payload) {
+    on_read_error("payload too large type=" + std::to_string(header_.type) + " len=" + std::to_string(len));
+    return false;
+  }
+  auto type = static_cast<fsx::protocol::MsgType>(header_.type);
+
+  if (type == fsx::protocol::MsgType::FILE_CHUNK && len >= sizeof(chunk_hdr_)) {
+    // Streamed bodies skip handle_message: refuse them before reading up
+    // to a megabyte from a peer that has not logged in
+    if (kRoutes[header_.type].needs_auth && !is_authenticated()) {
+      on_read_error("FILE_CHUNK before authentication");
+      return false;
+    }
+    frames_read.fetch_add(1, std::memory_order_relaxed);
+    rx_.consume(sizeof(header_));
+    do_read_file_chunk(len);
+    return false;
+  }
+
+  // Whole frame buffered: handled in place
+  if (rx_.size() - sizeof(header_) >= len) {
+    frames_read.fetch_add(1, std::memory_order_relaxed);
+    rx_.consume(sizeof(header_));
+    handle_message(type, std::span<const uint8_t>(rx_.data(), len));
+    rx_.consume(len);
+    return true;
+  }
+  if (sizeof(header_) + len <= rx_.capacity()) {
+    read_more();
+    return false;
+  }
+
+  // Too big for rx_: the body gets its own buffer and the rest is read into it
+  frames_read.fetch_add(1, std::memory_order_relaxed);
+  rx_.consume(sizeof(header_));
+  body_ = BufferPool::acquire(len);
+  do_read_body(rx_.take(body_.data(), len));
+  return false;
+}
+
+void TcpSession::read_more() {
+  static auto& reads = fsx::admin::Metrics::instance().counter("net.reads");
+
+  // Coalesced chunks are acked only once written: before waiting on an idle
+  // socket, write out the run so the sender's window doesn't stall on it
+  if (staged_write_) {
+    boost::system::error_code ec;
+    if (socket_.available(ec) == 0 || ec) std::exchange(staged_write_, nullptr)->flush();
+  }
+
   auto self = shared_from_this();
-  boost::asio::async_read(socket_,
-    boost::asio::buffer(&header_, sizeof(header_)),
+  socket_.async_read_some(rx_.prepare(),
     [this, self](boost::system::error_code ec, std::size_t n) {
       if (ec) {
-        log(std::string("DISCONNECTED (read header): ") + ec.message());
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
-        return;
-      }
-      if (n != sizeof(header_)) {
-        log("DISCONNECTED (header size mismatch)");
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
-        return;
-      }
-
-      try {
-        fsx::protocol::validate_header(header_);
-      } catch (const std::exception& e) {
-        log(std::string("DISCONNECTED (bad header): ") + e.what());
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
+        on_read_error("read: " + ec.message());
         return;
       }
+      reads.fetch_add(1, std::memory_order_relaxed);
+      rx_.commit(n);
+      do_read_header();
+    }
+  );
+}
 
-      auto len = fsx::protocol::payload_len(header_);
-      if (len > 16 * 1024 * 1024) { 
-        log("DISCONNECTED (payload too large)");
+void TcpSession::do_read_body(size_t have) {
+  auto self = shared_from_this();
+  boost::asio::async_read(socket_,
+    boost::asio::buffer(body_.data() + have, body_.size() - have),
+    [this, self](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        on_read_error("read body: " + ec.message());
         return;
       }
 
-      body_.assign(len, 0);
-      do_read_body();
+      handle_message(static_cast<fsx::protocol::MsgType>(header_.type), body_.span());
+      body_.reset();  // back to the pool, usually for the next frame
+      do_read_header();
     }
   );
 }
 
-void TcpSession::do_read_body() {
-  auto self = shared_from_this();
-  if (body_.empty()) {
-    handle_message(static_cast<fsx::protocol::MsgType>(header_.type), body_);
-    do_read_header();
+void TcpSession::do_read_file_chunk(size_t len) {
+  size_t data_len = len - sizeof(chunk_hdr_);
+  PooledBuffer buf = BufferPool::acquire(data_len);
+
+  // Whatever rx_ read ahead first, then the rest straight into buf
+  size_t hdr_have = rx_.take(chunk_hdr_, sizeof(chunk_hdr_));
+  size_t data_have = hdr_have == sizeof(chunk_hdr_) ? rx_.take(buf.data(), data_len) : 0;
+  if (data_have == data_len) {
+    on_file_chunk(std::move(buf), data_len);
     return;
   }
 
-  boost::asio::async_read(socket_,
-    boost::asio::buffer(body_.data(), body_.size()),
-    [this, self](boost::system::error_code ec, std::size_t n) {
+  auto self = shared_from_this();
+  std::array<boost::asio::mutable_buffer, 2> bufs = {
+    boost::asio::buffer(chunk_hdr_ + hdr_have, sizeof(chunk_hdr_) - hdr_have),
+    boost::asio::buffer(buf.data() + data_have, data_len - data_have),
+  };
+  boost::asio::async_read(socket_, bufs,
+    [this, self, buf = std::move(buf), data_len](boost::system::error_code ec, std::size_t) mutable {
       if (ec) {
-        log(std::string("DISCONNECTED (read body): ") + ec.message());
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
+        on_read_error("read chunk: " + ec.message());
         return;
       }
-      if (n != body_.size()) {
-        log("DISCONNECTED (body size mismatch)");
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
-        return;
-      }
-
-      handle_message(static_cast<fsx::protocol::MsgType>(header_.type), body_);
-      do_read_header();
+      on_file_chunk(std::move(buf), data_len);
     }
   );
 }
 
-void TcpSession::handle_message(fsx::protocol::MsgType type, const std::vector<uint8_t>& payload) {
-  if (type == fsx::protocol::MsgType::HELLO) {
-    std::string name(payload.begin(), payload.end());
-    log("RECV HELLO name=" + name);
+void TcpSession::on_file_chunk(PooledBuffer buf, size_t data_len) {
+  uint64_t transfer_id_be;
+  uint32_t chunk_index_be;
+  std::memcpy(&transfer_id_be, chunk_hdr_, 8);
+  std::memcpy(&chunk_index_be, chunk_hdr_ + 8, 4);
+  // The next frame is read once this one is on disk, so a steady upload
+  // cycles through the same pooled buffer
+  auto self = shared_from_this();
+  handle_file_chunk_data(be64toh(transfer_id_be), ntohl(chunk_index_be),
+                         std::move(buf), data_len, [this, self]() { resume_reads(); });
+}
+
+void TcpSession::pace_chunk(fsx::transfer::TransferSession& session, size_t len) {
+  auto* throttler = transfer_manager_.throttler();
+  if (!throttler) return;
+  if (rate_user_id_ != user_id_) {
+    rate_user_ = throttler->user_bucket(user_id_);
+    rate_user_id_ = user_id_;
+  }
+  read_pause_ = std::max(read_pause_, throttler->consume(rate_user_.get(), &session.throttle, len));
+}
+
+void TcpSession::resume_reads() {
+  static auto& pauses = fsx::admin::Metrics::instance().counter("throttle.pauses");
+  static auto& paused_us = fsx::admin::Metrics::instance().counter("throttle.paused_us");
+  
+  auto pause = std::exchange(read_pause_, std::chrono::nanoseconds(0));
+  // Shorter debts stay in the buckets and add up to a real pause later
+  if (pause < std::chrono::milliseconds(1)) {
+    do_read_header();
     return;
   }
-  if (type == fsx::protocol::MsgType::PING) {
-    log("RECV PING -> SEND PONG");
-    const std::string pong = "pong";
-    send(fsx::protocol::MsgType::PONG, std::vector<uint8_t>(pong.begin(), pong.end()));
+  pauses.fetch_add(1, std::memory_order_relaxed);
+  paused_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(pause).count(),
+                      std::memory_order_relaxed);
+  auto self = shared_from_this();
+  read_pause_timer_.expires_after(pause);
+  read_pause_timer_.async_wait([this, self](boost::system::error_code) { do_read_header(); });
+}
+
+// Message traits. A type without a Handler specialization is unknown to the
+// server: it is read (up to kUnroutedMaxPayload), logged and dropped.
+namespace {
+
+constexpr uint32_t kUnroutedMaxPayload = 64 * 1024;
+constexpr uint32_t kControlMaxPayload = 1024;  // HELLO / PING / PONG / ONLINE_LIST_REQ
+constexpr uint32_t kAuthMaxPayload = 4 * 1024;
+// Fixed-size requests: room for trailing fields a newer client may append
+constexpr uint32_t kExtensionSlack = 256;
+
+} // namespace
+
+template <typename Resp, fsx::protocol::MsgType kRespType>
+void TcpSession::reject_unauthenticated() {
+  Resp resp;
+  resp.ok = false;
+  resp.reason = "Not authenticated";
+  send(kRespType, resp.serialize());
+}
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::HELLO> {
+  static constexpr const char* kName = "HELLO";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kControlMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_hello;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::PING> {
+  static constexpr const char* kName = "PING";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kControlMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_ping;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::PONG> {
+  static constexpr const char* kName = "PONG";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kControlMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_pong;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::REGISTER_REQ> {
+  static constexpr const char* kName = "REGISTER_REQ";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kAuthMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_register_req;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::LOGIN_REQ> {
+  static constexpr const char* kName = "LOGIN_REQ";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kAuthMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_login_req;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::ONLINE_LIST_REQ> {
+  static constexpr const char* kName = "ONLINE_LIST_REQ";
+  static constexpr bool kNeedsAuth = false;
+  static constexpr uint32_t kMaxPayload = kControlMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_online_list_req;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_OFFER_REQ> {
+  using Msg = fsx::protocol::FileOfferReq;
+  static constexpr const char* kName = "FILE_OFFER_REQ";
+  static constexpr bool kNeedsAuth = true;
+  // Two u16 strings, the DEDUP block list at its cap and the codecs byte
+  static constexpr uint32_t kMaxPayload =
+      Msg::Wire::kSize + 2 * 0xFFFF + 4 + 4 + Msg::kMaxBlocks * Msg::BlockWire::kSize + 1;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_offer_req;
+  static constexpr RejectFn kReject =
+      &TcpSession::reject_unauthenticated<fsx::protocol::FileOfferResp, fsx::protocol::MsgType::FILE_OFFER_RESP>;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_ACCEPT_REQ> {
+  static constexpr const char* kName = "FILE_ACCEPT_REQ";
+  static constexpr bool kNeedsAuth = true;
+  static constexpr uint32_t kMaxPayload = fsx::protocol::FileAcceptReq::Wire::kSize + kExtensionSlack;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_accept_req;
+  static constexpr RejectFn kReject =
+      &TcpSession::reject_unauthenticated<fsx::protocol::FileAcceptResp, fsx::protocol::MsgType::FILE_ACCEPT_RESP>;
+};
+
+// Only chunks too short for their header get here; the rest are read by
+// do_read_file_chunk once next_frame has checked auth
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_CHUNK> {
+  static constexpr const char* kName = "FILE_CHUNK";
+  static constexpr bool kNeedsAuth = true;
+  static constexpr uint32_t kMaxPayload = fsx::protocol::FileChunk::kMaxPayload;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_chunk;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_DONE> {
+  static constexpr const char* kName = "FILE_DONE";
+  static constexpr bool kNeedsAuth = true;
+  static constexpr uint32_t kMaxPayload = fsx::protocol::FileDone::Wire::kSize + kExtensionSlack;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_done;
+  static constexpr RejectFn kReject = nullptr;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_FETCH_REQ> {
+  static constexpr const char* kName = "FILE_FETCH_REQ";
+  static constexpr bool kNeedsAuth = true;
+  static constexpr uint32_t kMaxPayload = fsx::protocol::FileFetchReq::Wire::kSize + kExtensionSlack;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_fetch_req;
+  static constexpr RejectFn kReject =
+      &TcpSession::reject_unauthenticated<fsx::protocol::FileFetchResp, fsx::protocol::MsgType::FILE_FETCH_RESP>;
+};
+
+template <>
+struct TcpSession::Handler<fsx::protocol::MsgType::FILE_RESUME_REQ> {
+  static constexpr const char* kName = "FILE_RESUME_REQ";
+  static constexpr bool kNeedsAuth = true;
+  static constexpr uint32_t kMaxPayload = fsx::protocol::FileResumeReq::Wire::kSize + kExtensionSlack;
+  static constexpr MessageFn kHandle = &TcpSession::handle_file_resume_req;
+  static constexpr RejectFn kReject =
+      &TcpSession::reject_unauthenticated<fsx::protocol::FileResumeResp, fsx::protocol::MsgType::FILE_RESUME_RESP>;
+};
+
+template <fsx::protocol::MsgType T>
+constexpr TcpSession::Route TcpSession::route() {
+  using H = Handler<T>;
+  static_assert(H::kMaxPayload <= 16 * 1024 * 1024, "payload cap over the 16 MB frame limit");
+  return Route{H::kName, H::kHandle, H::kReject, H::kMaxPayload, H::kNeedsAuth};
+}
+
+template <fsx::protocol::MsgType... Ts>
+constexpr std::array<TcpSession::Route, 256> TcpSession::make_routes() {
+  std::array<Route, 256> routes{};
+  for (auto& r : routes) r.max_payload = kUnroutedMaxPayload;
+  const std::pair<uint8_t, Route> entries[] = {{static_cast<uint8_t>(Ts), route<Ts>()}...};
+  for (const auto& [type, r] : entries) {
+    if (routes[type].handle) throw "message type registered twice";
+    routes[type] = r;
+  }
+  return routes;
+}
+
+constexpr std::array<TcpSession::Route, 256> TcpSession::kRoutes = TcpSession::make_routes<
+  fsx::protocol::MsgType::HELLO,
+  fsx::protocol::MsgType::PING,
+  fsx::protocol::MsgType::PONG,
+  fsx::protocol::MsgType::REGISTER_REQ,
+  fsx::protocol::MsgType::LOGIN_REQ,
+  fsx::protocol::MsgType::ONLINE_LIST_REQ,
+  fsx::protocol::MsgType::FILE_OFFER_REQ,
+  fsx::protocol::MsgType::FILE_ACCEPT_REQ,
+  fsx::protocol::MsgType::FILE_CHUNK,
+  fsx::protocol::MsgType::FILE_DONE,
+  fsx::protocol::MsgType::FILE_FETCH_REQ,
+  fsx::protocol::MsgType::FILE_RESUME_REQ>();
+
+void TcpSession::handle_message(fsx::protocol::MsgType type, std::span<const uint8_t> payload) {
+  const Route& route = kRoutes[static_cast<uint8_t>(type)];
+  if (!route.handle) {
+    log("RECV UNKNOWN type=" + std::to_string(static_cast<int>(type)));
     return;
   }
-  if (type == fsx::protocol::MsgType::PONG) {
-    log("RECV PONG");
+  if (route.needs_auth && !is_authenticated()) {
+    log(std::string(route.name) + " rejected: not authenticated from=" + get_remote_endpoint());
+    if (route.reject) (this->*route.reject)();
     return;
   }
-  
-  // Auth messages
-  if (type == fsx::protocol::MsgType::REGISTER_REQ) {
-    try {
-      auto req = fsx::protocol::RegisterReq::deserialize(payload);
-      log("RECV REGISTER_REQ username=" + req.username + " from=" + get_remote_endpoint());
-      auto resp = auth_handler_.handle_register(req);
-      auto resp_payload = resp.serialize();
-      send(fsx::protocol::MsgType::REGISTER_RESP, resp_payload);
-      if (resp.ok) {
-        log("AUTH_REGISTER_OK username=" + req.username + " from=" + get_remote_endpoint());
-      } else {
-        log("AUTH_REGISTER_FAIL username=" + req.username + " reason=" + resp.msg + " from=" + get_remote_endpoint());
-      }
-    } catch (const std::exception& e) {
-      log("REGISTER_REQ error: " + std::string(e.what()));
-      fsx::protocol::RegisterResp err_resp;
-      err_resp.ok = false;
-      err_resp.msg = std::string("error: ") + e.what();
-      send(fsx::protocol::MsgType::REGISTER_RESP, err_resp.serialize());
+  (this->*route.handle)(payload);
+}
+
+void TcpSession::handle_hello(std::span<const uint8_t> payload) {
+  std::string name(payload.begin(), payload.end());
+  log("RECV HELLO name=" + name);
+}
+
+void TcpSession::handle_ping(std::span<const uint8_t>) {
+  log("RECV PING -> SEND PONG");
+  if (!token_.empty()) auth_service_.handler().touch_session(token_);
+  const std::string pong = "pong";
+  send(fsx::protocol::MsgType::PONG, std::vector<uint8_t>(pong.begin(), pong.end()));
+}
+
+void TcpSession::handle_pong(std::span<const uint8_t>) {
+  log("RECV PONG");
+}
+
+// Auth messages: PBKDF2 + DB work runs on the AuthService pool, the
+// response is sent from the completion (back on this session's strand)
+void TcpSession::handle_register_req(std::span<const uint8_t> payload) {
+  try {
+    auto req = fsx::protocol::RegisterReq::deserialize(payload);
+    log("RECV REGISTER_REQ username=" + req.username + " from=" + get_remote_endpoint());
+    std::string username = req.username;
+    auto self = shared_from_this();
+    bool queued = auth_service_.submit_register(std::move(req),
+      [this, self, username](fsx::protocol::RegisterResp resp) {
+        boost::asio::post(socket_.get_executor(), [this, self, username, resp = std::move(resp)]() {
+          on_register_done(username, resp);
+        });
+      });
+    if (!queued) {
+      fsx::protocol::RegisterResp busy;
+      busy.ok = false;
+      busy.msg = "server busy, retry later";
+      on_register_done(username, busy);
     }
-    return;
+  } catch (const std::exception& e) {
+    log("REGISTER_REQ error: " + std::string(e.what()));
+    fsx::protocol::RegisterResp err_resp;
+    err_resp.ok = false;
+    err_resp.msg = std::string("error: ") + e.what();
+    send(fsx::protocol::MsgType::REGISTER_RESP, err_resp.serialize());
   }
-  
-  if (type == fsx::protocol::MsgType::LOGIN_REQ) {
-    try {
-      auto req = fsx::protocol::LoginReq::deserialize(payload);
-      log("RECV LOGIN_REQ username=" + req.username + " from=" + get_remote_endpoint());
-      auto resp = auth_handler_.handle_login(req);
-      auto resp_payload = resp.serialize();
-      send(fsx::protocol::MsgType::LOGIN_RESP, resp_payload);
-      
-      // If login successful, set auth state and register in session manager
-      if (resp.ok) {
-        // Set authentication state in this session
-        set_auth(resp.token, resp.user_id, resp.username);
-        
-        // Register session in SessionManager (for online list)
-        auto self = shared_from_this();
-        session_manager_.add_session(resp.token, self);
-        
-        log("AUTH_LOGIN_OK username=" + resp.username + " user_id=" + std::to_string(resp.user_id) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint());
-        log("ONLINE_ADD username=" + resp.username + " user_id=" + std::to_string(resp.user_id) + 
-            " count=" + std::to_string(session_manager_.count()));
-      } else {
-        log("AUTH_LOGIN_FAIL username=" + req.username + " reason=" + resp.msg + " from=" + get_remote_endpoint());
-      }
-    } catch (const std::exception& e) {
-      log("LOGIN_REQ error: " + std::string(e.what()));
-      fsx::protocol::LoginResp err_resp;
-      err_resp.ok = false;
-      err_resp.msg = std::string("error: ") + e.what();
-      send(fsx::protocol::MsgType::LOGIN_RESP, err_resp.serialize());
+}
+
+void TcpSession::handle_login_req(std::span<const uint8_t> payload) {
+  try {
+    auto req = fsx::protocol::LoginReq::deserialize(payload);
+    log("RECV LOGIN_REQ username=" + req.username + " from=" + get_remote_endpoint());
+    std::string username = req.username;
+    auto self = shared_from_this();
+    bool queued = auth_service_.submit_login(std::move(req),
+      [this, self, username](fsx::protocol::LoginResp resp) {
+        boost::asio::post(socket_.get_executor(), [this, self, username, resp = std::move(resp)]() {
+          on_login_done(username, resp);
+        });
+      });
+    if (!queued) {
+      fsx::protocol::LoginResp busy;
+      busy.ok = false;
+      busy.msg = "server busy, retry later";
+      on_login_done(username, busy);
     }
-    return;
+  } catch (const std::exception& e) {
+    log("LOGIN_REQ error: " + std::string(e.what()));
+    fsx::protocol::LoginResp err_resp;
+    err_resp.ok = false;
+    err_resp.msg = std::string("error: ") + e.what();
+    send(fsx::protocol::MsgType::LOGIN_RESP, err_resp.serialize());
   }
+}
+
+void TcpSession::handle_online_list_req(std::span<const uint8_t>) {
+  log("ONLINE_LIST_REQ from=" + get_remote_endpoint() + 
+      (is_authenticated() ? " user=" + username_ : " unauthenticated"));
   
-  if (type == fsx::protocol::MsgType::ONLINE_LIST_REQ) {
-    log("ONLINE_LIST_REQ from=" + get_remote_endpoint() + 
-        (is_authenticated() ? " user=" + username_ : " unauthenticated"));
-    
-    // Get online usernames from SessionManager
-    auto usernames = session_manager_.get_online_usernames();
-    
-    // Build response
-    fsx::protocol::OnlineListResp resp;
-    resp.usernames = usernames;
-    
-    // Serialize and send
-    auto resp_payload = resp.serialize();
-    send(fsx::protocol::MsgType::ONLINE_LIST_RESP, resp_payload);
-    
-    log("ONLINE_LIST_RESP count=" + std::to_string(usernames.size()) + 
-        " to=" + get_remote_endpoint());
-    return;
-  }
+  // Get online usernames from SessionManager
+  auto usernames = session_manager_.get_online_usernames();
   
-  // File transfer handlers (Phase 3)
-  if (type == fsx::protocol::MsgType::FILE_OFFER_REQ) {
-    log("RECV FILE_OFFER_REQ (type=30) from=" + get_remote_endpoint());
-    handle_file_offer_req(payload);
-    return;
-  }
+  // Build response
+  fsx::protocol::OnlineListResp resp;
+  resp.usernames = usernames;
   
-  if (type == fsx::protocol::MsgType::FILE_ACCEPT_REQ) {
-    handle_file_accept_req(payload);
-    return;
-  }
+  // Serialize and send
+  auto resp_payload = resp.serialize();
+  send(fsx::protocol::MsgType::ONLINE_LIST_RESP, resp_payload);
   
-  if (type == fsx::protocol::MsgType::FILE_CHUNK) {
-    handle_file_chunk(payload);
-    return;
+  log("ONLINE_LIST_RESP count=" + std::to_string(usernames.size()) + 
+      " to=" + get_remote_endpoint());
+}
+
+void TcpSession::on_register_done(const std::string& username, const fsx::protocol::RegisterResp& resp) {
+  send(fsx::protocol::MsgType::REGISTER_RESP, resp.serialize());
+  if (resp.ok) {
+    log("AUTH_REGISTER_OK username=" + username + " from=" + get_remote_endpoint());
+  } else {
+    log("AUTH_REGISTER_FAIL username=" + username + " reason=" + resp.msg + " from=" + get_remote_endpoint());
   }
+}
+
+void TcpSession::on_login_done(const std::string& username, const fsx::protocol::LoginResp& resp) {
+  send(fsx::protocol::MsgType::LOGIN_RESP, resp.serialize());
   
-  if (type == fsx::protocol::MsgType::FILE_DONE) {
-    handle_file_done(payload);
-    return;
+  // If login successful, set auth state and register in session manager
+  if (resp.ok) {
+    // Set authentication state in this session
+    set_auth(resp.token, resp.user_id, resp.username);
+    
+    // Register session in SessionManager (for online list)
+    auto self = shared_from_this();
+    session_manager_.add_session(resp.token, self);
+    
+    log("AUTH_LOGIN_OK username=" + resp.username + " user_id=" + std::to_string(resp.user_id) + 
+        " token=" + get_token_short() + " from=" + get_remote_endpoint());
+    log("ONLINE_ADD username=" + resp.username + " user_id=" + std::to_string(resp.user_id) + 
+        " count=" + std::to_string(session_manager_.count()));
+  } else {
+    log("AUTH_LOGIN_FAIL username=" + username + " reason=" + resp.msg + " from=" + get_remote_endpoint());
   }
-  
-  log("RECV UNKNOWN type=" + std::to_string(static_cast<int>(type)));
 }
 
-void TcpSession::send(fsx::protocol::MsgType type, const std::vector<uint8_t>& payload) {
-  // frame = header(12) + payload
-  fsx::protocol::MessageHeaderWire h = fsx::protocol::make_header(type, (uint32_t)payload.size());
+void TcpSession::send(fsx::protocol::MsgType type, std::vector<uint8_t> payload) {
+  // Other sessions (e.g. the receiver notifying the sender on FILE_ACCEPT) call
+  // this from their own strand; outq_ is only ever touched on ours.
+  auto self = shared_from_this();
+  boost::asio::dispatch(socket_.get_executor(),
+    [this, self, type, payload = std::move(payload)]() mutable {
+      // frame = header(12) + payload, written from where they are
+      OutFrame f;
+      f.set_header(type, (uint32_t)payload.size());
+      f.payload = std::move(payload);
 
-  OutFrame f;
-  f.bytes.resize(sizeof(h) + payload.size());
-  std::memcpy(f.bytes.data(), &h, sizeof(h));
-  if (!payload.empty()) std::memcpy(f.bytes.data() + sizeof(h), payload.data(), payload.size());
+      bool writing = !outq_.empty();
+      outq_.push_back(std::move(f));
+      if (!writing) do_write();
+    });
+}
+
+void TcpSession::OutFrame::set_header(fsx::protocol::MsgType type, uint32_t len) {
+  fsx::protocol::MessageHeaderWire h = fsx::protocol::make_header(type, len);
+  std::memcpy(head, &h, sizeof(h));
+  head_len = sizeof(h);
+}
 
-  bool writing = !outq_.empty();
-  outq_.push_back(std::move(f));
-  if (!writing) do_write();
+void TcpSession::OutFrame::set_chunk_header(uint64_t transfer_id, uint32_t chunk_index, size_t len) {
+  set_header(fsx::protocol::MsgType::FILE_CHUNK, (uint32_t)(12 + len));
+  uint64_t transfer_id_be = htobe64(transfer_id);
+  uint32_t chunk_index_be = htonl(chunk_index);
+  std::memcpy(head + head_len, &transfer_id_be, 8);
+  std::memcpy(head + head_len + 8, &chunk_index_be, 4);
+  head_len += 12;
 }
 
 void TcpSession::do_write() {
+  static auto& writes = fsx::admin::Metrics::instance().counter("net.writes");
+  static auto& frames = fsx::admin::Metrics::instance().counter("net.frames_written");
+
+  write_bufs_.clear();
+  write_batch_ = 0;
+  size_t bytes = 0;
+  for (const OutFrame& f : outq_) {
+    if (write_batch_ > 0 && (bytes >= kWriteBatchBytes || write_bufs_.size() + 3 > kWriteBatchBuffers)) break;
+    if (f.head_len > 0) write_bufs_.emplace_back(f.head, f.head_len);
+    if (!f.payload.empty()) write_bufs_.emplace_back(f.payload.data(), f.payload.size());
+    if (f.shared) write_bufs_.emplace_back(f.shared.data(), f.shared_len);
+    bytes += f.head_len + f.payload.size() + f.shared_len;
+    write_batch_++;
+    if (f.file_len > 0) break;  // its data follows with sendfile
+  }
+  writes.fetch_add(1, std::memory_order_relaxed);
+  frames.fetch_add(write_batch_, std::memory_order_relaxed);
+
+  // A span, so asio copies two pointers into the operation, not the vector
   auto self = shared_from_this();
-  boost::asio::async_write(socket_,
-    boost::asio::buffer(outq_.front().bytes),
+  boost::asio::async_write(socket_, std::span<const boost::asio::const_buffer>(write_bufs_),
     [this, self](boost::system::error_code ec, std::size_t) {
       if (ec) {
-        log(std::string("DISCONNECTED (write): ") + ec.message());
-        if (!token_.empty()) {
-        size_t count_before = session_manager_.count();
-        log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
-            " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
-            " count_before=" + std::to_string(count_before));
-        session_manager_.remove_session(token_);
-        clear_auth();
-        }
+        on_write_error(ec.message());
         return;
       }
-      outq_.pop_front();
-      if (!outq_.empty()) do_write();
+      if (outq_[write_batch_ - 1].file_len > 0) {
+        do_send_file();  // the batch retires once its data is out
+        return;
+      }
+      finish_write();
     }
   );
 }
 
-// File transfer handlers (Phase 3)
-void TcpSession::handle_file_offer_req(const std::vector<uint8_t>& payload) {
-  if (!is_authenticated()) {
-    log("FILE_OFFER_REQ rejected: not authenticated from=" + get_remote_endpoint());
-    fsx::protocol::FileOfferResp resp;
-    resp.ok = false;
-    resp.transfer_id = 0;
-    resp.reason = "Not authenticated";
-    send(fsx::protocol::MsgType::FILE_OFFER_RESP, resp.serialize());
+// Body of a fetched FILE_CHUNK, the last frame of the batch: kernel copies
+// page cache -> socket. The socket is non-blocking under asio, so EAGAIN
+// parks us on a write wait.
+void TcpSession::do_send_file() {
+  static auto& sendfile_bytes = fsx::admin::Metrics::instance().counter("fetch.bytes_sendfile");
+  static auto& copy_bytes = fsx::admin::Metrics::instance().counter("fetch.bytes_copy");
+
+  OutFrame& f = outq_[write_batch_ - 1];
+  while (f.file_len > 0) {
+    off_t off = static_cast<off_t>(f.file_off);
+    ssize_t n = ::sendfile(socket_.native_handle(), f.source->fd, &off, f.file_len);
+    if (n > 0) {
+      f.file_off += static_cast<uint64_t>(n);
+      f.file_len -= static_cast<size_t>(n);
+      sendfile_bytes.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      auto self = shared_from_this();
+      socket_.async_wait(boost::asio::ip::tcp::socket::wait_write,
+        [this, self](boost::system::error_code ec) {
+          if (ec) {
+            on_write_error(ec.message());
+            return;
+          }
+          do_send_file();
+        });
+      return;
+    }
+    if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+      // Source can't be sendfile'd (e.g. some FUSE mounts): pread + write
+      f.payload.resize(f.file_len);
+      size_t got = 0;
+      while (got < f.payload.size()) {
+        ssize_t r = ::pread(f.source->fd, f.payload.data() + got, f.payload.size() - got,
+                            static_cast<off_t>(f.file_off + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+          on_write_error("pread failed on fetch transfer_id=" + std::to_string(f.source->transfer_id));
+          return;
+        }
+        got += static_cast<size_t>(r);
+      }
+      copy_bytes.fetch_add(got, std::memory_order_relaxed);
+      f.file_len = 0;
+      auto self = shared_from_this();
+      boost::asio::async_write(socket_, boost::asio::buffer(f.payload),
+        [this, self](boost::system::error_code ec, std::size_t) {
+          if (ec) {
+            on_write_error(ec.message());
+            return;
+          }
+          finish_write();
+        });
+      return;
+    }
+    // n == 0: file shrank under us; anything else is a socket error
+    on_write_error(n == 0 ? "fetch source truncated" : std::string("sendfile: ") + std::strerror(errno));
     return;
   }
+  finish_write();
+}
+
+void TcpSession::finish_write() {
+  for (size_t i = 0; i < write_batch_; i++) {
+    OutFrame& f = outq_.front();
+    fetch_window_used_ -= f.window_bytes;
+    if (f.on_sent) sent_callbacks_.push_back(std::move(f.on_sent));
+    outq_.pop_front();
+  }
+  write_batch_ = 0;
+  pump_fetches();
+  if (!outq_.empty()) do_write();
+  // After the next write started, so one that queues a frame sees a
+  // non-empty outq_ exactly when a write is in flight
+  for (auto& on_sent : sent_callbacks_) on_sent(true);
+  sent_callbacks_.clear();
+}
+
+void TcpSession::on_write_error(const std::string& what) {
+  log("DISCONNECTED (write): " + what);
+  if (!token_.empty()) {
+  size_t count_before = session_manager_.count();
+  log("ONLINE_REMOVE username=" + username_ + " user_id=" + std::to_string(user_id_) + 
+      " token=" + get_token_short() + " from=" + get_remote_endpoint() + 
+      " count_before=" + std::to_string(count_before));
+  session_manager_.remove_session(token_);
+  clear_auth();
+  }
+  fetches_.clear();
+  // Frames stay queued so nothing else is written; relay senders get their
+  // window back
+  write_failed_ = true;
+  for (auto& f : outq_) {
+    if (!f.on_sent) continue;
+    auto on_sent = std::move(f.on_sent);
+    f.on_sent = nullptr;
+    on_sent(false);
+  }
+}
+
+void TcpSession::pump_fetches() {
+  static auto& failed = fsx::admin::Metrics::instance().counter("fetch.failed");
+  
+  // Ends a fetch that can't go on: FILE_RESULT(FAIL) in place of FILE_DONE,
+  // so the receiver stops waiting for the rest
+  auto fail = [this](const FetchStream& stream, const std::string& reason) {
+    failed.fetch_add(1, std::memory_order_relaxed);
+    fsx::protocol::FileResult result;
+    result.transfer_id = stream.transfer_id;
+    result.ok = false;
+    result.path_or_reason = reason;
+    OutFrame f;
+    f.payload = result.serialize();
+    f.set_header(fsx::protocol::MsgType::FILE_RESULT, (uint32_t)f.payload.size());
+    outq_.push_back(std::move(f));
+  };
+  
+  while (!fetches_.empty() && fetch_window_used_ < kFetchWindow) {
+    auto stream = fetches_.front();
+    fetches_.pop_front();
+
+    if (stream->next_index == stream->total_chunks) {
+      fsx::protocol::FileDone done;
+      done.transfer_id = stream->transfer_id;
+      done.total_chunks = stream->total_chunks;
+      done.file_size = stream->file_size;
+      OutFrame f;
+      f.payload = done.serialize();
+      f.set_header(fsx::protocol::MsgType::FILE_DONE, (uint32_t)f.payload.size());
+      outq_.push_back(std::move(f));
+      log("FILE_FETCH_DONE transfer_id=" + std::to_string(stream->transfer_id) + 
+          " chunks=" + std::to_string(stream->total_chunks));
+      continue;
+    }
+
+    uint64_t off = static_cast<uint64_t>(stream->next_index) * stream->chunk_size;
+    size_t len = static_cast<size_t>(std::min<uint64_t>(stream->chunk_size, stream->file_size - off));
+    std::shared_ptr<FetchStream> source = stream;
+    std::vector<uint8_t> inflated;
+    if (!stream->blocks.empty()) {
+      const auto& block = stream->blocks[stream->next_index];
+      auto* blocks = transfer_manager_.block_store();
+      source = std::make_shared<FetchStream>();
+      source->transfer_id = stream->transfer_id;
+      source->fd = blocks ? blocks->open_block(block.id) : -1;
+      if (source->fd < 0) {
+        // Referenced by a manifest, so this is disk trouble
+        log("FILE_FETCH FAIL: missing block " + fsx::crypto::to_hex(block.id) +
+            " transfer_id=" + std::to_string(stream->transfer_id));
+        fail(*stream, "stored block missing");
+        continue;
+      }
+      off = 0;
+      len = block.length;
+      if (fsx::storage::BlockStore::is_packed(source->fd, block.length)) {
+        // Stored compressed: inflated here and sent from memory
+        if (!blocks->read_block(block.id, block.length, &inflated)) {
+          log("FILE_FETCH FAIL: unreadable block " + fsx::crypto::to_hex(block.id) +
+              " transfer_id=" + std::to_string(stream->transfer_id));
+          fail(*stream, "stored block unreadable");
+          continue;
+        }
+        source.reset();
+      }
+    }
+
+    // frame header + u64 transfer_id + u32 chunk_index; the data follows via
+    // sendfile (from memory for a packed block)
+    OutFrame f;
+    f.set_chunk_header(stream->transfer_id, stream->next_index, len);
+    if (!source) {
+      f.payload = std::move(inflated);
+    } else {
+      f.source = std::move(source);
+      f.file_off = off;
+      f.file_len = len;
+    }
+    f.window_bytes = len;
+    fetch_window_used_ += len;
+    outq_.push_back(std::move(f));
+
+    stream->next_index++;
+    fetches_.push_back(std::move(stream));  // round-robin between fetches
+  }
+}
+
+TcpSession::FetchStream::~FetchStream() {
+  if (fd >= 0) ::close(fd);
+}
+
+// File transfer handlers (Phase 3)
+void TcpSession::handle_file_offer_req(std::span<const uint8_t> payload) {
+  log("RECV FILE_OFFER_REQ (type=30) from=" + get_remote_endpoint());
   
   try {
     fsx::protocol::FileOfferReq req = fsx::protocol::FileOfferReq::deserialize(payload);
@@ -339,8 +849,39 @@ void TcpSession::handle_file_offer_req(const std::vector<uint8_t>& payload) {
         " size=" + std::to_string(req.file_size) + 
         " chunk_size=" + std::to_string(req.chunk_size));
     
-    // Find receiver user
-    auto receiver_user = user_repository_.get_user_by_username(req.receiver_username);
+    // Find receiver user (async: the DB round-trip must not block this io thread)
+    auto self = shared_from_this();
+    user_repository_.async_get_user_by_username(req.receiver_username,
+      [this, self, req](std::optional<fsx::db::UserRow> receiver_user, std::string error) {
+        boost::asio::post(socket_.get_executor(),
+          [this, self, req, receiver_user = std::move(receiver_user), error = std::move(error)]() {
+            on_file_offer_receiver(req, receiver_user, error);
+          });
+      });
+    
+  } catch (const std::exception& e) {
+    log("FILE_OFFER_REQ error: " + std::string(e.what()));
+    fsx::protocol::FileOfferResp resp;
+    resp.ok = false;
+    resp.transfer_id = 0;
+    resp.reason = std::string("error: ") + e.what();
+    send(fsx::protocol::MsgType::FILE_OFFER_RESP, resp.serialize());
+  }
+}
+
+void TcpSession::on_file_offer_receiver(const fsx::protocol::FileOfferReq& req,
+                                        const std::optional<fsx::db::UserRow>& receiver_user,
+                                        const std::string& error) {
+  try {
+    if (!error.empty()) {
+      log("FILE_OFFER_REQ FAIL: receiver lookup error username=" + req.receiver_username + " error=" + error);
+      fsx::protocol::FileOfferResp resp;
+      resp.ok = false;
+      resp.transfer_id = 0;
+      resp.reason = "Receiver lookup failed";
+      send(fsx::protocol::MsgType::FILE_OFFER_RESP, resp.serialize());
+      return;
+    }
     if (!receiver_user) {
       log("FILE_OFFER_REQ FAIL: receiver not found username=" + req.receiver_username);
       fsx::protocol::FileOfferResp resp;
@@ -354,7 +895,29 @@ void TcpSession::handle_file_offer_req(const std::vector<uint8_t>& payload) {
     // Validate chunk size (min 1KB, max 1MB)
     uint32_t chunk_size = req.chunk_size;
     if (chunk_size < 1024) chunk_size = 64 * 1024;  // Default 64KB
-    if (chunk_size > 1024 * 1024) chunk_size = 256 * 1024;  // Max 256KB
+    if (chunk_size > fsx::protocol::FileChunk::kMaxChunkSize) chunk_size = 256 * 1024;
+    
+    // Dedup: the sender already cut the file into blocks (any lengths up to
+    // chunk_size) and hashed them; they must tile the file exactly
+    bool dedup = (req.features & fsx::protocol::FILE_FEATURE_DEDUP) && transfer_manager_.block_store();
+    if (dedup) {
+      uint64_t total = 0;
+      bool valid = !req.blocks.empty() || req.file_size == 0;
+      for (const auto& b : req.blocks) {
+        valid = valid && b.length > 0 && b.length <= chunk_size;
+        total += b.length;
+      }
+      if (!valid || total != req.file_size) {
+        log("FILE_OFFER_REQ FAIL: invalid block list blocks=" + std::to_string(req.blocks.size()) + 
+            " sum=" + std::to_string(total) + " file_size=" + std::to_string(req.file_size));
+        fsx::protocol::FileOfferResp resp;
+        resp.ok = false;
+        resp.transfer_id = 0;
+        resp.reason = "Invalid block list";
+        send(fsx::protocol::MsgType::FILE_OFFER_RESP, resp.serialize());
+        return;
+      }
+    }
     
     // Create transfer
     log("FILE_OFFER: creating transfer sender_token=" + (token_.empty() ? "EMPTY" : token_.substr(0, 8) + "..."));
@@ -381,18 +944,61 @@ void TcpSession::handle_file_offer_req(const std::vector<uint8_t>& payload) {
     
     // Get transfer session to set file paths
     auto session = transfer_manager_.get_transfer(transfer_id);
+    uint32_t features = req.features & (fsx::protocol::FILE_FEATURE_ACK | fsx::protocol::FILE_FEATURE_INTEGRITY);
+    if (dedup) features |= fsx::protocol::FILE_FEATURE_DEDUP;
+    if (transfer_manager_.timing_wheel()) features |= req.features & fsx::protocol::FILE_FEATURE_NACK;
+    auto codec = fsx::compress::Codec::NONE;
+    if (req.features & fsx::protocol::FILE_FEATURE_COMPRESS) {
+      codec = fsx::compress::pick_codec(req.codecs & transfer_manager_.codecs());
+      if (codec != fsx::compress::Codec::NONE) features |= fsx::protocol::FILE_FEATURE_COMPRESS;
+    }
+    fsx::protocol::FileOfferResp resp;
     if (session) {
       session->temp_file_path = file_store_.get_temp_path(transfer_id, req.filename);
       session->final_file_path = file_store_.get_file_path(transfer_id, req.filename);
+      session->features = features;
+      session->codec = static_cast<uint8_t>(codec);
+      session->window_bytes = transfer_manager_.window_bytes();
+      // Nothing bounds how far ahead of the hashed prefix a chunk may land
+      // (the window only limits bytes_pending, and senders without
+      // FILE_FEATURE_ACK have none), so the digest's buffer has its own cap;
+      // past it, finish() reads the rest back. A dedup file is already
+      // pinned block by block in its manifest: only the CRCs apply.
+      if ((features & fsx::protocol::FILE_FEATURE_INTEGRITY) && !dedup) {
+        session->digest = std::make_shared<fsx::transfer::FileDigest>(transfer_manager_.digest_buffer_bytes());
+      }
+      if (dedup) {
+        session->final_file_path += ".manifest";
+        std::vector<fsx::storage::BlockRef> blocks(req.blocks.size());
+        for (size_t i = 0; i < blocks.size(); i++) {
+          blocks[i].id = req.blocks[i].sha256;
+          blocks[i].length = req.blocks[i].length;
+        }
+        resp.block_count = static_cast<uint32_t>(blocks.size());
+        resp.present = transfer_manager_.setup_dedup(*session, std::move(blocks));
+        
+        static auto& offered = fsx::admin::Metrics::instance().counter("dedup.bytes_offered");
+        static auto& skipped = fsx::admin::Metrics::instance().counter("dedup.bytes_skipped");
+        std::lock_guard<std::mutex> lock(session->mu);
+        offered.fetch_add(req.file_size, std::memory_order_relaxed);
+        skipped.fetch_add(session->bytes_received, std::memory_order_relaxed);
+        log("FILE_OFFER dedup transfer_id=" + std::to_string(transfer_id) + 
+            " blocks=" + std::to_string(session->total_chunks) + 
+            " present=" + std::to_string(session->received.count()) + 
+            " skip_bytes=" + std::to_string(session->bytes_received));
+      }
     }
     
     log("FILE_OFFER_OK transfer_id=" + std::to_string(transfer_id) + 
         " sender=" + username_ + 
-        " receiver=" + req.receiver_username);
+        " receiver=" + req.receiver_username + 
+        " codec=" + fsx::compress::codec_name(codec));
     
-    fsx::protocol::FileOfferResp resp;
     resp.ok = true;
     resp.transfer_id = transfer_id;
+    resp.features = features;
+    resp.codec = static_cast<uint8_t>(codec);
+    resp.window_bytes = transfer_manager_.window_bytes();
     send(fsx::protocol::MsgType::FILE_OFFER_RESP, resp.serialize());
     
   } catch (const std::exception& e) {
@@ -405,16 +1011,7 @@ void TcpSession::handle_file_offer_req(const std::vector<uint8_t>& payload) {
   }
 }
 
-void TcpSession::handle_file_accept_req(const std::vector<uint8_t>& payload) {
-  if (!is_authenticated()) {
-    log("FILE_ACCEPT_REQ rejected: not authenticated");
-    fsx::protocol::FileAcceptResp resp;
-    resp.ok = false;
-    resp.reason = "Not authenticated";
-    send(fsx::protocol::MsgType::FILE_ACCEPT_RESP, resp.serialize());
-    return;
-  }
-  
+void TcpSession::handle_file_accept_req(std::span<const uint8_t> payload) {
   try {
     fsx::protocol::FileAcceptReq req = fsx::protocol::FileAcceptReq::deserialize(payload);
     
@@ -440,9 +1037,18 @@ void TcpSession::handle_file_accept_req(const std::vector<uint8_t>& payload) {
     }
     
     if (req.accept) {
-      // Open file for writing
-      void* file_handle = file_store_.open_for_write(req.transfer_id, session->filename);
-      if (!file_handle) {
+      bool relay = (req.flags & fsx::protocol::FILE_ACCEPT_RELAY) != 0;
+      
+      // Open file for writing (a relay without tee never touches disk)
+      // Dedup chunks go to the BlockStore, never to a .part file or a
+      // relay: only blocks the server lacks are sent at all
+      if (session->dedup) relay = false;
+      std::shared_ptr<fsx::storage::WriteHandle> file_handle;
+      if (!session->dedup && (!relay || transfer_manager_.relay_tee())) {
+        file_handle = file_store_.open_for_write(req.transfer_id, session->filename,
+                                                 session->file_size, session->chunk_size);
+      }
+      if (!file_handle && !session->dedup && (!relay || transfer_manager_.relay_tee())) {
         log("FILE_ACCEPT_REQ FAIL: failed to open file transfer_id=" + std::to_string(req.transfer_id));
         transfer_manager_.update_state(req.transfer_id, fsx::transfer::TransferState::FAILED);
         fsx::protocol::FileAcceptResp resp;
@@ -452,11 +1058,15 @@ void TcpSession::handle_file_accept_req(const std::vector<uint8_t>& payload) {
         return;
       }
       
-      session->file_handle = file_handle;
+      session->file_handle = std::move(file_handle);
+      if (session->file_handle) transfer_manager_.attach_resume(*session);
+      session->receiver_token = token_;
+      session->relay = relay;
       transfer_manager_.update_state(req.transfer_id, fsx::transfer::TransferState::ACCEPTED);
       
       log("FILE_ACCEPT_OK transfer_id=" + std::to_string(req.transfer_id) + 
-          " receiver=" + username_);
+          " receiver=" + username_ + 
+          " mode=" + (session->dedup ? "dedup" : relay ? (session->file_handle ? "relay+tee" : "relay") : "store"));
       
       // Notify sender that receiver accepted
       if (!session->sender_token.empty()) {
@@ -504,114 +1114,733 @@ void TcpSession::handle_file_accept_req(const std::vector<uint8_t>& payload) {
   }
 }
 
-void TcpSession::handle_file_chunk(const std::vector<uint8_t>& payload) {
-  log("FILE_CHUNK received (payload_size=" + std::to_string(payload.size()) + ")");
-  
+// Short FILE_CHUNK frames (< 12 bytes) still come through handle_message;
+// deserialize rejects them
+void TcpSession::handle_file_chunk(std::span<const uint8_t> payload) {
+  try {
+    auto chunk = fsx::protocol::FileChunk::View::decode(payload);
+    size_t len = chunk.data.size();
+    PooledBuffer buf = BufferPool::acquire(len);
+    std::copy(chunk.data.begin(), chunk.data.end(), buf.data());
+    handle_file_chunk_data(chunk.transfer_id, chunk.chunk_index, std::move(buf), len, []() {});
+  } catch (const std::exception& e) {
+    log("FILE_CHUNK error: " + std::string(e.what()));
+  }
+}
+
+void TcpSession::handle_file_chunk_data(uint64_t transfer_id, uint32_t chunk_index,
+                                        PooledBuffer buf, size_t len, std::function<void()> done) {
   if (!is_authenticated()) {
     log("FILE_CHUNK rejected: not authenticated");
+    done();
+    return;
+  }
+  
+  auto session = transfer_manager_.get_transfer(transfer_id);
+  if (!session) {
+    log("FILE_CHUNK FAIL: transfer not found transfer_id=" + std::to_string(transfer_id));
+    done();
+    return;
+  }
+  
+  // Check if sender is correct
+  if (session->sender_user_id != user_id_) {
+    log("FILE_CHUNK FAIL: not the sender transfer_id=" + std::to_string(transfer_id));
+    done();
+    return;
+  }
+  
+  // Check state
+  if (session->state != fsx::transfer::TransferState::ACCEPTED && 
+      session->state != fsx::transfer::TransferState::RECEIVING) {
+    log("FILE_CHUNK FAIL: invalid state transfer_id=" + std::to_string(transfer_id) + 
+        " state=" + std::to_string(static_cast<int>(session->state.load())));
+    done();
+    return;
+  }
+  
+  // Chunks may come in any order (and over several connections), each lands at
+  // chunk_index * chunk_size; only the index range is checked up front
+  if (chunk_index >= session->total_chunks) {
+    log("FILE_CHUNK FAIL: chunk_index out of range transfer_id=" + std::to_string(transfer_id) + 
+        " chunk_index=" + std::to_string(chunk_index) + 
+        " total_chunks=" + std::to_string(session->total_chunks));
+    done();
+    return;
+  }
+  
+  if (session->features & fsx::protocol::FILE_FEATURE_NACK) {
+    std::lock_guard<std::mutex> lock(session->mu);
+    if (session->chunk_token != token_) session->chunk_token = token_;
+  }
+  pace_chunk(*session, len);
+  
+  // Checked before anything is stored or forwarded. A bad chunk is NACKed
+  // (or, without FILE_FEATURE_NACK, simply missing: the sender sees the hole
+  // in the next FILE_CHUNK_ACK)
+  if (session->features & fsx::protocol::FILE_FEATURE_INTEGRITY) {
+    static auto& crc_errors = fsx::admin::Metrics::instance().counter("integrity.crc_errors");
+    bool intact = len >= 4;
+    if (intact) {
+      uint32_t crc_be;
+      len -= 4;
+      std::memcpy(&crc_be, buf.data() + len, 4);
+      intact = fsx::transfer::crc32c(buf.data(), len) == ntohl(crc_be);
+    }
+    if (!intact) {
+      crc_errors.fetch_add(1, std::memory_order_relaxed);
+      log("FILE_CHUNK FAIL: crc32c mismatch transfer_id=" + std::to_string(transfer_id) + 
+          " chunk_index=" + std::to_string(chunk_index));
+      nack_chunk(session, chunk_index, fsx::protocol::NackReason::CORRUPT);
+      done();
+      return;
+    }
+  }
+  
+  // From here on buf holds the raw chunk. The wire form is kept for a dedup
+  // block, which is stored compressed.
+  PooledBuffer wire;
+  size_t wire_len = 0;
+  if (session->features & fsx::protocol::FILE_FEATURE_COMPRESS) {
+    PooledBuffer raw;
+    if (!inflate_chunk(*session, buf.data(), len, &raw)) {
+      log("FILE_CHUNK FAIL: bad compressed chunk transfer_id=" + std::to_string(transfer_id) + 
+          " chunk_index=" + std::to_string(chunk_index));
+      if (!nack_chunk(session, chunk_index, fsx::protocol::NackReason::CORRUPT)) {
+        transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+      }
+      done();
+      return;
+    }
+    wire = std::move(buf);
+    wire_len = len;
+    buf = std::move(raw);
+    len = buf.size();
+  }
+  
+  if (session->dedup) {
+    bool packed = wire && wire.data()[0] != static_cast<uint8_t>(fsx::compress::Codec::NONE);
+    if (packed) {
+      store_block(session, chunk_index, buf.data(), len,
+                  wire.data() + fsx::protocol::kChunkCodecHeader, wire_len - fsx::protocol::kChunkCodecHeader);
+    } else {
+      store_block(session, chunk_index, buf.data(), len);
+    }
+    done();
+    return;
+  }
+  wire.reset();
+  
+  // Checked on the raw chunk, before it is relayed or stored: every chunk
+  // but the last is exactly chunk_size bytes, and one that isn't would
+  // leave a gap (or run into its neighbour) yet still count as received
+  uint64_t offset = static_cast<uint64_t>(chunk_index) * session->chunk_size;
+  uint64_t expected = std::min<uint64_t>(session->chunk_size, session->file_size - offset);
+  if (len != expected) {
+    log("FILE_CHUNK FAIL: wrong chunk length transfer_id=" + std::to_string(transfer_id) + 
+        " chunk_index=" + std::to_string(chunk_index) + 
+        " bytes=" + std::to_string(len) + "/" + std::to_string(expected));
+    if (!nack_chunk(session, chunk_index, fsx::protocol::NackReason::CORRUPT)) {
+      transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+    }
+    done();
+    return;
+  }
+  
+  // Cut-through: the receiver asked for live chunks and is online
+  std::shared_ptr<TcpSession> receiver;
+  if (session->relay) {
+    receiver = session_manager_.get_session(session->receiver_token);
+    if (!receiver && !session->file_handle) {
+      log("FILE_CHUNK FAIL: relay receiver offline transfer_id=" + std::to_string(transfer_id));
+      transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+      done();
+      return;
+    }
+  }
+  
+  auto self = shared_from_this();
+  session->bytes_pending += len;
+  if (receiver) {
+    static auto& relayed_bytes = fsx::admin::Metrics::instance().counter("relay.bytes");
+    relayed_bytes.fetch_add(len, std::memory_order_relaxed);
+    relay_inflight_ += len;
+    receiver->relay_chunk(transfer_id, chunk_index, buf, len,
+      [this, self, transfer_id, len](bool delivered) {
+        // runs on the receiver's strand
+        boost::asio::post(socket_.get_executor(), [this, self, transfer_id, len, delivered]() {
+          on_relay_sent(transfer_id, len, delivered);
+        });
+      });
+    if (!session->file_handle) {
+      session->bytes_pending -= len;
+      if (session->digest) {
+        session->digest->add(static_cast<uint64_t>(chunk_index) * session->chunk_size, buf.data(), len);
+      }
+      std::function<void()> on_complete;
+      transfer_manager_.mark_chunk_received(transfer_id, chunk_index, len, &on_complete);
+      send_chunk_ack(*session);
+      watch_holes(transfer_manager_, session_manager_, session);
+      if (on_complete) on_complete();
+      relay_continue(std::move(done));
+      return;
+    }
+  }
+  
+  // Write chunk to file (completes on this strand). The next frame is read
+  // once the store has taken the chunk; with coalescing that comes before
+  // the chunk is stored (and acked), see read_more.
+  const uint8_t* data = buf.data();
+  bool relayed = receiver != nullptr;
+  std::function<void()> on_queued = [this, self, relayed, done = std::move(done)]() mutable {
+    if (relayed) {
+      relay_continue(std::move(done));
+      return;
+    }
+    done();
+  };
+  if (file_store_.write_policy().coalesce_bytes > 0 && !file_store_.uses_io_uring()) {
+    // One connection may interleave several uploads: another transfer's
+    // run is written out now rather than left waiting on its next chunk
+    if (staged_write_ && staged_write_ != session->file_handle) staged_write_->flush();
+    staged_write_ = session->file_handle;
+  }
+  file_store_.async_write_chunk(session->file_handle, chunk_index, data, len, socket_.get_executor(),
+    [this, self, session, transfer_id, chunk_index, len, buf = std::move(buf)](int64_t written) mutable {
+      if (written >= 0 && session->digest) {
+        session->digest->add(static_cast<uint64_t>(chunk_index) * session->chunk_size, buf.data(), len);
+      }
+      buf.reset();  // back to the pool before the next read
+      session->bytes_pending -= len;
+      if (written < 0) {
+        log("FILE_CHUNK FAIL: write error transfer_id=" + std::to_string(transfer_id) + 
+            " chunk_index=" + std::to_string(chunk_index));
+        if (!nack_chunk(session, chunk_index, fsx::protocol::NackReason::NOT_STORED)) {
+          transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+        }
+        return;
+      }
+      
+      // Mark chunk as received (a duplicate just rewrote the same bytes)
+      std::function<void()> on_complete;
+      bool fresh = transfer_manager_.mark_chunk_received(transfer_id, chunk_index, len, &on_complete);
+      
+      uint64_t total_received;
+      {
+        std::lock_guard<std::mutex> lock(session->mu);
+        total_received = session->bytes_received;
+      }
+      log(std::string(fresh ? "FILE_CHUNK_RX" : "FILE_CHUNK_DUP") + " transfer_id=" + std::to_string(transfer_id) + 
+          " chunk_index=" + std::to_string(chunk_index) + 
+          " bytes=" + std::to_string(len) + 
+          " total_received=" + std::to_string(total_received) + 
+          "/" + std::to_string(session->file_size));
+      send_chunk_ack(*session);
+      watch_holes(transfer_manager_, session_manager_, session);
+      if (on_complete) on_complete();
+    }, std::move(on_queued));
+}
+
+// FILE_FEATURE_COMPRESS chunk: u8 codec + u32 raw_len header, raw length
+// capped at chunk_size
+bool TcpSession::inflate_chunk(const fsx::transfer::TransferSession& session, const uint8_t* data,
+                               size_t len, PooledBuffer* raw_out) {
+  static auto& wire_bytes = fsx::admin::Metrics::instance().counter("compress.wire_bytes");
+  static auto& raw_bytes = fsx::admin::Metrics::instance().counter("compress.raw_bytes");
+  
+  if (len < fsx::protocol::kChunkCodecHeader) return false;
+  uint8_t codec = data[0];
+  uint32_t raw_be;
+  std::memcpy(&raw_be, data + 1, 4);
+  uint32_t raw = ntohl(raw_be);
+  // Only the granted codec (or none), and never more than a chunk: a small
+  // frame must not inflate into something huge
+  if ((codec != 0 && codec != session.codec) || raw == 0 || raw > session.chunk_size) return false;
+  
+  PooledBuffer out = BufferPool::acquire(raw);
+  if (!fsx::compress::decompress(static_cast<fsx::compress::Codec>(codec),
+                                 data + fsx::protocol::kChunkCodecHeader, len - fsx::protocol::kChunkCodecHeader,
+                                 out.data(), raw)) {
+    return false;
+  }
+  wire_bytes.fetch_add(len, std::memory_order_relaxed);
+  raw_bytes.fetch_add(raw, std::memory_order_relaxed);
+  *raw_out = std::move(out);
+  return true;
+}
+
+// Dedup chunk: must be exactly the block offered at this index. Hashing
+// and the block write run inline on this strand (a block is at most one
+// chunk, and most offered blocks never arrive at all).
+void TcpSession::store_block(const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                             uint32_t chunk_index, const uint8_t* data, size_t len,
+                             const uint8_t* packed, size_t packed_len) {
+  static auto& stored = fsx::admin::Metrics::instance().counter("dedup.bytes_stored");
+  static auto& saved = fsx::admin::Metrics::instance().counter("dedup.bytes_saved");
+  
+  uint64_t transfer_id = session->transfer_id;
+  const auto& block = session->blocks[chunk_index];
+  if (len != block.length || fsx::crypto::sha256(data, len) != block.id) {
+    log("FILE_CHUNK FAIL: block mismatch transfer_id=" + std::to_string(transfer_id) + 
+        " chunk_index=" + std::to_string(chunk_index) + 
+        " bytes=" + std::to_string(len) + "/" + std::to_string(block.length));
+    if (!nack_chunk(session, chunk_index, fsx::protocol::NackReason::CORRUPT)) {
+      transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+    }
+    return;
+  }
+  
+  bool created = false;
+  if (!transfer_manager_.block_store()->put(block.id, data, len, &created, session->codec,
+                                            packed, packed_len)) {
+    log("FILE_CHUNK FAIL: block write error transfer_id=" + std::to_string(transfer_id) + 
+        " chunk_index=" + std::to_string(chunk_index));
+    if (!nack_chunk(session, chunk_index, fsx::protocol::NackReason::NOT_STORED)) {
+      transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+    }
+    return;
+  }
+  (created ? stored : saved).fetch_add(len, std::memory_order_relaxed);
+  
+  // Each received chunk holds exactly one reference
+  std::function<void()> on_complete;
+  bool fresh = transfer_manager_.mark_chunk_received(transfer_id, chunk_index, len, &on_complete);
+  if (!fresh) transfer_manager_.block_store()->unref(block.id);
+  log(std::string(fresh ? "FILE_CHUNK_RX" : "FILE_CHUNK_DUP") + " transfer_id=" + std::to_string(transfer_id) + 
+      " chunk_index=" + std::to_string(chunk_index) + 
+      " bytes=" + std::to_string(len) + 
+      " block=" + (created ? "new" : "existing"));
+  send_chunk_ack(*session);
+  watch_holes(transfer_manager_, session_manager_, session);
+  if (on_complete) on_complete();
+}
+
+bool TcpSession::nack_chunk(const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                            uint32_t chunk_index, fsx::protocol::NackReason reason) {
+  if (!(session->features & fsx::protocol::FILE_FEATURE_NACK)) return false;
+  if (!transfer_manager_.count_nack(*session, chunk_index, 1)) {
+    log("RETRANSMIT FAIL: chunk asked for too often transfer_id=" + std::to_string(session->transfer_id) + 
+        " chunk_index=" + std::to_string(chunk_index));
+    transfer_manager_.update_state(session->transfer_id, fsx::transfer::TransferState::FAILED);
+    return true;
+  }
+  static auto& nacks = fsx::admin::Metrics::instance().counter("retransmit.nacks");
+  static auto& requested = fsx::admin::Metrics::instance().counter("retransmit.chunks_requested");
+  nacks.fetch_add(1, std::memory_order_relaxed);
+  requested.fetch_add(1, std::memory_order_relaxed);
+  fsx::protocol::FileNack nack;
+  nack.transfer_id = session->transfer_id;
+  nack.reason = reason;
+  nack.ranges.push_back({chunk_index, 1});
+  send(fsx::protocol::MsgType::FILE_NACK, nack.serialize());
+  return true;
+}
+
+void TcpSession::watch_holes(transfer::TransferManager& transfers, SessionManager& sessions,
+                             const std::shared_ptr<fsx::transfer::TransferSession>& session) {
+  auto* wheel = transfers.timing_wheel();
+  if (!wheel || !(session->features & fsx::protocol::FILE_FEATURE_NACK)) return;
+  
+  std::lock_guard<std::mutex> lock(session->mu);
+  if (session->nack_timer != 0) return;
+  bool holes = session->on_complete ? !session->received.all()
+                                    : session->expected_chunk_index < session->received_end;
+  if (!holes) return;
+  const auto& policy = transfers.retransmit_policy();
+  auto delay = policy.timeout * (1u << std::min(session->nack_round, policy.max_backoff_shift));
+  std::weak_ptr<fsx::transfer::TransferSession> weak = session;
+  session->nack_timer = wheel->schedule(delay, [&transfers, &sessions, weak]() {
+    on_hole_timer(transfers, sessions, weak);
+  });
+}
+
+void TcpSession::on_hole_timer(transfer::TransferManager& transfers, SessionManager& sessions,
+                               const std::weak_ptr<fsx::transfer::TransferSession>& weak) {
+  static auto& timeouts = fsx::admin::Metrics::instance().counter("retransmit.timeouts");
+  static auto& nacks = fsx::admin::Metrics::instance().counter("retransmit.nacks");
+  static auto& requested = fsx::admin::Metrics::instance().counter("retransmit.chunks_requested");
+  
+  auto session = weak.lock();
+  if (!session) return;
+  std::string token;
+  {
+    std::lock_guard<std::mutex> lock(session->mu);
+    session->nack_timer = 0;
+    token = session->chunk_token;
+  }
+  auto state = session->state.load();
+  if (state != fsx::transfer::TransferState::ACCEPTED &&
+      state != fsx::transfer::TransferState::RECEIVING) {
     return;
   }
   
+  auto ranges = transfers.missing_ranges(*session, fsx::protocol::FileNack::kMaxRanges);
+  if (ranges.empty()) return;
+  timeouts.fetch_add(1, std::memory_order_relaxed);
+  
+  fsx::protocol::FileNack nack;
+  nack.transfer_id = session->transfer_id;
+  nack.reason = fsx::protocol::NackReason::MISSING;
+  uint64_t chunks = 0;
+  bool give_up = false;
+  for (const auto& [first, count] : ranges) {
+    give_up = !transfers.count_nack(*session, first, count) || give_up;
+    nack.ranges.push_back({first, count});
+    chunks += count;
+  }
+  if (give_up) {
+    log("RETRANSMIT FAIL: transfer_id=" + std::to_string(session->transfer_id) +
+        " chunks still missing after " + std::to_string(transfers.retransmit_policy().max_attempts) +
+        " NACKs");
+    transfers.update_state(session->transfer_id, fsx::transfer::TransferState::FAILED);
+    return;
+  }
+  
+  // No connection to ask (sender gone): keep waiting, it may come back with
+  // FILE_RESUME_REQ
+  if (auto sender = sessions.get_session(token)) {
+    nacks.fetch_add(1, std::memory_order_relaxed);
+    requested.fetch_add(chunks, std::memory_order_relaxed);
+    sender->send(fsx::protocol::MsgType::FILE_NACK, nack.serialize());
+  }
+  {
+    std::lock_guard<std::mutex> lock(session->mu);
+    session->nack_round++;
+  }
+  watch_holes(transfers, sessions, session);
+}
+
+void TcpSession::send_chunk_ack(const fsx::transfer::TransferSession& session) {
+  if (!(session.features & fsx::protocol::FILE_FEATURE_ACK)) return;
+  
+  // Chunks still being written or queued at a relay receiver eat into the
+  // window. It never closes below one chunk: no window update is sent
+  // later, so a closed window would stall an idle sender for good
+  // (backpressure beyond that is the paused socket read).
+  uint64_t used = session.bytes_pending + relay_inflight_;
+  uint64_t window = used >= session.window_bytes ? 0 : session.window_bytes - used;
+  fsx::protocol::FileChunkAck ack;
+  ack.transfer_id = session.transfer_id;
+  transfer_manager_.ack_state(session, &ack.cumulative_ack, &ack.sack,
+                              fsx::protocol::FileChunkAck::kMaxSackBytes);
+  ack.window_bytes = static_cast<uint32_t>(std::max<uint64_t>(window, session.chunk_size));
+  send(fsx::protocol::MsgType::FILE_CHUNK_ACK, ack.serialize());
+}
+
+void TcpSession::relay_continue(std::function<void()> done) {
+  if (relay_inflight_ >= kRelayWindow) {
+    relay_resume_ = std::move(done);
+    return;
+  }
+  done();
+}
+
+void TcpSession::on_relay_sent(uint64_t transfer_id, size_t len, bool delivered) {
+  relay_inflight_ -= len;
+  if (!delivered) {
+    auto session = transfer_manager_.get_transfer(transfer_id);
+    // With a tee the file is still complete on disk; without one it's lost
+    if (session && !session->file_handle &&
+        session->state != fsx::transfer::TransferState::FAILED) {
+      log("RELAY FAIL: receiver dropped transfer_id=" + std::to_string(transfer_id));
+      transfer_manager_.update_state(transfer_id, fsx::transfer::TransferState::FAILED);
+    }
+  }
+  if (relay_resume_ && relay_inflight_ < kRelayWindow) {
+    auto resume = std::move(relay_resume_);
+    relay_resume_ = nullptr;
+    resume();
+  }
+}
+
+void TcpSession::relay_chunk(uint64_t transfer_id, uint32_t chunk_index, PooledBuffer buf, size_t len,
+                             std::function<void(bool)> on_sent) {
+  auto self = shared_from_this();
+  boost::asio::dispatch(socket_.get_executor(),
+    [this, self, transfer_id, chunk_index, buf = std::move(buf), len, on_sent = std::move(on_sent)]() mutable {
+      if (write_failed_) {
+        on_sent(false);
+        return;
+      }
+      
+      // frame header + u64 transfer_id + u32 chunk_index; data is the sender's buffer
+      OutFrame f;
+      f.set_chunk_header(transfer_id, chunk_index, len);
+      f.shared = std::move(buf);
+      f.shared_len = len;
+      f.on_sent = std::move(on_sent);
+      
+      bool writing = !outq_.empty();
+      outq_.push_back(std::move(f));
+      if (!writing) do_write();
+    });
+}
+
+void TcpSession::handle_file_done(std::span<const uint8_t> payload) {
   try {
-    fsx::protocol::FileChunk chunk = fsx::protocol::FileChunk::deserialize(payload);
-    log("FILE_CHUNK deserialized: transfer_id=" + std::to_string(chunk.transfer_id) + 
-        " chunk_index=" + std::to_string(chunk.chunk_index) + 
-        " data_size=" + std::to_string(chunk.data.size()));
+    fsx::protocol::FileDone done = fsx::protocol::FileDone::deserialize(payload);
     
-    auto session = transfer_manager_.get_transfer(chunk.transfer_id);
+    auto session = transfer_manager_.get_transfer(done.transfer_id);
     if (!session) {
-      log("FILE_CHUNK FAIL: transfer not found transfer_id=" + std::to_string(chunk.transfer_id));
+      log("FILE_DONE FAIL: transfer not found transfer_id=" + std::to_string(done.transfer_id));
       return;
     }
     
     // Check if sender is correct
     if (session->sender_user_id != user_id_) {
-      log("FILE_CHUNK FAIL: not the sender transfer_id=" + std::to_string(chunk.transfer_id));
+      log("FILE_DONE FAIL: not the sender transfer_id=" + std::to_string(done.transfer_id));
       return;
     }
     
-    // Check state
-    if (session->state != fsx::transfer::TransferState::ACCEPTED && 
-        session->state != fsx::transfer::TransferState::RECEIVING) {
-      log("FILE_CHUNK FAIL: invalid state transfer_id=" + std::to_string(chunk.transfer_id) + 
-          " state=" + std::to_string(static_cast<int>(session->state)));
+    if (session->state == fsx::transfer::TransferState::FAILED) {
+      on_file_finalized(done, session, false);
       return;
     }
     
-    // Write chunk to file
-    int64_t written = file_store_.write_chunk(session->file_handle, chunk.data.data(), chunk.data.size());
-    if (written < 0) {
-      log("FILE_CHUNK FAIL: write error transfer_id=" + std::to_string(chunk.transfer_id) + 
-          " chunk_index=" + std::to_string(chunk.chunk_index));
-      transfer_manager_.update_state(chunk.transfer_id, fsx::transfer::TransferState::FAILED);
-      return;
-    }
+    // Chunks still staged for a coalesced write are stored (and counted)
+    // only once written
+    if (session->file_handle) session->file_handle->flush();
     
-    // Mark chunk as received
-    transfer_manager_.mark_chunk_received(chunk.transfer_id, chunk.chunk_index, chunk.data.size());
+    auto self = shared_from_this();
+    auto finalize = [this, self, done, session]() {
+      if (session->dedup) {
+        // The blocks are stored; the manifest makes them this file
+        bool sync = file_store_.write_policy().durability != fsx::storage::Durability::None;
+        on_file_finalized(done, session,
+                          session->state != fsx::transfer::TransferState::FAILED &&
+                          transfer_manager_.block_store()->write_manifest(session->final_file_path,
+                                                                          session->blocks, sync));
+        return;
+      }
+      if (!session->file_handle) {
+        // Pure relay: every chunk already went to the receiver
+        on_file_finalized(done, session,
+                          session->relay && session->state != fsx::transfer::TransferState::FAILED);
+        return;
+      }
+      // Finalize file (fsync + rename may complete asynchronously)
+      file_store_.async_finalize_file(done.transfer_id, session->filename, session->file_handle,
+                                      socket_.get_executor(),
+        [this, self, done, session](bool success) { on_file_finalized(done, session, success); });
+    };
     
-    log("FILE_CHUNK_RX transfer_id=" + std::to_string(chunk.transfer_id) + 
-        " chunk_index=" + std::to_string(chunk.chunk_index) + 
-        " bytes=" + std::to_string(chunk.data.size()) + 
-        " total_received=" + std::to_string(session->bytes_received) + 
-        "/" + std::to_string(session->file_size));
+    // With striping, other connections may still have chunks in flight: the
+    // one that stores the last chunk hands finalize back to this strand
+    bool complete = transfer_manager_.complete_or_defer(*session,
+      [this, self, finalize]() { boost::asio::post(socket_.get_executor(), finalize); });
+    if (!complete) {
+      log("FILE_DONE waiting for chunks transfer_id=" + std::to_string(done.transfer_id));
+      watch_holes(transfer_manager_, session_manager_, session);
+      return;
+    }
+    finalize();
     
   } catch (const std::exception& e) {
-    log("FILE_CHUNK error: " + std::string(e.what()));
+    log("FILE_DONE error: " + std::string(e.what()));
   }
 }
 
-void TcpSession::handle_file_done(const std::vector<uint8_t>& payload) {
-  if (!is_authenticated()) {
-    log("FILE_DONE rejected: not authenticated");
+void TcpSession::on_file_finalized(const fsx::protocol::FileDone& done,
+                                   const std::shared_ptr<fsx::transfer::TransferSession>& session,
+                                   bool success) {
+  if (!success) {
+    log("FILE_DONE FAIL: failed to finalize file transfer_id=" + std::to_string(done.transfer_id));
+    transfer_manager_.update_state(done.transfer_id, fsx::transfer::TransferState::FAILED);
+    
+    fsx::protocol::FileResult result;
+    result.transfer_id = done.transfer_id;
+    result.ok = false;
+    result.path_or_reason = "Failed to finalize file";
+    send(fsx::protocol::MsgType::FILE_RESULT, result.serialize());
     return;
   }
   
+  if (session->digest) {
+    // Usually everything was hashed on arrival; out-of-order leftovers are
+    // read back from the finished file
+    static auto& reread_bytes = fsx::admin::Metrics::instance().counter("integrity.digest_reread_bytes");
+    int fd = session->file_handle ? ::open(session->final_file_path.c_str(), O_RDONLY | O_CLOEXEC) : -1;
+    uint64_t reread = 0;
+    session->has_sha256 = session->digest->finish(fd, session->file_size, &session->sha256, &reread);
+    if (fd >= 0) ::close(fd);
+    session->digest.reset();
+    reread_bytes.fetch_add(reread, std::memory_order_relaxed);
+    if (!session->has_sha256) {
+      log("FILE_DONE: no digest for transfer_id=" + std::to_string(done.transfer_id));
+    }
+  }
+  transfer_manager_.update_state(done.transfer_id, fsx::transfer::TransferState::COMPLETED);
+  if (session->dedup) {
+    // logical bytes per stored byte, x1000, across all deduplicated files
+    static auto& offered = fsx::admin::Metrics::instance().counter("dedup.bytes_offered");
+    static auto& ratio = fsx::admin::Metrics::instance().counter("dedup.ratio_x1000");
+    uint64_t stored = transfer_manager_.block_store()->stored_bytes();
+    if (stored > 0) ratio.store(offered.load(std::memory_order_relaxed) * 1000 / stored, std::memory_order_relaxed);
+  }
+  
+  log("FILE_DONE_OK transfer_id=" + std::to_string(done.transfer_id) + 
+      " filename=" + session->filename + 
+      " total_chunks=" + std::to_string(done.total_chunks) + 
+      " file_size=" + std::to_string(done.file_size) + 
+      " saved_path=" + session->final_file_path + 
+      (session->has_sha256 ? " sha256=" + fsx::crypto::to_hex(session->sha256) : ""));
+  
+  // Relay: FILE_DONE queues behind the chunks already forwarded
+  if (session->relay) {
+    if (auto receiver = session_manager_.get_session(session->receiver_token)) {
+      receiver->send(fsx::protocol::MsgType::FILE_DONE, done.serialize());
+    }
+  }
+  
+  fsx::protocol::FileResult result;
+  result.transfer_id = done.transfer_id;
+  result.ok = true;
+  result.path_or_reason = session->file_handle || session->dedup ? session->final_file_path : "relayed";
+  result.has_sha256 = session->has_sha256;
+  result.sha256 = session->sha256;
+  send(fsx::protocol::MsgType::FILE_RESULT, result.serialize());
+}
+
+void TcpSession::handle_file_resume_req(std::span<const uint8_t> payload) {
+  fsx::protocol::FileResumeResp resp;
+  auto reject = [&](const std::string& reason) {
+    log("FILE_RESUME_REQ FAIL: " + reason + " transfer_id=" + std::to_string(resp.transfer_id));
+    resp.ok = false;
+    resp.reason = reason;
+    send(fsx::protocol::MsgType::FILE_RESUME_RESP, resp.serialize());
+  };
+
   try {
-    fsx::protocol::FileDone done = fsx::protocol::FileDone::deserialize(payload);
+    fsx::protocol::FileResumeReq req = fsx::protocol::FileResumeReq::deserialize(payload);
+    resp.transfer_id = req.transfer_id;
     
-    auto session = transfer_manager_.get_transfer(done.transfer_id);
+    auto session = transfer_manager_.get_transfer(req.transfer_id);
     if (!session) {
-      log("FILE_DONE FAIL: transfer not found transfer_id=" + std::to_string(done.transfer_id));
+      reject("Transfer not found");
       return;
     }
-    
-    // Check if sender is correct
     if (session->sender_user_id != user_id_) {
-      log("FILE_DONE FAIL: not the sender transfer_id=" + std::to_string(done.transfer_id));
+      reject("Not the sender");
+      return;
+    }
+    if (session->state != fsx::transfer::TransferState::ACCEPTED &&
+        session->state != fsx::transfer::TransferState::RECEIVING) {
+      reject("Transfer not in progress");
+      return;
+    }
+    // A relay without tee kept nothing the sender could skip
+    if (!session->file_handle && !session->dedup) {
+      reject("Transfer not resumable");
       return;
     }
     
-    // Finalize file
-    bool success = file_store_.finalize_file(done.transfer_id, session->filename, session->file_handle);
-    if (!success) {
-      log("FILE_DONE FAIL: failed to finalize file transfer_id=" + std::to_string(done.transfer_id));
-      transfer_manager_.update_state(done.transfer_id, fsx::transfer::TransferState::FAILED);
-      
-      fsx::protocol::FileResult result;
-      result.transfer_id = done.transfer_id;
-      result.ok = false;
-      result.path_or_reason = "Failed to finalize file";
-      send(fsx::protocol::MsgType::FILE_RESULT, result.serialize());
+    resp.ok = true;
+    resp.file_size = session->file_size;
+    resp.chunk_size = session->chunk_size;
+    resp.total_chunks = session->total_chunks;
+    resp.features = session->features;
+    resp.window_bytes = session->window_bytes;
+    resp.codec = session->codec;
+    uint64_t skipped_bytes;
+    {
+      std::lock_guard<std::mutex> lock(session->mu);
+      const auto& received = session->received;
+      uint32_t i = received.next_set(0);
+      while (i < received.size() && resp.ranges.size() < fsx::protocol::FileResumeResp::kMaxRanges) {
+        uint32_t end = received.next_unset(i);
+        resp.ranges.push_back({i, end - i});
+        i = received.next_set(end);
+      }
+      skipped_bytes = session->bytes_received;
+    }
+    
+    static auto& resumed = fsx::admin::Metrics::instance().counter("transfer.resumed");
+    static auto& resume_skipped = fsx::admin::Metrics::instance().counter("transfer.resume_skipped_bytes");
+    resumed.fetch_add(1, std::memory_order_relaxed);
+    resume_skipped.fetch_add(skipped_bytes, std::memory_order_relaxed);
+    
+    log("FILE_RESUME_OK transfer_id=" + std::to_string(req.transfer_id) + 
+        " sender=" + username_ + 
+        " ranges=" + std::to_string(resp.ranges.size()) + 
+        " have=" + std::to_string(skipped_bytes) + "/" + std::to_string(session->file_size));
+    send(fsx::protocol::MsgType::FILE_RESUME_RESP, resp.serialize());
+    
+  } catch (const std::exception& e) {
+    reject(std::string("error: ") + e.what());
+  }
+}
+
+void TcpSession::handle_file_fetch_req(std::span<const uint8_t> payload) {
+  fsx::protocol::FileFetchResp resp;
+  auto reject = [&](const std::string& reason) {
+    log("FILE_FETCH_REQ FAIL: " + reason + " transfer_id=" + std::to_string(resp.transfer_id));
+    resp.ok = false;
+    resp.reason = reason;
+    send(fsx::protocol::MsgType::FILE_FETCH_RESP, resp.serialize());
+  };
+
+  try {
+    fsx::protocol::FileFetchReq req = fsx::protocol::FileFetchReq::deserialize(payload);
+    resp.transfer_id = req.transfer_id;
+    
+    auto session = transfer_manager_.get_transfer(req.transfer_id);
+    if (!session) {
+      reject("Transfer not found");
+      return;
+    }
+    if (session->receiver_user_id != user_id_) {
+      reject("Not the receiver");
+      return;
+    }
+    if (session->state != fsx::transfer::TransferState::COMPLETED) {
+      reject("Transfer not completed");
       return;
     }
     
-      transfer_manager_.update_state(done.transfer_id, fsx::transfer::TransferState::COMPLETED);
+    auto stream = std::make_shared<FetchStream>();
+    if (session->dedup) {
+      // Blocks are at most chunk_size each; they go out in order
+      stream->transfer_id = req.transfer_id;
+      stream->file_size = session->file_size;
+      stream->chunk_size = session->chunk_size;
+      stream->blocks = session->blocks;
+      stream->total_chunks = static_cast<uint32_t>(stream->blocks.size());
+    } else {
+      stream->fd = ::open(session->final_file_path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat st;
+      if (stream->fd < 0 || ::fstat(stream->fd, &st) != 0) {
+        reject("Failed to open file");
+        return;
+      }
+      stream->transfer_id = req.transfer_id;
+      stream->file_size = static_cast<uint64_t>(st.st_size);
+      stream->chunk_size = session->chunk_size ? session->chunk_size : 64 * 1024;
+      stream->total_chunks = static_cast<uint32_t>((stream->file_size + stream->chunk_size - 1) / stream->chunk_size);
+    }
     
-    log("FILE_DONE_OK transfer_id=" + std::to_string(done.transfer_id) + 
-        " filename=" + session->filename + 
-        " total_chunks=" + std::to_string(done.total_chunks) + 
-        " file_size=" + std::to_string(done.file_size) + 
-        " saved_path=" + session->final_file_path);
+    resp.ok = true;
+    resp.file_size = stream->file_size;
+    resp.chunk_size = stream->chunk_size;
+    resp.total_chunks = stream->total_chunks;
+    resp.filename = session->filename;
+    resp.has_sha256 = session->has_sha256;
+    resp.sha256 = session->sha256;
     
-    fsx::protocol::FileResult result;
-    result.transfer_id = done.transfer_id;
-    result.ok = true;
-    result.path_or_reason = session->final_file_path;
-    send(fsx::protocol::MsgType::FILE_RESULT, result.serialize());
+    log("FILE_FETCH_OK transfer_id=" + std::to_string(req.transfer_id) + 
+        " receiver=" + username_ + 
+        " file_size=" + std::to_string(stream->file_size) + 
+        " chunks=" + std::to_string(stream->total_chunks));
+    
+    // We're on the strand, so send() queues the response right away and the
+    // chunks land behind it
+    send(fsx::protocol::MsgType::FILE_FETCH_RESP, resp.serialize());
+    bool writing = !outq_.empty();
+    fetches_.push_back(std::move(stream));
+    pump_fetches();
+    if (!writing && !outq_.empty()) do_write();
     
   } catch (const std::exception& e) {
-    log("FILE_DONE error: " + std::string(e.what()));
+    reject(std::string("error: ") + e.what());
   }
 }
 
@@ -0,0 +1,280 @@
+#include "fsx/storage/block_store.h"
+#include "fsx/compress/chunk_codec.h"
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace fsx::storage {
+
+namespace fs = std::filesystem;
+
+BlockStore::BlockStore(std::string base_path) : base_path_(std::move(base_path)) {}
+
+std::string BlockStore::block_path(const BlockId& id) const {
+  std::string hex = fsx::crypto::to_hex(id);
+  return base_path_ + "/" + hex.substr(0, 2) + "/" + hex;
+}
+
+bool BlockStore::initialize(const std::string& manifests_root) {
+  std::error_code ec;
+  fs::create_directories(base_path_, ec);
+  if (ec) {
+    std::cerr << "[BlockStore] Failed to create " << base_path_ << ": " << ec.message() << "\n";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  blocks_.clear();
+  stored_bytes_ = 0;
+
+  // Every stored block, unreferenced for now; leftover temp files go
+  for (fs::recursive_directory_iterator it(base_path_, ec), end; !ec && it != end; it.increment(ec)) {
+    if (!it->is_regular_file()) continue;
+    std::string name = it->path().filename().string();
+    BlockId id;
+    if (!fsx::crypto::from_hex(name, &id)) {
+      if (name.find(".tmp.") != std::string::npos) fs::remove(it->path(), ec);
+      continue;
+    }
+    blocks_[id].length = static_cast<uint32_t>(it->file_size());
+  }
+
+  size_t manifests = 0;
+  size_t missing = 0;
+  for (fs::directory_iterator dir(manifests_root, ec), end; !ec && dir != end; dir.increment(ec)) {
+    if (!dir->is_directory()) continue;
+    std::error_code ec2;
+    for (const auto& f : fs::directory_iterator(dir->path(), ec2)) {
+      if (f.path().extension() != ".manifest") continue;
+      std::vector<BlockRef> refs;
+      if (!read_manifest(f.path().string(), &refs)) continue;
+      manifests++;
+      for (const auto& r : refs) {
+        auto b = blocks_.find(r.id);
+        if (b == blocks_.end()) {
+          missing++;
+          continue;
+        }
+        b->second.refs++;
+      }
+    }
+  }
+
+  size_t orphans = 0;
+  for (auto it = blocks_.begin(); it != blocks_.end();) {
+    if (it->second.refs == 0) {
+      ::unlink(block_path(it->first).c_str());
+      it = blocks_.erase(it);
+      orphans++;
+      continue;
+    }
+    stored_bytes_ += it->second.length;
+    ++it;
+  }
+
+  std::cout << "[BlockStore] " << blocks_.size() << " blocks (" << stored_bytes_ << " bytes) from "
+            << manifests << " manifests, removed " << orphans << " unreferenced";
+  if (missing > 0) std::cout << ", " << missing << " referenced blocks MISSING";
+  std::cout << "\n";
+  return true;
+}
+
+bool BlockStore::ref_if_present(const BlockId& id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = blocks_.find(id);
+  if (it == blocks_.end()) return false;
+  it->second.refs++;
+  return true;
+}
+
+bool BlockStore::put(const BlockId& id, const void* data, size_t len, bool* created,
+                     uint8_t codec, const void* packed, size_t packed_len) {
+  if (created) *created = false;
+  if (ref_if_present(id)) return true;
+
+  std::string path = block_path(id);
+  std::string tmp;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    tmp = path + ".tmp." + std::to_string(++tmp_seq_);
+  }
+  std::error_code ec;
+  fs::create_directories(fs::path(path).parent_path(), ec);
+
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[BlockStore] Failed to create " << tmp << " (errno: " << errno << ")\n";
+    return false;
+  }
+  // Packed: the codec byte, then the compressed block. Readers tell the two
+  // apart by file size alone, so a packed copy that isn't strictly shorter
+  // than the block is dropped for the raw one
+  if (packed && 1 + packed_len >= len) packed = nullptr;
+  iovec iov[2];
+  int iovcnt = 0;
+  if (packed) {
+    iov[iovcnt++] = {&codec, 1};
+    iov[iovcnt++] = {const_cast<void*>(packed), packed_len};
+  } else {
+    iov[iovcnt++] = {const_cast<void*>(data), len};
+  }
+  size_t on_disk = packed ? 1 + packed_len : len;
+  int i = 0;
+  while (i < iovcnt) {
+    ssize_t n = ::writev(fd, iov + i, iovcnt - i);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[BlockStore] write failed: " << tmp << " (errno: " << errno << ")\n";
+      ::close(fd);
+      ::unlink(tmp.c_str());
+      return false;
+    }
+    size_t done = static_cast<size_t>(n);
+    while (i < iovcnt && done >= iov[i].iov_len) done -= iov[i++].iov_len;
+    if (i < iovcnt) {
+      iov[i].iov_base = static_cast<uint8_t*>(iov[i].iov_base) + done;
+      iov[i].iov_len -= done;
+    }
+  }
+  ::close(fd);
+
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = blocks_.find(id);
+  if (it != blocks_.end()) {
+    // Stored by someone else while we were writing
+    ::unlink(tmp.c_str());
+    it->second.refs++;
+    return true;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::cerr << "[BlockStore] rename failed: " << path << " (errno: " << errno << ")\n";
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  blocks_[id] = Entry{1, static_cast<uint32_t>(on_disk)};
+  stored_bytes_ += on_disk;
+  if (created) *created = true;
+  return true;
+}
+
+void BlockStore::unref(const BlockId& id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = blocks_.find(id);
+  if (it == blocks_.end()) return;
+  if (--it->second.refs > 0) return;
+  ::unlink(block_path(id).c_str());
+  stored_bytes_ -= it->second.length;
+  blocks_.erase(it);
+}
+
+int BlockStore::open_block(const BlockId& id) const {
+  return ::open(block_path(id).c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+bool BlockStore::is_packed(int fd, uint32_t length) {
+  struct stat st;
+  return ::fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) != length;
+}
+
+bool BlockStore::read_block(const BlockId& id, uint32_t length, std::vector<uint8_t>* out) const {
+  int fd = open_block(id);
+  if (fd < 0) return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  std::vector<uint8_t> file(static_cast<size_t>(st.st_size));
+  size_t got = 0;
+  while (got < file.size()) {
+    ssize_t n = ::pread(fd, file.data() + got, file.size() - got, static_cast<off_t>(got));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    got += static_cast<size_t>(n);
+  }
+  ::close(fd);
+  if (got != file.size()) return false;
+  if (file.size() == length) {
+    *out = std::move(file);
+    return true;
+  }
+  if (file.empty()) return false;
+  out->resize(length);
+  return fsx::compress::decompress(static_cast<fsx::compress::Codec>(file[0]), file.data() + 1,
+                                   file.size() - 1, out->data(), length);
+}
+
+bool BlockStore::write_manifest(const std::string& path, const std::vector<BlockRef>& blocks, bool sync) {
+  if (sync) {
+    int dir = ::open(base_path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+      ::syncfs(dir);
+      ::close(dir);
+    }
+  }
+
+  std::error_code ec;
+  fs::create_directories(fs::path(path).parent_path(), ec);
+  std::ostringstream oss;
+  for (const auto& b : blocks) oss << fsx::crypto::to_hex(b.id) << " " << b.length << "\n";
+
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << oss.str();
+    out.flush();
+    if (!out) {
+      std::cerr << "[BlockStore] Failed to write manifest " << tmp << "\n";
+      return false;
+    }
+  }
+  if (sync) {
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      ::fdatasync(fd);
+      ::close(fd);
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::cerr << "[BlockStore] rename failed for manifest " << path << " (errno: " << errno << ")\n";
+    return false;
+  }
+  return true;
+}
+
+bool BlockStore::read_manifest(const std::string& path, std::vector<BlockRef>* blocks) {
+  std::ifstream in(path);
+  if (!in) return false;
+  blocks->clear();
+  std::string hex;
+  uint64_t length;
+  while (in >> hex >> length) {
+    BlockRef r;
+    if (!fsx::crypto::from_hex(hex, &r.id) || length == 0 || length > UINT32_MAX) {
+      std::cerr << "[BlockStore] Malformed manifest " << path << "\n";
+      return false;
+    }
+    r.length = static_cast<uint32_t>(length);
+    blocks->push_back(r);
+  }
+  return in.eof();
+}
+
+size_t BlockStore::block_count() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return blocks_.size();
+}
+
+uint64_t BlockStore::stored_bytes() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return stored_bytes_;
+}
+
+} // namespace fsx::storage
@@ -1,4 +1,5 @@
 #include "fsx/storage/file_store.h"
+#include "fsx/storage/io_uring_engine.h"
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
@@ -18,8 +19,8 @@
 
 namespace fsx::storage {
 
-FileStore::FileStore(const std::string& base_storage_path)
-  : base_path_(base_storage_path) {
+FileStore::FileStore(const std::string& base_storage_path, WritePolicy policy)
+  : base_path_(base_storage_path), policy_(policy) {
 }
 
 FileStore::~FileStore() {
@@ -29,6 +30,23 @@ bool FileStore::initialize() {
   return ensure_directory(base_path_);
 }
 
+bool FileStore::enable_io_uring(boost::asio::io_context& io, unsigned entries) {
+#ifdef FSX_HAVE_IO_URING
+  try {
+    uring_ = std::make_shared<IoUringEngine>(io, entries);
+    return true;
+  } catch (const std::exception& e) {
+    std::cerr << "[FileStore] io_uring unavailable, using blocking writes: " << e.what() << "\n";
+    return false;
+  }
+#else
+  (void)io;
+  (void)entries;
+  std::cerr << "[FileStore] built without FSX_WITH_IO_URING, using blocking writes\n";
+  return false;
+#endif
+}
+
 bool FileStore::ensure_directory(const std::string& path) {
   try {
     std::filesystem::create_directories(path);
@@ -49,7 +67,9 @@ bool FileStore::ensure_directory(const std::string& path) {
   }
 }
 
-void* FileStore::open_for_write(uint64_t transfer_id, const std::string& filename) {
+std::shared_ptr<WriteHandle> FileStore::open_for_write(uint64_t transfer_id, const std::string& filename,
+                                                       uint64_t file_size, uint32_t chunk_size,
+                                                       bool resume) {
   std::string temp_path = get_temp_path(transfer_id, filename);
   
   // Ensure transfer directory exists
@@ -60,51 +80,23 @@ void* FileStore::open_for_write(uint64_t transfer_id, const std::string& filenam
     return nullptr;
   }
   
-  // Open file in binary write mode
-  FILE* f = fopen(temp_path.c_str(), "wb");
-  if (!f) {
-    std::cerr << "[FileStore] Failed to open file for writing: " << temp_path << " (errno: " << errno << ")\n";
-    std::cerr.flush();
-    return nullptr;
-  }
+  auto handle = WriteHandle::open(temp_path, file_size, chunk_size, policy_, resume);
+  if (!handle) return nullptr;
   
   std::cout << "[FileStore] Opened file for writing: " << temp_path << "\n";
   std::cout.flush();
-  return reinterpret_cast<void*>(f);
+  return handle;
 }
 
-int64_t FileStore::write_chunk(void* file_handle, const void* data, size_t len) {
-  if (!file_handle || !data || len == 0) {
-    std::cerr << "[FileStore] write_chunk: invalid parameters (handle=" << file_handle << " data=" << data << " len=" << len << ")\n";
-    std::cerr.flush();
-    return -1;
-  }
-  
-  FILE* f = reinterpret_cast<FILE*>(file_handle);
-  size_t written = fwrite(data, 1, len, f);
-  if (written != len) {
-    std::cerr << "[FileStore] write_chunk: partial write (written=" << written << " expected=" << len << " errno=" << errno << ")\n";
-    std::cerr.flush();
-    return -1;
-  }
-  
-  // Flush to ensure data is written
-  if (fflush(f) != 0) {
-    std::cerr << "[FileStore] write_chunk: fflush failed (errno=" << errno << ")\n";
-    std::cerr.flush();
-  }
-  
-  return static_cast<int64_t>(written);
+int64_t FileStore::write_chunk(WriteHandle& handle, uint32_t chunk_index, const void* data, size_t len) {
+  return handle.write_chunk(chunk_index, data, len);
 }
 
-bool FileStore::finalize_file(uint64_t transfer_id, const std::string& filename, void* file_handle) {
-  if (!file_handle) {
+bool FileStore::finalize_file(uint64_t transfer_id, const std::string& filename, WriteHandle& handle) {
+  if (!handle.close()) {
     return false;
   }
   
-  FILE* f = reinterpret_cast<FILE*>(file_handle);
-  fclose(f);
-  
   std::string temp_path = get_temp_path(transfer_id, filename);
   std::string final_path = get_file_path(transfer_id, filename);
   
@@ -116,6 +108,102 @@ bool FileStore::finalize_file(uint64_t transfer_id, const std::string& filename,
   return true;
 }
 
+void FileStore::async_write_chunk(std::shared_ptr<WriteHandle> handle, uint32_t chunk_index,
+                                  const void* data, size_t len,
+                                  boost::asio::any_io_executor ex, WriteCallback cb,
+                                  std::function<void()> on_queued) {
+  if (!uring_ && data && handle->policy().coalesce_bytes > 0) {
+    // Coalescing: cb follows the run (maybe written by another strand's
+    // chunk), the caller goes on as soon as this chunk is copied into it
+    handle->write_chunk(chunk_index, data, len, [ex, len, cb = std::move(cb)](bool stored) mutable {
+      boost::asio::dispatch(ex, [len, stored, cb = std::move(cb)]() { cb(stored ? static_cast<int64_t>(len) : -1); });
+    });
+    if (on_queued) boost::asio::dispatch(ex, std::move(on_queued));
+    return;
+  }
+
+  auto finish = [cb = std::move(cb), on_queued = std::move(on_queued)](int64_t written) mutable {
+    cb(written);
+    if (on_queued) on_queued();
+  };
+#ifdef FSX_HAVE_IO_URING
+  if (uring_) {
+    uint64_t offset;
+    if (!data || !handle->check_chunk(chunk_index, len, &offset)) {
+      boost::asio::dispatch(ex, [finish = std::move(finish)]() mutable { finish(-1); });
+      return;
+    }
+    int fd = handle->fd();
+    auto uring = uring_;
+    uring_->write(fd, data, len, offset, ex,
+      [uring, handle, offset, len, ex, finish = std::move(finish)](int res) mutable {
+        if (res < 0 || static_cast<size_t>(res) != len) {
+          std::cerr << "[FileStore] io_uring write failed: " << handle->path()
+                    << " (res: " << res << ")\n";
+          finish(-1);
+          return;
+        }
+        handle->note_written(offset, len);
+        if (!handle->sync_due()) {
+          finish(static_cast<int64_t>(len));
+          return;
+        }
+        auto bits = handle->resume_snapshot();
+        if (handle->policy().durability == Durability::None) {
+          handle->publish_resume(bits);
+          finish(static_cast<int64_t>(len));
+          return;
+        }
+        uring->fdatasync(handle->fd(), ex,
+          [handle, len, bits = std::move(bits), finish = std::move(finish)](int sres) mutable {
+            if (sres >= 0) handle->publish_resume(bits);
+            finish(sres < 0 ? -1 : static_cast<int64_t>(len));
+          });
+      });
+    return;
+  }
+#endif
+  int64_t written = data ? handle->write_chunk(chunk_index, data, len) : -1;
+  boost::asio::dispatch(ex, [written, finish = std::move(finish)]() mutable { finish(written); });
+}
+
+void FileStore::async_finalize_file(uint64_t transfer_id, const std::string& filename,
+                                    std::shared_ptr<WriteHandle> handle,
+                                    boost::asio::any_io_executor ex, FinalizeCallback cb) {
+#ifdef FSX_HAVE_IO_URING
+  if (uring_) {
+    std::string temp_path = get_temp_path(transfer_id, filename);
+    std::string final_path = get_file_path(transfer_id, filename);
+    auto uring = uring_;
+
+    // trim (sync, metadata only) -> fdatasync -> close -> renameat
+    auto do_rename = [uring, temp_path, final_path, ex, cb](bool ok) mutable {
+      if (!ok) {
+        cb(false);
+        return;
+      }
+      uring->rename(temp_path, final_path, ex, [cb](int res) { cb(res == 0); });
+    };
+    if (!handle->trim()) {
+      handle->close(false);
+      boost::asio::dispatch(ex, [cb = std::move(cb)]() { cb(false); });
+      return;
+    }
+    if (handle->policy().durability == Durability::None) {
+      do_rename(handle->close(false));
+      return;
+    }
+    uring_->fdatasync(handle->fd(), ex, [handle, do_rename](int res) mutable {
+      bool closed = handle->close(false);
+      do_rename(res == 0 && closed);
+    });
+    return;
+  }
+#endif
+  bool ok = finalize_file(transfer_id, filename, *handle);
+  boost::asio::dispatch(ex, [ok, cb = std::move(cb)]() { cb(ok); });
+}
+
 std::string FileStore::get_file_path(uint64_t transfer_id, const std::string& filename) const {
   std::ostringstream oss;
   oss << base_path_ << "/" << transfer_id << "/" << filename;
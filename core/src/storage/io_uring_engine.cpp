@@ -0,0 +1,134 @@
+#include "fsx/storage/io_uring_engine.h"
+
+#ifdef FSX_HAVE_IO_URING
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace fsx::storage {
+
+IoUringEngine::IoUringEngine(boost::asio::io_context& io, unsigned entries)
+  : event_desc_(io) {
+  int rc = io_uring_queue_init(entries, &ring_, 0);
+  if (rc < 0) {
+    throw std::runtime_error(std::string("io_uring_queue_init: ") + std::strerror(-rc));
+  }
+  event_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event_fd_ < 0 || io_uring_register_eventfd(&ring_, event_fd_) < 0) {
+    if (event_fd_ >= 0) ::close(event_fd_);
+    io_uring_queue_exit(&ring_);
+    throw std::runtime_error("io_uring eventfd setup failed");
+  }
+  // asio owns a dup so closing the descriptor never races our eventfd
+  event_desc_.assign(::dup(event_fd_));
+  wait_completions();
+}
+
+IoUringEngine::~IoUringEngine() {
+  boost::system::error_code ignored;
+  event_desc_.close(ignored);
+  io_uring_unregister_eventfd(&ring_);
+  ::close(event_fd_);
+  io_uring_queue_exit(&ring_);
+}
+
+void IoUringEngine::submit(std::unique_ptr<Op> op, const std::function<void(io_uring_sqe*)>& prep) {
+  {
+    std::lock_guard<std::mutex> lock(sq_mu_);
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+      unsubmitted_ = io_uring_submit(&ring_) < 0;
+      sqe = io_uring_get_sqe(&ring_);
+    }
+    if (sqe) {
+      prep(sqe);
+      io_uring_sqe_set_data(sqe, op.get());
+      op.release();  // owned by the ring until reap()
+      // -EBUSY/-EAGAIN: the CQ is full or the kernel is short of memory. The
+      // SQE stays queued; reap() submits it again after draining the CQ.
+      unsubmitted_ = io_uring_submit(&ring_) < 0;
+      return;
+    }
+  }
+  Op* failed = op.release();
+  boost::asio::post(failed->ex, [failed]() {
+    std::unique_ptr<Op> owned(failed);
+    owned->cb(-EBUSY);
+  });
+}
+
+void IoUringEngine::write(int fd, const void* data, size_t len, uint64_t offset,
+                          boost::asio::any_io_executor ex, Completion cb) {
+  auto op = std::make_unique<Op>();
+  op->ex = ex;
+  // Short writes: continue with the rest, report the total once done
+  op->cb = [this, fd, data, len, offset, ex, cb = std::move(cb)](int res) mutable {
+    if (res <= 0 || static_cast<size_t>(res) == len) {
+      cb(res);
+      return;
+    }
+    size_t done = static_cast<size_t>(res);
+    write(fd, static_cast<const uint8_t*>(data) + done, len - done, offset + done, ex,
+          [done, cb = std::move(cb)](int rest) { cb(rest < 0 ? rest : static_cast<int>(done) + rest); });
+  };
+  submit(std::move(op), [&](io_uring_sqe* sqe) {
+    io_uring_prep_write(sqe, fd, data, static_cast<unsigned>(len), offset);
+  });
+}
+
+void IoUringEngine::fdatasync(int fd, boost::asio::any_io_executor ex, Completion cb) {
+  auto op = std::make_unique<Op>();
+  op->ex = std::move(ex);
+  op->cb = std::move(cb);
+  submit(std::move(op), [&](io_uring_sqe* sqe) {
+    io_uring_prep_fsync(sqe, fd, IORING_FSYNC_DATASYNC);
+  });
+}
+
+void IoUringEngine::rename(std::string from, std::string to,
+                           boost::asio::any_io_executor ex, Completion cb) {
+  auto op = std::make_unique<Op>();
+  op->ex = std::move(ex);
+  op->cb = std::move(cb);
+  op->from = std::move(from);
+  op->to = std::move(to);
+  Op* raw = op.get();
+  submit(std::move(op), [raw](io_uring_sqe* sqe) {
+    io_uring_prep_renameat(sqe, AT_FDCWD, raw->from.c_str(), AT_FDCWD, raw->to.c_str(), 0);
+  });
+}
+
+void IoUringEngine::wait_completions() {
+  event_desc_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+    [this](boost::system::error_code ec) {
+      if (ec) return;
+      uint64_t n;
+      while (::read(event_fd_, &n, sizeof(n)) > 0) {}
+      reap();
+      wait_completions();
+    });
+}
+
+// Single consumer: only the wait_completions chain reaps
+void IoUringEngine::reap() {
+  io_uring_cqe* cqe;
+  while (io_uring_peek_cqe(&ring_, &cqe) == 0) {
+    Op* op = static_cast<Op*>(io_uring_cqe_get_data(cqe));
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring_, cqe);
+    boost::asio::post(op->ex, [op, res]() {
+      std::unique_ptr<Op> owned(op);
+      owned->cb(res);
+    });
+  }
+  std::lock_guard<std::mutex> lock(sq_mu_);
+  if (unsubmitted_) unsubmitted_ = io_uring_submit(&ring_) < 0;
+}
+
+} // namespace fsx::storage
+
+#endif // FSX_HAVE_IO_URING
@@ -0,0 +1,122 @@
+#include "fsx/storage/resume_store.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fsx::storage {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x42585346;  // "FSXB" little-endian
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderBytes = 16;
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t total_chunks;
+  uint32_t reserved;
+};
+static_assert(sizeof(Header) == kHeaderBytes, "bitmap header layout");
+
+} // namespace
+
+std::shared_ptr<ResumeBitmap> ResumeBitmap::open(const std::string& path, uint32_t total_chunks) {
+  size_t map_len = kHeaderBytes + ((static_cast<size_t>(total_chunks) + 63) / 64) * 8;
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[ResumeStore] Failed to open " << path << " (errno: " << errno << ")\n";
+    return nullptr;
+  }
+
+  // Anything that isn't our header for this chunk count starts over empty
+  Header hdr{};
+  struct stat st;
+  bool valid = ::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == map_len &&
+               ::pread(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr)) &&
+               hdr.magic == kMagic && hdr.version == kVersion && hdr.total_chunks == total_chunks;
+  if (!valid) {
+    hdr = Header{kMagic, kVersion, total_chunks, 0};
+    if (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, static_cast<off_t>(map_len)) != 0 ||
+        ::pwrite(fd, &hdr, sizeof(hdr), 0) != static_cast<ssize_t>(sizeof(hdr))) {
+      std::cerr << "[ResumeStore] Failed to initialise " << path << " (errno: " << errno << ")\n";
+      ::close(fd);
+      return nullptr;
+    }
+  }
+
+  void* map = ::mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);  // the mapping keeps the file referenced
+  if (map == MAP_FAILED) {
+    std::cerr << "[ResumeStore] mmap failed for " << path << " (errno: " << errno << ")\n";
+    return nullptr;
+  }
+  return std::shared_ptr<ResumeBitmap>(new ResumeBitmap(path, map, map_len, total_chunks));
+}
+
+ResumeBitmap::ResumeBitmap(std::string path, void* map, size_t map_len, uint32_t total_chunks)
+  : path_(std::move(path)),
+    map_(map),
+    map_len_(map_len),
+    total_chunks_(total_chunks),
+    words_(reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(map) + kHeaderBytes)),
+    live_(words_, words_ + (total_chunks + 63) / 64) {}
+
+ResumeBitmap::~ResumeBitmap() {
+  ::munmap(map_, map_len_);
+}
+
+void ResumeBitmap::set(uint32_t i) {
+  if (i >= total_chunks_) return;
+  __atomic_fetch_or(&live_[i / 64], uint64_t{1} << (i % 64), __ATOMIC_RELAXED);
+}
+
+bool ResumeBitmap::test(uint32_t i) const {
+  if (i >= total_chunks_) return false;
+  return (__atomic_load_n(&live_[i / 64], __ATOMIC_RELAXED) >> (i % 64)) & 1;
+}
+
+ResumeBitmap::Words ResumeBitmap::snapshot() const {
+  Words out(live_.size());
+  for (size_t w = 0; w < out.size(); w++) out[w] = __atomic_load_n(&live_[w], __ATOMIC_RELAXED);
+  return out;
+}
+
+void ResumeBitmap::publish(const Words& words) {
+  // OR, not copy: publishes from concurrent syncs (a striped transfer) may
+  // land in any order
+  for (size_t w = 0; w < words.size() && w < live_.size(); w++) {
+    if (words[w]) __atomic_fetch_or(&words_[w], words[w], __ATOMIC_RELAXED);
+  }
+  ::msync(map_, map_len_, MS_ASYNC);
+}
+
+ResumeStore::ResumeStore(std::string base_storage_path)
+  : base_path_(std::move(base_storage_path)) {}
+
+std::string ResumeStore::bitmap_path(uint64_t transfer_id) const {
+  return base_path_ + "/" + std::to_string(transfer_id) + "/chunks.bitmap";
+}
+
+std::shared_ptr<ResumeBitmap> ResumeStore::open(uint64_t transfer_id, uint32_t total_chunks) {
+  std::error_code ec;
+  std::filesystem::create_directories(base_path_ + "/" + std::to_string(transfer_id), ec);
+  if (ec) {
+    std::cerr << "[ResumeStore] Failed to create directory for transfer " << transfer_id
+              << ": " << ec.message() << "\n";
+    return nullptr;
+  }
+  return ResumeBitmap::open(bitmap_path(transfer_id), total_chunks);
+}
+
+void ResumeStore::remove(uint64_t transfer_id) {
+  ::unlink(bitmap_path(transfer_id).c_str());
+}
+
+} // namespace fsx::storage
@@ -0,0 +1,149 @@
+#include "fsx/storage/transfer_store.h"
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+namespace fsx::storage {
+
+namespace {
+
+// Filenames and usernames come from clients: keep every record one line per key
+std::string escape(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  for (char c : s) {
+    if (c == '\\') out += "\\\\";
+    else if (c == '\n') out += "\\n";
+    else if (c == '\r') out += "\\r";
+    else out += c;
+  }
+  return out;
+}
+
+std::string unescape(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] != '\\' || i + 1 == s.size()) {
+      out += s[i];
+      continue;
+    }
+    char c = s[++i];
+    out += c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+  }
+  return out;
+}
+
+bool parse_record(std::istream& in, TransferRecord* r) {
+  bool have_id = false;
+  std::string line;
+  while (std::getline(in, line)) {
+    auto eq = line.find('=');
+    if (eq == std::string::npos) continue;
+    std::string key = line.substr(0, eq);
+    std::string value = line.substr(eq + 1);
+    try {
+      if (key == "transfer_id") { r->transfer_id = std::stoull(value); have_id = true; }
+      else if (key == "sender_user_id") r->sender_user_id = std::stoll(value);
+      else if (key == "sender_username") r->sender_username = unescape(value);
+      else if (key == "receiver_user_id") r->receiver_user_id = std::stoll(value);
+      else if (key == "receiver_username") r->receiver_username = unescape(value);
+      else if (key == "filename") r->filename = unescape(value);
+      else if (key == "file_size") r->file_size = std::stoull(value);
+      else if (key == "chunk_size") r->chunk_size = static_cast<uint32_t>(std::stoul(value));
+      else if (key == "features") r->features = static_cast<uint32_t>(std::stoul(value));
+      else if (key == "window_bytes") r->window_bytes = static_cast<uint32_t>(std::stoul(value));
+      else if (key == "codec") r->codec = std::stoi(value);
+      else if (key == "relay") r->relay = value == "1";
+      else if (key == "dedup") r->dedup = value == "1";
+      else if (key == "sha256") r->sha256 = value;
+      else if (key == "state") r->state = std::stoi(value);
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  return have_id;
+}
+
+} // namespace
+
+TransferStore::TransferStore(std::string base_storage_path)
+  : base_path_(std::move(base_storage_path)) {}
+
+std::string TransferStore::meta_path(uint64_t transfer_id) const {
+  return base_path_ + "/" + std::to_string(transfer_id) + "/transfer.meta";
+}
+
+bool TransferStore::save(const TransferRecord& r) {
+  std::error_code ec;
+  std::filesystem::create_directories(base_path_ + "/" + std::to_string(r.transfer_id), ec);
+  if (ec) {
+    std::cerr << "[TransferStore] Failed to create directory for transfer " << r.transfer_id
+              << ": " << ec.message() << "\n";
+    return false;
+  }
+
+  std::ostringstream oss;
+  oss << "transfer_id=" << r.transfer_id << "\n"
+      << "sender_user_id=" << r.sender_user_id << "\n"
+      << "sender_username=" << escape(r.sender_username) << "\n"
+      << "receiver_user_id=" << r.receiver_user_id << "\n"
+      << "receiver_username=" << escape(r.receiver_username) << "\n"
+      << "filename=" << escape(r.filename) << "\n"
+      << "file_size=" << r.file_size << "\n"
+      << "chunk_size=" << r.chunk_size << "\n"
+      << "features=" << r.features << "\n"
+      << "window_bytes=" << r.window_bytes << "\n"
+      << "codec=" << r.codec << "\n"
+      << "relay=" << (r.relay ? 1 : 0) << "\n"
+      << "dedup=" << (r.dedup ? 1 : 0) << "\n"
+      << "sha256=" << r.sha256 << "\n"
+      << "state=" << r.state << "\n";
+
+  std::string path = meta_path(r.transfer_id);
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << oss.str();
+    out.flush();
+    if (!out) {
+      std::cerr << "[TransferStore] Failed to write " << tmp << "\n";
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::cerr << "[TransferStore] rename failed for " << path << " (errno: " << errno << ")\n";
+    return false;
+  }
+  return true;
+}
+
+void TransferStore::remove(uint64_t transfer_id) {
+  ::unlink(meta_path(transfer_id).c_str());
+}
+
+std::vector<TransferRecord> TransferStore::load_all() const {
+  std::vector<TransferRecord> out;
+  std::error_code ec;
+  std::filesystem::directory_iterator it(base_path_, ec);
+  if (ec) return out;
+
+  for (const auto& entry : it) {
+    if (!entry.is_directory()) continue;
+    std::ifstream in(entry.path() / "transfer.meta");
+    if (!in) continue;
+    TransferRecord r;
+    if (!parse_record(in, &r) || std::to_string(r.transfer_id) != entry.path().filename().string()) {
+      std::cerr << "[TransferStore] Skipping unreadable record in " << entry.path() << "\n";
+      continue;
+    }
+    out.push_back(std::move(r));
+  }
+  return out;
+}
+
+} // namespace fsx::storage
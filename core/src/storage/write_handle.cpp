@@ -0,0 +1,305 @@
+#include "fsx/storage/write_handle.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace fsx::storage {
+
+Durability parse_durability(const std::string& s) {
+  if (s == "none") return Durability::None;
+  if (s == "periodic") return Durability::Periodic;
+  return Durability::SyncOnDone;
+}
+
+std::shared_ptr<WriteHandle> WriteHandle::open(const std::string& path, uint64_t file_size,
+                                               uint32_t chunk_size, const WritePolicy& policy,
+                                               bool resume) {
+  if (chunk_size == 0) {
+    std::cerr << "[FileStore] open: chunk_size is 0 for " << path << "\n";
+    return nullptr;
+  }
+
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (resume ? 0 : O_TRUNC);
+  int fd = ::open(path.c_str(), flags, 0644);
+  if (fd < 0) {
+    std::cerr << "[FileStore] Failed to open file for writing: " << path << " (errno: " << errno << ")\n";
+    std::cerr.flush();
+    return nullptr;
+  }
+
+#ifdef __linux__
+  if (policy.preallocate && file_size > 0) {
+    // Best effort: reserves extents up front; filesystems without support just skip it
+    if (::fallocate(fd, 0, 0, static_cast<off_t>(file_size)) != 0 && errno != EOPNOTSUPP) {
+      std::cerr << "[FileStore] fallocate failed for " << path << " (errno: " << errno << ")\n";
+    }
+  }
+#endif
+
+  auto handle = std::shared_ptr<WriteHandle>(new WriteHandle(fd, path, file_size, chunk_size, policy));
+  if (resume) {
+    // Whatever is already there may be written data: never trim it away
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      handle->high_water_ = std::min<uint64_t>(static_cast<uint64_t>(st.st_size), file_size);
+    }
+  }
+  return handle;
+}
+
+WriteHandle::WriteHandle(int fd, std::string path, uint64_t file_size, uint32_t chunk_size,
+                         WritePolicy policy)
+  : fd_(fd),
+    path_(std::move(path)),
+    file_size_(file_size),
+    chunk_size_(chunk_size),
+    policy_(policy),
+    last_sync_(std::chrono::steady_clock::now()) {}
+
+WriteHandle::~WriteHandle() {
+  close();
+}
+
+bool WriteHandle::check_chunk(uint32_t chunk_index, size_t len, uint64_t* offset) const {
+  if (fd_ < 0 || len == 0 || len > chunk_size_) {
+    std::cerr << "[FileStore] write_chunk: invalid parameters (fd=" << fd_ << " len=" << len
+              << " chunk_size=" << chunk_size_ << ")\n";
+    return false;
+  }
+  *offset = static_cast<uint64_t>(chunk_index) * chunk_size_;
+  if (*offset >= file_size_) {
+    std::cerr << "[FileStore] write_chunk: chunk " << chunk_index << " past end of file ("
+              << *offset << " >= " << file_size_ << ")\n";
+    return false;
+  }
+  // Only the last chunk may be short
+  uint64_t expected = std::min<uint64_t>(chunk_size_, file_size_ - *offset);
+  if (len != expected) {
+    std::cerr << "[FileStore] write_chunk: chunk " << chunk_index << " is " << len
+              << " bytes, expected " << expected << "\n";
+    return false;
+  }
+  return true;
+}
+
+void WriteHandle::note_written(uint64_t offset, size_t len) {
+  std::lock_guard<std::mutex> lock(mu_);
+  note_written_locked(offset, len);
+}
+
+void WriteHandle::note_written_locked(uint64_t offset, size_t len) {
+  bytes_written_ += len;
+  if (offset + len > high_water_) high_water_ = offset + len;
+}
+
+void WriteHandle::run_completions(Completions& done) {
+  for (auto& [fn, stored] : done) {
+    if (fn) fn(stored);
+  }
+  done.clear();
+}
+
+int64_t WriteHandle::write_chunk(uint32_t chunk_index, const void* data, size_t len, StoredFn on_stored) {
+  uint64_t offset;
+  if (!data || !check_chunk(chunk_index, len, &offset)) {
+    if (on_stored) on_stored(false);
+    return -1;
+  }
+
+  if (policy_.coalesce_bytes == 0) {
+    bool ok = write_at(offset, data, len);
+    if (ok) note_written(offset, len);
+    ok = ok && maybe_periodic_sync();
+    if (on_stored) on_stored(ok);
+    return ok ? static_cast<int64_t>(len) : -1;
+  }
+
+  Completions done;
+  bool ok = true;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    // A chunk that doesn't extend the run (or would overflow it) closes it first
+    bool extends = staged_count_ > 0 && offset == run_offset_ + staged_bytes_;
+    if (staged_count_ > 0 && (!extends || staged_bytes_ + len > policy_.coalesce_bytes)) {
+      ok = flush_locked(&done);
+    }
+    if (!ok) {
+      done.emplace_back(std::move(on_stored), false);
+    } else {
+      if (staged_count_ == 0) run_offset_ = offset;
+      if (staged_.size() <= staged_count_) {
+        staged_.emplace_back();
+        staged_done_.emplace_back();
+      }
+      staged_[staged_count_].assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + len);
+      staged_done_[staged_count_] = std::move(on_stored);
+      staged_count_++;
+      staged_bytes_ += len;
+      // A partial chunk or the last one ends the file (or a gap follows): no
+      // point waiting
+      if (staged_bytes_ >= policy_.coalesce_bytes || len < chunk_size_ || offset + len == file_size_) {
+        ok = flush_locked(&done);
+      }
+    }
+    // Periodic sync: whatever it flushes counts as stored only once synced
+    if (ok && sync_due_locked()) {
+      size_t first = done.size();
+      ok = flush_locked(&done) && datasync();
+      if (!ok) {
+        for (size_t i = first; i < done.size(); i++) done[i].second = false;
+      }
+    }
+  }
+  run_completions(done);
+
+  return ok ? static_cast<int64_t>(len) : -1;
+}
+
+bool WriteHandle::write_at(uint64_t offset, const void* data, size_t len) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  while (len > 0) {
+    ssize_t n = ::pwrite(fd_, p, len, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[FileStore] pwrite failed: " << path_ << " (errno: " << errno << ")\n";
+      return false;
+    }
+    p += n;
+    offset += static_cast<uint64_t>(n);
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool WriteHandle::flush() {
+  Completions done;
+  bool ok;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    ok = flush_locked(&done);
+  }
+  run_completions(done);
+  return ok;
+}
+
+bool WriteHandle::flush_locked(Completions* done) {
+  if (staged_count_ == 0) return true;
+
+  // However the run ends, every chunk in it learns the outcome
+  auto finish = [&](bool stored) {
+    if (stored) note_written_locked(run_offset_, staged_bytes_);
+    for (size_t i = 0; i < staged_count_; i++) done->emplace_back(std::move(staged_done_[i]), stored);
+    staged_count_ = 0;
+    staged_bytes_ = 0;
+    return stored;
+  };
+
+  auto& iov = iov_;
+  iov.resize(staged_count_);
+  for (size_t i = 0; i < staged_count_; i++) {
+    iov[i].iov_base = staged_[i].data();
+    iov[i].iov_len = staged_[i].size();
+  }
+
+  // pwritev may stop short; advance through the iovec array until done
+  size_t first = 0;
+  uint64_t offset = run_offset_;
+  size_t remaining = staged_bytes_;
+  while (remaining > 0) {
+    int cnt = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t n = ::pwritev(fd_, iov.data() + first, cnt, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[FileStore] pwritev failed: " << path_ << " (errno: " << errno << ")\n";
+      return finish(false);
+    }
+    offset += static_cast<uint64_t>(n);
+    remaining -= static_cast<size_t>(n);
+    size_t left = static_cast<size_t>(n);
+    while (left > 0 && left >= iov[first].iov_len) {
+      left -= iov[first].iov_len;
+      first++;
+    }
+    if (left > 0) {
+      iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + left;
+      iov[first].iov_len -= left;
+    }
+  }
+
+  return finish(true);
+}
+
+bool WriteHandle::sync_due() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return sync_due_locked();
+}
+
+bool WriteHandle::sync_due_locked() {
+  if (policy_.durability != Durability::Periodic && !resume_) return false;
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_sync_ < policy_.sync_interval) return false;
+  last_sync_ = now;
+  return true;
+}
+
+bool WriteHandle::datasync() {
+  // Only chunks whose bits were set before the sync started are covered by it
+  ResumeBitmap::Words bits = resume_snapshot();
+  if (policy_.durability != Durability::None && ::fdatasync(fd_) != 0) {
+    std::cerr << "[FileStore] fdatasync failed: " << path_ << " (errno: " << errno << ")\n";
+    return false;
+  }
+  publish_resume(bits);
+  return true;
+}
+
+ResumeBitmap::Words WriteHandle::resume_snapshot() const {
+  return resume_ ? resume_->snapshot() : ResumeBitmap::Words{};
+}
+
+void WriteHandle::publish_resume(const ResumeBitmap::Words& bits) {
+  if (resume_) resume_->publish(bits);
+}
+
+bool WriteHandle::maybe_periodic_sync() {
+  if (!sync_due()) return true;
+  return flush() && datasync();
+}
+
+bool WriteHandle::trim() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return trim_locked();
+}
+
+bool WriteHandle::trim_locked() {
+  // Preallocation extended the file to file_size; cut back to what arrived
+  if (fd_ >= 0 && high_water_ < file_size_ && ::ftruncate(fd_, static_cast<off_t>(high_water_)) != 0) {
+    std::cerr << "[FileStore] ftruncate failed: " << path_ << " (errno: " << errno << ")\n";
+    return false;
+  }
+  return true;
+}
+
+bool WriteHandle::close(bool sync) {
+  Completions done;
+  bool ok;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (fd_ < 0) return true;
+    ok = flush_locked(&done);
+    if (!trim_locked()) ok = false;
+    if (ok && sync && policy_.durability != Durability::None && !datasync()) ok = false;
+    if (::close(fd_) != 0) ok = false;
+    fd_ = -1;
+  }
+  run_completions(done);
+  return ok;
+}
+
+} // namespace fsx::storage
@@ -0,0 +1,124 @@
+#include "fsx/transfer/chunk_bitmap.h"
+#include <algorithm>
+#include <bit>
+
+namespace fsx::transfer {
+
+ChunkBitmap::ChunkBitmap(uint32_t size)
+  : size_(size),
+    words_((static_cast<size_t>(size) + 63) / 64, 0),
+    tree_((words_.size() + kWordsPerBlock - 1) / kWordsPerBlock + 1, 0) {}
+
+bool ChunkBitmap::set(uint32_t i) {
+  if (i >= size_) return false;
+  uint64_t mask = uint64_t{1} << (i % 64);
+  uint64_t& w = words_[i / 64];
+  if (w & mask) return false;
+  w |= mask;
+  count_++;
+  tree_add(i / 64 / kWordsPerBlock, 1);
+  return true;
+}
+
+void ChunkBitmap::tree_add(size_t block, int32_t delta) {
+  for (size_t k = block + 1; k < tree_.size(); k += k & (~k + 1)) {
+    tree_[k] += static_cast<uint32_t>(delta);
+  }
+}
+
+uint32_t ChunkBitmap::tree_prefix(size_t blocks) const {
+  uint32_t sum = 0;
+  for (size_t k = blocks; k > 0; k &= k - 1) sum += tree_[k];
+  return sum;
+}
+
+uint32_t ChunkBitmap::rank(uint32_t i) const {
+  if (i >= size_) return count_;
+  size_t word = i / 64;
+  size_t block = word / kWordsPerBlock;
+  uint32_t r = tree_prefix(block);
+  for (size_t w = block * kWordsPerBlock; w < word; w++) r += std::popcount(words_[w]);
+  uint64_t below = (uint64_t{1} << (i % 64)) - 1;
+  return r + std::popcount(words_[word] & below);
+}
+
+uint32_t ChunkBitmap::select(uint32_t k) const {
+  if (k >= count_) return npos;
+
+  // Fenwick descent: largest block prefix with at most k bits set
+  size_t pos = 0;
+  size_t step = std::bit_floor(tree_.size() - 1);
+  for (; step > 0; step >>= 1) {
+    if (pos + step < tree_.size() && tree_[pos + step] <= k) {
+      pos += step;
+      k -= tree_[pos];
+    }
+  }
+
+  // pos = block holding the bit; k = rank within it
+  for (size_t w = pos * kWordsPerBlock; w < words_.size(); w++) {
+    uint32_t c = std::popcount(words_[w]);
+    if (k < c) {
+      uint64_t bits = words_[w];
+      for (; k > 0; k--) bits &= bits - 1;
+      return static_cast<uint32_t>(w * 64 + std::countr_zero(bits));
+    }
+    k -= c;
+  }
+  return npos;
+}
+
+uint32_t ChunkBitmap::next_unset(uint32_t from) const {
+  if (from >= size_) return size_;
+  size_t w = from / 64;
+  uint64_t bits = ~words_[w] & ~((uint64_t{1} << (from % 64)) - 1);
+  while (bits == 0) {
+    if (++w == words_.size()) return size_;
+    bits = ~words_[w];
+  }
+  return std::min<uint32_t>(size_, static_cast<uint32_t>(w * 64 + std::countr_zero(bits)));
+}
+
+uint32_t ChunkBitmap::next_set(uint32_t from) const {
+  if (from >= size_) return size_;
+  size_t w = from / 64;
+  uint64_t bits = words_[w] & ~((uint64_t{1} << (from % 64)) - 1);
+  while (bits == 0) {
+    if (++w == words_.size()) return size_;
+    bits = words_[w];
+  }
+  return std::min<uint32_t>(size_, static_cast<uint32_t>(w * 64 + std::countr_zero(bits)));
+}
+
+std::vector<uint8_t> ChunkBitmap::range_bytes(uint32_t from, size_t max_bytes) const {
+  std::vector<uint8_t> out;
+  if (from >= size_) return out;
+  size_t nbits = std::min<size_t>(max_bytes * 8, size_ - from);
+  out.assign((nbits + 7) / 8, 0);
+  for (size_t b = 0; b < nbits; b++) {
+    if (test(static_cast<uint32_t>(from + b))) out[b / 8] |= static_cast<uint8_t>(1u << (b % 8));
+  }
+  while (!out.empty() && out.back() == 0) out.pop_back();
+  return out;
+}
+
+void ChunkBitmap::assign_words(const uint64_t* words, size_t n) {
+  std::fill(words_.begin(), words_.end(), 0);
+  std::copy(words, words + std::min(n, words_.size()), words_.begin());
+  if (size_ % 64 != 0 && !words_.empty()) {
+    words_.back() &= (uint64_t{1} << (size_ % 64)) - 1;
+  }
+  rebuild_tree();
+}
+
+void ChunkBitmap::rebuild_tree() {
+  std::fill(tree_.begin(), tree_.end(), 0);
+  count_ = 0;
+  for (size_t w = 0; w < words_.size(); w++) {
+    uint32_t c = std::popcount(words_[w]);
+    count_ += c;
+    if (c) tree_add(w / kWordsPerBlock, static_cast<int32_t>(c));
+  }
+}
+
+} // namespace fsx::transfer
@@ -0,0 +1,234 @@
+#include "fsx/transfer/chunker.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FSX_CHUNKER_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace fsx::transfer {
+
+namespace {
+
+constexpr uint32_t kWindow = 32;            // bytes that influence a 32-bit Gear hash
+constexpr uint32_t kMaxChunk = 1u << 30;    // hits store position << 1
+constexpr size_t kScanBlock = 16 * 1024;    // positions per AVX2 scan (2 KiB per lane)
+constexpr size_t kMinSimdPositions = 8 * 64;
+
+// splitmix64 over a fixed seed: deterministic, no table to check in
+constexpr std::array<uint32_t, 256> make_gear() {
+  std::array<uint32_t, 256> t{};
+  uint64_t x = 0x66737863646331ull;  // "fsxcdc1"
+  for (auto& v : t) {
+    x += 0x9e3779b97f4a7c15ull;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    v = static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+  }
+  return t;
+}
+
+alignas(64) constexpr std::array<uint32_t, 256> kGear = make_gear();
+
+// The top bits of h have seen the most bytes, so masks take them from the top
+constexpr uint32_t top_bits(uint32_t n) {
+  return n == 0 ? 0 : ~uint32_t{0} << (32 - n);
+}
+
+// First cut length in [first_pos + 1, last_pos + 1], 0 if none. Position p
+// is a cut after byte p when (h & mask_l) == 0, and also (h & mask_s) == 0
+// while the chunk would be shorter than avg.
+size_t scan_scalar(const uint8_t* data, size_t first_pos, size_t last_pos,
+                   uint32_t mask_s, uint32_t mask_l, size_t avg) {
+  uint32_t h = 0;
+  for (size_t i = first_pos + 1 - kWindow; i < first_pos; i++) h = (h << 1) + kGear[data[i]];
+  size_t p = first_pos;
+  for (; p <= last_pos && p + 1 < avg; p++) {
+    h = (h << 1) + kGear[data[p]];
+    if ((h & mask_s) == 0) return p + 1;
+  }
+  for (; p <= last_pos; p++) {
+    h = (h << 1) + kGear[data[p]];
+    if ((h & mask_l) == 0) return p + 1;
+  }
+  return 0;
+}
+
+#ifdef FSX_CHUNKER_AVX2
+
+#define FSX_AVX2 __attribute__((target("avx2")))
+
+struct Avx2Lanes {
+  const uint8_t* base;        // lane 0's first warm-up byte
+  __m256i offs;               // lane starts relative to base
+  __m256i h;
+  size_t first_pos;
+  size_t lane_len;
+  uint32_t mask_s;
+  uint32_t mask_l;
+  std::vector<uint32_t>* hits;
+};
+
+FSX_AVX2 inline __m256i avx2_load4(const Avx2Lanes& s, size_t i) {
+  return _mm256_i32gather_epi32(reinterpret_cast<const int*>(s.base + i), s.offs, 1);
+}
+
+FSX_AVX2 inline void avx2_step(Avx2Lanes& s, __m256i bytes) {
+  __m256i idx = _mm256_and_si256(bytes, _mm256_set1_epi32(0xff));
+  __m256i g = _mm256_i32gather_epi32(reinterpret_cast<const int*>(kGear.data()), idx, 4);
+  s.h = _mm256_add_epi32(_mm256_slli_epi32(s.h, 1), g);
+}
+
+FSX_AVX2 inline void avx2_test(Avx2Lanes& s, size_t i) {
+  __m256i masked = _mm256_and_si256(s.h, _mm256_set1_epi32(static_cast<int>(s.mask_l)));
+  __m256i eq = _mm256_cmpeq_epi32(masked, _mm256_setzero_si256());
+  int bits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+  if (bits == 0) return;
+  alignas(32) uint32_t hs[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(hs), s.h);
+  while (bits) {
+    int lane = std::countr_zero(static_cast<unsigned>(bits));
+    bits &= bits - 1;
+    size_t pos = s.first_pos + lane * s.lane_len + (i + 1 - kWindow);
+    s.hits[lane].push_back(static_cast<uint32_t>(pos << 1) | ((hs[lane] & s.mask_s) == 0));
+  }
+}
+
+// Positions [first_pos, last_pos] split into 8 consecutive slices, one per
+// 32-bit lane; each lane warms its hash up on the 31 bytes before its slice.
+// Every (h & mask_l) == 0 goes to lane_hits[lane] as position << 1 | strong,
+// so concatenating the lanes gives the hits in order. Bytes are fetched 4 at
+// a time per lane with one gather; the slices stop 3 bytes short of last_pos
+// so those reads stay in bounds, and that tail goes to the last lane scalar.
+FSX_AVX2 void scan_avx2(const uint8_t* data, size_t first_pos, size_t last_pos,
+                        uint32_t mask_s, uint32_t mask_l, std::vector<uint32_t>* lane_hits) {
+  size_t positions = last_pos - first_pos + 1;
+  size_t lane_len = (positions - 3) / 8;
+  int32_t ll = static_cast<int32_t>(lane_len);
+
+  Avx2Lanes s;
+  s.base = data + first_pos + 1 - kWindow;
+  s.offs = _mm256_setr_epi32(0, ll, 2 * ll, 3 * ll, 4 * ll, 5 * ll, 6 * ll, 7 * ll);
+  s.h = _mm256_setzero_si256();
+  s.first_pos = first_pos;
+  s.lane_len = lane_len;
+  s.mask_s = mask_s;
+  s.mask_l = mask_l;
+  s.hits = lane_hits;
+
+  size_t steps = kWindow - 1 + lane_len;
+  size_t i = 0;
+  for (; i < kWindow - 1; i++) avx2_step(s, avx2_load4(s, i));
+  for (; i + 4 <= steps; i += 4) {
+    __m256i b = avx2_load4(s, i);
+    avx2_step(s, b);
+    avx2_test(s, i);
+    avx2_step(s, _mm256_srli_epi32(b, 8));
+    avx2_test(s, i + 1);
+    avx2_step(s, _mm256_srli_epi32(b, 16));
+    avx2_test(s, i + 2);
+    avx2_step(s, _mm256_srli_epi32(b, 24));
+    avx2_test(s, i + 3);
+  }
+  for (; i < steps; i++) {
+    avx2_step(s, avx2_load4(s, i));
+    avx2_test(s, i);
+  }
+
+  // Tail the slices didn't cover
+  uint32_t h = 0;
+  size_t tail = first_pos + 8 * lane_len;
+  for (size_t k = tail + 1 - kWindow; k < tail; k++) h = (h << 1) + kGear[data[k]];
+  for (size_t p = tail; p <= last_pos; p++) {
+    h = (h << 1) + kGear[data[p]];
+    if ((h & mask_l) == 0) lane_hits[7].push_back(static_cast<uint32_t>(p << 1) | ((h & mask_s) == 0));
+  }
+}
+
+#undef FSX_AVX2
+
+#endif
+
+} // namespace
+
+bool Chunker::cpu_has_avx2() {
+#ifdef FSX_CHUNKER_AVX2
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+Chunker::Chunker(ChunkerConfig cfg) : cfg_(cfg) {
+  cfg_.min_size = std::max(cfg_.min_size, kWindow);
+  cfg_.max_size = std::clamp(cfg_.max_size, cfg_.min_size + 1, kMaxChunk);
+  cfg_.avg_size = std::bit_floor(std::clamp(cfg_.avg_size, cfg_.min_size, cfg_.max_size));
+  uint32_t bits = static_cast<uint32_t>(std::countr_zero(cfg_.avg_size));
+  mask_s_ = top_bits(std::min<uint32_t>(bits + 2, 31));
+  mask_l_ = top_bits(bits > 3 ? bits - 2 : 1);
+  simd_ = cpu_has_avx2();
+}
+
+void Chunker::set_simd(bool on) {
+  simd_ = on && cpu_has_avx2();
+}
+
+size_t Chunker::next(const uint8_t* data, size_t n, bool last) {
+  if (n == 0) return 0;
+  if (cfg_.mode == ChunkingMode::Fixed) {
+    if (n >= cfg_.max_size) return cfg_.max_size;
+    return last ? n : 0;
+  }
+  return next_cdc(data, n, last);
+}
+
+size_t Chunker::next_cdc(const uint8_t* data, size_t n, bool last) {
+  if (n <= cfg_.min_size) return last ? n : 0;
+
+  // Candidate cuts after positions min_size - 1 .. limit - 1
+  size_t limit = std::min<size_t>(n, cfg_.max_size);
+  size_t first_pos = cfg_.min_size - 1;
+  size_t last_pos = limit - 1;
+
+#ifdef FSX_CHUNKER_AVX2
+  if (simd_ && last_pos - first_pos + 1 >= kMinSimdPositions) {
+    for (size_t from = first_pos; from <= last_pos; from += kScanBlock) {
+      size_t to = std::min(last_pos, from + kScanBlock - 1);
+      for (auto& hits : lane_hits_) hits.clear();
+      if (to - from + 1 >= kMinSimdPositions) {
+        scan_avx2(data, from, to, mask_s_, mask_l_, lane_hits_);
+        for (const auto& hits : lane_hits_) {
+          for (uint32_t hit : hits) {
+            size_t len = (hit >> 1) + 1;
+            if ((hit & 1) || len >= cfg_.avg_size) return len;
+          }
+        }
+      } else if (size_t len = scan_scalar(data, from, to, mask_s_, mask_l_, cfg_.avg_size)) {
+        return len;
+      }
+    }
+  } else
+#endif
+  if (size_t len = scan_scalar(data, first_pos, last_pos, mask_s_, mask_l_, cfg_.avg_size)) {
+    return len;
+  }
+
+  if (limit == cfg_.max_size) return cfg_.max_size;
+  return last ? n : 0;
+}
+
+size_t Chunker::split(const uint8_t* data, size_t n, bool last, std::vector<uint32_t>* lengths) {
+  size_t off = 0;
+  while (off < n) {
+    size_t len = next(data + off, n - off, last);
+    if (len == 0) break;
+    lengths->push_back(static_cast<uint32_t>(len));
+    off += len;
+  }
+  return off;
+}
+
+} // namespace fsx::transfer
@@ -0,0 +1,250 @@
+#include "fsx/transfer/integrity.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FSX_CRC32C_SSE42 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define FSX_CRC32C_ARMV8 1
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace fsx::transfer {
+
+namespace {
+
+// The raw functions work on the CRC register: callers apply the ~ before and
+// after, so pieces of one buffer can be chained and combined.
+
+constexpr uint32_t kPoly = 0x82f63b78;  // reflected 0x1edc6f41
+
+constexpr std::array<std::array<uint32_t, 256>, 8> make_tables() {
+  std::array<std::array<uint32_t, 256>, 8> t{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c >> 1) ^ (kPoly & (0u - (c & 1)));
+    t[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (size_t s = 1; s < 8; s++) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+  }
+  return t;
+}
+
+alignas(64) constexpr auto kTables = make_tables();
+
+uint32_t raw_sw(uint32_t c, const uint8_t* p, size_t len) {
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    w ^= c;
+    c = kTables[7][w & 0xff] ^ kTables[6][(w >> 8) & 0xff] ^
+        kTables[5][(w >> 16) & 0xff] ^ kTables[4][(w >> 24) & 0xff] ^
+        kTables[3][(w >> 32) & 0xff] ^ kTables[2][(w >> 40) & 0xff] ^
+        kTables[1][(w >> 48) & 0xff] ^ kTables[0][w >> 56];
+  }
+  for (; len > 0; p++, len--) c = (c >> 8) ^ kTables[0][(c ^ *p) & 0xff];
+  return c;
+}
+
+#ifdef FSX_CRC32C_SSE42
+
+// crc32 has a 3-cycle latency but issues every cycle, so one dependency
+// chain runs at a third of the possible speed. Large buffers are cut into
+// three lanes of kLane bytes hashed side by side and then merged:
+// raw(c, A B) = shift(raw(c, A), |B|) ^ raw(0, B), where shift (feeding |B|
+// zero bytes) is linear in the register and so a table lookup per byte.
+constexpr size_t kLane = 4096;
+
+struct LaneShift {
+  std::array<std::array<uint32_t, 256>, 4> t;
+
+  uint32_t operator()(uint32_t c) const {
+    return t[0][c & 0xff] ^ t[1][(c >> 8) & 0xff] ^ t[2][(c >> 16) & 0xff] ^ t[3][c >> 24];
+  }
+};
+
+LaneShift make_lane_shift() {
+  // Image of each basis bit after kLane zero bytes, then every byte value as
+  // the xor of its bits' images
+  std::array<uint32_t, 32> basis;
+  std::vector<uint8_t> zeros(kLane, 0);
+  for (int b = 0; b < 32; b++) basis[b] = raw_sw(1u << b, zeros.data(), zeros.size());
+  LaneShift s{};
+  for (int k = 0; k < 4; k++) {
+    for (uint32_t v = 0; v < 256; v++) {
+      uint32_t x = 0;
+      for (int b = 0; b < 8; b++) {
+        if (v & (1u << b)) x ^= basis[8 * k + b];
+      }
+      s.t[k][v] = x;
+    }
+  }
+  return s;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t raw_sse42_1(uint32_t c, const uint8_t* p, size_t len) {
+  uint64_t c64 = c;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    c64 = _mm_crc32_u64(c64, w);
+  }
+  c = static_cast<uint32_t>(c64);
+  for (; len > 0; p++, len--) c = _mm_crc32_u8(c, *p);
+  return c;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t raw_sse42(uint32_t c, const uint8_t* p, size_t len) {
+  static const LaneShift shift = make_lane_shift();
+  for (; len >= 3 * kLane; p += 3 * kLane, len -= 3 * kLane) {
+    uint64_t a = c, b = 0, d = 0;
+    for (size_t i = 0; i < kLane; i += 8) {
+      uint64_t wa, wb, wd;
+      std::memcpy(&wa, p + i, 8);
+      std::memcpy(&wb, p + kLane + i, 8);
+      std::memcpy(&wd, p + 2 * kLane + i, 8);
+      a = _mm_crc32_u64(a, wa);
+      b = _mm_crc32_u64(b, wb);
+      d = _mm_crc32_u64(d, wd);
+    }
+    c = shift(shift(static_cast<uint32_t>(a)) ^ static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(d);
+  }
+  return raw_sse42_1(c, p, len);
+}
+
+bool cpu_has_sse42() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#endif
+
+#ifdef FSX_CRC32C_ARMV8
+
+__attribute__((target("+crc")))
+uint32_t raw_armv8(uint32_t c, const uint8_t* p, size_t len) {
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    c = __crc32cd(c, w);
+  }
+  for (; len > 0; p++, len--) c = __crc32cb(c, *p);
+  return c;
+}
+
+bool cpu_has_armv8_crc() {
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+#endif
+
+using RawFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+struct Impl {
+  RawFn fn;
+  const char* name;
+};
+
+Impl pick_impl() {
+#if defined(FSX_CRC32C_SSE42)
+  if (cpu_has_sse42()) return {raw_sse42, "sse4.2"};
+#elif defined(FSX_CRC32C_ARMV8)
+  if (cpu_has_armv8_crc()) return {raw_armv8, "armv8-crc"};
+#endif
+  return {raw_sw, "table"};
+}
+
+const Impl& impl() {
+  static const Impl i = pick_impl();
+  return i;
+}
+
+} // namespace
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+  return ~impl().fn(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t crc) {
+  return ~raw_sw(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+const char* crc32c_impl() {
+  return impl().name;
+}
+
+FileDigest::FileDigest(size_t max_pending_bytes) : max_pending_(max_pending_bytes) {}
+
+void FileDigest::add(uint64_t offset, const void* data, size_t len) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (offset == next_) {
+    sha_.update(data, len);
+    next_ += len;
+    drain_locked();
+    return;
+  }
+  if (offset < next_ || overflowed_ || pending_.count(offset)) return;
+  if (pending_bytes_ + len > max_pending_) {
+    // Too far ahead: finish() reads the rest back instead
+    overflowed_ = true;
+    pending_.clear();
+    pending_bytes_ = 0;
+    return;
+  }
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  pending_.emplace(offset, std::vector<uint8_t>(p, p + len));
+  pending_bytes_ += len;
+}
+
+void FileDigest::drain_locked() {
+  while (!pending_.empty() && pending_.begin()->first <= next_) {
+    auto it = pending_.begin();
+    if (it->first == next_) {
+      sha_.update(it->second.data(), it->second.size());
+      next_ += it->second.size();
+    }
+    pending_bytes_ -= it->second.size();
+    pending_.erase(it);
+  }
+}
+
+uint64_t FileDigest::hashed() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return next_;
+}
+
+bool FileDigest::finish(int fd, uint64_t file_size, fsx::crypto::Sha256Digest* out,
+                        uint64_t* reread_bytes) {
+  std::lock_guard<std::mutex> lock(mu_);
+  uint64_t reread = 0;
+  if (next_ < file_size) {
+    if (fd < 0) return false;
+    std::vector<uint8_t> buf(1024 * 1024);
+    while (next_ < file_size) {
+      size_t want = static_cast<size_t>(std::min<uint64_t>(buf.size(), file_size - next_));
+      ssize_t n = ::pread(fd, buf.data(), want, static_cast<off_t>(next_));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      sha_.update(buf.data(), static_cast<size_t>(n));
+      next_ += static_cast<uint64_t>(n);
+      reread += static_cast<uint64_t>(n);
+    }
+  }
+  if (next_ != file_size) return false;
+  pending_.clear();
+  pending_bytes_ = 0;
+  *out = sha_.final();
+  if (reread_bytes) *reread_bytes = reread;
+  return true;
+}
+
+} // namespace fsx::transfer
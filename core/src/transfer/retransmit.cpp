@@ -0,0 +1,66 @@
+#include "fsx/transfer/retransmit.h"
+#include <algorithm>
+
+namespace fsx::transfer {
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tick, size_t slots)
+  : tick_(std::max(tick, std::chrono::milliseconds(1))),
+    slots_(std::max<size_t>(slots, 1)),
+    cursor_time_(Clock::now()) {}
+
+TimingWheel::TimerId TimingWheel::schedule(std::chrono::milliseconds delay, Callback cb) {
+  auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mu_);
+  // Count from the last processed tick, which may be up to a tick (or more,
+  // if advance() lags) behind now, and round up: a timer must never fire
+  // before its delay
+  auto wait = std::max(now - cursor_time_, Clock::duration::zero()) + Clock::duration(delay);
+  auto step = Clock::duration(tick_).count();
+  uint64_t ticks = std::max<uint64_t>(1, static_cast<uint64_t>((wait.count() + step - 1) / step));
+  TimerId id = next_id_++;
+  size_t slot = (cursor_ + ticks) % slots_.size();
+  auto& list = slots_[slot];
+  list.push_back(Entry{id, (ticks - 1) / slots_.size(), std::move(cb)});
+  index_.emplace(id, Location{slot, std::prev(list.end())});
+  return id;
+}
+
+bool TimingWheel::cancel(TimerId id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = index_.find(id);
+  if (it == index_.end()) return false;
+  slots_[it->second.slot].erase(it->second.it);
+  index_.erase(it);
+  return true;
+}
+
+size_t TimingWheel::advance(Clock::time_point now) {
+  std::vector<Callback> due;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    while (cursor_time_ + tick_ <= now) {
+      cursor_time_ += tick_;
+      cursor_ = (cursor_ + 1) % slots_.size();
+      auto& list = slots_[cursor_];
+      for (auto it = list.begin(); it != list.end();) {
+        if (it->rounds > 0) {
+          it->rounds--;
+          ++it;
+          continue;
+        }
+        due.push_back(std::move(it->cb));
+        index_.erase(it->id);
+        it = list.erase(it);
+      }
+    }
+  }
+  for (auto& cb : due) cb();
+  return due.size();
+}
+
+size_t TimingWheel::pending() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return index_.size();
+}
+
+} // namespace fsx::transfer
@@ -0,0 +1,60 @@
+#include "fsx/transfer/throttler.h"
+#include <algorithm>
+
+namespace fsx::transfer {
+
+namespace {
+
+int64_t bytes_to_ns(uint64_t bytes, uint64_t rate) {
+  return static_cast<int64_t>(static_cast<unsigned __int128>(bytes) * 1000000000u / rate);
+}
+
+} // namespace
+
+void TokenBucket::reset(uint64_t rate_bytes_per_sec, uint64_t burst_bytes) {
+  rate_ = rate_bytes_per_sec;
+  tolerance_ns_ = rate_ ? bytes_to_ns(burst_bytes, rate_) : 0;
+  tat_.store(0, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds TokenBucket::consume(uint64_t bytes, int64_t now_ns) {
+  if (rate_ == 0) return std::chrono::nanoseconds(0);
+  int64_t cost = bytes_to_ns(bytes, rate_);
+  int64_t tat = tat_.load(std::memory_order_relaxed);
+  int64_t next;
+  do {
+    // An idle bucket doesn't bank more than the burst: tat never lags now
+    next = std::max(tat, now_ns) + cost;
+  } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+  int64_t wait = next - tolerance_ns_ - now_ns;
+  return std::chrono::nanoseconds(wait > 0 ? wait : 0);
+}
+
+Throttler::Throttler(const RateLimits& limits)
+  : limits_(limits), global_(limits.global_bps, limits.burst_bytes) {}
+
+std::shared_ptr<TokenBucket> Throttler::user_bucket(long long user_id) {
+  if (limits_.user_bps == 0) return nullptr;
+  std::lock_guard<std::mutex> lock(users_mu_);
+  auto& slot = users_[user_id];
+  auto bucket = slot.lock();
+  if (!bucket) {
+    // Drop entries of users that went away while we're here
+    for (auto it = users_.begin(); it != users_.end();) {
+      it = it->second.expired() && it->first != user_id ? users_.erase(it) : std::next(it);
+    }
+    bucket = std::make_shared<TokenBucket>(limits_.user_bps, limits_.burst_bytes);
+    users_[user_id] = bucket;
+  }
+  return bucket;
+}
+
+std::chrono::nanoseconds Throttler::consume(TokenBucket* user, TokenBucket* transfer, uint64_t bytes) {
+  int64_t now = now_ns();
+  auto wait = global_.consume(bytes, now);
+  if (user) wait = std::max(wait, user->consume(bytes, now));
+  if (transfer) wait = std::max(wait, transfer->consume(bytes, now));
+  return wait;
+}
+
+} // namespace fsx::transfer
@@ -1,5 +1,11 @@
 #include "fsx/transfer/transfer_manager.h"
+#include "fsx/storage/file_store.h"
+#include "fsx/storage/resume_store.h"
+#include "fsx/storage/transfer_store.h"
+#include "fsx/protocol/file_messages.h"
 #include <algorithm>
+#include <filesystem>
+#include <iostream>
 
 namespace fsx::transfer {
 
@@ -26,12 +32,11 @@ uint64_t TransferManager::create_transfer(
   uint64_t file_size,
   uint32_t chunk_size
 ) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  
   uint64_t transfer_id = generate_transfer_id();
   
   auto session = std::make_shared<TransferSession>();
   session->transfer_id = transfer_id;
+  if (throttler_) throttler_->init_transfer_bucket(session->throttle);
   session->sender_user_id = sender_user_id;
   session->sender_username = sender_username;
   session->sender_token = sender_token;
@@ -40,11 +45,17 @@ uint64_t TransferManager::create_transfer(
   session->filename = filename;
   session->file_size = file_size;
   session->chunk_size = chunk_size;
+  session->total_chunks = chunk_size ? static_cast<uint32_t>((file_size + chunk_size - 1) / chunk_size) : 0;
+  session->received = ChunkBitmap(session->total_chunks);
   session->state = TransferState::OFFERED;
   session->expected_chunk_index = 0;
   session->bytes_received = 0;
   
-  transfers_[transfer_id] = session;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    transfers_[transfer_id] = session;
+  }
+  persist(*session);
   
   return transfer_id;
 }
@@ -59,35 +70,238 @@ std::shared_ptr<TransferSession> TransferManager::get_transfer(uint64_t transfer
 }
 
 bool TransferManager::update_state(uint64_t transfer_id, TransferState new_state) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = transfers_.find(transfer_id);
-  if (it != transfers_.end()) {
-    it->second->state = new_state;
-    return true;
+  auto session = get_transfer(transfer_id);
+  if (!session) return false;
+  session->state = new_state;
+  
+  // Finished either way: nothing left to resume
+  if ((new_state == TransferState::COMPLETED || new_state == TransferState::FAILED) && resume_store_) {
+    std::lock_guard<std::mutex> lock(session->mu);
+    if (session->resume) {
+      session->resume.reset();
+      resume_store_->remove(transfer_id);
+    }
   }
-  return false;
+  // A failed dedup transfer will never write its manifest: give back the
+  // blocks it holds (cleared so a second FAILED doesn't repeat it)
+  if (new_state == TransferState::FAILED && session->dedup && block_store_) {
+    std::lock_guard<std::mutex> lock(session->mu);
+    for (uint32_t i = session->received.next_set(0); i < session->received.size();
+         i = session->received.next_set(i + 1)) {
+      block_store_->unref(session->blocks[i].id);
+    }
+    session->received = ChunkBitmap(session->total_chunks);
+  }
+  persist(*session);
+  return true;
 }
 
-bool TransferManager::mark_chunk_received(uint64_t transfer_id, uint32_t chunk_index, size_t chunk_bytes) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = transfers_.find(transfer_id);
-  if (it != transfers_.end()) {
-    auto& session = it->second;
-    // For MVP: simple sequential check (Phase 4 will add proper validation)
-    if (chunk_index == session->expected_chunk_index) {
-      session->expected_chunk_index++;
-      session->bytes_received += chunk_bytes;
-      if (session->state == TransferState::ACCEPTED) {
-        session->state = TransferState::RECEIVING;
+void TransferManager::persist(const TransferSession& session) {
+  if (!transfer_store_) return;
+  // A relay without tee has no .part file, so nothing survives a restart
+  if (session.relay && !session.file_handle) {
+    transfer_store_->remove(session.transfer_id);
+    return;
+  }
+  // Unfinished dedup transfers hold block references that only live in
+  // memory; BlockStore::initialize drops their blocks after a restart
+  if (session.dedup && session.state.load() != TransferState::COMPLETED) {
+    transfer_store_->remove(session.transfer_id);
+    return;
+  }
+  fsx::storage::TransferRecord r;
+  r.transfer_id = session.transfer_id;
+  r.sender_user_id = session.sender_user_id;
+  r.sender_username = session.sender_username;
+  r.receiver_user_id = session.receiver_user_id;
+  r.receiver_username = session.receiver_username;
+  r.filename = session.filename;
+  r.file_size = session.file_size;
+  r.chunk_size = session.chunk_size;
+  r.features = session.features;
+  r.window_bytes = session.window_bytes;
+  r.codec = session.codec;
+  r.relay = session.relay;
+  r.dedup = session.dedup;
+  if (session.has_sha256) r.sha256 = fsx::crypto::to_hex(session.sha256);
+  r.state = static_cast<int>(session.state.load());
+  transfer_store_->save(r);
+}
+
+bool TransferManager::attach_resume(TransferSession& session) {
+  if (!resume_store_) return false;
+  auto bitmap = resume_store_->open(session.transfer_id, session.total_chunks);
+  if (!bitmap) return false;
+  std::lock_guard<std::mutex> lock(session.mu);
+  if (session.file_handle) session.file_handle->set_resume(bitmap);
+  session.resume = std::move(bitmap);
+  return true;
+}
+
+size_t TransferManager::restore(fsx::storage::FileStore& files) {
+  if (!transfer_store_) return 0;
+  
+  size_t restored = 0;
+  uint64_t max_id = 0;
+  for (const auto& r : transfer_store_->load_all()) {
+    max_id = std::max(max_id, r.transfer_id);
+    auto state = static_cast<TransferState>(r.state);
+    bool unfinished = state == TransferState::ACCEPTED || state == TransferState::RECEIVING;
+    if (!unfinished && state != TransferState::COMPLETED) continue;
+    
+    auto session = std::make_shared<TransferSession>();
+    session->transfer_id = r.transfer_id;
+    if (throttler_) throttler_->init_transfer_bucket(session->throttle);
+    session->sender_user_id = r.sender_user_id;
+    session->sender_username = r.sender_username;
+    session->receiver_user_id = r.receiver_user_id;
+    session->receiver_username = r.receiver_username;
+    session->filename = r.filename;
+    session->file_size = r.file_size;
+    session->chunk_size = r.chunk_size;
+    session->total_chunks = r.chunk_size ? static_cast<uint32_t>((r.file_size + r.chunk_size - 1) / r.chunk_size) : 0;
+    session->received = ChunkBitmap(session->total_chunks);
+    session->features = r.features;
+    session->window_bytes = r.window_bytes;
+    session->codec = static_cast<uint8_t>(r.codec);
+    session->temp_file_path = files.get_temp_path(r.transfer_id, r.filename);
+    session->final_file_path = files.get_file_path(r.transfer_id, r.filename);
+    // The receiver's old connection is gone: a tee'd relay carries on as a
+    // stored transfer
+    session->relay = false;
+    session->has_sha256 = fsx::crypto::from_hex(r.sha256, &session->sha256);
+    
+    if (state == TransferState::COMPLETED && r.dedup) {
+      session->dedup = true;
+      session->final_file_path += ".manifest";
+      if (!fsx::storage::BlockStore::read_manifest(session->final_file_path, &session->blocks)) continue;
+      session->total_chunks = static_cast<uint32_t>(session->blocks.size());
+      session->state = TransferState::COMPLETED;
+    } else if (state == TransferState::COMPLETED) {
+      if (!std::filesystem::exists(session->final_file_path)) continue;
+      session->state = TransferState::COMPLETED;
+    } else {
+      session->resume = resume_store_ ? resume_store_->open(r.transfer_id, session->total_chunks) : nullptr;
+      session->file_handle = session->resume
+          ? files.open_for_write(r.transfer_id, r.filename, r.file_size, r.chunk_size, /*resume=*/true)
+          : nullptr;
+      if (!session->file_handle) {
+        std::cerr << "[TransferManager] Cannot resume transfer " << r.transfer_id << "\n";
+        session->state = TransferState::FAILED;
+        persist(*session);
+        continue;
+      }
+      session->file_handle->set_resume(session->resume);
+      session->received.assign_words(session->resume->words(), session->resume->word_count());
+      uint32_t count = session->received.count();
+      session->bytes_received = static_cast<uint64_t>(count) * r.chunk_size;
+      if (count > 0 && session->received.test(session->total_chunks - 1)) {
+        // The last chunk is usually short
+        session->bytes_received -= static_cast<uint64_t>(session->total_chunks) * r.chunk_size - r.file_size;
       }
-      return true;
+      session->expected_chunk_index = session->received.next_unset(0);
+      session->state = count > 0 ? TransferState::RECEIVING : TransferState::ACCEPTED;
+      // The hash state is gone: FILE_DONE reads back what was stored before
+      if (r.features & fsx::protocol::FILE_FEATURE_INTEGRITY) {
+        session->digest = std::make_shared<FileDigest>(digest_buffer_bytes_);
+      }
+    }
+    
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      transfers_[r.transfer_id] = session;
     }
-    // Out of order chunk (will be handled in Phase 4 with retransmission)
-    return false;
+    restored++;
+  }
+  
+  uint64_t next = next_transfer_id_.load();
+  if (max_id >= next) next_transfer_id_.store(max_id + 1);
+  return restored;
+}
+
+std::vector<uint8_t> TransferManager::setup_dedup(TransferSession& session,
+                                                  std::vector<fsx::storage::BlockRef> blocks) {
+  std::vector<uint8_t> present((blocks.size() + 7) / 8, 0);
+  {
+    std::lock_guard<std::mutex> lock(session.mu);
+    session.dedup = true;
+    session.blocks = std::move(blocks);
+    session.total_chunks = static_cast<uint32_t>(session.blocks.size());
+    session.received = ChunkBitmap(session.total_chunks);
+    for (uint32_t i = 0; i < session.total_chunks; i++) {
+      if (!block_store_->ref_if_present(session.blocks[i].id)) continue;
+      session.received.set(i);
+      session.bytes_received += session.blocks[i].length;
+      present[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+    }
+    session.expected_chunk_index = session.received.next_unset(0);
+  }
+  persist(session);
+  return present;
+}
+
+bool TransferManager::mark_chunk_received(uint64_t transfer_id, uint32_t chunk_index, size_t chunk_bytes,
+                                          std::function<void()>* on_complete) {
+  auto session = get_transfer(transfer_id);
+  if (!session) return false;
+  
+  std::lock_guard<std::mutex> lock(session->mu);
+  if (!session->received.set(chunk_index)) return false;
+  if (session->resume) session->resume->set(chunk_index);
+  session->bytes_received += chunk_bytes;
+  session->received_end = std::max(session->received_end, chunk_index + 1);
+  session->nack_attempts.erase(chunk_index);
+  if (chunk_index == session->expected_chunk_index) {
+    session->expected_chunk_index = session->received.next_unset(chunk_index + 1);
+    session->nack_round = 0;  // the front moved: retransmission works
   }
+  TransferState accepted = TransferState::ACCEPTED;
+  session->state.compare_exchange_strong(accepted, TransferState::RECEIVING);
+  if (session->received.all() && session->on_complete) {
+    if (on_complete) *on_complete = std::move(session->on_complete);
+    session->on_complete = nullptr;
+  }
+  return true;
+}
+
+bool TransferManager::complete_or_defer(TransferSession& session, std::function<void()> on_complete) {
+  std::lock_guard<std::mutex> lock(session.mu);
+  if (session.received.all()) return true;
+  session.on_complete = std::move(on_complete);
   return false;
 }
 
+void TransferManager::ack_state(const TransferSession& session, uint32_t* cumulative,
+                                std::vector<uint8_t>* sack, size_t max_sack_bytes) const {
+  std::lock_guard<std::mutex> lock(session.mu);
+  *cumulative = session.expected_chunk_index;
+  *sack = session.received.range_bytes(session.expected_chunk_index + 1, max_sack_bytes);
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> TransferManager::missing_ranges(const TransferSession& session,
+                                                                           size_t max_ranges) const {
+  std::vector<std::pair<uint32_t, uint32_t>> out;
+  std::lock_guard<std::mutex> lock(session.mu);
+  const auto& received = session.received;
+  uint32_t end = session.on_complete ? received.size() : session.received_end;
+  uint32_t i = session.expected_chunk_index;
+  while (i < end && out.size() < max_ranges) {
+    uint32_t stop = std::min(received.next_set(i), end);
+    out.emplace_back(i, stop - i);
+    i = received.next_unset(stop);
+  }
+  return out;
+}
+
+bool TransferManager::count_nack(TransferSession& session, uint32_t first, uint32_t count) {
+  std::lock_guard<std::mutex> lock(session.mu);
+  bool ok = true;
+  for (uint32_t i = first; i - first < count; i++) {
+    if (++session.nack_attempts[i] > retransmit_policy_.max_attempts) ok = false;
+  }
+  return ok;
+}
+
 bool TransferManager::remove_transfer(uint64_t transfer_id) {
   std::lock_guard<std::mutex> lock(mutex_);
   return transfers_.erase(transfer_id) > 0;
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Server CPU cost of FILE_FETCH downloads (sendfile path)
+# Uploads one file, then has CONCURRENCY receivers download it REPEAT times
+# each while sampling fsx_core utime+stime from /proc, and reports
+# CPU-seconds per GB served alongside client-side GB/s.
+#
+# Requires: postgres reachable via FSX_DB_* (e.g. docker compose up -d db),
+#           core/build/fsx_core and client/build/bench_load built.
+
+PORT="${1:-9500}"
+FILE_MB="${FILE_MB:-512}"
+CONCURRENCY="${CONCURRENCY:-8}"
+REPEAT="${REPEAT:-4}"
+
+CORE=./core/build/fsx_core
+BENCH=./client/build/bench_load
+
+if [ ! -x "$CORE" ] || [ ! -x "$BENCH" ]; then
+    echo "ERROR: build core and client first ($CORE, $BENCH)"
+    exit 1
+fi
+
+STORAGE_DIR=$(mktemp -d)
+trap 'kill $CORE_PID 2>/dev/null; rm -rf "$STORAGE_DIR"' EXIT
+
+(cd "$STORAGE_DIR" && FSX_TCP_PORT=$PORT exec "$OLDPWD/$CORE" > core.log 2>&1) &
+CORE_PID=$!
+sleep 1
+
+./client/build/test_auth register benchsender pass123 benchsender@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+./client/build/test_auth register benchreceiver pass123 benchreceiver@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+
+TID=$($BENCH upload benchsender pass123 benchreceiver pass123 1 "$FILE_MB" 127.0.0.1 "$PORT" \
+      | grep -oP 'last_transfer_id=\K[0-9]+')
+if [ -z "$TID" ] || [ "$TID" = "0" ]; then
+    echo "ERROR: upload failed"
+    exit 1
+fi
+
+# utime + stime in clock ticks (fields 14 and 15 of /proc/<pid>/stat)
+cpu_ticks() {
+    awk '{print $14 + $15}' "/proc/$CORE_PID/stat"
+}
+
+TICKS_BEFORE=$(cpu_ticks)
+OUT=$($BENCH fetch benchreceiver pass123 "$TID" "$CONCURRENCY" "$REPEAT" 127.0.0.1 "$PORT")
+TICKS_AFTER=$(cpu_ticks)
+echo "$OUT"
+
+HZ=$(getconf CLK_TCK)
+GB=$(echo "$OUT" | grep -oP ' gb=\K[0-9.]+')
+GBPS=$(echo "$OUT" | grep -oP 'aggregate_gb_per_sec=\K[0-9.]+')
+awk -v t=$((TICKS_AFTER - TICKS_BEFORE)) -v hz="$HZ" -v gb="$GB" -v gbps="$GBPS" \
+    'BEGIN { cpu = t / hz; printf "gb=%.2f gb_per_sec=%.2f server_cpu_sec=%.2f cpu_sec_per_gb=%.3f\n", gb, gbps, cpu, (gb > 0 ? cpu / gb : 0) }'
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Acceptance benchmark for the io_context pool (FSX_IO_THREADS)
+# Starts a local fsx_core for each thread count and measures
+# connections/sec and aggregate FILE_CHUNK throughput with client/build/bench_load.
+#
+# Requires: postgres reachable via FSX_DB_* (e.g. docker compose up -d db),
+#           core/build/fsx_core and client/build/bench_load built.
+
+PORT="${1:-9500}"
+THREADS="${THREADS:-1 2 4 8 16}"
+CONNS="${CONNS:-5000}"
+CONCURRENCY="${CONCURRENCY:-64}"
+STREAMS="${STREAMS:-16}"
+MB_PER_STREAM="${MB_PER_STREAM:-64}"
+
+CORE=./core/build/fsx_core
+BENCH=./client/build/bench_load
+
+if [ ! -x "$CORE" ] || [ ! -x "$BENCH" ]; then
+    echo "ERROR: build core and client first ($CORE, $BENCH)"
+    exit 1
+fi
+
+STORAGE_DIR=$(mktemp -d)
+trap 'rm -rf "$STORAGE_DIR"' EXIT
+
+echo "threads,conn_per_sec,aggregate_mb_per_sec"
+for n in $THREADS; do
+    (cd "$STORAGE_DIR" && FSX_IO_THREADS=$n FSX_TCP_PORT=$PORT exec "$OLDPWD/$CORE" > core_$n.log 2>&1) &
+    CORE_PID=$!
+    sleep 1
+
+    ./client/build/test_auth register benchsender pass123 benchsender@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+    ./client/build/test_auth register benchreceiver pass123 benchreceiver@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+
+    CPS=$($BENCH connect "$CONNS" "$CONCURRENCY" 127.0.0.1 "$PORT" | grep -oP 'conn_per_sec=\K[0-9.]+')
+    MBPS=$($BENCH upload benchsender pass123 benchreceiver pass123 "$STREAMS" "$MB_PER_STREAM" 127.0.0.1 "$PORT" \
+           | grep -oP 'aggregate_mb_per_sec=\K[0-9.]+')
+    echo "$n,$CPS,$MBPS"
+
+    kill $CORE_PID 2>/dev/null
+    wait $CORE_PID 2>/dev/null
+    rm -rf "$STORAGE_DIR/storage"
+done
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Upload throughput vs. round-trip time with FILE_CHUNK_ACK flow control
+# Adds a netem delay on loopback for each RTT (half each way; loopback
+# traffic crosses lo twice) and runs a single-stream upload against a local
+# fsx_core for each server send window (FSX_TRANSFER_WINDOW_KB).
+# Expect throughput ~ window / RTT until the link or disk caps it.
+#
+# Requires: root (tc qdisc on lo), postgres reachable via FSX_DB_*
+#           (e.g. docker compose up -d db), core/build/fsx_core and
+#           client/build/bench_load built.
+
+PORT="${1:-9500}"
+RTTS_MS="${RTTS_MS:-1 10 50 100 200}"
+WINDOWS_KB="${WINDOWS_KB:-1024 8192 65536}"
+MB="${MB:-256}"
+
+CORE=./core/build/fsx_core
+BENCH=./client/build/bench_load
+
+if [ ! -x "$CORE" ] || [ ! -x "$BENCH" ]; then
+    echo "ERROR: build core and client first ($CORE, $BENCH)"
+    exit 1
+fi
+if ! tc qdisc show dev lo > /dev/null 2>&1; then
+    echo "ERROR: tc (iproute2) not usable; run as root"
+    exit 1
+fi
+
+STORAGE_DIR=$(mktemp -d)
+cleanup() {
+    tc qdisc del dev lo root 2>/dev/null
+    kill $CORE_PID 2>/dev/null
+    rm -rf "$STORAGE_DIR"
+}
+trap cleanup EXIT
+
+echo "window_kb,rtt_ms,mb_per_sec"
+for w in $WINDOWS_KB; do
+    (cd "$STORAGE_DIR" && FSX_TRANSFER_WINDOW_KB=$w FSX_TCP_PORT=$PORT exec "$OLDPWD/$CORE" > core_$w.log 2>&1) &
+    CORE_PID=$!
+    sleep 1
+
+    ./client/build/test_auth register benchsender pass123 benchsender@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+    ./client/build/test_auth register benchreceiver pass123 benchreceiver@example.com 127.0.0.1 $PORT > /dev/null 2>&1
+
+    for rtt in $RTTS_MS; do
+        half=$(awk -v r="$rtt" 'BEGIN { printf "%.1f", r / 2 }')
+        tc qdisc replace dev lo root netem delay "${half}ms" limit 100000
+        MBPS=$($BENCH upload benchsender pass123 benchreceiver pass123 1 "$MB" 127.0.0.1 "$PORT" \
+               | grep -oP 'aggregate_mb_per_sec=\K[0-9.]+')
+        tc qdisc del dev lo root 2>/dev/null
+        echo "$w,$rtt,$MBPS"
+        rm -rf "$STORAGE_DIR/storage/transfers"/*
+    done
+
+    kill $CORE_PID 2>/dev/null
+    wait $CORE_PID 2>/dev/null
+    rm -rf "$STORAGE_DIR/storage"
+done
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Generates test inputs for transfers and the chunker/dedup benchmarks.
+#
+# Usage: python3 scripts/gen_test_files.py [out_dir] [size_mb]
+#   defaults: ./test_files, 64 MB per file
+#
+# Files:
+#   random.bin       incompressible bytes
+#   text.txt         word soup (compressible, like logs or source)
+#   zeros.bin        all zero bytes
+#   base.bin         random bytes, the original of a near-duplicate pair
+#   edited.bin       base.bin with a few small inserts, deletes and overwrites
+#                    (what delta transfer / dedup should mostly skip)
+# Output is deterministic (fixed seed), so runs are comparable.
+
+import os
+import random
+import sys
+
+WORDS = ("the quick brown fox jumps over lazy dog transfer chunk file server "
+         "client session token window relay resume offer accept done result "
+         "error retry timeout buffer socket stream frame header payload").split()
+
+
+def write_random(path, size, rng):
+    with open(path, "wb") as f:
+        left = size
+        while left > 0:
+            n = min(left, 1 << 20)
+            f.write(rng.randbytes(n))
+            left -= n
+
+
+def write_text(path, size, rng):
+    with open(path, "wb") as f:
+        left = size
+        while left > 0:
+            line = (" ".join(rng.choice(WORDS) for _ in range(rng.randint(4, 16))) + "\n").encode()
+            line = line[:left]
+            f.write(line)
+            left -= len(line)
+
+
+def write_zeros(path, size):
+    with open(path, "wb") as f:
+        f.truncate(size)
+
+
+def write_edited(src, dst, rng, edits=16):
+    data = bytearray(open(src, "rb").read())
+    for _ in range(edits):
+        pos = rng.randrange(len(data))
+        kind = rng.choice(("insert", "delete", "overwrite"))
+        n = rng.randint(1, 512)
+        if kind == "insert":
+            data[pos:pos] = rng.randbytes(n)
+        elif kind == "delete":
+            del data[pos:pos + n]
+        else:
+            data[pos:pos + n] = rng.randbytes(len(data[pos:pos + n]))
+    with open(dst, "wb") as f:
+        f.write(data)
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) >= 2 else "./test_files"
+    size = (int(sys.argv[2]) if len(sys.argv) >= 3 else 64) * 1024 * 1024
+    os.makedirs(out_dir, exist_ok=True)
+    rng = random.Random(42)
+
+    write_random(os.path.join(out_dir, "random.bin"), size, rng)
+    write_text(os.path.join(out_dir, "text.txt"), size, rng)
+    write_zeros(os.path.join(out_dir, "zeros.bin"), size)
+    write_random(os.path.join(out_dir, "base.bin"), size, rng)
+    write_edited(os.path.join(out_dir, "base.bin"), os.path.join(out_dir, "edited.bin"), rng)
+
+    for name in sorted(os.listdir(out_dir)):
+        path = os.path.join(out_dir, name)
+        print(f"{path} {os.path.getsize(path)} bytes")
+
+
+if __name__ == "__main__":
+    main()